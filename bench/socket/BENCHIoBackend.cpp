@@ -0,0 +1,159 @@
+/**
+ * @file BENCHIoBackend.cpp
+ * @brief Loopback comparison of the EPOLL and IO_URING backends.
+ *
+ * Measures multi-client TCP ingest into one LinuxTCPSocket server and the
+ * receive rate of a UDPSocket fed Reed-Solomon protected datagrams, whose
+ * shards the io_uring backend sends in one submission.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "socket/IoUring.h"
+#include "socket/TCP/LinuxTCP/LinuxTCPSocket.h"
+#include "socket/UDP/UDPSocket.h"
+
+namespace {
+
+const int kTcpPort = 47011;
+const int kUdpSenderPort = 47012;
+const int kUdpReceiverPort = 47013;
+
+const char *backendName(IoBackend backend) {
+  return backend == IoBackend::IO_URING ? "io_uring" : "epoll";
+}
+
+class ByteCounter : public Subscriber {
+ public:
+  std::atomic<size_t> bytes{0};
+
+  void update(Serializable data) override {
+    bytes += static_cast<std::vector<uint8_t>>(data).size();
+  }
+};
+
+// TCP: several clients stream small messages into one server.
+void benchTcp(IoBackend backend) {
+  const int clients = 4;
+  const int messages = 50000;
+  const size_t size = 64;
+
+  LinuxTCPSocket server("127.0.0.1", kTcpPort, 0, TCPSocket::SERVER, 3, 1);
+  server.setIoBackend(backend);
+  auto counter = std::make_shared<ByteCounter>();
+  server.addSubscriber(counter);
+  server.open();
+
+  std::vector<std::unique_ptr<LinuxTCPSocket>> peers;
+  for (int i = 0; i < clients; ++i) {
+    peers.emplace_back(new LinuxTCPSocket("127.0.0.1", 0, kTcpPort,
+                                          TCPSocket::CLIENT, 3, 1));
+    peers.back()->setIoBackend(backend);
+    peers.back()->open();
+  }
+
+  const size_t expected = static_cast<size_t>(clients) * messages * size;
+  const Serializable message(std::vector<uint8_t>(size, 0x5a));
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < messages; ++i) {
+    for (auto &peer : peers) peer->write(message);
+  }
+  auto deadline = start + std::chrono::seconds(30);
+  while (counter->bytes < expected &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+  }
+  double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+
+  std::printf("tcp  %-8s  %d clients  %8.1f MB/s  %8.1f kmsg/s  received "
+              "%6.2f%%\n",
+              backendName(server.getIoBackend()), clients,
+              counter->bytes / seconds / 1e6,
+              counter->bytes / size / seconds / 1e3,
+              100.0 * counter->bytes / expected);
+  peers.clear();
+  server.close();
+}
+
+// UDP: one receiver reading FEC-protected datagrams as fast as they come.
+void benchUdp(IoBackend backend) {
+  const int messages = 50000;
+  const size_t size = 1200;
+
+  FecConfig fec;
+  fec.scheme = FecScheme::REED_SOLOMON;
+  fec.dataShards = 8;
+  fec.parityShards = 2;
+  UDPSocket sender("127.0.0.1", kUdpSenderPort, kUdpReceiverPort);
+  UDPSocket receiver("127.0.0.1", kUdpReceiverPort, kUdpSenderPort);
+  sender.setIoBackend(backend);
+  receiver.setIoBackend(backend);
+  sender.setFec(fec);
+  receiver.setFec(fec);
+  sender.open();
+  receiver.open();
+
+  std::atomic<bool> done{false};
+  std::atomic<int> received{0};
+  std::chrono::steady_clock::time_point last;
+  std::thread reader([&] {
+    while (true) {
+      if (receiver.read().empty()) {
+        if (done) break;
+        continue;
+      }
+      ++received;
+      last = std::chrono::steady_clock::now();
+    }
+  });
+
+  const Serializable message(std::vector<uint8_t>(size, 0xa5));
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < messages; ++i) {
+    sender.write(message);
+    // Keep loopback buffers from overflowing so both backends see the
+    // same offered load.
+    if (i % 64 == 63) {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  }
+  auto sent = std::chrono::steady_clock::now();
+  done = true;
+  reader.join();
+
+  std::printf("udp  %-8s  rs 8+2     send %7.1f kmsg/s  receive %7.1f "
+              "kmsg/s  delivered %6.2f%%\n",
+              backendName(receiver.getIoBackend()),
+              messages / std::chrono::duration<double>(sent - start).count() /
+                  1e3,
+              received / std::chrono::duration<double>(last - start).count() /
+                  1e3,
+              100.0 * received / messages);
+  sender.close();
+  receiver.close();
+}
+
+}  // namespace
+
+int main() {
+  spdlog::set_level(spdlog::level::off);
+#ifdef SOCKET_LIB_HAS_IO_URING
+  const bool uring = IoUring::supported();
+#else
+  const bool uring = false;
+#endif
+  if (!uring) std::printf("io_uring not supported here, epoll only\n");
+  for (IoBackend backend : {IoBackend::EPOLL, IoBackend::IO_URING}) {
+    if (backend == IoBackend::IO_URING && !uring) continue;
+    benchTcp(backend);
+    benchUdp(backend);
+  }
+  return 0;
+}
@@ -0,0 +1,104 @@
+/**
+ * @file BENCHRuntime.cpp
+ * @brief Cross-core handoff through Runtime::post() versus a mutex-guarded
+ * queue drained by a condition-variable thread.
+ *
+ * Producers on every core hand small tasks to core 0, which counts them.
+ * The figures only mean something with a CPU per core; on a single CPU all
+ * threads take turns and both paths are dominated by scheduling.
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "socket/Runtime.h"
+
+namespace {
+
+const int kTasksPerProducer = 200000;
+
+using Clock = std::chrono::steady_clock;
+
+void report(const char *name, int producers, Clock::duration elapsed) {
+  double seconds = std::chrono::duration<double>(elapsed).count();
+  std::printf("%-12s %d producers  %8.2f Mtasks/s\n", name, producers,
+              producers * kTasksPerProducer / seconds / 1e6);
+}
+
+void runtimePost(Runtime &runtime, int producers) {
+  std::atomic<int> done{0};
+  std::promise<void> finished;
+  int total = producers * kTasksPerProducer;
+  auto start = Clock::now();
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&]() {
+      for (int i = 0; i < kTasksPerProducer; ++i) {
+        while (!runtime.post(0, [&]() {
+          if (++done == total) finished.set_value();
+        })) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  finished.get_future().wait();
+  for (auto &thread : threads) thread.join();
+  report("post()", producers, Clock::now() - start);
+}
+
+void mutexQueue(int producers) {
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::deque<std::function<void()>> queue;
+  int total = producers * kTasksPerProducer;
+  int done = 0;
+  auto start = Clock::now();
+  std::thread consumer([&]() {
+    while (done < total) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock, [&]() { return !queue.empty(); });
+        task = std::move(queue.front());
+        queue.pop_front();
+      }
+      task();
+    }
+  });
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&]() {
+      for (int i = 0; i < kTasksPerProducer; ++i) {
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          queue.emplace_back([&]() { ++done; });
+        }
+        ready.notify_one();
+      }
+    });
+  }
+  for (auto &thread : threads) thread.join();
+  consumer.join();
+  report("mutex queue", producers, Clock::now() - start);
+}
+
+}  // namespace
+
+int main() {
+  spdlog::set_level(spdlog::level::off);
+  Runtime runtime;
+  std::printf("%zu cores\n", runtime.cores());
+  for (int producers : {1, 2, 4}) {
+    runtimePost(runtime, producers);
+    mutexQueue(producers);
+  }
+  return 0;
+}
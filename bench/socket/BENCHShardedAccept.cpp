@@ -0,0 +1,102 @@
+/**
+ * @file BENCHShardedAccept.cpp
+ * @brief Loopback connection rate of one LinuxTCPSocket server versus a
+ * ShardedTCPServer with one shard per CPU.
+ *
+ * Client threads connect, send one request, wait for the echo and close,
+ * as fast as they can; the rate counts completed exchanges.
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "socket/TCP/LinuxTCP/LinuxTCPSocket.h"
+#include "socket/TCP/LinuxTCP/ShardedTCPServer.h"
+
+namespace {
+
+const int kSinglePort = 47031;
+const int kShardedPort = 47032;
+const int kClients = 8;
+const std::chrono::seconds kDuration(2);
+
+template <typename Server>
+class Echo : public Subscriber {
+ public:
+  explicit Echo(Server *server) : server(server) {}
+
+  void update(Serializable) override {}
+
+  void update(Serializable data, ConnectionId connection) override {
+    server->writeTo(connection, data);
+  }
+
+ private:
+  Server *server;
+};
+
+// Returns completed connect/request/close exchanges per second.
+double hammer(int port) {
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> exchanges{0};
+  std::vector<std::thread> clients;
+  for (int i = 0; i < kClients; ++i) {
+    clients.emplace_back([&] {
+      sockaddr_in address{};
+      address.sin_family = AF_INET;
+      address.sin_port = htons(port);
+      address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      char byte = 'x';
+      // Close with a reset so TIME_WAIT does not exhaust the ports.
+      linger reset{1, 0};
+      while (!stop) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+        if (connect(fd, reinterpret_cast<sockaddr *>(&address),
+                    sizeof(address)) == 0 &&
+            send(fd, &byte, 1, 0) == 1 && recv(fd, &byte, 1, 0) == 1) {
+          ++exchanges;
+        }
+        ::close(fd);
+      }
+    });
+  }
+  std::this_thread::sleep_for(kDuration);
+  stop = true;
+  for (auto &client : clients) client.join();
+  return exchanges / std::chrono::duration<double>(kDuration).count();
+}
+
+}  // namespace
+
+int main() {
+  spdlog::set_level(spdlog::level::off);
+
+  LinuxTCPSocket single("127.0.0.1", kSinglePort, 0, TCPSocket::SERVER, 3, 1);
+  single.addSubscriber(std::make_shared<Echo<LinuxTCPSocket>>(&single));
+  single.open();
+  std::printf("single loop   %8.0f conn/s\n", hammer(kSinglePort));
+  single.close();
+
+  ShardedTCPServer sharded(kShardedPort);
+  sharded.addSubscriber(std::make_shared<Echo<ShardedTCPServer>>(&sharded));
+  sharded.open();
+  std::printf("%2zu shards     %8.0f conn/s\n", sharded.shardCount(),
+              hammer(kShardedPort));
+  for (const ShardStats &stats : sharded.getShardStats()) {
+    std::printf("  cpu %2d  accepted %8llu  bytes in %8llu\n", stats.cpu,
+                static_cast<unsigned long long>(stats.accepted),
+                static_cast<unsigned long long>(stats.bytesIn));
+  }
+  sharded.close();
+  return 0;
+}
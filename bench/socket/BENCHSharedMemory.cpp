@@ -0,0 +1,121 @@
+/**
+ * @file BENCHSharedMemory.cpp
+ * @brief Round trip between two processes through a SharedMemorySocket
+ * versus UDP over loopback.
+ *
+ * A forked child echoes every message back; the parent sends the next one
+ * once the echo arrives. Half the round trip approximates the one-way
+ * latency. Busy-polling needs a CPU per process to show its benefit, so on a
+ * single CPU the socket goes straight to the futex.
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "socket/SharedMemory/SharedMemorySocket.h"
+
+namespace {
+
+const char *kSegment = "/socketlib-bench";
+const int kUdpPort = 47041;
+const int kRounds = 20000;
+const size_t kMessageSize = 64;
+
+using Clock = std::chrono::steady_clock;
+
+void report(const char *name, std::vector<double> &rtts) {
+  std::sort(rtts.begin(), rtts.end());
+  std::printf("%-14s one-way p50 %8.2f us  p99 %8.2f us\n", name,
+              rtts[rtts.size() / 2] / 2, rtts[rtts.size() * 99 / 100] / 2);
+}
+
+double micros(Clock::duration elapsed) {
+  return std::chrono::duration<double, std::micro>(elapsed).count();
+}
+
+void sharedMemory(const char *name, const ShmRingConfig &config) {
+  SharedMemorySocket parent(kSegment, SharedMemorySocket::CREATOR, config);
+  parent.open();
+  pid_t child = fork();
+  if (child == 0) {
+    SharedMemorySocket echo(kSegment, SharedMemorySocket::ATTACH, config);
+    echo.open();
+    for (int i = 0; i < kRounds; ++i) echo.write(echo.read());
+    _exit(0);
+  }
+  std::vector<uint8_t> message(kMessageSize, 'x');
+  std::vector<double> rtts;
+  for (int i = 0; i < kRounds; ++i) {
+    auto start = Clock::now();
+    // Built in place in the ring.
+    ShmSlot slot = parent.reserve(message.size());
+    std::copy(message.begin(), message.end(), slot.data);
+    parent.commit(slot);
+    parent.read();
+    rtts.push_back(micros(Clock::now() - start));
+  }
+  waitpid(child, nullptr, 0);
+  parent.close();
+  report(name, rtts);
+}
+
+void udpLoopback() {
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(kUdpPort);
+  int server = socket(AF_INET, SOCK_DGRAM, 0);
+  bind(server, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+  pid_t child = fork();
+  if (child == 0) {
+    char buffer[kMessageSize];
+    sockaddr_in peer{};
+    for (int i = 0; i < kRounds; ++i) {
+      socklen_t length = sizeof(peer);
+      ssize_t received =
+          recvfrom(server, buffer, sizeof(buffer), 0,
+                   reinterpret_cast<sockaddr *>(&peer), &length);
+      sendto(server, buffer, received, 0, reinterpret_cast<sockaddr *>(&peer),
+             length);
+    }
+    _exit(0);
+  }
+  int client = socket(AF_INET, SOCK_DGRAM, 0);
+  connect(client, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+  std::vector<uint8_t> message(kMessageSize, 'x');
+  std::vector<double> rtts;
+  for (int i = 0; i < kRounds; ++i) {
+    auto start = Clock::now();
+    send(client, message.data(), message.size(), 0);
+    recv(client, message.data(), message.size(), 0);
+    rtts.push_back(micros(Clock::now() - start));
+  }
+  waitpid(child, nullptr, 0);
+  close(client);
+  close(server);
+  report("udp loopback", rtts);
+}
+
+}  // namespace
+
+int main() {
+  spdlog::set_level(spdlog::level::off);
+
+  ShmRingConfig config;
+  config.capacity = 1 << 16;
+  sharedMemory("shm spin+futex", config);
+
+  config.spinIterations = 0;
+  sharedMemory("shm futex", config);
+
+  udpLoopback();
+  return 0;
+}
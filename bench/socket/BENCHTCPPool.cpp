@@ -0,0 +1,96 @@
+/**
+ * @file BENCHTCPPool.cpp
+ * @brief Loopback request latency with a connection per request versus a
+ * TCPConnectionPool.
+ *
+ * An echo server answers each request; the client side either opens and
+ * closes a LinuxTCPSocket around every exchange or borrows one from a
+ * pre-warmed pool.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "socket/TCP/LinuxTCP/LinuxTCPSocket.h"
+#include "socket/TCP/LinuxTCP/TCPConnectionPool.h"
+
+namespace {
+
+const int kPort = 47021;
+const int kRequests = 2000;
+
+class Echo : public Subscriber {
+ public:
+  explicit Echo(LinuxTCPSocket *server) : server(server) {}
+
+  void update(Serializable) override {}
+
+  void update(Serializable data, ConnectionId connection) override {
+    server->writeTo(connection, data);
+  }
+
+ private:
+  LinuxTCPSocket *server;
+};
+
+void report(const char *name, std::vector<double> &micros) {
+  std::sort(micros.begin(), micros.end());
+  double sum = 0;
+  for (double value : micros) sum += value;
+  std::printf("%-12s  mean %8.1f us  p50 %8.1f us  p99 %8.1f us\n", name,
+              sum / micros.size(), micros[micros.size() / 2],
+              micros[micros.size() * 99 / 100]);
+}
+
+}  // namespace
+
+int main() {
+  spdlog::set_level(spdlog::level::off);
+  LinuxTCPSocket server("127.0.0.1", kPort, 0, TCPSocket::SERVER, 3, 1);
+  server.addSubscriber(std::make_shared<Echo>(&server));
+  server.open();
+
+  const Serializable request(std::vector<uint8_t>(128, 0x42));
+  std::vector<double> micros;
+
+  for (int i = 0; i < kRequests / 10; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    LinuxTCPSocket client("127.0.0.1", 0, kPort, TCPSocket::CLIENT, 3, 1);
+    client.open();
+    client.write(request);
+    client.read();
+    client.close();
+    micros.push_back(std::chrono::duration<double, std::micro>(
+                         std::chrono::steady_clock::now() - start)
+                         .count());
+  }
+  report("per-request", micros);
+
+  TCPPoolConfig config;
+  config.minIdle = 2;
+  TCPConnectionPool pool(config);
+  pool.warm("127.0.0.1", kPort);
+  micros.clear();
+  for (int i = 0; i < kRequests; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    TCPConnectionPool::Handle connection = pool.acquire("127.0.0.1", kPort);
+    connection->write(request);
+    connection->read();
+    connection.release();
+    micros.push_back(std::chrono::duration<double, std::micro>(
+                         std::chrono::steady_clock::now() - start)
+                         .count());
+  }
+  report("pooled", micros);
+
+  TCPPoolStats stats = pool.getStats();
+  std::printf("pool: created %llu reused %llu\n",
+              static_cast<unsigned long long>(stats.created),
+              static_cast<unsigned long long>(stats.reused));
+  pool.close();
+  server.close();
+  return 0;
+}
@@ -0,0 +1,91 @@
+/**
+ * @file BENCHTimerWheel.cpp
+ * @brief Re-arming one deadline per connection on the TimerWheel versus an
+ * ordered std::set, the structure the Reactor used before.
+ *
+ * Each round moves every connection's deadline, the way a heartbeat or an
+ * idle timeout is pushed back on every receive, then expires whatever is
+ * due. No sockets are involved.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "socket/TimerWheel.h"
+
+namespace {
+
+const int kRounds = 20;
+
+using Clock = std::chrono::steady_clock;
+
+void report(const char *name, size_t connections, Clock::duration elapsed) {
+  double seconds = std::chrono::duration<double>(elapsed).count();
+  std::printf("%-10s %7zu timers  %7.1f ns per re-arm\n", name, connections,
+              seconds * 1e9 / (connections * kRounds));
+}
+
+// Deadlines spread over 30 s, like idle timeouts of unrelated connections.
+std::vector<Clock::duration> delays(size_t count) {
+  std::mt19937 engine(1);
+  std::uniform_int_distribution<int> spread(1, 30000);
+  std::vector<Clock::duration> result;
+  for (size_t i = 0; i < count; ++i) {
+    result.push_back(std::chrono::milliseconds(spread(engine)));
+  }
+  return result;
+}
+
+void wheel(size_t connections) {
+  std::vector<Clock::duration> delay = delays(connections);
+  TimerWheel timers;
+  std::vector<TimerId> ids(connections, 0);
+  std::vector<uint64_t> expired;
+  Clock::time_point now = Clock::now();
+  auto start = Clock::now();
+  for (int round = 0; round < kRounds; ++round) {
+    for (size_t i = 0; i < connections; ++i) {
+      timers.cancel(ids[i]);
+      ids[i] = timers.schedule(now + delay[i], i);
+    }
+    now += std::chrono::milliseconds(100);
+    expired.clear();
+    timers.advance(now, expired);
+  }
+  report("wheel", connections, Clock::now() - start);
+}
+
+void orderedSet(size_t connections) {
+  std::vector<Clock::duration> delay = delays(connections);
+  std::set<std::pair<Clock::time_point, size_t>> timers;
+  std::vector<Clock::time_point> due(connections, Clock::time_point::max());
+  Clock::time_point now = Clock::now();
+  auto start = Clock::now();
+  for (int round = 0; round < kRounds; ++round) {
+    for (size_t i = 0; i < connections; ++i) {
+      timers.erase(std::make_pair(due[i], i));
+      due[i] = now + delay[i];
+      timers.emplace(due[i], i);
+    }
+    now += std::chrono::milliseconds(100);
+    while (!timers.empty() && timers.begin()->first <= now) {
+      due[timers.begin()->second] = Clock::time_point::max();
+      timers.erase(timers.begin());
+    }
+  }
+  report("std::set", connections, Clock::now() - start);
+}
+
+}  // namespace
+
+int main() {
+  for (size_t connections : {1000, 10000, 100000, 1000000}) {
+    wheel(connections);
+    orderedSet(connections);
+  }
+  return 0;
+}
@@ -4,6 +4,9 @@
 
 #include "socket/Socket.h"
 #include <memory>
+#ifdef __linux__
+#include "socket/Unix/UnixSocket.h"
+#endif
 
 class FactorySocket {
 public:
@@ -39,6 +42,16 @@ TCP sockets, and serial sockets. / class FactorySocket { public: /*
 @param parity The parity.
 @return A unique pointer to the socket. */
     static std::unique_ptr<Socket> createSerialSocket(std::string portName, int baudRate, int dataBits, int stopBits, int parity) ;
+#ifdef __linux__
+    /**
+
+@brief Creates a Unix domain socket for same-host IPC.
+@param path The socket path; a leading '@' selects the abstract namespace.
+@param role Whether the socket binds (SERVER) or connects (CLIENT).
+@param type Stream, sequenced packet or datagram.
+@return A unique pointer to the socket. */
+    static std::unique_ptr<Socket> createUnixSocket(std::string path, UnixSocket::Role role, UnixSocketType type = UnixSocketType::STREAM);
+#endif
 };
 
 #endif //SOCKET_LIB_FACTORYSOCKET_H
\ No newline at end of file
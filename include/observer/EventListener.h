@@ -11,6 +11,7 @@
 #include "subscriber.h"
 
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <algorithm>
 
@@ -21,6 +22,9 @@
 class EventListener {
 private:
    std::vector<std::shared_ptr<Subscriber>> subscribers; ///< Vector of subscribers.
+   std::mutex subscribersMutex; ///< Sockets notify from their I/O threads.
+
+   std::vector<std::shared_ptr<Subscriber>> snapshot();
 
 public:
    /**
@@ -40,6 +44,20 @@ public:
     * @param event The event to be notified.
     */
    void notify(Serializable event) ;
+
+   /**
+    * @brief Notify all subscribers of an event received on a connection.
+    * @param event The event to be notified.
+    * @param connection The connection the event arrived on.
+    */
+   void notify(Serializable event, ConnectionId connection) ;
+
+   /**
+    * @brief Notify all subscribers of a connection lifecycle event.
+    * @param connection The connection concerned.
+    * @param event What happened to it.
+    */
+   void notifyConnectionEvent(ConnectionId connection, ConnectionEvent event) ;
 };
 
 #endif // SOCKET_LIB_EVENTLISTENER_H
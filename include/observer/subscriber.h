@@ -9,6 +9,22 @@
 
 #include "serializable/Serializable.h"
 
+#include <cstdint>
+
+/**
+* @brief Identifies the connection an update came from. Sockets with a single
+* peer use 0.
+*/
+using ConnectionId = uint64_t;
+
+/**
+* @brief Lifecycle events of a connection.
+*/
+enum class ConnectionEvent {
+   CONNECTED,    ///< A peer connected (accepted or connect() completed).
+   DISCONNECTED  ///< The connection closed or failed.
+};
+
 /**
 * @class Subscriber
 * @brief Represents an abstract base class for subscribers.
@@ -22,6 +38,31 @@ public:
     * @param updateData The update data in a Serializable format.
     */
    virtual void update(Serializable updateData) = 0;
+
+   /**
+    * @brief Receives an update together with the connection it came from.
+    *
+    * Multi-connection sockets call this overload; the default forwards to
+    * update(updateData), so existing subscribers keep working.
+    * @param updateData The update data in a Serializable format.
+    * @param connection The connection the data arrived on.
+    */
+   virtual void update(Serializable updateData, ConnectionId connection) {
+       (void)connection;
+       update(updateData);
+   }
+
+   /**
+    * @brief Receives connection lifecycle events. Ignored by default.
+    * @param connection The connection concerned.
+    * @param event What happened to it.
+    */
+   virtual void onConnectionEvent(ConnectionId connection, ConnectionEvent event) {
+       (void)connection;
+       (void)event;
+   }
+
+   virtual ~Subscriber() = default;
 };
 
 #endif // SOCKET_LIB_SUBSCRIBER_H
@@ -0,0 +1,197 @@
+/**
+ * @file AsyncSocket.h
+ * @brief Contains the AsyncSocket class declaration.
+ *
+ * Needs C++20; only the SocketLibAsync target is built with it.
+ */
+
+#ifndef SOCKET_LIB_ASYNC_SOCKET_H
+#define SOCKET_LIB_ASYNC_SOCKET_H
+
+#include <coroutine>
+#include <memory>
+
+#include "observer/subscriber.h"
+#include "serializable/Serializable.h"
+#include "socket/Async/Task.h"
+#include "socket/Reactor.h"
+#include "socket/Socket.h"
+
+class LinuxTCPSocket;
+
+/**
+ * @class AsyncSocket
+ * @brief Awaitable open, read, write and accept over a Socket driven by a
+ * Reactor.
+ *
+ * The socket keeps its synchronous API; this adapter subscribes to it and
+ * hands what it delivers to the coroutines waiting for it. A waiting
+ * coroutine is resumed on the reactor thread that received its data, so it
+ * must not block; many sessions then share the reactor's threads and cost
+ * one coroutine frame each.
+ *
+ * Works with UDPSocket, SerialSocket and LinuxTCPSocket; a LinuxTCPSocket
+ * is put on the reactor by async_open(). Data that arrives while nobody
+ * waits is queued until read.
+ *
+ * @code
+ * Task<void> echo(AsyncSocket& server, ConnectionId id) {
+ *   while (true) {
+ *     Serializable message = co_await server.async_receive(id);
+ *     if (message.empty()) co_return;  // closed
+ *     co_await server.async_write(id, message);
+ *   }
+ * }
+ * Task<void> serve(AsyncSocket& server) {
+ *   co_await server.async_open();
+ *   while (ConnectionId id = co_await server.async_accept()) {
+ *     spawn(echo(server, id));
+ *   }
+ * }
+ * @endcode
+ */
+class AsyncSocket {
+ private:
+  struct State;
+  struct Listener;
+
+ public:
+  /**
+   * @brief Awaitable returned by the read operations; yields the data, or an
+   * empty Serializable once the connection closed or close() was called.
+   */
+  class ReadAwaiter {
+   public:
+    bool await_ready();
+    bool await_suspend(std::coroutine_handle<> awaiting);
+    Serializable await_resume();
+
+   private:
+    friend class AsyncSocket;
+    friend struct AsyncSocket::State;
+    ReadAwaiter(std::shared_ptr<State> state, bool anyConnection,
+                ConnectionId connection, ConnectionId *from);
+
+    std::shared_ptr<State> state;
+    bool anyConnection;
+    ConnectionId connection;
+    ConnectionId *from;
+    std::coroutine_handle<> handle;
+    Serializable result;
+  };
+
+  /**
+   * @brief Awaitable returned by async_write(). Completes once the data is
+   * handed to the socket and, for TCP, once the send queue concerned is
+   * below its high watermark again; yields whether the write was accepted.
+   */
+  class WriteAwaiter {
+   public:
+    bool await_ready();
+    bool await_suspend(std::coroutine_handle<> awaiting);
+    bool await_resume() { return result; }
+
+   private:
+    friend class AsyncSocket;
+    friend struct AsyncSocket::State;
+    WriteAwaiter(AsyncSocket &owner, bool anyConnection,
+                 ConnectionId connection, Serializable data);
+
+    AsyncSocket &owner;
+    bool anyConnection;
+    ConnectionId connection;
+    Serializable data;
+    std::coroutine_handle<> handle;
+    bool result = false;
+  };
+
+  /**
+   * @brief Awaitable returned by async_accept(); yields the new connection,
+   * or 0 once close() was called.
+   */
+  class AcceptAwaiter {
+   public:
+    bool await_ready();
+    bool await_suspend(std::coroutine_handle<> awaiting);
+    ConnectionId await_resume() { return result; }
+
+   private:
+    friend class AsyncSocket;
+    friend struct AsyncSocket::State;
+    explicit AcceptAwaiter(std::shared_ptr<State> state);
+
+    std::shared_ptr<State> state;
+    std::coroutine_handle<> handle;
+    ConnectionId result = 0;
+  };
+
+  /**
+   * @brief Adapts socket, which must not be open yet, to run on reactor.
+   * Both must outlive this object.
+   */
+  AsyncSocket(Socket &socket, Reactor &reactor);
+
+  /**
+   * @brief Stops dispatching the socket. Call close() first if coroutines
+   * may still be waiting on it.
+   */
+  ~AsyncSocket();
+
+  AsyncSocket(const AsyncSocket &) = delete;
+  AsyncSocket &operator=(const AsyncSocket &) = delete;
+
+  /**
+   * @brief Opens the socket and starts dispatching it. A TCP client
+   * completes once connected, without blocking a thread on the connect.
+   * @return false if the socket could not be opened or connected.
+   */
+  Task<bool> async_open();
+
+  /**
+   * @brief Next message from any connection.
+   */
+  ReadAwaiter async_read();
+
+  /**
+   * @brief Next message from any connection.
+   * @param from Set to the connection the message arrived on.
+   */
+  ReadAwaiter async_read(ConnectionId &from);
+
+  /**
+   * @brief Next message from one connection; empty once it has closed and
+   * everything it sent was read.
+   */
+  ReadAwaiter async_receive(ConnectionId connection);
+
+  /**
+   * @brief Writes as write() does.
+   */
+  WriteAwaiter async_write(Serializable data);
+
+  /**
+   * @brief Writes to one connection of a LinuxTCPSocket.
+   */
+  WriteAwaiter async_write(ConnectionId connection, Serializable data);
+
+  /**
+   * @brief Next connection accepted by a LinuxTCPSocket server.
+   */
+  AcceptAwaiter async_accept();
+
+  /**
+   * @brief Resumes every waiting coroutine with an empty result and closes
+   * the socket.
+   */
+  void close();
+
+ private:
+  Socket &socket;
+  LinuxTCPSocket *tcp;
+  Reactor &reactor;
+  bool added = false;
+  std::shared_ptr<State> state;
+  std::shared_ptr<Subscriber> listener;
+};
+
+#endif  // SOCKET_LIB_ASYNC_SOCKET_H
@@ -0,0 +1,191 @@
+/**
+ * @file Task.h
+ * @brief Contains the Task coroutine type used by the async socket API.
+ *
+ * Needs C++20; only the SocketLibAsync target is built with it.
+ */
+
+#ifndef SOCKET_LIB_TASK_H
+#define SOCKET_LIB_TASK_H
+
+#include <coroutine>
+#include <exception>
+#include <future>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include <spdlog/spdlog.h>
+
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+struct TaskPromiseBase {
+  std::coroutine_handle<> continuation = std::noop_coroutine();
+  std::exception_ptr exception;
+
+  // Lazy: the body runs when the task is awaited.
+  std::suspend_always initial_suspend() noexcept { return {}; }
+
+  struct FinalAwaiter {
+    bool await_ready() noexcept { return false; }
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<Promise> handle) noexcept {
+      // Symmetric transfer, so long chains of tasks do not grow the stack.
+      return handle.promise().continuation;
+    }
+    void await_resume() noexcept {}
+  };
+  FinalAwaiter final_suspend() noexcept { return {}; }
+
+  void unhandled_exception() { exception = std::current_exception(); }
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase {
+  std::optional<T> value;
+
+  Task<T> get_return_object();
+  void return_value(T result) { value = std::move(result); }
+  T take() {
+    if (exception) std::rethrow_exception(exception);
+    return std::move(*value);
+  }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+  Task<void> get_return_object();
+  void return_void() {}
+  void take() {
+    if (exception) std::rethrow_exception(exception);
+  }
+};
+
+/**
+ * @brief Coroutine that starts at once and frees itself when done; used by
+ * spawn() and syncWait().
+ */
+struct Detached {
+  struct promise_type {
+    Detached get_return_object() { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() {
+      try {
+        throw;
+      } catch (const std::exception &e) {
+        spdlog::error("Spawned task failed: {0}; spawn()", e.what());
+      } catch (...) {
+        spdlog::error("Spawned task failed; spawn()");
+      }
+    }
+  };
+};
+
+}  // namespace detail
+
+/**
+ * @class Task
+ * @brief A lazily started coroutine producing a T.
+ *
+ * A Task runs when it is co_awaited, and resumes its awaiter when it
+ * finishes; exceptions thrown by its body are rethrown there. Top-level
+ * tasks are started with spawn() or syncWait().
+ */
+template <typename T>
+class Task {
+ public:
+  using promise_type = detail::TaskPromise<T>;
+  using Handle = std::coroutine_handle<promise_type>;
+
+  Task() = default;
+  explicit Task(Handle handle) : handle(handle) {}
+  Task(Task &&other) noexcept : handle(std::exchange(other.handle, {})) {}
+  Task &operator=(Task &&other) noexcept {
+    if (this != &other) {
+      if (handle) handle.destroy();
+      handle = std::exchange(other.handle, {});
+    }
+    return *this;
+  }
+  Task(const Task &) = delete;
+  Task &operator=(const Task &) = delete;
+  ~Task() {
+    if (handle) handle.destroy();
+  }
+
+  auto operator co_await() && noexcept {
+    struct Awaiter {
+      Handle handle;
+      bool await_ready() noexcept { return !handle || handle.done(); }
+      std::coroutine_handle<> await_suspend(
+          std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+      }
+      T await_resume() { return handle.promise().take(); }
+    };
+    return Awaiter{handle};
+  }
+
+ private:
+  Handle handle;
+};
+
+namespace detail {
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() {
+  return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+  return Task<void>(
+      std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+template <typename T>
+Detached runAndSignal(Task<T> task, std::promise<T> &result) {
+  try {
+    if constexpr (std::is_void_v<T>) {
+      co_await std::move(task);
+      result.set_value();
+    } else {
+      result.set_value(co_await std::move(task));
+    }
+  } catch (...) {
+    result.set_exception(std::current_exception());
+  }
+}
+
+}  // namespace detail
+
+/**
+ * @brief Starts task without waiting for it. It runs on the calling thread
+ * until its first suspension, then on whichever thread resumes it.
+ * Exceptions escaping it are logged.
+ */
+inline void spawn(Task<void> task) {
+  [](Task<void> task) -> detail::Detached {
+    co_await std::move(task);
+  }(std::move(task));
+}
+
+/**
+ * @brief Runs task and blocks the calling thread until it finishes.
+ * @return The task's result; its exception is rethrown.
+ */
+template <typename T>
+T syncWait(Task<T> task) {
+  std::promise<T> result;
+  std::future<T> done = result.get_future();
+  detail::runAndSignal(std::move(task), result);
+  return done.get();
+}
+
+#endif  // SOCKET_LIB_TASK_H
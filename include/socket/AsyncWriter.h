@@ -0,0 +1,146 @@
+/**
+ * @file AsyncWriter.h
+ * @brief Contains the background writer behind the asynchronous write mode
+ * of UDPSocket and SerialSocket.
+ */
+
+#ifndef SOCKET_LIB_ASYNC_WRITER_H
+#define SOCKET_LIB_ASYNC_WRITER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "socket/MpscQueue.h"
+
+/**
+ * @brief What write() does when the queue is full.
+ */
+enum class QueueFullPolicy {
+  BLOCK,        ///< Wait for the writer to make room.
+  DROP_NEWEST,  ///< Discard the message being written and count it.
+  THROW         ///< Throw std::runtime_error.
+};
+
+/**
+ * @brief Configuration of the asynchronous write mode.
+ */
+struct AsyncWriteConfig {
+  bool enabled = false;
+  size_t queueCapacity = 4096;  ///< Messages; rounded up to a power of two.
+  size_t maxBatch = 64;         ///< Messages handed to one send.
+  /// How long the writer waits for a batch to fill once it holds a
+  /// message; zero sends whatever is queued right away.
+  std::chrono::microseconds linger{0};
+  QueueFullPolicy whenFull = QueueFullPolicy::BLOCK;
+  bool drainOnClose = true;  ///< close() sends the queue; false drops it.
+};
+
+/**
+ * @brief Asynchronous write counters.
+ */
+struct AsyncWriteStats {
+  uint64_t enqueued = 0;  ///< Messages accepted by write().
+  uint64_t sent = 0;      ///< Messages the socket took.
+  uint64_t failed = 0;    ///< Messages of batches the socket failed to send.
+  uint64_t dropped = 0;   ///< Refused when full or left behind on close.
+  uint64_t batches = 0;   ///< Batches handed to the socket.
+};
+
+inline AsyncWriteStats operator+(AsyncWriteStats a, const AsyncWriteStats &b) {
+  a.enqueued += b.enqueued;
+  a.sent += b.sent;
+  a.failed += b.failed;
+  a.dropped += b.dropped;
+  a.batches += b.batches;
+  return a;
+}
+
+/**
+ * @class AsyncWriter
+ * @brief Takes messages from any number of threads through a lock-free
+ * queue and hands them to the socket from one thread, in batches.
+ *
+ * Producers never touch the socket lock or make a system call unless the
+ * writer is asleep and has to be woken. The writer pops up to maxBatch
+ * messages and passes them to the sink in one call, which sends them with
+ * as few system calls as the socket allows. Messages of one producer keep
+ * their order.
+ */
+class AsyncWriter {
+ public:
+  /**
+   * @brief Sends a batch; false if it could not. Runs on the writer thread.
+   */
+  using Sink = std::function<bool(std::vector<std::vector<uint8_t>> &)>;
+
+  /**
+   * @brief Starts the writer thread.
+   */
+  AsyncWriter(const AsyncWriteConfig &config, Sink sink);
+
+  /**
+   * @brief stop(config.drainOnClose).
+   */
+  ~AsyncWriter();
+
+  AsyncWriter(const AsyncWriter &) = delete;
+  AsyncWriter &operator=(const AsyncWriter &) = delete;
+
+  /**
+   * @brief Queues message; any thread.
+   * @return false if the message was dropped.
+   * @throws std::runtime_error if the queue is full under
+   * QueueFullPolicy::THROW.
+   */
+  bool enqueue(std::vector<uint8_t> message);
+
+  /**
+   * @brief Waits until every message queued before the call has been
+   * handed to the socket; duration::max() waits as long as it takes.
+   * @return false on timeout.
+   */
+  bool drain(std::chrono::steady_clock::duration timeout);
+
+  /**
+   * @brief Stops the writer thread, after sending what is queued if drain
+   * is set. Later enqueue() calls drop their message.
+   */
+  void stop(bool drain);
+
+  AsyncWriteStats stats() const;
+
+ private:
+  AsyncWriteConfig config;
+  Sink sink;
+  MpscQueue<std::vector<uint8_t>> queue;
+  std::thread thread;
+
+  std::mutex mutex;  ///< Only for sleeping and waking.
+  std::condition_variable wakeCv;   ///< Writer waits for messages.
+  std::condition_variable spaceCv;  ///< Blocked producers wait for room.
+  std::condition_variable doneCv;   ///< drain() waits for the writer.
+  std::atomic<bool> sleeping{false};
+  std::atomic<int> blocked{0};
+  std::atomic<int> draining{0};
+  std::atomic<bool> stopping{false};
+  bool drainOnStop = true;  ///< mutex.
+
+  std::atomic<uint64_t> enqueued{0};
+  std::atomic<uint64_t> handled{0};  ///< Sent, failed or dropped on stop.
+  std::atomic<uint64_t> sent{0};
+  std::atomic<uint64_t> failed{0};
+  std::atomic<uint64_t> dropped{0};
+  std::atomic<uint64_t> batches{0};
+
+  void run();
+  bool waitForMessages(std::chrono::steady_clock::time_point until);
+};
+
+#endif  // SOCKET_LIB_ASYNC_WRITER_H
@@ -0,0 +1,95 @@
+/**
+ * @file Endpoint.h
+ * @brief Contains the address-family independent socket address.
+ */
+
+#ifndef SOCKET_LIB_ENDPOINT_H
+#define SOCKET_LIB_ENDPOINT_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+/**
+ * @class Endpoint
+ * @brief An IPv4 or IPv6 address and port, held in a sockaddr_storage so
+ * that it can be handed to bind(), connect() and sendto() as is.
+ *
+ * resolve() is the only place names are looked up. Numeric addresses are
+ * parsed directly; host names go through getaddrinfo() once and are then
+ * served from a process-wide cache until their entry expires, so sockets
+ * resolve when they open and never while sending.
+ */
+class Endpoint {
+ public:
+  Endpoint() = default;
+
+  /**
+   * @brief Copies an address returned by accept(), recvfrom() and the like.
+   */
+  Endpoint(const sockaddr *address, socklen_t length);
+
+  /**
+   * @brief The addresses of host, in the order they should be tried.
+   * @param host A host name or an IPv4 or IPv6 literal.
+   * @param port The port.
+   * @param socketType SOCK_STREAM or SOCK_DGRAM.
+   * @return The addresses, empty if host cannot be resolved.
+   */
+  static std::vector<Endpoint> resolve(const std::string &host, int port,
+                                       int socketType = SOCK_STREAM);
+
+  /**
+   * @brief The any-address of family (AF_INET or AF_INET6) on port.
+   */
+  static Endpoint wildcard(int family, int port);
+
+  /**
+   * @brief How long resolved host names are reused. Default 60 s.
+   */
+  static void setCacheTtl(std::chrono::seconds ttl);
+  static void clearCache();
+
+  bool valid() const { return addressLength != 0; }
+  int family() const { return storage.ss_family; }
+  int port() const;
+  const sockaddr *address() const {
+    return reinterpret_cast<const sockaddr *>(&storage);
+  }
+  socklen_t length() const { return addressLength; }
+
+  /**
+   * @brief This IPv4 address as an IPv4-mapped IPv6 one, for sending from a
+   * dual-stack socket; other addresses are returned unchanged.
+   */
+  Endpoint toV6Mapped() const;
+
+  /**
+   * @brief The numeric host, with IPv4-mapped addresses shown as IPv4.
+   */
+  std::string host() const;
+
+  /**
+   * @brief "host:port", or "[host]:port" for IPv6.
+   */
+  std::string toString() const;
+
+  /**
+   * @brief The raw address bytes, usable as a map key.
+   */
+  std::string key() const;
+
+ private:
+  sockaddr_storage storage{};
+  socklen_t addressLength = 0;
+};
+
+#endif  // SOCKET_LIB_ENDPOINT_H
@@ -0,0 +1,156 @@
+/**
+ * @file IoUring.h
+ * @brief Contains the minimal io_uring ring used by the io_uring backends.
+ */
+
+#ifndef SOCKET_LIB_IOURING_H
+#define SOCKET_LIB_IOURING_H
+
+/**
+ * @brief I/O mechanism of a socket, chosen before open().
+ */
+enum class IoBackend {
+  AUTO,     ///< io_uring when the kernel supports it, else EPOLL.
+  EPOLL,    ///< Readiness notification (epoll/select) and plain syscalls.
+  IO_URING  ///< io_uring; falls back to EPOLL on unsupported kernels.
+};
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#if defined(IORING_RECV_MULTISHOT)
+#define SOCKET_LIB_HAS_IO_URING 1
+#endif
+#endif
+#endif
+
+#ifdef SOCKET_LIB_HAS_IO_URING
+
+#include <sys/socket.h>
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @class IoUring
+ * @brief One io_uring instance with a sparse fixed-file table and a ring of
+ * provided receive buffers.
+ *
+ * Talks to the kernel through the raw syscalls, so no liburing is needed.
+ * Not thread-safe: each instance is owned by a single thread.
+ */
+class IoUring {
+ public:
+  /**
+   * @brief Checks once whether the kernel has everything the backends use:
+   * EXT_ARG waits, registered files, provided buffer rings and multishot
+   * accept/recv/recvmsg/poll (Linux 6.0).
+   */
+  static bool supported();
+
+  /**
+   * @brief Creates the ring.
+   * @param entries Submission queue size.
+   * @param files Size of the fixed-file table.
+   * @param buffers Number of provided receive buffers, a power of two, or 0
+   * for a ring that does not receive.
+   * @param bufferSize Size of each receive buffer.
+   * @throws std::runtime_error if any part of the setup fails.
+   */
+  IoUring(unsigned entries, unsigned files, unsigned buffers,
+          unsigned bufferSize);
+  ~IoUring();
+
+  IoUring(const IoUring &) = delete;
+  IoUring &operator=(const IoUring &) = delete;
+
+  /**
+   * @brief Puts a descriptor into a fixed-file slot, -1 clears it.
+   */
+  bool setFile(unsigned slot, int fd);
+
+  /**
+   * @brief Drops the fixed-file table once no request uses it any more.
+   *
+   * Clearing a slot releases the descriptor lazily; this does it before
+   * returning, so a closed socket's port is free again at once.
+   */
+  bool releaseFiles();
+
+  /// The ring's descriptor; pollable, readable while completions wait.
+  int fd() const { return ringFd; }
+
+  void pollMultishot(int fd, uint64_t userData);
+  void acceptMultishot(int fd, uint64_t userData);
+  /// Receives into provided buffers from a fixed file until it fails.
+  void recvMultishot(unsigned slot, uint64_t userData);
+  /// As recvMultishot(); each buffer starts with an io_uring_recvmsg_out.
+  void recvmsgMultishot(unsigned slot, msghdr *layout, uint64_t userData);
+  void sendmsg(unsigned slot, const msghdr *message, uint64_t userData);
+  void cancel(uint64_t userData);
+  /// Cancels all requests carrying userData and waits for them to go.
+  /// Unlike the calls above it does not touch the queues, so any thread
+  /// may use it.
+  bool cancelSync(uint64_t userData);
+
+  /**
+   * @brief Submits the queued requests and waits for a completion.
+   * @param timeout Longest wait; negative waits forever, zero only submits.
+   * @return false on an unexpected error.
+   */
+  bool submitAndWait(std::chrono::nanoseconds timeout);
+
+  /**
+   * @brief Calls handle(const io_uring_cqe&) for every completion.
+   * @return Number of completions handled.
+   */
+  template <typename Handler>
+  unsigned completions(Handler handle) {
+    unsigned head = *cqHead;
+    unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    unsigned count = 0;
+    for (; head != tail; ++head, ++count) {
+      handle(cqes[head & *cqMask]);
+      __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+    }
+    return count;
+  }
+
+  /// Buffer id carried in a completion, or -1 if it has none.
+  static int bufferId(const io_uring_cqe &cqe);
+  uint8_t *buffer(unsigned id) { return bufferMemory + id * bufferSize; }
+  unsigned getBufferSize() const { return bufferSize; }
+  /// Returns a buffer to the kernel once its data was consumed.
+  void recycle(unsigned id);
+
+ private:
+  io_uring_sqe *nextSqe();
+  void release();
+  int enter(unsigned submit, unsigned wait, unsigned flags, void *arg,
+            size_t argSize);
+
+  int ringFd = -1;
+  void *sqRing = nullptr;
+  size_t sqRingSize = 0;
+  void *cqRing = nullptr;
+  size_t cqRingSize = 0;
+  io_uring_sqe *sqes = nullptr;
+  size_t sqesSize = 0;
+  unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+  unsigned *cqHead, *cqTail, *cqMask;
+  io_uring_cqe *cqes;
+  unsigned sqEntries = 0;
+  unsigned pending = 0;  ///< SQEs queued but not yet submitted.
+
+  io_uring_buf_ring *bufferRing = nullptr;
+  size_t bufferRingSize = 0;
+  unsigned bufferCount = 0;
+  unsigned bufferSize = 0;
+  uint8_t *bufferMemory = nullptr;
+  std::vector<uint8_t> bufferStorage;
+};
+
+#endif  // SOCKET_LIB_HAS_IO_URING
+
+#endif  // SOCKET_LIB_IOURING_H
@@ -0,0 +1,121 @@
+/**
+ * @file MpscQueue.h
+ * @brief Contains the bounded lock-free multi-producer queue.
+ */
+
+#ifndef SOCKET_LIB_MPSC_QUEUE_H
+#define SOCKET_LIB_MPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+/**
+ * @class MpscQueue
+ * @brief Bounded queue that any number of threads push to and one thread
+ * pops from, without locks.
+ *
+ * Each cell carries a sequence number telling whether it is free for the
+ * producer that claimed its position or filled for the consumer. Producers
+ * claim positions with a CAS on the tail; the consumer owns the head. A full
+ * queue fails the push instead of waiting, so callers choose the policy.
+ */
+template <typename T>
+class MpscQueue {
+ public:
+  /**
+   * @param capacity Rounded up to a power of two, at least 2.
+   */
+  explicit MpscQueue(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) size <<= 1;
+    mask = size - 1;
+    cells.reset(new Cell[size]);
+    for (size_t i = 0; i < size; ++i) {
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MpscQueue(const MpscQueue &) = delete;
+  MpscQueue &operator=(const MpscQueue &) = delete;
+
+  /**
+   * @brief Appends value; any thread.
+   * @return false, leaving value untouched, if the queue is full.
+   */
+  bool tryPush(T &&value) {
+    Cell *cell;
+    size_t position = tail.load(std::memory_order_relaxed);
+    while (true) {
+      cell = &cells[position & mask];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      intptr_t difference = static_cast<intptr_t>(sequence) -
+                            static_cast<intptr_t>(position);
+      if (difference == 0) {
+        if (tail.compare_exchange_weak(position, position + 1,
+                                       std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        return false;
+      } else {
+        position = tail.load(std::memory_order_relaxed);
+      }
+    }
+    cell->value = std::move(value);
+    cell->sequence.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool tryPush(const T &value) {
+    T copy(value);
+    return tryPush(std::move(copy));
+  }
+
+  /**
+   * @brief Takes the oldest value; the consumer thread only.
+   * @return false if the queue is empty.
+   */
+  bool tryPop(T &value) {
+    size_t position = head.load(std::memory_order_relaxed);
+    Cell &cell = cells[position & mask];
+    if (cell.sequence.load(std::memory_order_acquire) != position + 1) {
+      return false;
+    }
+    value = std::move(cell.value);
+    cell.value = T();
+    cell.sequence.store(position + mask + 1, std::memory_order_release);
+    head.store(position + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  /**
+   * @brief Whether the oldest value is still missing; any thread. A push in
+   * progress counts as empty until it completes.
+   */
+  bool empty() const {
+    size_t position = head.load(std::memory_order_seq_cst);
+    return cells[position & mask].sequence.load(std::memory_order_seq_cst) !=
+           position + 1;
+  }
+
+  size_t capacity() const { return mask + 1; }
+
+ private:
+  struct Cell {
+    std::atomic<size_t> sequence{0};
+    T value{};
+  };
+
+  std::unique_ptr<Cell[]> cells;
+  size_t mask = 0;
+  // Producers and the consumer write different cache lines.
+  char producerPadding[64];
+  std::atomic<size_t> tail{0};
+  char consumerPadding[64];
+  std::atomic<size_t> head{0};
+};
+
+#endif  // SOCKET_LIB_MPSC_QUEUE_H
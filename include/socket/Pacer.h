@@ -0,0 +1,91 @@
+/**
+ * @file Pacer.h
+ * @brief Contains the token-bucket transmit pacer shared by all sockets.
+ */
+
+#ifndef SOCKET_LIB_PACER_H
+#define SOCKET_LIB_PACER_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+/**
+ * @brief Where pacing is enforced.
+ */
+enum class PacingMode {
+  AUTO,    ///< Kernel pacing where it is known to work (TCP), else user space.
+  KERNEL,  ///< SO_MAX_PACING_RATE; for UDP it needs the fq qdisc.
+  USER     ///< User-space token bucket only.
+};
+
+/**
+ * @brief Configuration of transmit pacing.
+ */
+struct PacingConfig {
+  bool enabled = false;
+  uint64_t rateBytesPerSecond = 0;  ///< Sustained rate.
+  uint64_t burstBytes = 16 * 1024;  ///< Bytes that may leave back to back.
+  PacingMode mode = PacingMode::AUTO;
+};
+
+/**
+ * @brief Pacing counters. Delays are only measured for user-space pacing,
+ * the kernel paces without blocking write().
+ */
+struct PacingStats {
+  bool kernelPacing = false;               ///< SO_MAX_PACING_RATE in use.
+  uint64_t pacedWrites = 0;                ///< Writes through the bucket.
+  uint64_t delayedWrites = 0;              ///< Writes that had to wait.
+  std::chrono::nanoseconds totalDelay{0};  ///< Sum of all waits.
+  std::chrono::nanoseconds maxDelay{0};    ///< Longest single wait.
+};
+
+/**
+ * @class Pacer
+ * @brief User-space token bucket with a high-resolution wait.
+ *
+ * Tokens are bytes. A write larger than the available tokens takes them on
+ * credit and waits until the bucket would have refilled, so concurrent
+ * writers are spaced correctly without holding a lock while they wait.
+ */
+class Pacer {
+ public:
+  /**
+   * @brief Applies a configuration.
+   * @param config The pacing configuration.
+   * @param kernelPacing true if the socket already paces in the kernel, in
+   * which case acquire() never waits.
+   */
+  void configure(const PacingConfig &config, bool kernelPacing);
+
+  /**
+   * @brief Waits until bytes may be sent.
+   * @return How long the caller was delayed.
+   */
+  std::chrono::nanoseconds acquire(size_t bytes);
+
+  PacingStats stats() const;
+
+  PacingConfig config() const;
+
+ private:
+  mutable std::mutex mtx;
+  PacingConfig current;
+  bool kernel = false;
+  double tokens = 0;
+  std::chrono::steady_clock::time_point refilled;
+  PacingStats counters;
+};
+
+/**
+ * @brief Sets SO_MAX_PACING_RATE on a socket descriptor.
+ * @param fd The socket.
+ * @param rateBytesPerSecond The rate, 0 removes the limit.
+ * @return true if the kernel accepted it; always false where the option
+ * does not exist.
+ */
+bool setKernelPacingRate(int fd, uint64_t rateBytesPerSecond);
+
+#endif  // SOCKET_LIB_PACER_H
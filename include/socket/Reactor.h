@@ -0,0 +1,122 @@
+/**
+ * @file Reactor.h
+ * @brief Contains the Reactor class declaration.
+ */
+
+#ifndef SOCKET_LIB_REACTOR_H
+#define SOCKET_LIB_REACTOR_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "socket/MpscQueue.h"
+#include "socket/Socket.h"
+#include "socket/TimerWheel.h"
+
+/**
+ * @class Reactor
+ * @brief Drives many sockets from one epoll instance and a few threads.
+ *
+ * A socket added to the reactor is no longer read by calling read(): when
+ * its descriptor becomes readable, or when a deadline it asked for passes,
+ * a reactor thread calls its reactorDispatch(), which hands the data to the
+ * subscribers as it arrives. A socket is dispatched by one thread at a time,
+ * different sockets run in parallel on different threads.
+ *
+ * UDPSocket and SerialSocket are added once open. A LinuxTCPSocket is
+ * given the reactor with setReactor() before open() and then runs its
+ * event loop here instead of on a thread of its own.
+ *
+ * Other threads hand work to the reactor with post(), through a lock-free
+ * queue.
+ */
+class Reactor {
+ public:
+  /**
+   * @brief Creates the epoll instance and starts the threads.
+   * @param threads Number of dispatch threads, at least 1.
+   * @throws std::runtime_error if epoll cannot be set up.
+   */
+  explicit Reactor(unsigned threads = 1);
+
+  /**
+   * @brief Stops the threads; sockets still added are left alone.
+   */
+  ~Reactor();
+
+  Reactor(const Reactor &) = delete;
+  Reactor &operator=(const Reactor &) = delete;
+
+  /**
+   * @brief Starts dispatching an open socket; its first dispatch happens
+   * right away on a reactor thread.
+   * @return false if the socket has no descriptor to watch or is already
+   * added.
+   */
+  bool add(Socket &socket);
+
+  /**
+   * @brief Stops dispatching a socket. Waits for a dispatch in progress on
+   * another thread, so the socket may be closed once this returns. Call it
+   * before closing a socket that was added.
+   */
+  void remove(Socket &socket);
+
+  /**
+   * @brief Number of sockets added.
+   */
+  size_t size();
+
+  /**
+   * @brief Runs task on a reactor thread, in posting order. Any thread may
+   * post; tasks still queued when the reactor is destroyed are dropped.
+   * @return false if the task queue is full.
+   */
+  bool post(std::function<void()> task);
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Entry {
+    Socket *socket = nullptr;
+    int fd = -1;
+    uint64_t id = 0;
+    std::atomic<unsigned> requests{0};  ///< Dispatches asked for; the
+                                        ///< thread that made it non-zero
+                                        ///< runs them all.
+    std::atomic<bool> removed{false};
+    TimerId timer = 0;  ///< Pending dispatch deadline; entriesMutex.
+  };
+
+  int epollFd = -1;
+  int wakeFd = -1;
+  std::atomic<bool> running{true};
+  std::vector<std::thread> threads;
+
+  std::mutex entriesMutex;
+  std::unordered_map<uint64_t, std::shared_ptr<Entry>> entries;
+  std::unordered_map<Socket *, uint64_t> ids;
+  TimerWheel timers;  ///< Tokens are entry ids.
+  uint64_t nextId = 1;
+
+  MpscQueue<std::function<void()>> tasks;
+  std::atomic<bool> runningTasks{false};  ///< A thread is the consumer.
+  std::atomic<bool> tasksWoken{false};    ///< A wake for tasks is pending.
+
+  void loop();
+  void runTasks();
+  void dispatch(const std::shared_ptr<Entry> &entry);
+  void schedule(Entry &entry, Clock::time_point due);
+  int nextTimeout();
+  void wake();
+};
+
+#endif  // SOCKET_LIB_REACTOR_H
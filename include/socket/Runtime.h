@@ -0,0 +1,164 @@
+/**
+ * @file Runtime.h
+ * @brief Contains the thread-per-core Runtime and its per-core BufferPool.
+ */
+
+#ifndef SOCKET_LIB_RUNTIME_H
+#define SOCKET_LIB_RUNTIME_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "socket/MpscQueue.h"
+#include "socket/Reactor.h"
+#include "socket/Socket.h"
+
+/**
+ * @brief Configuration of a Runtime.
+ */
+struct RuntimeConfig {
+  std::vector<int> cpus;          ///< CPUs to run on; empty for all allowed.
+  size_t bufferSize = 64 * 1024;  ///< Bytes per pooled buffer.
+  size_t buffersPerCore = 64;     ///< Buffers in each core's pool.
+};
+
+/**
+ * @class BufferPool
+ * @brief Fixed-size buffers carved from one slab that belongs to one
+ * thread.
+ *
+ * The slab is written by the thread that creates the pool, so under the
+ * kernel's first-touch policy its pages sit on that thread's NUMA node.
+ * Only that thread acquires; buffers released by other threads come back
+ * through a lock-free queue.
+ */
+class BufferPool {
+ public:
+  /**
+   * @throws std::runtime_error if the slab cannot be allocated.
+   */
+  BufferPool(size_t bufferSize, size_t count);
+  ~BufferPool();
+
+  BufferPool(const BufferPool &) = delete;
+  BufferPool &operator=(const BufferPool &) = delete;
+
+  /**
+   * @brief A free buffer of bufferSize() bytes, or nullptr if all are in
+   * use. Owning thread only.
+   */
+  uint8_t *acquire();
+
+  /**
+   * @brief Gives a buffer of this pool back; any thread.
+   */
+  void release(uint8_t *buffer);
+
+  size_t bufferSize() const { return size; }
+
+ private:
+  uint8_t *slab = nullptr;
+  size_t slabBytes = 0;
+  size_t size;
+  std::thread::id owner;
+  std::vector<uint8_t *> freeBuffers;  ///< Owning thread only.
+  MpscQueue<uint8_t *> returned;       ///< Released by other threads.
+};
+
+/**
+ * @class Runtime
+ * @brief One single-threaded Reactor per selected CPU, each thread pinned
+ * to its CPU.
+ *
+ * A socket is assigned to one core, explicitly or by hashing a key such as
+ * its peer address, and is then only ever dispatched by that core's thread,
+ * so its state stays in that CPU's caches. Each core owns a BufferPool on
+ * its own NUMA node. Work for another core is handed over with post(),
+ * which goes through the target reactor's lock-free task queue.
+ */
+class Runtime {
+ public:
+  /**
+   * @brief Starts and pins the threads and allocates their pools.
+   * @throws std::runtime_error if no CPU is usable or a reactor cannot be
+   * created.
+   */
+  explicit Runtime(const RuntimeConfig &config = RuntimeConfig());
+
+  /**
+   * @brief Stops the threads. Remove the sockets first.
+   */
+  ~Runtime();
+
+  Runtime(const Runtime &) = delete;
+  Runtime &operator=(const Runtime &) = delete;
+
+  size_t cores() const { return coreList.size(); }
+  int cpu(size_t core) const { return coreList[core].cpu; }
+
+  /**
+   * @brief NUMA node of the core's CPU, -1 if unknown.
+   */
+  int node(size_t core) const { return coreList[core].node; }
+
+  Reactor &reactor(size_t core) { return *coreList[core].reactor; }
+  BufferPool &buffers(size_t core) { return *coreList[core].pool; }
+
+  /**
+   * @brief The core key maps to; the same key gives the same core for the
+   * lifetime of the process.
+   */
+  size_t coreFor(const std::string &key) const;
+
+  /**
+   * @brief Assigns socket to core. An open UDPSocket or SerialSocket starts
+   * being dispatched there; a LinuxTCPSocket is given the core's reactor
+   * and moves there at its next open(), so add it before opening it.
+   * @return false if core is out of range or the reactor refused socket.
+   */
+  bool add(Socket &socket, size_t core);
+
+  /**
+   * @brief Assigns socket to coreFor(key).
+   */
+  bool add(Socket &socket, const std::string &key);
+
+  /**
+   * @brief Stops dispatching socket; call before closing it. A
+   * LinuxTCPSocket leaves its reactor when it is closed.
+   */
+  void remove(Socket &socket);
+
+  /**
+   * @brief Runs task on core's thread.
+   * @return false if core is out of range or its task queue is full.
+   */
+  bool post(size_t core, std::function<void()> task);
+
+  /**
+   * @brief Index of the core the calling thread runs, -1 off the runtime's
+   * threads.
+   */
+  static int currentCore();
+
+ private:
+  struct Core {
+    int cpu = -1;
+    int node = -1;
+    std::unique_ptr<BufferPool> pool;  ///< Freed after the reactor stopped.
+    std::unique_ptr<Reactor> reactor;
+  };
+
+  std::vector<Core> coreList;
+  std::mutex assignedMutex;
+  std::unordered_map<Socket *, size_t> assigned;  ///< Added to a reactor.
+};
+
+#endif  // SOCKET_LIB_RUNTIME_H
@@ -16,8 +16,13 @@
 #include <unistd.h>
 #endif
 
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <utility>
+#include <vector>
 
+#include "socket/AsyncWriter.h"
 #include "socket/Socket.h"
 
 /**
@@ -62,8 +67,62 @@ class SerialSocket : public Socket {
   void open() override;
   void close() override;
   void write(Serializable serializableObj) override;
+
+  /**
+   * @brief Reads what the driver holds, waiting up to 50 ms for data.
+   * @return The bytes read, empty if none arrived in time.
+   */
   Serializable read() override;
 
+  /**
+   * @brief Waits for data until deadline.
+   * @return The bytes read, or an empty Serializable if the deadline passed,
+   * cancel() was called or the port was closed.
+   */
+  Serializable read(std::chrono::steady_clock::time_point deadline);
+
+  /**
+   * @brief Returns what the driver already holds, or an empty Serializable,
+   * without waiting.
+   */
+  Serializable tryRead();
+
+  /**
+   * @brief Wakes every read() waiting right now; they return an empty
+   * Serializable. Reads started later wait as usual. close() does the same.
+   */
+  void cancel();
+
+  /**
+   * @brief Reactor support (POSIX only): the port's descriptor; a dispatch
+   * reads what the driver holds.
+   */
+  int reactorHandle() override;
+  std::chrono::steady_clock::time_point reactorDispatch() override;
+
+  /**
+   * @brief Enables, reconfigures or disables asynchronous writes.
+   *
+   * When enabled write() queues the message and returns; a writer thread
+   * writes each batch with one writev() under a single acquisition of the
+   * port lock. Reconfiguring writes what is already queued first. Settings
+   * made before open() are applied when the port opens.
+   * @param config The asynchronous write configuration.
+   */
+  void setAsyncWrite(const AsyncWriteConfig &config);
+
+  /**
+   * @brief Waits until everything written so far in asynchronous mode has
+   * reached the driver.
+   * @return false on timeout.
+   */
+  bool drainWrites(std::chrono::steady_clock::duration timeout);
+
+  /**
+   * @brief Returns the asynchronous write counters since construction.
+   */
+  AsyncWriteStats getAsyncWriteStats();
+
   ~SerialSocket();
 
  protected:
@@ -78,8 +137,20 @@ class SerialSocket : public Socket {
   DWORD m_errors;  ///< Error status during communication.
 #else
   int serialPort{};  ///< File descriptor for the serial port.
+  int wakeFd = -1;   ///< eventfd cancel() signals to wake a waiting read().
 #endif
+  std::atomic<uint64_t> readGeneration{0};  ///< Bumped by cancel().
   std::mutex mtx;  ///< Mutex for thread safety.   #else
+  std::mutex asyncWriteMutex;  ///< Guards the two below and starting and
+                               ///< stopping the writer.
+  AsyncWriteConfig asyncWriteConfig;
+  AsyncWriteStats asyncWriteTotals;  ///< Of writers already stopped.
+  std::shared_ptr<AsyncWriter> asyncWriter;  ///< Atomic access only.
+
+  Serializable receive();
+  bool writeBatch(std::vector<std::vector<uint8_t>> &messages);
+  void startAsyncWriter();
+  void stopAsyncWriter(bool closing);
 };
 
 #endif  // SOCKET_LIB_SERIALSOCKET_H
@@ -0,0 +1,151 @@
+/**
+ * @file SharedMemorySocket.h
+ * @brief Contains the SharedMemorySocket class declaration.
+ */
+
+#ifndef SOCKET_LIB_SHAREDMEMORYSOCKET_H
+#define SOCKET_LIB_SHAREDMEMORYSOCKET_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "socket/Socket.h"
+
+/**
+ * @brief Shape of the rings of a SharedMemorySocket. The creator's values
+ * are used; an attaching socket only reads its own timing fields.
+ */
+struct ShmRingConfig {
+  size_t capacity = 1 << 20;  ///< Bytes per direction, rounded up to a power of 2.
+  bool multiProducer = false;  ///< Let several threads or processes write
+                               ///< to the creator at once (MPSC).
+  unsigned spinIterations = 20000;  ///< Polls before sleeping on the futex;
+                                    ///< none on a single CPU.
+  bool wakeup = true;  ///< Sleep on a futex after spinning; false keeps
+                       ///< spinning (yielding) until the timeout.
+  std::chrono::milliseconds readTimeout = std::chrono::milliseconds(1000);
+};
+
+/**
+ * @brief A message space reserved in the ring by SharedMemorySocket::reserve().
+ */
+struct ShmSlot {
+  uint8_t *data = nullptr;  ///< Where to write the message; null if full.
+  size_t size = 0;
+  uint64_t position = 0;
+};
+
+/**
+ * @class SharedMemorySocket
+ * @brief Same-host messaging through two rings in a POSIX shared memory
+ * segment, one per direction, with no system call on the data path.
+ *
+ * The CREATOR makes the segment named name (as for shm_open, e.g.
+ * "/telemetry") and reads what the ATTACHed side writes, and the other way
+ * round. Each ring has cache-line-padded head and tail indices; the reader
+ * busy-polls for spinIterations and then sleeps on a futex in the segment,
+ * which a writer only wakes when the reader is asleep.
+ *
+ * A ring has one writer unless multiProducer is set, in which case several
+ * attached threads or processes may write to the creator, reserving space
+ * with a CAS. Replies to them share one ring, so only one should read.
+ *
+ * write() copies a message in; reserve() and commit() let the caller build
+ * it in the ring instead. close() waits for writes in progress, including
+ * every reserved slot up to its commit().
+ */
+class SharedMemorySocket : public Socket {
+ public:
+  enum Role { CREATOR, ATTACH };
+
+  /**
+   * @brief Constructor; nothing is mapped yet.
+   * @param name Segment name.
+   * @param role CREATOR makes the segment, ATTACH maps an existing one.
+   * @param config Ring shape and timing.
+   */
+  SharedMemorySocket(std::string name, Role role,
+                     const ShmRingConfig &config = ShmRingConfig());
+
+  ~SharedMemorySocket() override;
+
+  /**
+   * @brief Creates or maps the segment.
+   * @throws std::runtime_error if that fails or the segment is not one.
+   */
+  void open() override;
+
+  /**
+   * @brief Unmaps the segment; the CREATOR also removes its name.
+   *
+   * Waits for write() calls in progress and for reserved slots to be
+   * committed, so it must not be called between reserve() and commit().
+   */
+  void close() override;
+
+  /**
+   * @brief Waits up to the read timeout for the next message.
+   * @return The message, empty on timeout.
+   */
+  Serializable read() override;
+
+  /**
+   * @brief Copies the message into the ring, waiting up to the read timeout
+   * for space. Messages that could never fit are dropped.
+   */
+  void write(Serializable serializableObj) override;
+
+  /**
+   * @brief Reserves space for a message of size bytes without waiting.
+   *
+   * A slot with data must be passed to commit(); close() waits for it.
+   * @return The slot, with null data if the ring is full or not open.
+   */
+  ShmSlot reserve(size_t size);
+
+  /**
+   * @brief Publishes a slot filled by the caller.
+   */
+  void commit(const ShmSlot &slot);
+
+  /**
+   * @brief Bytes written but not read yet in the incoming ring.
+   */
+  size_t pending() const;
+
+ private:
+  struct Ring;
+  struct Segment;
+
+  std::string name;
+  Role role;
+  ShmRingConfig config;
+
+  std::mutex mapMutex;
+  Segment *segment = nullptr;
+  size_t mappedSize = 0;
+  Ring *in = nullptr;     ///< Ring this side reads.
+  Ring *out = nullptr;    ///< Ring this side writes.
+  uint8_t *inData = nullptr;
+  uint8_t *outData = nullptr;
+  uint64_t capacity = 0;
+  bool multiProducer = false;
+  unsigned spinLimit = 0;
+
+  std::mutex readMutex;  ///< Serialises read() as each ring has one reader.
+  std::atomic<bool> closing{true};  ///< Set while not open.
+  std::atomic<unsigned> writers{0};  ///< write() calls and uncommitted slots.
+
+  bool enterWriter();
+  void leaveWriter();
+  ShmSlot reserveSpace(size_t size);
+  void publish(const ShmSlot &slot);
+  bool take(std::vector<uint8_t> &message);
+  void wakeReader(Ring &ring);
+};
+
+#endif  // SOCKET_LIB_SHAREDMEMORYSOCKET_H
@@ -10,8 +10,11 @@
 #include <spdlog/common.h>
 #include <spdlog/spdlog.h>
 
+#include <chrono>
+
 #include "observer/EventListener.h"
 #include "serializable/Serializable.h"
+#include "socket/Pacer.h"
 
 /**
  * @class Socket
@@ -65,9 +68,53 @@ class Socket : public EventListener {
     spdlog::set_level(level);
   }
 
+  /**
+   * @brief Enables, reconfigures or disables transmit pacing of write().
+   *
+   * The kernel paces (SO_MAX_PACING_RATE) where config.mode allows it and
+   * the socket supports it; otherwise a token bucket delays write().
+   * Settings made before open() are applied when the socket opens.
+   * @param config The pacing configuration.
+   */
+  void setPacing(const PacingConfig &config) {
+    pacer.configure(config, applyKernelPacing(config) && config.enabled);
+  }
+
+  /**
+   * @brief Returns the pacing counters, including how long writes waited.
+   */
+  PacingStats getPacingStats() const { return pacer.stats(); }
+
+  /**
+   * @brief Descriptor a Reactor watches for this socket, or -1 if the
+   * socket cannot be driven by one. Valid while the socket is open.
+   */
+  virtual int reactorHandle() { return -1; }
+
+  /**
+   * @brief Called by a Reactor when reactorHandle() is readable or the
+   * deadline returned last time has passed. Takes whatever has arrived
+   * without blocking and passes it to the subscribers.
+   * @return When to be called again if nothing arrives,
+   * time_point::max() for never.
+   */
+  virtual std::chrono::steady_clock::time_point reactorDispatch() {
+    return std::chrono::steady_clock::time_point::max();
+  }
+
  protected:
+  /**
+   * @brief Hands the pacing configuration to the kernel.
+   * @return true if the kernel now paces this socket.
+   */
+  virtual bool applyKernelPacing(const PacingConfig &config) {
+    (void)config;
+    return false;
+  }
+
   // logger
   std::shared_ptr<spdlog::logger> logger;
+  Pacer pacer;  ///< Transmit pacing, consulted by write().
 };
 
 #endif  // SOCKET_LIB_SOCKET_H
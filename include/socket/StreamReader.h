@@ -0,0 +1,144 @@
+/**
+ * @file StreamReader.h
+ * @brief Contains the buffered reader that turns socket chunks into a byte
+ * stream.
+ */
+
+#ifndef SOCKET_LIB_STREAMREADER_H
+#define SOCKET_LIB_STREAMREADER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "socket/Socket.h"
+
+/**
+ * @brief Bytes inside a StreamReader's buffer, parsed in place.
+ *
+ * Valid until the next call on the reader.
+ */
+struct StreamView {
+  const uint8_t *data = nullptr;
+  size_t size = 0;
+
+  bool empty() const { return size == 0; }
+};
+
+/**
+ * @class StreamReader
+ * @brief Buffered reader over a Socket or a descriptor, for length-prefixed
+ * and delimited protocols.
+ *
+ * The buffer is a ring whose pages are mapped twice, back to back, so the
+ * buffered bytes are always contiguous and a message that wraps around is
+ * returned without copying. Where that mapping is unavailable (not Linux,
+ * or mmap fails) or not wanted, the buffer is compacted instead: buffered
+ * bytes are moved to its start before each fill.
+ *
+ * Each fill is one Socket::read() or one read(2) of all the free space.
+ * Not thread-safe: one reader per stream.
+ */
+class StreamReader {
+ public:
+  /**
+   * @brief Reads from socket.read(), e.g. a LinuxTCPSocket in CLIENT mode or
+   * a SerialSocket. An empty read() (timeout) ends the current call.
+   * @param socket The source; must outlive the reader.
+   * @param capacity Buffer size, rounded up to whole pages; the longest
+   * message that can be returned.
+   * @param mirror false to compact even where the ring can be mirrored,
+   * which saves two mappings per reader.
+   */
+  explicit StreamReader(Socket &socket, size_t capacity = 64 * 1024,
+                        bool mirror = true);
+
+#ifndef _WIN32
+  /**
+   * @brief Reads straight from a descriptor into the free buffer space.
+   * @param fd A blocking descriptor; the reader does not close it.
+   * @param capacity As above.
+   * @param mirror As above.
+   */
+  explicit StreamReader(int fd, size_t capacity = 64 * 1024,
+                        bool mirror = true);
+#endif
+
+  ~StreamReader();
+
+  StreamReader(const StreamReader &) = delete;
+  StreamReader &operator=(const StreamReader &) = delete;
+
+  /**
+   * @brief Waits until n bytes are buffered, without consuming them.
+   * @return The first n buffered bytes, empty on timeout, end of stream,
+   * error or if n exceeds the capacity; what arrived stays buffered.
+   */
+  StreamView peek(size_t n);
+
+  /**
+   * @brief As peek(n), and consumes the bytes.
+   */
+  StreamView readExact(size_t n);
+
+  /**
+   * @brief Reads up to and including the first delimiter byte.
+   *
+   * Bytes already scanned are not scanned again after a fill; the scan is
+   * the C library's vectorised memchr().
+   * @param delimiter The byte that ends a message.
+   * @param maxLength Longest message accepted, capped at the capacity.
+   * @return The message with its delimiter, empty if none arrived or it
+   * would be longer than maxLength.
+   */
+  StreamView readUntil(uint8_t delimiter, size_t maxLength = SIZE_MAX);
+
+  /**
+   * @brief All bytes buffered now, without reading.
+   */
+  StreamView buffered() const { return StreamView{base + head, size}; }
+
+  /**
+   * @brief Drops n buffered bytes, e.g. after parsing buffered() in place.
+   */
+  void consume(size_t n);
+
+  /**
+   * @brief Reads once from the source.
+   * @return false on timeout, end of stream, error or a full buffer.
+   */
+  bool fill();
+
+  /**
+   * @brief true once the descriptor source reported end of stream.
+   */
+  bool eof() const { return ended; }
+
+  size_t capacity() const { return cap; }
+
+  /**
+   * @brief true if the buffer is the mirrored ring, false if it compacts.
+   */
+  bool isMirrored() const { return mirrored; }
+
+ private:
+  void allocate(size_t capacity, bool mirror);
+  uint8_t *writePosition();
+  size_t fromSocket(uint8_t *target, size_t space);
+
+  Socket *socket = nullptr;
+  int fd = -1;
+  bool ended = false;
+
+  uint8_t *base = nullptr;
+  size_t cap = 0;
+  size_t head = 0;  ///< Offset of the first buffered byte.
+  size_t size = 0;  ///< Buffered bytes.
+  bool mirrored = false;
+  std::vector<uint8_t> fallback;  ///< Used when the ring cannot be mirrored.
+
+  std::vector<uint8_t> pending;  ///< Rest of a read() that did not fit.
+  size_t pendingOffset = 0;
+};
+
+#endif  // SOCKET_LIB_STREAMREADER_H
@@ -9,16 +9,189 @@
 #define SOCKET_LIB_LINUXTCPSOCKET_H
 
 #include "socket/TCP/TCPSocket.h"
+#include "socket/IoUring.h"
+#include "socket/Endpoint.h"
+#include "socket/TimerWheel.h"
 #include <netinet/in.h>
+#include <sys/uio.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <random>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+class Reactor;
+
+/**
+* @brief Snapshot of one connection of a LinuxTCPSocket.
+*/
+struct ConnectionInfo {
+   ConnectionId id;        ///< Id passed to subscribers and writeTo().
+   std::string peer;       ///< Remote "ip:port", "[ip]:port" for IPv6.
+   uint64_t bytesIn = 0;   ///< Bytes received.
+   uint64_t bytesOut = 0;  ///< Bytes sent.
+   size_t queuedBytes = 0; ///< Bytes accepted by write() but not sent yet.
+   std::chrono::microseconds rtt{0};         ///< Kernel smoothed round-trip time (TCP_INFO).
+   std::chrono::microseconds rttVariance{0}; ///< Kernel round-trip time variance.
+   std::chrono::microseconds heartbeatRtt{0}; ///< Last heartbeat round trip, 0 if none measured.
+};
+
+/**
+* @brief Limits of the per-connection send queue.
+*
+* Once a connection holds more than highWatermark unsent bytes the
+* backpressure callback is called with paused = true; when it has drained
+* to lowWatermark it is called again with paused = false. Writes are never
+* refused or dropped, the caller decides whether to hold back.
+*/
+struct SendQueueConfig {
+   size_t highWatermark = 4 * 1024 * 1024;
+   size_t lowWatermark = 1024 * 1024;
+};
+
+/**
+* @brief Called with the connection and whether its writers should pause.
+*/
+using BackpressureCallback = std::function<void(ConnectionId, bool)>;
+
+/**
+* @brief How writes are turned into TCP segments.
+*/
+enum class WriteMode {
+   DEFAULT,             ///< Kernel defaults (Nagle's algorithm on).
+   LOW_LATENCY,         ///< TCP_NODELAY, every write is sent at once.
+   THROUGHPUT_CORK,     ///< TCP_CORK, the kernel only sends full segments.
+   THROUGHPUT_COALESCE  ///< Writes are held and sent in one batch.
+};
+
+/**
+* @brief Write mode and its batching limits.
+*
+* In the throughput modes data written since the last flush goes out at the
+* latest flushDeadline later (the event loop has millisecond resolution), or
+* when flush() is called. THROUGHPUT_COALESCE also sends as soon as
+* maxBatchBytes are held.
+*/
+struct WriteModeConfig {
+   WriteMode mode = WriteMode::DEFAULT;
+   size_t maxBatchBytes = 64 * 1024;
+   std::chrono::microseconds flushDeadline{1000};
+};
+
+/**
+* @brief MSG_ZEROCOPY sending of large messages.
+*
+* Messages of at least threshold bytes are sent without copying them into
+* the kernel; below it, copying is cheaper than the page pinning and the
+* completion notification. A connection closed before its sends complete
+* keeps its descriptor, shut down, and the buffers until they do; after
+* lingerTimeout it is reset instead.
+*/
+struct ZeroCopyConfig {
+   bool enabled = false;
+   size_t threshold = 64 * 1024;
+   std::chrono::milliseconds lingerTimeout{10000}; ///< Longest a closed connection waits for its completions.
+};
+
+/**
+* @brief Zero-copy counters of a LinuxTCPSocket.
+*
+* The hit rate is (zeroCopySends - kernelCopied) / (zeroCopySends +
+* copiedSends): the kernel may still copy a zero-copy send, e.g. on
+* loopback or when the device cannot gather.
+*/
+struct ZeroCopyStats {
+   uint64_t zeroCopySends = 0; ///< sendmsg() calls made with MSG_ZEROCOPY.
+   uint64_t zeroCopyBytes = 0;
+   uint64_t copiedSends = 0;   ///< sendmsg() calls that copied.
+   uint64_t copiedBytes = 0;
+   uint64_t kernelCopied = 0;  ///< Zero-copy sends the kernel copied anyway.
+   uint64_t completions = 0;   ///< Zero-copy sends reported complete.
+   size_t pinnedBuffers = 0;   ///< Sent buffers waiting for their completion.
+};
+
+/**
+* @brief Outcome of a sendFile() or relay().
+*
+* A transfer that stopped early is resumed by calling sendFile() again from
+* nextOffset with the remaining length. bytesSent counts what the kernel
+* accepted, not what the peer has received.
+*/
+struct TransferResult {
+   bool complete = false;  ///< Everything requested (for relay(), up to end of file) was sent.
+   uint64_t bytesSent = 0;
+   off_t nextOffset = 0;   ///< Source offset to resume from; sendFile() only.
+   int error = 0;          ///< errno of the failure, 0 if none or stopped by progress.
+};
+
+/**
+* @brief Told the bytes sent so far and the total (0 if unknown) after each
+* chunk of a transfer; returning false stops it.
+*/
+using TransferProgress = std::function<bool(uint64_t sent, uint64_t total)>;
+
+/**
+* @brief Retry schedule of a CLIENT connect.
+*
+* Attempt n waits initialDelay * multiplier^(n-1), capped at maxDelay, minus
+* a random share of up to jitter, so clients restarted together spread out.
+*/
+struct BackoffConfig {
+   std::chrono::milliseconds initialDelay{100};
+   std::chrono::milliseconds maxDelay{30000};
+   double multiplier = 2.0;
+   double jitter = 0.5;    ///< Randomised fraction of each delay, 0 to 1.
+};
+
+/**
+* @brief Dead-peer detection of a LinuxTCPSocket.
+*
+* Keepalive probes find a silent peer of an idle connection after keepIdle +
+* keepInterval * keepCount; userTimeout closes a connection whose sent data
+* stays unacknowledged that long. The heartbeat writes heartbeatPayload on
+* every connection each heartbeatInterval, so userTimeout also covers idle
+* connections, and closes connections that received nothing for
+* heartbeatTimeout. The payload must be something the peer's protocol
+* ignores or answers. However the peer is found dead, the connection is
+* closed and subscribers get ConnectionEvent::DISCONNECTED.
+*/
+struct LivenessConfig {
+   bool keepAlive = false;                    ///< SO_KEEPALIVE.
+   std::chrono::seconds keepIdle{10};         ///< TCP_KEEPIDLE.
+   std::chrono::seconds keepInterval{1};      ///< TCP_KEEPINTVL.
+   int keepCount = 3;                         ///< TCP_KEEPCNT.
+   std::chrono::milliseconds userTimeout{0};  ///< TCP_USER_TIMEOUT, 0 for the kernel default.
+   std::chrono::milliseconds heartbeatInterval{0}; ///< 0 disables the heartbeat.
+   std::chrono::milliseconds heartbeatTimeout{0};  ///< Receive silence that closes a connection, 0 never.
+   std::vector<uint8_t> heartbeatPayload;
+};
+
 /**
 * @class LinuxTCPSocket
 * @brief Represents a TCP socket implementation for Linux.
 *
 * This class inherits from TCPSocket and provides specific functionality
 * for TCP communication on the Linux platform.
+*
+* All descriptors are non-blocking and driven by one edge-triggered epoll
+* loop thread per socket, or by the threads of a Reactor (setReactor()). In SERVER mode it accepts any number of peers;
+* data is delivered to subscribers on arrival with its ConnectionId, and is
+* also queued for read().
+*
+* The read() queue holds a bounded number of chunks. When it is full the
+* socket stops reading from the connection until read() has caught up, so
+* TCP flow control slows the peer down; nothing is dropped. A socket whose
+* data is only taken by subscribers turns the queue off with setReadQueue().
 */
 class LinuxTCPSocket : public TCPSocket {
 public:
@@ -66,50 +239,472 @@ public:
     */
    Serializable read() override;
 
+   /**
+    * @brief Read data from the TCP socket along with its connection.
+    * @param connection Set to the connection the data arrived on.
+    * @return The deserialized object, empty on timeout.
+    */
+   Serializable read(ConnectionId& connection);
+
+   /**
+    * @brief Read data, waiting no later than deadline.
+    *
+    * The calling thread sleeps until data arrives or the deadline, on
+    * steady_clock. The deadline is not on the event loop's TimerWheel: a
+    * wheel timer would have to wake the loop, which would then wake the
+    * reader, and a socket without a running loop could never time out.
+    * @return The deserialized object, empty if the deadline passed or the
+    * read was cancelled.
+    */
+   Serializable read(std::chrono::steady_clock::time_point deadline);
+
+   /**
+    * @brief Read data along with its connection, waiting no later than deadline.
+    * @param connection Set to the connection the data arrived on, 0 if none.
+    * @param deadline When to give up.
+    * @return The deserialized object, empty if the deadline passed or the
+    * read was cancelled.
+    */
+   Serializable read(ConnectionId& connection, std::chrono::steady_clock::time_point deadline);
+
+   /**
+    * @brief Read data that has already arrived, without waiting.
+    * @return The deserialized object, empty if nothing is queued.
+    */
+   Serializable tryRead();
+
+   /**
+    * @brief Read data that has already arrived along with its connection, without waiting.
+    * @param connection Set to the connection the data arrived on, 0 if none.
+    * @return The deserialized object, empty if nothing is queued.
+    */
+   Serializable tryRead(ConnectionId& connection);
+
+   /**
+    * @brief Wake every read() waiting right now; they return an empty object.
+    *
+    * Reads started later wait as usual. close() cancels first, so a blocked
+    * reader never holds up closing.
+    */
+   void cancel();
+
    /**
     * @brief Write data to the TCP socket.
+    *
+    * In SERVER mode the data is broadcast to every connected peer.
     * @param serializableObj The object to be serialized and written to the TCP socket.
     */
    void write(Serializable serializableObj) override;
 
+   /**
+    * @brief Write data to one connection.
+    *
+    * Whatever the kernel does not take at once is queued and sent by the
+    * event loop when the socket becomes writable; see setSendQueue().
+    * @param connection The target connection.
+    * @param serializableObj The object to be written.
+    * @return False if the connection is unknown or failed.
+    */
+   bool writeTo(ConnectionId connection, const Serializable& serializableObj);
+
+   /**
+    * @brief Write data to every connection.
+    * @param serializableObj The object to be written.
+    * @return The number of connections the data was sent to.
+    */
+   size_t broadcast(const Serializable& serializableObj);
+
+   /**
+    * @brief Send part of a file to the CLIENT connection with sendfile().
+    *
+    * The data goes from the page cache to the socket without passing
+    * through user space. It is ordered with write(): data written before
+    * goes out first, data written meanwhile waits. Blocks the caller until
+    * the transfer ends.
+    * @param fd Source descriptor that supports mmap, e.g. a regular file.
+    * @param offset Where to start reading; fd's file offset is untouched.
+    * @param length Bytes to send; fewer are sent if the file ends first.
+    * @param progress Optional progress callback, run on the calling thread.
+    * @return How far the transfer got.
+    */
+   TransferResult sendFile(int fd, off_t offset, size_t length, TransferProgress progress = nullptr);
+
+   /**
+    * @brief As sendFile(), to one connection.
+    */
+   TransferResult sendFileTo(ConnectionId connection, int fd, off_t offset, size_t length, TransferProgress progress = nullptr);
+
+   /**
+    * @brief Forward another descriptor's output to the CLIENT connection
+    * with splice().
+    *
+    * Pipes are spliced straight into the socket; other sources (sockets,
+    * character devices, files) go through a kernel pipe. Waits for the
+    * source when it has no data. Stops at end of file, after length bytes,
+    * or when progress returns false; nothing read from fd is lost then.
+    * @param fd Source descriptor, read from its current position.
+    * @param length Most bytes to forward.
+    * @param progress Optional progress callback, run on the calling thread.
+    * @return How far the relay got.
+    */
+   TransferResult relay(int fd, size_t length = SIZE_MAX, TransferProgress progress = nullptr);
+
+   /**
+    * @brief As relay(), to one connection.
+    */
+   TransferResult relayTo(ConnectionId connection, int fd, size_t length = SIZE_MAX, TransferProgress progress = nullptr);
+
+   /**
+    * @brief Choose the I/O backend; takes effect at the next open().
+    *
+    * With io_uring, accept and receive are multishot requests reading into
+    * a ring of kernel-provided buffers, connections are registered files,
+    * and queued writes of all connections go out in one submission per loop
+    * iteration. Connects and timers keep using epoll, whose descriptor is
+    * itself watched by the ring.
+    * @param backend The backend; IO_URING falls back to EPOLL if the kernel
+    * lacks support.
+    */
+   void setIoBackend(IoBackend backend);
+
+   /**
+    * @brief The backend in use, EPOLL or IO_URING, while the socket is open.
+    */
+   IoBackend getIoBackend() const;
+
+   /**
+    * @brief Share the listening port with other sockets (SO_REUSEPORT);
+    * takes effect at the next open(). The kernel spreads new connections
+    * over the sockets of the group.
+    * @param enabled Whether to set SO_REUSEPORT.
+    * @param steerByCpu Hand each connection to the group member whose index
+    * is the CPU that received it, instead of hashing. Meant for one member
+    * per CPU, opened in CPU order and each with its loop pinned there.
+    */
+   void setReusePort(bool enabled, bool steerByCpu = false);
+
+   /**
+    * @brief Listen on IPv6 and IPv4 at once (default) or on IPv4 only;
+    * takes effect at the next open(). IPv4 peers of a dual-stack listener
+    * are reported by their IPv4 address. A CLIENT connects to whichever
+    * family its host resolves to either way.
+    */
+   void setDualStack(bool enabled);
+
+   /**
+    * @brief Pin the event loop thread to a CPU; takes effect at the next
+    * open().
+    * @param cpu The CPU, or -1 to let the scheduler choose.
+    */
+   void setLoopAffinity(int cpu);
+
+   /**
+   * @brief Run the event loop on reactor's threads instead of a thread of
+   * its own; takes effect at the next open(). The socket's epoll instance
+   * is then one descriptor of the reactor's, and the io_uring backend is
+   * not used. open() of a CLIENT waits for the connect, so it must not be
+   * called from a single-threaded reactor's own thread.
+   * @param reactor The reactor, or nullptr for an own loop thread.
+   */
+   void setReactor(Reactor* reactor);
+
+   int reactorHandle() override;
+   std::chrono::steady_clock::time_point reactorDispatch() override;
+
+   /**
+    * @brief Enable or disable zero-copy sends on all connections.
+    *
+    * A message sent with MSG_ZEROCOPY is kept, unchanged, until the kernel
+    * reports on the socket error queue that it no longer reads it; the event
+    * loop reaps those reports. Kernels without SO_ZEROCOPY, and the io_uring
+    * backend, keep copying.
+    * @param config Whether to enable it and the smallest message it is for.
+    */
+   void setZeroCopy(const ZeroCopyConfig& config);
+
+   /**
+    * @brief The zero-copy counters, summed over all connections.
+    */
+   ZeroCopyStats getZeroCopyStats();
+
+   /**
+    * @brief Set the write mode of all connections.
+    * @param config The mode and its batching limits.
+    */
+   void setWriteMode(const WriteModeConfig& config);
+
+   /**
+    * @brief Send everything held back by the write mode, on all connections.
+    */
+   void flush();
+
+   /**
+    * @brief Send everything held back by the write mode on one connection.
+    * @param connection The connection to flush.
+    */
+   void flush(ConnectionId connection);
+
+   /**
+    * @brief Set the send queue watermarks of all connections.
+    * @param config The watermarks.
+    */
+   void setSendQueue(const SendQueueConfig& config);
+
+   /**
+    * @brief Whether received data is also queued for read().
+    *
+    * On by default. With the queue on, a connection is no longer read while
+    * the queue is full, so a socket whose data is only taken by subscribers
+    * must turn it off. Turning it off discards what is queued.
+    * @param enabled false to deliver to subscribers only.
+    */
+   void setReadQueue(bool enabled);
+
+   /**
+    * @brief Set the function told when a send queue crosses a watermark.
+    *
+    * It runs on the thread that wrote (paused) or on the event loop
+    * (resumed), and must not block.
+    * @param callback The callback, nullptr to remove it.
+    */
+   void setBackpressureCallback(BackpressureCallback callback);
+
+   /**
+    * @brief Set keepalive, user timeout and heartbeat of all connections.
+    *
+    * The time from a heartbeat to the next data received on its connection
+    * is reported as ConnectionInfo::heartbeatRtt; it is the application
+    * round trip when the peer answers heartbeats.
+    * @param config The liveness configuration.
+    */
+   void setLiveness(const LivenessConfig& config);
+
+   /**
+    * @brief Close one connection.
+    * @param connection The connection to close.
+    */
+   void disconnect(ConnectionId connection);
+
+   /**
+    * @brief List the open connections.
+    */
+   std::vector<ConnectionInfo> getConnections();
+
    /**
     * @brief Open the TCP socket for communication.
+    *
+    * In CLIENT mode this waits for openAsync() to finish.
     */
    void open() override;
 
+   /**
+    * @brief Start connecting without blocking the caller.
+    *
+    * Each attempt uses a fresh non-blocking socket whose completion is
+    * reported by the event loop; failed attempts are retried after the
+    * backoff delay until maxRetries attempts were made. Each attempt may
+    * take up to the retry timeout. In SERVER mode this is open(), and the
+    * result, given before this returns, is whether the socket listens.
+    * @param onComplete Called on the event loop thread with the result.
+    * @return Becomes true once connected, false if every attempt failed or
+    * the socket was closed first.
+    */
+   std::future<bool> openAsync(std::function<void(bool)> onComplete = nullptr);
+
+   /**
+    * @brief Set the retry schedule used by openAsync().
+    * @param config The backoff configuration.
+    */
+   void setBackoff(const BackoffConfig& config);
+
    /**
     * @brief Close the TCP socket.
+    *
+    * May be called from a subscriber, on the event loop; the loop then
+    * stops once the subscriber returns. The socket must not be destroyed
+    * or reopened from there.
     */
    void close() override;
 
 private:
-   int tcpSocket;          ///< File descriptor for the TCP socket.
-   sockaddr_in localAddr;  ///< Local address structure.
-   sockaddr_in remoteAddr; ///< Remote address structure.
+   /**
+    * @brief Per-connection state owned by the event loop.
+    */
+   struct Connection {
+       ConnectionId id;
+       int fd;
+       int lingerFd = -1;      ///< fd after closing, until zero-copy sends complete.
+       std::string peer;
+       std::mutex writeMutex;  ///< Guards fd and the send queue.
+       std::atomic<uint64_t> bytesIn{0};
+       std::atomic<uint64_t> bytesOut{0};
+       std::deque<std::vector<uint8_t>> sendQueue; ///< Unsent buffers, oldest first.
+       size_t sendOffset = 0;  ///< Bytes of sendQueue.front() already sent.
+       std::atomic<size_t> queuedBytes{0};
+       bool writeArmed = false; ///< EPOLLOUT is registered.
+       bool paused = false;     ///< Above the high watermark.
+       bool flushPending = false; ///< Data held back by the write mode.
+       int slot = -1;           ///< io_uring fixed-file slot.
+       bool sendInFlight = false; ///< io_uring owns sendIov until it completes.
+       bool sendScheduled = false; ///< Listed in uringSends.
+       iovec sendIov[64];
+       msghdr sendMessage{};
+       bool zeroCopy = false;   ///< SO_ZEROCOPY is set.
+       uint32_t zeroCopyNext = 0; ///< Number the kernel gives the next zero-copy send.
+       int64_t frontZeroCopy = -1; ///< Last zero-copy send that read sendQueue.front().
+       std::deque<std::pair<uint32_t, std::vector<uint8_t>>> zeroCopyPinned; ///< Sent buffers and their last send, until completed.
+       uint64_t pushedBuffers = 0; ///< Buffers ever queued.
+       uint64_t poppedBuffers = 0; ///< Buffers ever fully sent.
+       std::mutex transferMutex;   ///< Held by the thread running a transfer.
+       std::condition_variable transferCv; ///< Signalled when the data ahead of a transfer is out.
+       bool transferring = false;  ///< Buffers from transferBarrier on wait for the transfer.
+       uint64_t transferBarrier = 0;
+       std::chrono::steady_clock::time_point lastReceive; ///< Loop thread only.
+       std::chrono::steady_clock::time_point heartbeatSent; ///< Loop thread only.
+       std::chrono::steady_clock::time_point heartbeatDue;  ///< Loop thread only.
+       bool heartbeatOutstanding = false; ///< Nothing received since heartbeatSent.
+       std::atomic<int64_t> heartbeatRttMicros{0};
+       TimerId livenessTimer = 0;  ///< Next heartbeat or silence deadline, or the linger timeout once closed; timersMutex.
+       TimerId flushTimer = 0;     ///< Deadline of flushPending; timersMutex.
+       bool receivePaused = false; ///< Not read until read() makes room; loop thread only.
+   };
+
+   std::mutex sendQueueMutex;
+   SendQueueConfig sendQueueConfig;
+   BackpressureCallback backpressureCallback;
+   WriteModeConfig writeMode;
+
+   std::mutex zeroCopyMutex;  ///< May be taken while holding a writeMutex.
+   ZeroCopyConfig zeroCopyConfig;
+   ZeroCopyStats zeroCopyStats;
+
+   std::mutex livenessMutex;
+   LivenessConfig liveness;
+
+   std::mutex timersMutex;      ///< Taken last, after any other lock.
+   TimerWheel timers;           ///< Connect, flush, liveness and linger deadlines; read() deadlines wait on the caller's thread.
+   TimerId livenessSweep = 0;   ///< Re-checks every connection after setLiveness().
+   std::vector<uint64_t> expiredTimers; ///< Loop thread only.
+
    int serverSocket = -1;       ///< Server socket file descriptor.
    int clientSocket = -1;      ///< Client socket file descriptor.
+   std::atomic<ConnectionId> clientConnection{0}; ///< Connection of CLIENT mode.
+
+   int epollFd = -1;            ///< Event loop epoll instance.
+   int wakeFd = -1;             ///< eventfd used to stop the loop.
+   std::thread loopThread;      ///< Runs eventLoop().
+   std::atomic<bool> loopRunning{false};
+   std::atomic<bool> listening{false};
+   bool reusePort = false;
+   bool reusePortSteering = false;
+   bool dualStack = true;
+   int loopCpu = -1;            ///< CPU the loop thread is pinned to, -1 for none.
+   Reactor* reactor = nullptr;  ///< Reactor to run the loop on, if any.
+   std::atomic<bool> onReactor{false}; ///< The loop is running on reactor.
+   std::atomic<std::thread::id> dispatchThread{}; ///< Thread inside reactorDispatch(), if any.
+   bool releaseAfterDispatch = false; ///< stopLoop() ran inside reactorDispatch(); that thread only.
+
+   IoBackend ioBackend = IoBackend::EPOLL; ///< Requested backend.
+   std::atomic<bool> usingUring{false};
+#ifdef SOCKET_LIB_HAS_IO_URING
+   std::unique_ptr<IoUring> uring;          ///< Used by the loop thread only.
+#endif
+   std::vector<unsigned> freeSlots;         ///< Guarded by connectionsMutex.
+   std::unordered_map<ConnectionId, std::shared_ptr<Connection>> retired; ///< Closed with a send or zero-copy completions outstanding.
+   std::mutex uringSendsMutex;
+   std::vector<ConnectionId> uringSends;    ///< Connections with data to submit.
+
+   std::mutex connectionsMutex;
+   std::unordered_map<ConnectionId, std::shared_ptr<Connection>> connections;
+   ConnectionId nextConnectionId = 16; ///< Lower values tag the listen and wake fds.
 
    /**
-    * @brief Reconnect to the server.
+    * @brief State of a CLIENT connect driven by the event loop.
     */
-   void reconnect();
+   struct PendingConnect {
+       int fd = -1;             ///< Socket of the attempt in flight.
+       unsigned attempt = 0;    ///< Attempts started so far.
+       std::chrono::steady_clock::time_point due; ///< Next attempt, or deadline of the one in flight.
+       TimerId timer = 0;       ///< Wakes the loop at due; timersMutex.
+       std::promise<bool> result;
+       std::function<void(bool)> onComplete;
+       std::vector<Endpoint> addresses; ///< Resolved remote, tried in turn.
+   };
+
+   std::mutex connectMutex;
+   std::unique_ptr<PendingConnect> pendingConnect;
+   BackoffConfig backoff;
+   std::mt19937 jitterEngine{std::random_device{}()};
+
+   std::mutex inboxMutex;
+   std::condition_variable inboxCv;
+   std::deque<std::pair<ConnectionId, std::vector<uint8_t>>> inbox; ///< Data waiting for read().
+   uint64_t readGeneration = 0; ///< Bumped by cancel(), inboxMutex.
+   bool readQueue = true;       ///< setReadQueue(), inboxMutex.
+   bool readCalled = false;     ///< read() has been called, inboxMutex.
+   std::vector<ConnectionId> pausedReceives; ///< Waiting for room in the inbox, inboxMutex.
+   std::atomic<bool> resumePending{false};   ///< The loop should resume pausedReceives.
+
+   void startLoop();
+   void stopLoop();
+   bool onLoop() const;
+   void releaseLoop();
+   void wakeLoop();
+   void eventLoop();
+   void dispatchEvents(int timeoutMs);
+   void uringLoop();
+   void scheduleSend(Connection& connection);
+   void submitSends();
+   void submitSendLocked(Connection& connection);
+   void completeSend(ConnectionId id, int result);
+   void completeReceive(ConnectionId id, int result, int bufferId, bool more);
+   void consumeSent(Connection& connection, size_t bytes);
+   std::chrono::steady_clock::time_point nextDeadline();
+   int loopTimeout();
+   void driveConnect(bool writable);
+   bool startConnectAttempt(PendingConnect& pending, int& connectedFd);
+   bool scheduleRetry(PendingConnect& pending);
+   void completeConnect(std::unique_ptr<PendingConnect> pending, int connectedFd);
+   void acceptConnections();
+   ConnectionId addConnection(int fd, const std::string& peer);
+   std::shared_ptr<Connection> findConnection(ConnectionId id);
+   bool receiveFrom(Connection& connection);
+   void closeConnection(ConnectionId id);
+   void reapClosed(ConnectionId id, bool expired);
+   static void abortConnection(int fd);
+   bool enqueue(Connection& connection, std::vector<uint8_t> data);
+   bool flushQueue(Connection& connection);
+   bool drainLocked(Connection& connection);
+   void armWrite(Connection& connection, bool arm);
+   void enableZeroCopy(Connection& connection);
+   void reapZeroCopy(Connection& connection);
+   void applyWriteMode(int fd, WriteMode mode);
+   bool flushConnection(Connection& connection);
+   bool armTimer(TimerId& timer, std::chrono::steady_clock::time_point due, uint64_t token);
+   void runTimers();
+   void applyLiveness(int fd, const LivenessConfig& config);
+   void armLiveness(Connection& connection, const LivenessConfig& config);
+   bool checkLiveness(Connection& connection, const LivenessConfig& config, std::chrono::steady_clock::time_point now);
+   void noteReceive(Connection& connection);
+   void signalBackpressure(ConnectionId id, bool paused);
+   bool deliver(ConnectionId id, std::vector<uint8_t> data);
+   void pauseReceive(Connection& connection);
+   void resumeReceives();
+   static bool sendable(const Connection& connection);
+   TransferResult transfer(ConnectionId id, int fd, off_t offset, size_t length, bool useSplice, const TransferProgress& progress);
+   bool beginTransfer(Connection& connection);
+   void endTransfer(Connection& connection);
+   ConnectionId clientTarget(const char* where);
 
    /**
     * @brief Start listening for incoming connections.
     */
    void startListening();
 
-   /**
-    * @brief Connect to the server with retries.
-    * @return True if the connection was successful, false otherwise.
-    */
-   bool connectWithRetries();
-
-   /**
-    * @brief Open a thread for socket operations.
-    */
-   void openthread();
    bool isConnected();
+
+protected:
+   bool applyKernelPacing(const PacingConfig& config) override;
 };
 
 #endif // SOCKET_LIB_LINUXTCPSOCKET_H
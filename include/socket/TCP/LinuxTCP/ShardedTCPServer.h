@@ -0,0 +1,156 @@
+/**
+* @file ShardedTCPServer.h
+* @brief Contains the ShardedTCPServer class declaration.
+*/
+
+#ifndef SOCKET_LIB_SHARDEDTCPSERVER_H
+#define SOCKET_LIB_SHARDEDTCPSERVER_H
+
+#include "socket/TCP/LinuxTCP/LinuxTCPSocket.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+* @brief Shape of a ShardedTCPServer.
+*/
+struct ShardConfig {
+   unsigned shards = 0;        ///< Number of listeners, 0 for one per CPU.
+   std::vector<int> cpus;      ///< CPU of each shard; empty pins shard i to CPU i.
+   bool steerByCpu = false;    ///< Accept on the shard of the CPU that received the connection; needs cpus 0..shards-1.
+   IoBackend ioBackend = IoBackend::EPOLL;
+};
+
+/**
+* @brief Counters of one shard. active is a current value.
+*/
+struct ShardStats {
+   int cpu = -1;              ///< CPU the shard's loop is pinned to.
+   uint64_t accepted = 0;     ///< Connections accepted.
+   size_t active = 0;         ///< Connections open.
+   uint64_t messagesIn = 0;   ///< Reads delivered.
+   uint64_t bytesIn = 0;
+   uint64_t bytesOut = 0;     ///< Bytes queued by writeTo() and broadcast().
+};
+
+/**
+* @class ShardedTCPServer
+* @brief TCP server whose port is served by several LinuxTCPSockets in
+* SERVER mode, each with its own listener (SO_REUSEPORT) and its event loop
+* pinned to one CPU.
+*
+* The kernel spreads incoming connections over the listeners; a connection
+* is then read, written and closed by the loop that accepted it for its
+* whole lifetime. Subscribers run on that loop, with ConnectionIds that are
+* unique across shards. read() merges the data of all shards.
+*
+* The read() queue is bounded. When it is full a shard's loop waits for
+* read() to make room, so that shard's peers are slowed down by TCP flow
+* control; nothing is dropped. A server whose data is only taken by
+* subscribers turns the queue off with setReadQueue().
+*/
+class ShardedTCPServer : public Socket {
+public:
+   /**
+    * @brief Constructor. Nothing listens until open().
+    * @param localPort Port shared by all shards.
+    * @param config The shard layout.
+    * @param readTimeout Seconds read() waits for data.
+    */
+   ShardedTCPServer(int localPort, const ShardConfig& config = ShardConfig(), unsigned readTimeout = 1);
+
+   /**
+    * @brief Destructor.
+    */
+   ~ShardedTCPServer() override;
+
+   /**
+    * @brief Read the next data received by any shard.
+    * @param connection Set to the connection the data came from, 0 on timeout.
+    */
+   Serializable read(ConnectionId& connection);
+   Serializable read() override;
+
+   /**
+    * @brief Whether received data is also queued for read().
+    *
+    * On by default; turning it off discards what is queued.
+    * @param enabled false to deliver to subscribers only.
+    */
+   void setReadQueue(bool enabled);
+
+   /**
+    * @brief Send data to every connection of every shard.
+    */
+   void write(Serializable serializableObj) override;
+
+   bool writeTo(ConnectionId connection, const Serializable& serializableObj);
+   size_t broadcast(const Serializable& serializableObj);
+   void disconnect(ConnectionId connection);
+
+   /**
+    * @brief List the open connections of all shards.
+    */
+   std::vector<ConnectionInfo> getConnections();
+
+   /**
+    * @brief The counters of each shard, in shard order.
+    */
+   std::vector<ShardStats> getShardStats();
+
+   size_t shardCount() const { return shards.size(); }
+
+   /**
+    * @brief Open every shard's listener and start its loop.
+    */
+   void open() override;
+
+   /**
+    * @brief Close all shards.
+    */
+   void close() override;
+
+private:
+   /**
+    * @brief Relays a shard's events with its connection ids made global.
+    */
+   class Forwarder : public Subscriber {
+   public:
+       Forwarder(ShardedTCPServer& server, unsigned shard) : server(server), shard(shard) {}
+       void update(Serializable) override {}
+       void update(Serializable updateData, ConnectionId connection) override;
+       void onConnectionEvent(ConnectionId connection, ConnectionEvent event) override;
+
+   private:
+       ShardedTCPServer& server;
+       unsigned shard;
+   };
+
+   struct Shard {
+       std::unique_ptr<LinuxTCPSocket> socket;
+       int cpu = -1;
+       std::atomic<uint64_t> accepted{0};
+       std::atomic<size_t> active{0};
+       std::atomic<uint64_t> messagesIn{0};
+       std::atomic<uint64_t> bytesIn{0};
+       std::atomic<uint64_t> bytesOut{0};
+   };
+
+   std::vector<std::unique_ptr<Shard>> shards;
+   unsigned readTimeout;
+
+   std::mutex inboxMutex;
+   std::condition_variable inboxCv;
+   std::condition_variable roomCv; ///< The shard loops wait here for room in the inbox.
+   std::deque<std::pair<ConnectionId, std::vector<uint8_t>>> inbox; ///< Data waiting for read().
+   bool readQueue = true; ///< setReadQueue(), inboxMutex.
+   bool closing = false;  ///< Releases the shard loops in close(), inboxMutex.
+
+   ConnectionId globalId(unsigned shard, ConnectionId local) const;
+   Shard* shardOf(ConnectionId global, ConnectionId& local);
+};
+
+#endif // SOCKET_LIB_SHARDEDTCPSERVER_H
@@ -0,0 +1,192 @@
+/**
+* @file TCPConnectionPool.h
+* @brief Contains the TCPConnectionPool class declaration.
+*/
+
+#ifndef SOCKET_LIB_TCPCONNECTIONPOOL_H
+#define SOCKET_LIB_TCPCONNECTIONPOOL_H
+
+#include "socket/TCP/LinuxTCP/LinuxTCPSocket.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+* @brief Sizing and lifetime of the connections of a TCPConnectionPool.
+*/
+struct TCPPoolConfig {
+   size_t maxPerEndpoint = 8;  ///< Idle plus in use plus connecting.
+   size_t minIdle = 1;         ///< Connections kept open and ready per endpoint.
+   std::chrono::milliseconds idleTimeout{60000}; ///< Idle connections above minIdle close after this.
+   std::chrono::milliseconds healthInterval{1000}; ///< Period of the expiry, health and refill pass.
+   std::chrono::milliseconds acquireTimeout{5000}; ///< Longest acquire() wait at the cap.
+   unsigned maxRetries = 3;    ///< Connect attempts per new connection.
+   unsigned retryTimeout = 1;  ///< Seconds; also the read() timeout of pooled sockets.
+   IoBackend ioBackend = IoBackend::EPOLL;
+   WriteModeConfig writeMode;
+};
+
+/**
+* @brief Counters of a TCPConnectionPool. idle and inUse are current values.
+*/
+struct TCPPoolStats {
+   uint64_t created = 0;     ///< Connections opened.
+   uint64_t reused = 0;      ///< acquire() calls served by an idle connection.
+   uint64_t expired = 0;     ///< Idle connections closed after idleTimeout.
+   uint64_t unhealthy = 0;   ///< Idle or returned connections found closed.
+   uint64_t failed = 0;      ///< Connects that gave up.
+   uint64_t timeouts = 0;    ///< acquire() calls that found the endpoint full until acquireTimeout.
+   size_t idle = 0;
+   size_t inUse = 0;
+};
+
+/**
+* @class TCPConnectionPool
+* @brief Keeps CLIENT mode LinuxTCPSockets open per remote endpoint, so a
+* request/response exchange does not pay for the handshake.
+*
+* acquire() hands out the most recently used idle connection, which is a
+* map lookup and a vector pop. A background thread closes idle connections
+* that the peer closed or that exceeded idleTimeout, and reopens connections
+* until every known endpoint has minIdle ready. Liveness is tracked from the
+* sockets' DISCONNECTED events, not by probing.
+*
+* The pool must outlive its handles. Subscribers added through a handle must
+* be removed before it is released.
+*/
+class TCPConnectionPool {
+   struct Member;
+   struct Endpoint;
+
+public:
+   /**
+    * @class Handle
+    * @brief Borrowed connection; returns it to the pool when destroyed.
+    */
+   class Handle {
+   public:
+       Handle() = default;
+       Handle(Handle&& other) noexcept;
+       Handle& operator=(Handle&& other) noexcept;
+       Handle(const Handle&) = delete;
+       Handle& operator=(const Handle&) = delete;
+       ~Handle();
+
+       /**
+        * @brief true if the handle holds a connection.
+        */
+       explicit operator bool() const { return member != nullptr; }
+       LinuxTCPSocket* operator->() const;
+       LinuxTCPSocket& operator*() const;
+
+       /**
+        * @brief Return the connection now instead of at destruction.
+        */
+       void release();
+
+       /**
+        * @brief Close the connection instead of returning it, e.g. after a
+        * protocol error left unread data behind.
+        */
+       void discard();
+
+   private:
+       friend class TCPConnectionPool;
+       Handle(TCPConnectionPool* pool, Endpoint* endpoint, std::unique_ptr<Member> member);
+
+       TCPConnectionPool* pool = nullptr;
+       Endpoint* endpoint = nullptr;
+       std::unique_ptr<Member> member;
+   };
+
+   /**
+    * @brief Start the maintenance thread; no connection is opened yet.
+    * @param config The pool configuration.
+    */
+   explicit TCPConnectionPool(const TCPPoolConfig& config = TCPPoolConfig());
+
+   /**
+    * @brief Destructor. Closes every idle connection.
+    */
+   ~TCPConnectionPool();
+
+   TCPConnectionPool(const TCPConnectionPool&) = delete;
+   TCPConnectionPool& operator=(const TCPConnectionPool&) = delete;
+
+   /**
+    * @brief Open minIdle connections to an endpoint before the first request.
+    * @param ip Remote address.
+    * @param port Remote port.
+    * @return Number of idle connections to the endpoint afterwards.
+    */
+   size_t warm(const std::string& ip, int port);
+
+   /**
+    * @brief Borrow a connection to an endpoint.
+    *
+    * Uses an idle connection if there is one, else opens one on the calling
+    * thread while the endpoint is below maxPerEndpoint, else waits up to
+    * acquireTimeout for one to be released.
+    * @param ip Remote address.
+    * @param port Remote port.
+    * @return A handle, empty if no connection could be had.
+    */
+   Handle acquire(const std::string& ip, int port);
+
+   /**
+    * @brief Get the pool counters.
+    */
+   TCPPoolStats getStats();
+
+   /**
+    * @brief Stop maintenance and close the idle connections. Handles still
+    * out close their connection when released.
+    */
+   void close();
+
+private:
+   /**
+    * @brief One pooled socket and the watch on its connection.
+    */
+   struct Member {
+       std::unique_ptr<LinuxTCPSocket> socket;
+       std::shared_ptr<Subscriber> watch; ///< Clears alive on DISCONNECTED.
+       std::shared_ptr<std::atomic<bool>> alive;
+       std::chrono::steady_clock::time_point idleSince;
+   };
+
+   struct Endpoint {
+       std::string ip;
+       int port = 0;
+       std::vector<std::unique_ptr<Member>> idle; ///< Most recently used last.
+       size_t inUse = 0;
+       size_t connecting = 0;
+   };
+
+   TCPPoolConfig config;
+   std::mutex poolMutex;  ///< Guards endpoints, stats and closed; never held while connecting.
+   std::condition_variable released;
+   std::map<std::string, std::unique_ptr<Endpoint>> endpoints;
+   TCPPoolStats stats;
+   bool closed = false;
+
+   std::mutex maintenanceMutex;
+   std::condition_variable maintenanceCv;
+   bool stopping = false;
+   std::thread maintenanceThread;
+
+   Endpoint& endpointLocked(const std::string& ip, int port);
+   std::unique_ptr<Member> connect(const Endpoint& endpoint);
+   void giveBack(Endpoint* endpoint, std::unique_ptr<Member> member, bool reuse);
+   void maintain();
+   void refill(Endpoint& endpoint);
+};
+
+#endif // SOCKET_LIB_TCPCONNECTIONPOOL_H
@@ -0,0 +1,105 @@
+/**
+ * @file TimerWheel.h
+ * @brief Contains the hierarchical timing wheel used for socket deadlines.
+ */
+
+#ifndef SOCKET_LIB_TIMER_WHEEL_H
+#define SOCKET_LIB_TIMER_WHEEL_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Identifies a scheduled timer; 0 is never a valid timer.
+ */
+using TimerId = uint64_t;
+
+/**
+ * @class TimerWheel
+ * @brief Timers on the monotonic clock with O(1) schedule and cancel.
+ *
+ * Four wheels of 256, 64, 64 and 64 slots cover 2^26 ticks (18.6 hours at
+ * the default 1 ms tick); later timers wait in an overflow list. A timer
+ * goes into the finest wheel its distance allows and moves down a level
+ * when the coarser slot it sits in comes up, so each timer is touched at
+ * most once per level. Timers fire on the first tick at or after their
+ * deadline, never before.
+ *
+ * A timer carries a caller-chosen token that advance() hands back when it
+ * expires; the owner decides what to run. Not thread-safe: guard it with
+ * the lock of the state it schedules for.
+ *
+ * The LinuxTCPSocket event loop and the Reactor each own one. A thread
+ * blocked in a read() with a deadline waits on steady_clock by itself
+ * instead, so its timeout does not depend on a loop running.
+ */
+class TimerWheel {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * @param tick Resolution; deadlines are rounded up to it.
+   */
+  explicit TimerWheel(Clock::duration tick = std::chrono::milliseconds(1));
+
+  /**
+   * @brief Schedules token to expire at due.
+   * @return The timer, or 0 if due is time_point::max().
+   */
+  TimerId schedule(Clock::time_point due, uint64_t token);
+
+  /**
+   * @brief Cancels a pending timer.
+   * @return false if it already expired, was cancelled or is 0.
+   */
+  bool cancel(TimerId timer);
+
+  /**
+   * @brief Expires every timer due by now.
+   * @param expired Receives their tokens, in deadline order.
+   */
+  void advance(Clock::time_point now, std::vector<uint64_t> &expired);
+
+  /**
+   * @brief When advance() next has work: the earliest deadline, or earlier
+   * when a coarse slot must first move down a level. time_point::max() if
+   * no timer is pending.
+   */
+  Clock::time_point nextExpiry() const;
+
+  size_t size() const { return pending; }
+
+ private:
+  static const uint32_t kNone = UINT32_MAX;
+
+  struct Node {
+    uint64_t expires = 0;  ///< Tick.
+    uint64_t token = 0;
+    uint32_t previous = kNone;
+    uint32_t next = kNone;
+    uint32_t list = kNone;  ///< Slot holding the node, kNone when free.
+    uint32_t generation = 1;
+  };
+
+  Clock::time_point origin;
+  Clock::duration tick;
+  uint64_t current = 0;  ///< Last tick processed.
+  size_t pending = 0;
+
+  std::vector<Node> nodes;
+  std::vector<uint32_t> freeNodes;
+  std::vector<uint32_t> heads;     ///< Slot lists, the overflow list last.
+  uint64_t occupied[7] = {};       ///< One bit per non-empty wheel slot.
+
+  uint64_t tickOf(Clock::time_point due) const;
+  void place(uint32_t index);
+  void link(uint32_t index, uint32_t list);
+  void unlink(uint32_t index);
+  void release(uint32_t index);
+  uint64_t nextTick() const;
+  void processTick(std::vector<uint64_t> &expired);
+};
+
+#endif  // SOCKET_LIB_TIMER_WHEEL_H
@@ -0,0 +1,186 @@
+/**
+ * @file FecCodec.h
+ * @brief Contains the forward error correction encoder/decoder used by
+ * UDPSocket.
+ */
+
+#ifndef SOCKET_LIB_FECCODEC_H
+#define SOCKET_LIB_FECCODEC_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Parity scheme used by the FEC layer.
+ */
+enum class FecScheme {
+  NONE,         ///< FEC disabled.
+  XOR,          ///< One XOR parity datagram per block (recovers one loss).
+  REED_SOLOMON  ///< M Reed-Solomon parity datagrams per block over GF(256).
+};
+
+/**
+ * @brief Configuration of the FEC layer.
+ *
+ * Loss tolerance is parityShards / dataShards: every block of dataShards
+ * datagrams survives the loss of any parityShards of its datagrams. The CPU
+ * cost grows with dataShards * parityShards, and XOR is the cheapest scheme.
+ */
+struct FecConfig {
+  FecScheme scheme = FecScheme::NONE;
+  unsigned dataShards = 8;         ///< K, data datagrams per block (1..250).
+  unsigned parityShards = 1;       ///< M, parity datagrams per block (XOR: 1).
+  unsigned maxPendingBlocks = 16;  ///< Receive window of blocks, per sender.
+  size_t maxPeers = 1024;  ///< Senders decoded at once; the one heard from
+                           ///< least recently is forgotten first.
+  /// Silence after which a sender's next datagram starts over, and after
+  /// which an idle sender is forgotten.
+  std::chrono::milliseconds peerIdleTimeout{5000};
+  /// How long a partial block waits for more payloads before its parity is
+  /// sent anyway; zero leaves it to UDPSocket::flush() and close().
+  std::chrono::microseconds parityDeadline{0};
+};
+
+/**
+ * @brief Counters exposed by the FEC layer.
+ */
+struct FecStats {
+  uint64_t dataSent = 0;           ///< Data datagrams emitted.
+  uint64_t paritySent = 0;         ///< Parity datagrams emitted.
+  uint64_t dataReceived = 0;       ///< Data datagrams received.
+  uint64_t parityReceived = 0;     ///< Parity datagrams received.
+  uint64_t recovered = 0;          ///< Data datagrams rebuilt from parity.
+  uint64_t unrecoverable = 0;      ///< Data datagrams lost for good.
+};
+
+/**
+ * @class FecEncoder
+ * @brief Wraps outgoing payloads in FEC data datagrams and emits parity
+ * datagrams once a block is complete.
+ *
+ * Data datagrams are emitted immediately, so FEC adds no latency to the
+ * happy path; parity follows the last datagram of each block. A block cut
+ * short by flush() gets parity over the payloads it holds, so the tail of a
+ * burst is protected too.
+ */
+class FecEncoder {
+ public:
+  explicit FecEncoder(const FecConfig &config);
+
+  /**
+   * @brief Encodes one payload.
+   * @param payload The application payload.
+   * @return The datagrams to send, in order: the data datagram followed by
+   * the parity datagrams if this payload closed a block.
+   */
+  std::vector<std::vector<uint8_t>> encode(const std::vector<uint8_t> &payload);
+
+  /**
+   * @brief Closes the open block early.
+   * @return The parity datagrams of the payloads encoded since the last
+   * block closed; empty if there are none.
+   */
+  std::vector<std::vector<uint8_t>> flush();
+
+  /**
+   * @brief When the open block is due for flush(): config.parityDeadline
+   * after its first payload, or time_point::max() if there is no open block
+   * or no deadline.
+   */
+  std::chrono::steady_clock::time_point deadline() const;
+
+  /**
+   * @brief Bytes the largest datagram of a block, its parity, takes beyond
+   * the largest payload.
+   */
+  static size_t overhead();
+
+  const FecStats &stats() const { return counters; }
+
+ private:
+  void closeBlock(std::vector<std::vector<uint8_t>> &out);
+
+  FecConfig config;
+  uint32_t blockId = 0;
+  std::vector<std::vector<uint8_t>> block;  ///< Payloads of the open block.
+  std::chrono::steady_clock::time_point opened;  ///< First payload of block.
+  FecStats counters;
+};
+
+/**
+ * @class FecDecoder
+ * @brief Strips FEC headers from incoming datagrams and rebuilds lost data
+ * datagrams from parity without a round trip.
+ *
+ * Every sender numbers its blocks from 0, so blocks are kept per sending
+ * peer. A block id further behind the sender's newest than the receive
+ * window, or the first datagram after config.peerIdleTimeout of silence,
+ * means the sender started over: its old blocks are dropped.
+ */
+class FecDecoder {
+ public:
+  explicit FecDecoder(const FecConfig &config);
+
+  /**
+   * @brief Decodes one received datagram of a single sender.
+   * @param datagram The datagram as read from the socket.
+   * @return The payloads that became deliverable: the payload carried by a
+   * data datagram, or those rebuilt after a parity datagram arrived.
+   * Datagrams without an FEC header are returned unchanged.
+   */
+  std::vector<std::vector<uint8_t>> decode(const std::vector<uint8_t> &datagram);
+
+  /**
+   * @brief Decodes one received datagram of peer.
+   * @param peer Opaque key identifying the sender (raw socket address).
+   * @param datagram The datagram as read from the socket.
+   * @param now Current monotonic time.
+   */
+  std::vector<std::vector<uint8_t>> decode(
+      const std::string &peer, const std::vector<uint8_t> &datagram,
+      std::chrono::steady_clock::time_point now);
+
+  /**
+   * @brief Forgets senders idle for longer than config.peerIdleTimeout.
+   */
+  void expire(std::chrono::steady_clock::time_point now);
+
+  const FecStats &stats() const { return counters; }
+
+ private:
+  struct Block {
+    FecScheme scheme = FecScheme::NONE;
+    unsigned dataShards = 0;
+    unsigned parityShards = 0;
+    size_t shardLength = 0;  ///< Protected length carried by parity.
+    std::vector<std::vector<uint8_t>> shards;  ///< K data then M parity.
+    std::vector<bool> present;
+    unsigned received = 0;
+    bool complete = false;
+    bool shortened = false;  ///< Closed by flush() with fewer than K shards.
+  };
+
+  struct Peer {
+    std::map<uint32_t, Block> blocks;
+    std::deque<uint32_t> order;  ///< Block ids in arrival order, for eviction.
+    uint32_t newest = 0;         ///< Highest block id seen, modulo 2^32.
+    std::chrono::steady_clock::time_point lastSeen;
+  };
+
+  bool shorten(Block &block, unsigned dataShards);
+  void recover(Block &block, std::vector<std::vector<uint8_t>> &output);
+  void evict(Peer &peer, uint32_t id);
+  void reset(Peer &peer);
+  void forgetOldest();
+
+  FecConfig config;
+  std::map<std::string, Peer> peers;
+  FecStats counters;
+};
+
+#endif  // SOCKET_LIB_FECCODEC_H
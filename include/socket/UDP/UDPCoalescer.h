@@ -0,0 +1,82 @@
+/**
+ * @file UDPCoalescer.h
+ * @brief Contains the small-message coalescing layer used by UDPSocket.
+ */
+
+#ifndef SOCKET_LIB_UDPCOALESCER_H
+#define SOCKET_LIB_UDPCOALESCER_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+/**
+ * @brief Configuration of the coalescing layer.
+ */
+struct CoalescingConfig {
+  bool enabled = false;
+  /// Largest UDP payload: a 1500-byte MTU minus the IPv4 and UDP headers.
+  /// UDPSocket takes the sequencing and FEC headers in use and the larger
+  /// IPv6 header off it, so a full datagram does not fragment.
+  size_t maxDatagramSize = 1472;
+  std::chrono::microseconds flushDeadline{200};  ///< Max time a message waits.
+};
+
+/**
+ * @class UDPCoalescer
+ * @brief Packs many small messages into one datagram.
+ *
+ * A coalesced datagram is a one byte marker followed by sub-frames, each a
+ * LEB128 length (one byte below 128 bytes) and the message bytes.
+ */
+class UDPCoalescer {
+ public:
+  explicit UDPCoalescer(const CoalescingConfig &config);
+
+  /**
+   * @brief Adds a message to the open datagram.
+   * @param message The message.
+   * @param now Current monotonic time, starts the flush deadline of an
+   * empty datagram.
+   * @return Datagrams that are complete and must be sent now.
+   */
+  std::vector<std::vector<uint8_t>> add(
+      const std::vector<uint8_t> &message,
+      std::chrono::steady_clock::time_point now);
+
+  /**
+   * @brief Caps coalesced datagrams at size bytes instead of
+   * config.maxDatagramSize, leaving room for headers added further down.
+   */
+  void setLimit(size_t size);
+
+  /**
+   * @brief Closes the open datagram.
+   * @return The datagram, empty if no message was pending.
+   */
+  std::vector<uint8_t> flush();
+
+  /**
+   * @brief Returns when the open datagram must be flushed, or
+   * time_point::max() if it is empty.
+   */
+  std::chrono::steady_clock::time_point deadline() const;
+
+  /**
+   * @brief Splits a received datagram into its messages.
+   *
+   * Datagrams without the coalescing marker are passed through whole.
+   * @return false if the datagram was malformed and dropped.
+   */
+  static bool unpack(const std::vector<uint8_t> &datagram,
+                     std::deque<std::vector<uint8_t>> &output);
+
+ private:
+  CoalescingConfig config;
+  size_t limit;  ///< Bytes a coalesced datagram may take.
+  std::vector<uint8_t> open;
+  std::chrono::steady_clock::time_point opened;
+};
+
+#endif  // SOCKET_LIB_UDPCOALESCER_H
@@ -0,0 +1,156 @@
+/**
+ * @file UDPSequencer.h
+ * @brief Contains the per-peer sequencing and reorder layer used by UDPSocket.
+ */
+
+#ifndef SOCKET_LIB_UDPSEQUENCER_H
+#define SOCKET_LIB_UDPSEQUENCER_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Configuration of the sequencing layer.
+ */
+struct SequencerConfig {
+  bool enabled = false;
+  size_t reorderWindow = 64;  ///< Max datagrams held back behind a gap.
+  std::chrono::microseconds reorderTimeout{
+      std::chrono::milliseconds(20)};  ///< Max time a gap may stall delivery.
+  size_t maxPeers = 1024;  ///< Senders tracked at once; the one heard from
+                           ///< least recently is forgotten first.
+  /// Silence after which a sender's next datagram starts a new sequence,
+  /// and after which an idle sender is forgotten.
+  std::chrono::milliseconds peerIdleTimeout{5000};
+};
+
+/**
+ * @brief Counters of the sequencing layer, summed over all peers.
+ */
+struct SequencerStats {
+  uint64_t delivered = 0;   ///< Datagrams released in order.
+  uint64_t lost = 0;        ///< Sequence numbers skipped by released gaps.
+  uint64_t gaps = 0;        ///< Holes given up on (LOST gap events).
+  uint64_t duplicates = 0;  ///< Datagrams seen twice.
+  uint64_t reordered = 0;   ///< Datagrams that arrived ahead of a hole.
+  uint64_t late = 0;        ///< Datagrams that arrived after their hole was
+                            ///< released; they are dropped.
+  uint64_t restarts = 0;    ///< Senders seen starting a new sequence.
+};
+
+/**
+ * @brief What happened to a hole in a peer's sequence.
+ */
+enum class GapEvent {
+  DETECTED,  ///< A datagram arrived ahead of it; it may still fill in.
+  LOST       ///< It was given up on; later datagrams were delivered.
+};
+
+/**
+ * @brief A hole in a peer's sequence.
+ */
+struct SequenceGap {
+  std::string peer;       ///< Sender as "ip:port".
+  uint32_t firstMissing;  ///< First missing sequence number.
+  uint32_t count;         ///< Number of consecutive missing sequence numbers.
+  GapEvent event = GapEvent::LOST;
+};
+
+/**
+ * @class UDPSequencer
+ * @brief Stamps outgoing datagrams with a sequence number and restores the
+ * order of incoming ones per sending peer.
+ *
+ * Datagrams that arrive ahead of a hole are held in a bounded reorder buffer.
+ * The hole is reported as DETECTED by the first datagram beyond it, so the
+ * application can ask for a retransmission while it still fits in. It is
+ * released, and reported as LOST, when the buffer is full or when it has
+ * stalled delivery for longer than the reorder timeout.
+ *
+ * A sender that restarts on the same address begins again at sequence 0.
+ * A datagram further behind than the reorder window that is not a known
+ * hole, or the first one after config.peerIdleTimeout of silence, starts
+ * a new sequence for its sender instead of being dropped as a duplicate.
+ */
+class UDPSequencer {
+ public:
+  explicit UDPSequencer(const SequencerConfig &config);
+
+  /**
+   * @brief Prefixes a payload with the next outgoing sequence number.
+   */
+  std::vector<uint8_t> stamp(const std::vector<uint8_t> &payload);
+
+  /**
+   * @brief Bytes stamp() adds to a payload.
+   */
+  static size_t overhead();
+
+  /**
+   * @brief Processes one incoming datagram.
+   * @param peer Opaque key identifying the sender (raw socket address).
+   * @param peerName Printable sender name used in gap reports.
+   * @param datagram The datagram, sequencing header included.
+   * @param now Current monotonic time.
+   * @param output Receives the payloads released in order.
+   * @param gaps Receives the gaps this datagram uncovered or released.
+   */
+  void receive(const std::string &peer, const std::string &peerName,
+               const std::vector<uint8_t> &datagram,
+               std::chrono::steady_clock::time_point now,
+               std::deque<std::vector<uint8_t>> &output,
+               std::vector<SequenceGap> &gaps);
+
+  /**
+   * @brief Releases holes that stalled delivery past the reorder timeout
+   * and forgets senders idle for longer than config.peerIdleTimeout.
+   */
+  void expire(std::chrono::steady_clock::time_point now,
+              std::deque<std::vector<uint8_t>> &output,
+              std::vector<SequenceGap> &gaps);
+
+  /**
+   * @brief Returns when the oldest held-back datagram times out, or
+   * time_point::max() if nothing is held back.
+   */
+  std::chrono::steady_clock::time_point nextDeadline() const;
+
+  const SequencerStats &stats() const { return counters; }
+
+ private:
+  struct Held {
+    std::vector<uint8_t> payload;
+    std::chrono::steady_clock::time_point arrival;
+  };
+
+  struct Peer {
+    std::string name;
+    std::chrono::steady_clock::time_point lastSeen;
+    uint64_t expected = 0;           ///< Next sequence, extended to 64 bits.
+    std::map<uint64_t, Held> held;   ///< Reorder buffer.
+    std::deque<std::pair<uint64_t, uint64_t>> lost;  ///< Recently released
+                                                     ///< holes (first, count).
+  };
+
+  void drain(Peer &peer, std::deque<std::vector<uint8_t>> &output);
+  void releaseGap(Peer &peer, std::deque<std::vector<uint8_t>> &output,
+                  std::vector<SequenceGap> &gaps);
+  void restart(Peer &peer, uint32_t sequence,
+               std::deque<std::vector<uint8_t>> &output,
+               std::vector<SequenceGap> &gaps);
+  void forgetOldest(std::deque<std::vector<uint8_t>> &output,
+                    std::vector<SequenceGap> &gaps);
+
+  SequencerConfig config;
+  uint32_t nextSequence = 0;
+  std::map<std::string, Peer> peers;
+  SequencerStats counters;
+};
+
+#endif  // SOCKET_LIB_UDPSEQUENCER_H
@@ -1,10 +1,24 @@
 #ifndef SOCKET_LIB_UDPSOCKET_H
 #define SOCKET_LIB_UDPSOCKET_H
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
+#include "socket/AsyncWriter.h"
+#include "socket/Endpoint.h"
+#include "socket/IoUring.h"
 #include "socket/Socket.h"
+#include "socket/UDP/FecCodec.h"
+#include "socket/UDP/UDPCoalescer.h"
+#include "socket/UDP/UDPSequencer.h"
 
 #ifdef _WIN32
 #include <winsock2.h>
@@ -26,9 +40,91 @@ class UDPSocket : public Socket {
 #else
   int udpSocket;
 #endif
-  struct sockaddr_in localAddr {};
-  struct sockaddr_in remoteAddr {};
-  std::mutex socketMutex;
+  Endpoint localAddr;
+  Endpoint remoteAddr;  ///< Resolved by open(), never while sending.
+  int wireFamily = AF_INET;  ///< IP version datagrams to remoteAddr use,
+                             ///< even from a dual-stack socket.
+  bool reuseAddress = false;
+  bool dualStack = false;
+  std::mutex socketMutex;  ///< Guards the socket and the send path.
+  std::mutex readMutex;    ///< Guards the receive path, so a read() waiting
+                           ///< for data does not hold up writers.
+  int wakeFd = -1;  ///< eventfd cancel() signals to wake a waiting read()
+                    ///< (Linux only).
+  std::atomic<uint64_t> readGeneration{0};  ///< Bumped by cancel().
+  std::atomic<bool> readsClosed{true};      ///< Not open, reads return.
+  std::chrono::steady_clock::duration readTimeout =
+      std::chrono::seconds(1);  ///< Of read() without a deadline, readMutex.
+  std::unique_ptr<FecEncoder> fecEncoder;
+  std::unique_ptr<FecDecoder> fecDecoder;
+  std::unique_ptr<UDPSequencer> sequencer;
+  std::function<void(const SequenceGap&)> gapCallback;
+  std::unique_ptr<UDPCoalescer> coalescer;
+  size_t coalesceSize = 0;  ///< CoalescingConfig::maxDatagramSize.
+  std::thread flushThread;  ///< Sends coalesced datagrams and the parity of
+                            ///< partial FEC blocks on their deadline.
+  std::condition_variable flushCv;
+  bool flushStop = false;
+  bool parityOnDeadline = false;  ///< FecConfig::parityDeadline is set.
+  bool unpackCoalesced = false;  ///< Receive side of coalescing, readMutex.
+  std::deque<std::vector<uint8_t>> pendingReads;  ///< Decoded, not yet read.
+  std::vector<uint8_t> receiveBuffer =
+      std::vector<uint8_t>(65536);  ///< Fits the largest UDP datagram.
+  IoBackend ioBackend = IoBackend::EPOLL;
+  std::mutex asyncWriteMutex;  ///< Guards the two below and starting and
+                               ///< stopping the writer; never taken with
+                               ///< socketMutex held while stopping.
+  AsyncWriteConfig asyncWriteConfig;
+  AsyncWriteStats asyncWriteTotals;  ///< Of writers already stopped.
+  std::shared_ptr<AsyncWriter> asyncWriter;  ///< Atomic access only.
+#ifdef SOCKET_LIB_HAS_IO_URING
+  std::unique_ptr<IoUring> recvRing;  ///< Multishot recvmsg, readMutex.
+  std::unique_ptr<IoUring> sendRing;  ///< Batched sendmsg, socketMutex.
+  msghdr recvLayout{};  ///< Tells recvmsg how much room the name gets.
+  bool recvArmed = false;
+
+  bool wakeArmed = false;  ///< Multishot poll of wakeFd, readMutex.
+
+  bool receiveUring(std::chrono::nanoseconds timeout,
+                    std::vector<SequenceGap>& gaps);
+  bool sendBatch(const std::vector<std::vector<uint8_t>>& datagrams);
+#endif
+
+  bool sendDatagram(const std::vector<uint8_t>& datagram);
+  bool sendFrame(const std::vector<uint8_t>& frame);
+  void encodeFrame(const std::vector<uint8_t>& frame,
+                   std::vector<std::vector<uint8_t>>& datagrams);
+  bool sendDatagrams(const std::vector<std::vector<uint8_t>>& datagrams);
+#ifdef __linux__
+  bool sendMany(const std::vector<std::vector<uint8_t>>& datagrams);
+#endif
+  bool writeBatch(std::vector<std::vector<uint8_t>>& messages);
+  void startAsyncWriter();
+  void stopAsyncWriter(bool closing);
+  void setOption(int level, int option, const void* value, int length,
+                 const char* where);
+  void changeMembership(int option, const std::string& group,
+                        const std::string& source,
+                        const std::string& interfaceIp, const char* where);
+  std::chrono::steady_clock::time_point nextFlush();
+  void sendPending(std::chrono::steady_clock::time_point now);
+  void flushLoop();
+  void startFlushThread();
+  void stopFlushThread();
+  void fitCoalescer();
+  void enqueueReceived(const std::vector<uint8_t>& payload);
+  bool receivePayload(std::vector<uint8_t>& payload,
+                      std::vector<SequenceGap>& gaps,
+                      std::chrono::steady_clock::time_point deadline,
+                      uint64_t generation);
+  void reportGaps(const std::vector<SequenceGap>& gaps,
+                  const std::function<void(const SequenceGap&)>& onGap);
+  void processDatagram(std::vector<uint8_t> datagram, const Endpoint& peer,
+                       std::vector<SequenceGap>& gaps);
+  Serializable deliver(std::vector<uint8_t> payload);
+
+ protected:
+  bool applyKernelPacing(const PacingConfig& config) override;
 
  public:
   UDPSocket();
@@ -39,7 +135,211 @@ class UDPSocket : public Socket {
   void close() override;
   void write(Serializable serializableObj) override;
   Serializable read() override;
-  
+
+  /**
+   * @brief Waits for a message until deadline.
+   *
+   * select() waits for the time left, worked out again on steady_clock
+   * after every wake. There is no event loop, and so no TimerWheel, on the
+   * reading thread.
+   * @return The message, or an empty Serializable if the deadline passed,
+   * cancel() was called or the socket was closed.
+   */
+  Serializable read(std::chrono::steady_clock::time_point deadline);
+
+  /**
+   * @brief Returns a message that has already arrived, or an empty
+   * Serializable, without waiting.
+   */
+  Serializable tryRead();
+
+  /**
+   * @brief Wakes every read() waiting right now; they return an empty
+   * Serializable. Reads started later wait as usual. close() does the
+   * same, so a reader never holds up closing.
+   */
+  void cancel();
+
+  /**
+   * @brief Sets how long read() without a deadline waits, 1 s by default;
+   * duration::max() waits until data arrives or the read is cancelled.
+   */
+  void setReadTimeout(std::chrono::steady_clock::duration timeout);
+
+  /**
+   * @brief Reactor support: the socket, or the io_uring receiving for it.
+   * A socket driven by a Reactor should not also be read().
+   */
+  int reactorHandle() override;
+  std::chrono::steady_clock::time_point reactorDispatch() override;
+
+  /**
+   * @brief Enables, reconfigures or disables (FecScheme::NONE) forward error
+   * correction.
+   *
+   * Both peers must use the same scheme; block geometry travels in every
+   * datagram, so the receiver adapts to whatever K and M the sender uses.
+   * A partial block gets its parity on flush(), close() or after
+   * config.parityDeadline.
+   * @param config The FEC configuration.
+   */
+  void setFec(const FecConfig& config);
+
+  /**
+   * @brief Returns the FEC counters of both directions.
+   */
+  FecStats getFecStats();
+
+  /**
+   * @brief Enables, reconfigures or disables per-peer sequencing.
+   *
+   * When enabled every datagram carries a sequence number and read()
+   * returns datagrams of each sender in order, holding early ones back for
+   * at most config.reorderTimeout. Both peers must enable it.
+   * @param config The sequencing configuration.
+   */
+  void setSequencing(const SequencerConfig& config);
+
+  /**
+   * @brief Sets the function called for sequence gaps.
+   *
+   * A gap is reported as GapEvent::DETECTED as soon as a datagram arrives
+   * ahead of it, while there is still time to retransmit what is missing,
+   * and again as GapEvent::LOST if it is given up on. It is called from the
+   * reading thread after the socket lock is released, so it may write to
+   * this socket (e.g. to request a retransmission).
+   */
+  void setGapCallback(std::function<void(const SequenceGap&)> callback);
+
+  /**
+   * @brief Returns the sequencing counters, summed over all peers.
+   */
+  SequencerStats getSequenceStats();
+
+  /**
+   * @brief Enables, reconfigures or disables small-message coalescing.
+   *
+   * When enabled write() appends to an MTU-sized datagram that is sent when
+   * the next message no longer fits or config.flushDeadline after its first
+   * message, whichever comes first. The receiving UDPSocket, which must
+   * enable coalescing too, splits it back into one Serializable per message.
+   * The sequencing and FEC headers in use, and the longer IPv6 header for
+   * an IPv6 peer, are taken off config.maxDatagramSize, so the datagram on
+   * the wire stays within it.
+   * @param config The coalescing configuration.
+   */
+  void setCoalescing(const CoalescingConfig& config);
+
+  /**
+   * @brief Sends what write() queued in asynchronous mode, then the pending
+   * coalesced datagram and the parity of the open FEC block.
+   */
+  void flush();
+
+  /**
+   * @brief Enables, reconfigures or disables asynchronous writes.
+   *
+   * When enabled write() queues the message and returns; a writer thread
+   * sends the queue in batches, with one sendmmsg() (or one io_uring
+   * submission) per batch under a single acquisition of the socket lock.
+   * Reconfiguring sends what is already queued first. Settings made before
+   * open() are applied when the socket opens.
+   * @param config The asynchronous write configuration.
+   */
+  void setAsyncWrite(const AsyncWriteConfig& config);
+
+  /**
+   * @brief Waits until everything written so far in asynchronous mode has
+   * been sent.
+   * @return false on timeout.
+   */
+  bool drainWrites(std::chrono::steady_clock::duration timeout);
+
+  /**
+   * @brief Returns the asynchronous write counters since construction.
+   */
+  AsyncWriteStats getAsyncWriteStats();
+
+  /**
+   * @brief Selects how the socket does its I/O; takes effect on open().
+   *
+   * With io_uring the receive side keeps one multishot recvmsg armed over
+   * a ring of provided buffers, and the datagrams of one write() (FEC
+   * shards, coalesced frames) go to the kernel in a single submission.
+   * Falls back to EPOLL when the kernel lacks io_uring support.
+   */
+  void setIoBackend(IoBackend backend);
+
+  /**
+   * @brief Returns the backend in use, or the requested one before open().
+   */
+  IoBackend getIoBackend();
+
+  /**
+   * @brief Lets several sockets bind the same local port (SO_REUSEADDR),
+   * so multiple receivers of a multicast group can share one host.
+   *
+   * Must be called before open().
+   */
+  void setReuseAddress(bool enable);
+
+  /**
+   * @brief Receives from IPv6 and IPv4 peers on one IPv6 socket. Without it
+   * the socket takes the family of the remote address, IPv4 if there is
+   * none. Multicast membership stays IPv4.
+   *
+   * Must be called before open().
+   */
+  void setDualStack(bool enable);
+
+  /**
+   * @brief Joins an any-source multicast group.
+   *
+   * Multicast is sent by constructing the socket with the group as remote
+   * ip; all the methods below require an open socket.
+   * @param group The group address, e.g. "239.1.2.3".
+   * @param interfaceIp Address of the local interface to join on;
+   * "0.0.0.0" lets the kernel choose.
+   */
+  void joinGroup(const std::string& group,
+                 const std::string& interfaceIp = "0.0.0.0");
+
+  /**
+   * @brief Leaves an any-source multicast group.
+   */
+  void leaveGroup(const std::string& group,
+                  const std::string& interfaceIp = "0.0.0.0");
+
+  /**
+   * @brief Joins a source-specific multicast group (only datagrams from
+   * source are received).
+   */
+  void joinSourceGroup(const std::string& group, const std::string& source,
+                       const std::string& interfaceIp = "0.0.0.0");
+
+  /**
+   * @brief Leaves a source-specific multicast group.
+   */
+  void leaveSourceGroup(const std::string& group, const std::string& source,
+                        const std::string& interfaceIp = "0.0.0.0");
+
+  /**
+   * @brief Sets the TTL of outgoing multicast datagrams (IP_MULTICAST_TTL).
+   */
+  void setMulticastTTL(int ttl);
+
+  /**
+   * @brief Enables or disables local delivery of our own multicast
+   * datagrams (IP_MULTICAST_LOOP).
+   */
+  void setMulticastLoop(bool enable);
+
+  /**
+   * @brief Selects the interface outgoing multicast leaves through
+   * (IP_MULTICAST_IF).
+   * @param interfaceIp Address of the local interface.
+   */
+  void setMulticastInterface(const std::string& interfaceIp);
 };
 
 #endif  // SOCKET_LIB_UDPSOCKET_H
@@ -0,0 +1,172 @@
+/**
+ * @file UnixSocket.h
+ * @brief Contains the UnixSocket class declaration.
+ */
+
+#ifndef SOCKET_LIB_UNIXSOCKET_H
+#define SOCKET_LIB_UNIXSOCKET_H
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "socket/Socket.h"
+
+/**
+ * @brief Kind of a UnixSocket.
+ */
+enum class UnixSocketType {
+  STREAM,     ///< SOCK_STREAM: a byte stream, read() returns chunks.
+  SEQPACKET,  ///< SOCK_SEQPACKET: connected, keeps message boundaries.
+  DATAGRAM    ///< SOCK_DGRAM: connectionless, keeps message boundaries.
+};
+
+/**
+ * @class UnixSocket
+ * @brief Same-host transport over AF_UNIX, with the Socket interface of the
+ * TCP and UDP sockets.
+ *
+ * A path starting with '@' is an abstract-namespace address (Linux): it
+ * lives only while bound and needs no file system cleanup. Other paths are
+ * files; a SERVER removes a stale one before binding and its own on close().
+ *
+ * A SERVER serves any number of peers, each with its own ConnectionId: the
+ * accepted connections for STREAM and SEQPACKET, the sending addresses for
+ * DATAGRAM. Like UDPSocket, data is received and passed to subscribers by
+ * read(), which also accepts new connections.
+ */
+class UnixSocket : public Socket {
+ public:
+  enum Role { SERVER, CLIENT };
+
+  /**
+   * @brief Constructor; nothing is opened yet.
+   * @param path Address the SERVER binds and the CLIENT connects to.
+   * @param role SERVER or CLIENT.
+   * @param type Socket kind.
+   * @param readTimeout Longest wait of read().
+   */
+  UnixSocket(std::string path, Role role,
+             UnixSocketType type = UnixSocketType::STREAM,
+             std::chrono::milliseconds readTimeout =
+                 std::chrono::milliseconds(1000));
+
+  ~UnixSocket() override;
+
+  /**
+   * @brief Binds (SERVER) or connects (CLIENT).
+   * @throws std::runtime_error if that fails.
+   */
+  void open() override;
+  void close() override;
+
+  /**
+   * @brief Waits up to the read timeout for data from any peer.
+   * @return The data, empty on timeout.
+   */
+  Serializable read() override;
+
+  /**
+   * @brief As read(), telling the connection the data came from.
+   */
+  Serializable read(ConnectionId &connection);
+
+  /**
+   * @brief Waits for data until deadline.
+   * @return The data, or an empty Serializable if the deadline passed,
+   * cancel() was called or the socket was closed.
+   */
+  Serializable read(std::chrono::steady_clock::time_point deadline);
+  Serializable read(ConnectionId &connection,
+                    std::chrono::steady_clock::time_point deadline);
+
+  /**
+   * @brief Returns data that has already arrived, or an empty Serializable,
+   * without waiting.
+   */
+  Serializable tryRead();
+
+  /**
+   * @brief Wakes every read() waiting right now; they return an empty
+   * Serializable. Reads started later wait as usual. close() does the same.
+   */
+  void cancel();
+
+  /**
+   * @brief Sends to the server (CLIENT) or to every peer (SERVER).
+   */
+  void write(Serializable serializableObj) override;
+
+  bool writeTo(ConnectionId connection, const Serializable &serializableObj);
+  size_t broadcast(const Serializable &serializableObj);
+
+  /**
+   * @brief Passes descriptors to the peer (SCM_RIGHTS) along with data.
+   *
+   * The receiver gets its own descriptors for the same open files through
+   * takeReceivedFds(). The caller keeps ownership of fds.
+   * @param fds Descriptors to pass.
+   * @param data Data sent with them; a single zero byte if empty, as stream
+   * sockets cannot carry descriptors alone.
+   */
+  bool sendFds(const std::vector<int> &fds,
+               const Serializable &data = Serializable());
+  bool sendFdsTo(ConnectionId connection, const std::vector<int> &fds,
+                 const Serializable &data = Serializable());
+
+  /**
+   * @brief Descriptors received by read() so far, oldest first; the caller
+   * now owns them.
+   */
+  std::vector<int> takeReceivedFds();
+
+  /**
+   * @brief Closes one peer's connection (SERVER) or forgets its address.
+   */
+  void disconnect(ConnectionId connection);
+
+  /**
+   * @brief Ids of the peers known now.
+   */
+  std::vector<ConnectionId> getConnections();
+
+ private:
+  struct Peer {
+    int fd = -1;           ///< Connected socket; the shared socket for DATAGRAM.
+    sockaddr_un address{};  ///< DATAGRAM peer address.
+    socklen_t addressLength = 0;
+  };
+
+  std::string path;
+  Role role;
+  UnixSocketType type;
+  std::chrono::milliseconds readTimeout;
+  int socketFd = -1;  ///< Listener (SERVER) or the connection (CLIENT).
+  int wakeFd = -1;    ///< eventfd cancel() signals to wake a waiting read().
+  std::atomic<uint64_t> readGeneration{0};  ///< Bumped by cancel().
+
+  std::mutex socketMutex;  ///< Guards socketFd, peers and sends.
+  std::mutex readMutex;    ///< Serialises read().
+  std::map<ConnectionId, Peer> peers;
+  std::map<std::string, ConnectionId> datagramPeers;  ///< Address to id.
+  ConnectionId nextPeerId = 1;
+  std::vector<int> receivedFds;  ///< Guarded by socketMutex.
+  std::vector<uint8_t> receiveBuffer = std::vector<uint8_t>(65536);
+
+  int socketType() const;
+  bool sendTo(const Peer &peer, const std::vector<uint8_t> &data,
+              const std::vector<int> &fds);
+  bool receive(ConnectionId &id, int fd, std::vector<uint8_t> &data,
+               bool &closed);
+  void acceptPeers();
+  void dropPeer(ConnectionId id);
+  bool abstractAddress() const { return !path.empty() && path[0] == '@'; }
+};
+
+#endif  // SOCKET_LIB_UNIXSOCKET_H
@@ -17,6 +17,13 @@ std::unique_ptr<Socket> FactorySocket::createUDPSocket(std::string ip, int local
 {
     return std::make_unique<SerialSocket>(portName,baudRate,dataBits,stopBits,parity);
 }
+
+#ifdef __linux__
+std::unique_ptr<Socket> FactorySocket::createUnixSocket(std::string path, UnixSocket::Role role, UnixSocketType type)
+{
+    return std::make_unique<UnixSocket>(path,role,type);
+}
+#endif
 /*
 std::unique_ptr<Socket> FactorySocket::createTCPSocket(const std::string &ip, int localPort, int remotePort, TCPSocket::mode mode, unsigned int maxRetries, unsigned int retryTimeout)
 {
@@ -2,19 +2,31 @@
 #include <thread>  // Para std::this_thread::sleep_for
 
 #include "factory/FactorySocket.h"
+#include "observer/subscriber.h"
 #include "socket/Socket.h"
 #include "socket/TCP/TCPSocket.h"
+#ifdef __linux__
+#include "socket/Reactor.h"
+#endif
 
 static std::unique_ptr<Socket> socketComm;
 
-void chatRecibir() {
+// Prints what the socket delivers; called as messages arrive.
+class ChatPrinter : public Subscriber {
+ public:
+  void update(Serializable mensaje) override {
+    if (mensaje.size() > 0)
+      std::cout << "Recibido: " << mensaje << std::endl;
+  }
+};
 
+// read() blocks until data arrives, no sleep needed between calls.
+void chatRecibir() {
   Serializable mensaje;
   while (true) {
     mensaje = socketComm->read();
     if (mensaje.size() > 0)
       std::cout << "Recibido: " << mensaje << std::endl;
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));
   }
 }
 
@@ -115,9 +127,23 @@ int main() {
   }
   socketComm->open();
   socketComm->setLevelspdlog(spdlog::level::off);
+#ifdef __linux__
+  // The reactor hands arriving messages to the printer.
+  Reactor reactor;
+  auto printer = std::make_shared<ChatPrinter>();
+  socketComm->addSubscriber(printer);
+  if (!reactor.add(*socketComm)) {
+    socketComm->removeSubscriber(printer);
+    std::thread hilo1(chatRecibir);
+    hilo1.detach();
+  }
+  chatEscribir();
+  reactor.remove(*socketComm);
+#else
   std::thread hilo1(chatRecibir);
   hilo1.detach();
   chatEscribir();
+#endif
   socketComm->close();
   return 0;
 }
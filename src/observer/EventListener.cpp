@@ -2,18 +2,37 @@
 #include <algorithm>
 
 void EventListener::addSubscriber(std::shared_ptr<Subscriber> subscriber) {
+    std::lock_guard<std::mutex> lock(subscribersMutex);
     subscribers.push_back(subscriber);
 }
 
 void EventListener::removeSubscriber(std::shared_ptr<Subscriber> subscriber) {
+    std::lock_guard<std::mutex> lock(subscribersMutex);
     auto it = std::find(subscribers.begin(), subscribers.end(), subscriber);
     if (it != subscribers.end()) {
         subscribers.erase(it);
     }
 }
 
+std::vector<std::shared_ptr<Subscriber>> EventListener::snapshot() {
+    std::lock_guard<std::mutex> lock(subscribersMutex);
+    return subscribers;
+}
+
 void EventListener::notify(Serializable event) {
-    for (auto &subscriber : subscribers) {
+    for (auto &subscriber : snapshot()) {
         subscriber->update(event);
     }
 }
+
+void EventListener::notify(Serializable event, ConnectionId connection) {
+    for (auto &subscriber : snapshot()) {
+        subscriber->update(event, connection);
+    }
+}
+
+void EventListener::notifyConnectionEvent(ConnectionId connection, ConnectionEvent event) {
+    for (auto &subscriber : snapshot()) {
+        subscriber->onConnectionEvent(connection, event);
+    }
+}
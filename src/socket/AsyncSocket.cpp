@@ -0,0 +1,399 @@
+#include "socket/Async/AsyncSocket.h"
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "socket/TCP/LinuxTCP/LinuxTCPSocket.h"
+
+namespace {
+
+// Completes when LinuxTCPSocket::openAsync() reports, which may happen
+// before openAsync() even returns; whichever side comes second resumes.
+struct OpenAwaiter {
+  LinuxTCPSocket &socket;
+  std::coroutine_handle<> handle{};
+  std::atomic<bool> raced{false};
+  bool result = false;
+
+  bool await_ready() { return false; }
+  bool await_suspend(std::coroutine_handle<> awaiting) {
+    handle = awaiting;
+    socket.openAsync([this](bool connected) {
+      result = connected;
+      if (raced.exchange(true)) handle.resume();
+    });
+    return !raced.exchange(true);
+  }
+  bool await_resume() { return result; }
+};
+
+}  // namespace
+
+/**
+ * Everything the subscriber and the awaiters share. Held by shared_ptr, so
+ * a notification racing the AsyncSocket's destruction still finds it.
+ */
+struct AsyncSocket::State {
+  std::mutex mutex;
+  bool closed = false;
+
+  // Messages nobody waited for, per connection, plus their arrival order
+  // across connections for the any-connection reads. Entries of arrival
+  // whose message was taken by async_receive() go stale and are skipped.
+  uint64_t nextSequence = 0;
+  size_t queuedCount = 0;
+  std::unordered_map<ConnectionId, std::deque<std::pair<uint64_t, Serializable>>>
+      queued;
+  std::deque<std::pair<uint64_t, ConnectionId>> arrival;
+  std::unordered_set<ConnectionId> finished;  ///< Closed, not yet reported.
+
+  std::deque<ReadAwaiter *> anyReaders;
+  std::unordered_map<ConnectionId, std::deque<ReadAwaiter *>> connectionReaders;
+
+  std::deque<ConnectionId> accepted;
+  std::deque<AcceptAwaiter *> acceptors;
+
+  std::unordered_set<ConnectionId> paused;  ///< Above the high watermark.
+  std::vector<WriteAwaiter *> writers;
+
+  bool takeLocked(ReadAwaiter &reader) {
+    if (reader.anyConnection) {
+      while (!arrival.empty()) {
+        auto next = arrival.front();
+        arrival.pop_front();
+        auto it = queued.find(next.second);
+        if (it == queued.end() || it->second.front().first != next.first) {
+          continue;
+        }
+        if (reader.from != nullptr) *reader.from = next.second;
+        popLocked(it, reader.result);
+        return true;
+      }
+      return closed;
+    }
+    auto it = queued.find(reader.connection);
+    if (it != queued.end()) {
+      popLocked(it, reader.result);
+      return true;
+    }
+    return finished.erase(reader.connection) != 0 || closed;
+  }
+
+  void popLocked(decltype(queued)::iterator it, Serializable &result) {
+    result = std::move(it->second.front().second);
+    it->second.pop_front();
+    if (it->second.empty()) queued.erase(it);
+    --queuedCount;
+  }
+
+  bool blockedLocked(const WriteAwaiter &writer) {
+    if (closed || !writer.result) return false;
+    return writer.anyConnection ? !paused.empty()
+                                : paused.count(writer.connection) != 0;
+  }
+
+  std::vector<std::coroutine_handle<>> releaseWritersLocked() {
+    std::vector<std::coroutine_handle<>> ready;
+    for (auto it = writers.begin(); it != writers.end();) {
+      if (blockedLocked(**it)) {
+        ++it;
+      } else {
+        ready.push_back((*it)->handle);
+        it = writers.erase(it);
+      }
+    }
+    return ready;
+  }
+
+  void deliver(ConnectionId connection, Serializable data) {
+    std::coroutine_handle<> ready;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      ReadAwaiter *reader = nullptr;
+      auto waiting = connectionReaders.find(connection);
+      if (waiting != connectionReaders.end()) {
+        reader = waiting->second.front();
+        waiting->second.pop_front();
+        if (waiting->second.empty()) connectionReaders.erase(waiting);
+      } else if (!anyReaders.empty()) {
+        reader = anyReaders.front();
+        anyReaders.pop_front();
+        if (reader->from != nullptr) *reader->from = connection;
+      }
+      if (reader != nullptr) {
+        reader->result = std::move(data);
+        ready = reader->handle;
+      } else {
+        queued[connection].emplace_back(nextSequence, std::move(data));
+        arrival.emplace_back(nextSequence++, connection);
+        ++queuedCount;
+        if (arrival.size() > 2 * queuedCount + 64) compactLocked();
+      }
+    }
+    // Resumed outside the lock: the coroutine may read or write again.
+    if (ready) ready.resume();
+  }
+
+  void compactLocked() {
+    std::deque<std::pair<uint64_t, ConnectionId>> live;
+    for (auto &entry : arrival) {
+      auto it = queued.find(entry.second);
+      if (it != queued.end() && it->second.front().first <= entry.first) {
+        live.push_back(entry);
+      }
+    }
+    arrival.swap(live);
+  }
+
+  void connected(ConnectionId connection) {
+    std::coroutine_handle<> ready;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (acceptors.empty()) {
+        accepted.push_back(connection);
+      } else {
+        acceptors.front()->result = connection;
+        ready = acceptors.front()->handle;
+        acceptors.pop_front();
+      }
+    }
+    if (ready) ready.resume();
+  }
+
+  void disconnected(ConnectionId connection) {
+    std::vector<std::coroutine_handle<>> ready;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto waiting = connectionReaders.find(connection);
+      if (waiting != connectionReaders.end()) {
+        for (ReadAwaiter *reader : waiting->second) {
+          ready.push_back(reader->handle);
+        }
+        connectionReaders.erase(waiting);
+      } else {
+        finished.insert(connection);
+      }
+      paused.erase(connection);
+      auto writable = releaseWritersLocked();
+      ready.insert(ready.end(), writable.begin(), writable.end());
+    }
+    for (auto &handle : ready) handle.resume();
+  }
+
+  void backpressure(ConnectionId connection, bool pause) {
+    std::vector<std::coroutine_handle<>> ready;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (pause) {
+        paused.insert(connection);
+        return;
+      }
+      paused.erase(connection);
+      ready = releaseWritersLocked();
+    }
+    for (auto &handle : ready) handle.resume();
+  }
+
+  void shutdown() {
+    std::vector<std::coroutine_handle<>> ready;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      closed = true;
+      for (ReadAwaiter *reader : anyReaders) ready.push_back(reader->handle);
+      anyReaders.clear();
+      for (auto &waiting : connectionReaders) {
+        for (ReadAwaiter *reader : waiting.second) {
+          ready.push_back(reader->handle);
+        }
+      }
+      connectionReaders.clear();
+      for (AcceptAwaiter *acceptor : acceptors) {
+        ready.push_back(acceptor->handle);
+      }
+      acceptors.clear();
+      for (WriteAwaiter *writer : writers) ready.push_back(writer->handle);
+      writers.clear();
+    }
+    for (auto &handle : ready) handle.resume();
+  }
+};
+
+struct AsyncSocket::Listener : Subscriber {
+  explicit Listener(std::shared_ptr<State> state) : state(std::move(state)) {}
+
+  void update(Serializable data) override { state->deliver(0, std::move(data)); }
+  void update(Serializable data, ConnectionId connection) override {
+    state->deliver(connection, std::move(data));
+  }
+  void onConnectionEvent(ConnectionId connection,
+                         ConnectionEvent event) override {
+    if (event == ConnectionEvent::CONNECTED) {
+      state->connected(connection);
+    } else {
+      state->disconnected(connection);
+    }
+  }
+
+  std::shared_ptr<State> state;
+};
+
+AsyncSocket::ReadAwaiter::ReadAwaiter(std::shared_ptr<State> state,
+                                      bool anyConnection,
+                                      ConnectionId connection,
+                                      ConnectionId *from)
+    : state(std::move(state)),
+      anyConnection(anyConnection),
+      connection(connection),
+      from(from) {}
+
+bool AsyncSocket::ReadAwaiter::await_ready() {
+  std::lock_guard<std::mutex> lock(state->mutex);
+  return state->takeLocked(*this);
+}
+
+bool AsyncSocket::ReadAwaiter::await_suspend(
+    std::coroutine_handle<> awaiting) {
+  std::lock_guard<std::mutex> lock(state->mutex);
+  // Data may have arrived since await_ready().
+  if (state->takeLocked(*this)) return false;
+  handle = awaiting;
+  if (anyConnection) {
+    state->anyReaders.push_back(this);
+  } else {
+    state->connectionReaders[connection].push_back(this);
+  }
+  return true;
+}
+
+Serializable AsyncSocket::ReadAwaiter::await_resume() {
+  return std::move(result);
+}
+
+AsyncSocket::WriteAwaiter::WriteAwaiter(AsyncSocket &owner, bool anyConnection,
+                                        ConnectionId connection,
+                                        Serializable data)
+    : owner(owner),
+      anyConnection(anyConnection),
+      connection(connection),
+      data(std::move(data)) {}
+
+bool AsyncSocket::WriteAwaiter::await_ready() {
+  if (owner.tcp != nullptr && !anyConnection) {
+    result = owner.tcp->writeTo(connection, data);
+  } else {
+    owner.socket.write(data);
+    result = true;
+  }
+  std::lock_guard<std::mutex> lock(owner.state->mutex);
+  return !owner.state->blockedLocked(*this);
+}
+
+bool AsyncSocket::WriteAwaiter::await_suspend(
+    std::coroutine_handle<> awaiting) {
+  std::lock_guard<std::mutex> lock(owner.state->mutex);
+  if (!owner.state->blockedLocked(*this)) return false;
+  handle = awaiting;
+  owner.state->writers.push_back(this);
+  return true;
+}
+
+AsyncSocket::AcceptAwaiter::AcceptAwaiter(std::shared_ptr<State> state)
+    : state(std::move(state)) {}
+
+bool AsyncSocket::AcceptAwaiter::await_ready() {
+  std::lock_guard<std::mutex> lock(state->mutex);
+  if (!state->accepted.empty()) {
+    result = state->accepted.front();
+    state->accepted.pop_front();
+    return true;
+  }
+  return state->closed;
+}
+
+bool AsyncSocket::AcceptAwaiter::await_suspend(
+    std::coroutine_handle<> awaiting) {
+  std::lock_guard<std::mutex> lock(state->mutex);
+  if (!state->accepted.empty()) {
+    result = state->accepted.front();
+    state->accepted.pop_front();
+    return false;
+  }
+  if (state->closed) return false;
+  handle = awaiting;
+  state->acceptors.push_back(this);
+  return true;
+}
+
+AsyncSocket::AsyncSocket(Socket &socket, Reactor &reactor)
+    : socket(socket),
+      tcp(dynamic_cast<LinuxTCPSocket *>(&socket)),
+      reactor(reactor),
+      state(std::make_shared<State>()) {
+  listener = std::make_shared<Listener>(state);
+  socket.addSubscriber(listener);
+  // The listener queues for the coroutines; nobody calls read().
+  if (tcp != nullptr) tcp->setReadQueue(false);
+}
+
+AsyncSocket::~AsyncSocket() {
+  socket.removeSubscriber(listener);
+  if (tcp != nullptr) {
+    tcp->setBackpressureCallback(nullptr);
+    tcp->setReadQueue(true);
+  }
+  if (added) reactor.remove(socket);
+}
+
+Task<bool> AsyncSocket::async_open() {
+  if (tcp != nullptr) {
+    // The socket's own event loop moves onto the reactor's threads.
+    tcp->setReactor(&reactor);
+    std::shared_ptr<State> shared = state;
+    tcp->setBackpressureCallback([shared](ConnectionId connection, bool pause) {
+      shared->backpressure(connection, pause);
+    });
+    co_return co_await OpenAwaiter{*tcp};
+  }
+  socket.open();
+  added = reactor.add(socket);
+  co_return added;
+}
+
+AsyncSocket::ReadAwaiter AsyncSocket::async_read() {
+  return ReadAwaiter(state, true, 0, nullptr);
+}
+
+AsyncSocket::ReadAwaiter AsyncSocket::async_read(ConnectionId &from) {
+  return ReadAwaiter(state, true, 0, &from);
+}
+
+AsyncSocket::ReadAwaiter AsyncSocket::async_receive(ConnectionId connection) {
+  return ReadAwaiter(state, false, connection, nullptr);
+}
+
+AsyncSocket::WriteAwaiter AsyncSocket::async_write(Serializable data) {
+  return WriteAwaiter(*this, true, 0, std::move(data));
+}
+
+AsyncSocket::WriteAwaiter AsyncSocket::async_write(ConnectionId connection,
+                                                   Serializable data) {
+  return WriteAwaiter(*this, false, connection, std::move(data));
+}
+
+AsyncSocket::AcceptAwaiter AsyncSocket::async_accept() {
+  return AcceptAwaiter(state);
+}
+
+void AsyncSocket::close() {
+  state->shutdown();
+  if (added) {
+    reactor.remove(socket);
+    added = false;
+  }
+  socket.close();
+}
@@ -0,0 +1,164 @@
+#include "socket/AsyncWriter.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include "spdlog/spdlog.h"
+
+AsyncWriter::AsyncWriter(const AsyncWriteConfig &config, Sink sink)
+    : config(config),
+      sink(std::move(sink)),
+      queue(std::max<size_t>(config.queueCapacity, 2)) {
+  this->config.maxBatch = std::max<size_t>(config.maxBatch, 1);
+  thread = std::thread(&AsyncWriter::run, this);
+}
+
+AsyncWriter::~AsyncWriter() { stop(config.drainOnClose); }
+
+bool AsyncWriter::enqueue(std::vector<uint8_t> message) {
+  while (stopping || !queue.tryPush(std::move(message))) {
+    if (stopping || config.whenFull == QueueFullPolicy::DROP_NEWEST) {
+      ++dropped;
+      return false;
+    }
+    if (config.whenFull == QueueFullPolicy::THROW) {
+      throw std::runtime_error("Write queue full; AsyncWriter::enqueue()");
+    }
+    ++blocked;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      // Bounded, so a wake that slips between the failed push and the wait
+      // costs a millisecond at most.
+      spaceCv.wait_for(lock, std::chrono::milliseconds(1));
+    }
+    --blocked;
+  }
+  ++enqueued;
+  // Pairs with the fence in waitForMessages(): either the writer sees the
+  // message or this thread sees it asleep.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (sleeping) {
+    { std::lock_guard<std::mutex> lock(mutex); }
+    wakeCv.notify_one();
+  }
+  return true;
+}
+
+bool AsyncWriter::waitForMessages(std::chrono::steady_clock::time_point until) {
+  sleeping = true;
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  bool ready;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto wakeable = [this]() { return !queue.empty() || stopping; };
+    if (until == std::chrono::steady_clock::time_point::max()) {
+      wakeCv.wait(lock, wakeable);
+      ready = true;
+    } else {
+      ready = wakeCv.wait_until(lock, until, wakeable);
+    }
+  }
+  sleeping = false;
+  return ready;
+}
+
+void AsyncWriter::run() {
+  std::vector<std::vector<uint8_t>> batch;
+  batch.reserve(config.maxBatch);
+  while (true) {
+    std::vector<uint8_t> message;
+    while (batch.size() < config.maxBatch && queue.tryPop(message)) {
+      batch.push_back(std::move(message));
+    }
+    if (batch.empty()) {
+      if (stopping) break;
+      waitForMessages(std::chrono::steady_clock::time_point::max());
+      continue;
+    }
+    if (batch.size() < config.maxBatch && config.linger.count() > 0 &&
+        !stopping) {
+      auto until = std::chrono::steady_clock::now() + config.linger;
+      while (batch.size() < config.maxBatch && !stopping &&
+             waitForMessages(until)) {
+        while (batch.size() < config.maxBatch && queue.tryPop(message)) {
+          batch.push_back(std::move(message));
+        }
+      }
+    }
+    if (blocked > 0) spaceCv.notify_all();
+
+    bool drop;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      drop = stopping && !drainOnStop;
+    }
+    size_t count = batch.size();
+    if (drop) {
+      dropped += count;
+    } else {
+      bool ok = false;
+      try {
+        ok = sink(batch);
+      } catch (const std::exception &e) {
+        spdlog::error("Error sending queued messages: {0}; AsyncWriter::run()",
+                      e.what());
+      }
+      (ok ? sent : failed) += count;
+      ++batches;
+    }
+    batch.clear();
+    handled += count;
+    if (draining > 0) {
+      { std::lock_guard<std::mutex> lock(mutex); }
+      doneCv.notify_all();
+    }
+  }
+}
+
+bool AsyncWriter::drain(std::chrono::steady_clock::duration timeout) {
+  uint64_t target = enqueued;
+  ++draining;
+  bool done;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto finished = [&]() { return handled >= target; };
+    if (timeout == std::chrono::steady_clock::duration::max()) {
+      doneCv.wait(lock, finished);
+      done = true;
+    } else {
+      done = doneCv.wait_for(lock, timeout, finished);
+    }
+  }
+  --draining;
+  return done;
+}
+
+void AsyncWriter::stop(bool drain) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    drainOnStop = drain;
+    stopping = true;
+  }
+  wakeCv.notify_all();
+  spaceCv.notify_all();
+  if (thread.joinable()) thread.join();
+  // Pushes that raced with the stop.
+  std::vector<uint8_t> message;
+  while (queue.tryPop(message)) {
+    ++dropped;
+    ++handled;
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  doneCv.notify_all();
+}
+
+AsyncWriteStats AsyncWriter::stats() const {
+  AsyncWriteStats result;
+  result.enqueued = enqueued;
+  result.sent = sent;
+  result.failed = failed;
+  result.dropped = dropped;
+  result.batches = batches;
+  return result;
+}
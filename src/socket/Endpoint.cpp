@@ -0,0 +1,168 @@
+#include "socket/Endpoint.h"
+
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netdb.h>
+#endif
+
+namespace {
+
+struct CacheEntry {
+  std::vector<Endpoint> addresses;
+  std::chrono::steady_clock::time_point expires;
+};
+
+std::mutex cacheMutex;
+std::unordered_map<std::string, CacheEntry> cache;
+std::chrono::seconds cacheTtl(60);
+
+bool lookup(const std::string &host, int port, int socketType, int flags,
+            std::vector<Endpoint> &addresses) {
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = socketType;
+  hints.ai_flags = flags;
+  addrinfo *result = nullptr;
+  std::string service = std::to_string(port);
+  if (getaddrinfo(host.c_str(), service.c_str(), &hints, &result) != 0) {
+    return false;
+  }
+  for (addrinfo *entry = result; entry != nullptr; entry = entry->ai_next) {
+    addresses.emplace_back(entry->ai_addr,
+                           static_cast<socklen_t>(entry->ai_addrlen));
+  }
+  freeaddrinfo(result);
+  return !addresses.empty();
+}
+
+bool isV4Mapped(const sockaddr_in6 &address) {
+  static const uint8_t prefix[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+  return std::memcmp(&address.sin6_addr, prefix, sizeof(prefix)) == 0;
+}
+
+}  // namespace
+
+Endpoint::Endpoint(const sockaddr *address, socklen_t length) {
+  if (address == nullptr || length <= 0 ||
+      static_cast<size_t>(length) > sizeof(storage)) {
+    return;
+  }
+  std::memcpy(&storage, address, length);
+  addressLength = length;
+}
+
+std::vector<Endpoint> Endpoint::resolve(const std::string &host, int port,
+                                        int socketType) {
+  std::vector<Endpoint> addresses;
+  if (host.empty()) return addresses;
+  // Literals need neither DNS nor the cache.
+  if (lookup(host, port, socketType, AI_NUMERICHOST, addresses)) {
+    return addresses;
+  }
+
+  std::string key =
+      host + "|" + std::to_string(port) + "|" + std::to_string(socketType);
+  auto now = std::chrono::steady_clock::now();
+  {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto it = cache.find(key);
+    if (it != cache.end() && it->second.expires > now) {
+      return it->second.addresses;
+    }
+  }
+  // AI_ADDRCONFIG leaves out families the host has no address of.
+  if (!lookup(host, port, socketType, AI_ADDRCONFIG, addresses)) {
+    return addresses;
+  }
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  CacheEntry &entry = cache[key];
+  entry.addresses = addresses;
+  entry.expires = now + cacheTtl;
+  return addresses;
+}
+
+Endpoint Endpoint::wildcard(int family, int port) {
+  Endpoint endpoint;
+  if (family == AF_INET6) {
+    sockaddr_in6 &address = reinterpret_cast<sockaddr_in6 &>(endpoint.storage);
+    address.sin6_family = AF_INET6;
+    address.sin6_addr = in6addr_any;
+    address.sin6_port = htons(static_cast<uint16_t>(port));
+    endpoint.addressLength = sizeof(sockaddr_in6);
+  } else {
+    sockaddr_in &address = reinterpret_cast<sockaddr_in &>(endpoint.storage);
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    endpoint.addressLength = sizeof(sockaddr_in);
+  }
+  return endpoint;
+}
+
+void Endpoint::setCacheTtl(std::chrono::seconds ttl) {
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  cacheTtl = ttl;
+}
+
+void Endpoint::clearCache() {
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  cache.clear();
+}
+
+int Endpoint::port() const {
+  if (family() == AF_INET6) {
+    return ntohs(reinterpret_cast<const sockaddr_in6 &>(storage).sin6_port);
+  }
+  if (family() == AF_INET) {
+    return ntohs(reinterpret_cast<const sockaddr_in &>(storage).sin_port);
+  }
+  return 0;
+}
+
+Endpoint Endpoint::toV6Mapped() const {
+  if (family() != AF_INET) return *this;
+  const sockaddr_in &v4 = reinterpret_cast<const sockaddr_in &>(storage);
+  Endpoint mapped;
+  sockaddr_in6 &v6 = reinterpret_cast<sockaddr_in6 &>(mapped.storage);
+  v6.sin6_family = AF_INET6;
+  v6.sin6_port = v4.sin_port;
+  uint8_t *bytes = reinterpret_cast<uint8_t *>(&v6.sin6_addr);
+  bytes[10] = 0xff;
+  bytes[11] = 0xff;
+  std::memcpy(bytes + 12, &v4.sin_addr, 4);
+  mapped.addressLength = sizeof(sockaddr_in6);
+  return mapped;
+}
+
+std::string Endpoint::host() const {
+  char text[INET6_ADDRSTRLEN] = {};
+  if (family() == AF_INET6) {
+    const sockaddr_in6 &v6 = reinterpret_cast<const sockaddr_in6 &>(storage);
+    if (isV4Mapped(v6)) {
+      inet_ntop(AF_INET, reinterpret_cast<const uint8_t *>(&v6.sin6_addr) + 12,
+                text, sizeof(text));
+    } else {
+      inet_ntop(AF_INET6, &v6.sin6_addr, text, sizeof(text));
+    }
+  } else if (family() == AF_INET) {
+    inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in &>(storage).sin_addr,
+              text, sizeof(text));
+  }
+  return text;
+}
+
+std::string Endpoint::toString() const {
+  std::string name = host();
+  bool bracketed = family() == AF_INET6 &&
+                   !isV4Mapped(reinterpret_cast<const sockaddr_in6 &>(storage));
+  if (bracketed) name = "[" + name + "]";
+  return name + ":" + std::to_string(port());
+}
+
+std::string Endpoint::key() const {
+  return std::string(reinterpret_cast<const char *>(&storage), addressLength);
+}
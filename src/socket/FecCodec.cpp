@@ -0,0 +1,546 @@
+#include "socket/UDP/FecCodec.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "spdlog/spdlog.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define FEC_X86_DISPATCH 1
+#endif
+
+namespace {
+
+// Datagram layout (big endian):
+//   [0] magic, [1] scheme << 4 | flags, [2..5] block id,
+//   [6] shard index, [7] K, [8] M, then the payload for data shards or
+//   a 2-byte protected length followed by the parity bytes.
+// Parity of a block closed early by flush() has the short flag set and
+// carries the number of data shards the block really holds as K; its data
+// datagrams went out with the configured K.
+const uint8_t kMagic = 0xFE;
+const uint8_t kParityFlag = 1;
+const uint8_t kShortFlag = 2;
+const size_t kHeaderSize = 9;
+const size_t kLengthPrefix = 2;
+
+// GF(2^8) with the 0x11D polynomial, the usual field for Reed-Solomon.
+struct GaloisField {
+  uint8_t exp[512];
+  uint8_t log[256];
+  uint8_t mul[256][256];
+
+  GaloisField() {
+    unsigned x = 1;
+    for (unsigned i = 0; i < 255; ++i) {
+      exp[i] = static_cast<uint8_t>(x);
+      log[x] = static_cast<uint8_t>(i);
+      x <<= 1;
+      if (x & 0x100) x ^= 0x11D;
+    }
+    for (unsigned i = 255; i < 512; ++i) exp[i] = exp[i - 255];
+    log[0] = 0;
+    for (unsigned a = 0; a < 256; ++a) {
+      for (unsigned b = 0; b < 256; ++b) {
+        mul[a][b] = (a == 0 || b == 0) ? 0 : exp[log[a] + log[b]];
+      }
+    }
+  }
+
+  uint8_t inv(uint8_t a) const { return exp[255 - log[a]]; }
+};
+
+const GaloisField &gf() {
+  static const GaloisField field;
+  return field;
+}
+
+void xorRegion(uint8_t *dst, const uint8_t *src, size_t n) {
+  for (size_t i = 0; i < n; ++i) dst[i] ^= src[i];
+}
+
+void mulAddScalar(uint8_t *dst, const uint8_t *src, uint8_t c, size_t n) {
+  const uint8_t *row = gf().mul[c];
+  for (size_t i = 0; i < n; ++i) dst[i] ^= row[src[i]];
+}
+
+#ifdef FEC_X86_DISPATCH
+// Split-nibble table lookup: c * x = T_lo[x & 0x0f] ^ T_hi[x >> 4].
+__attribute__((target("ssse3"))) void mulAddSsse3(uint8_t *dst,
+                                                  const uint8_t *src,
+                                                  uint8_t c, size_t n) {
+  alignas(16) uint8_t lo[16];
+  alignas(16) uint8_t hi[16];
+  for (unsigned i = 0; i < 16; ++i) {
+    lo[i] = gf().mul[c][i];
+    hi[i] = gf().mul[c][i << 4];
+  }
+  const __m128i tableLo = _mm_load_si128(reinterpret_cast<const __m128i *>(lo));
+  const __m128i tableHi = _mm_load_si128(reinterpret_cast<const __m128i *>(hi));
+  const __m128i mask = _mm_set1_epi8(0x0f);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+    __m128i l = _mm_and_si128(x, mask);
+    __m128i h = _mm_and_si128(_mm_srli_epi64(x, 4), mask);
+    __m128i p = _mm_xor_si128(_mm_shuffle_epi8(tableLo, l),
+                              _mm_shuffle_epi8(tableHi, h));
+    __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_xor_si128(d, p));
+  }
+  mulAddScalar(dst + i, src + i, c, n - i);
+}
+
+__attribute__((target("avx2"))) void mulAddAvx2(uint8_t *dst,
+                                                const uint8_t *src, uint8_t c,
+                                                size_t n) {
+  alignas(16) uint8_t lo[16];
+  alignas(16) uint8_t hi[16];
+  for (unsigned i = 0; i < 16; ++i) {
+    lo[i] = gf().mul[c][i];
+    hi[i] = gf().mul[c][i << 4];
+  }
+  const __m256i tableLo = _mm256_broadcastsi128_si256(
+      _mm_load_si128(reinterpret_cast<const __m128i *>(lo)));
+  const __m256i tableHi = _mm256_broadcastsi128_si256(
+      _mm_load_si128(reinterpret_cast<const __m128i *>(hi)));
+  const __m256i mask = _mm256_set1_epi8(0x0f);
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+    __m256i l = _mm256_and_si256(x, mask);
+    __m256i h = _mm256_and_si256(_mm256_srli_epi64(x, 4), mask);
+    __m256i p = _mm256_xor_si256(_mm256_shuffle_epi8(tableLo, l),
+                                 _mm256_shuffle_epi8(tableHi, h));
+    __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i),
+                        _mm256_xor_si256(d, p));
+  }
+  mulAddScalar(dst + i, src + i, c, n - i);
+}
+#endif
+
+using MulAddFn = void (*)(uint8_t *, const uint8_t *, uint8_t, size_t);
+
+MulAddFn selectMulAdd() {
+#ifdef FEC_X86_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return mulAddAvx2;
+  if (__builtin_cpu_supports("ssse3")) return mulAddSsse3;
+#endif
+  return mulAddScalar;
+}
+
+// dst ^= c * src over GF(256), using the widest SIMD unit available.
+void mulAdd(uint8_t *dst, const uint8_t *src, uint8_t c, size_t n) {
+  static const MulAddFn fn = selectMulAdd();
+  if (c == 0) return;
+  if (c == 1) {
+    xorRegion(dst, src, n);
+    return;
+  }
+  fn(dst, src, c, n);
+}
+
+// Cauchy matrix coefficient for parity row p and data column j. Every square
+// submatrix of a Cauchy matrix is invertible, so any K of the K + M shards
+// rebuild the block.
+uint8_t cauchy(unsigned p, unsigned j, unsigned parityShards) {
+  return gf().inv(static_cast<uint8_t>(p ^ (parityShards + j)));
+}
+
+// Inverts a square matrix over GF(256) in place. Returns false if singular.
+bool invert(std::vector<std::vector<uint8_t>> &m) {
+  const size_t n = m.size();
+  std::vector<std::vector<uint8_t>> inv(n, std::vector<uint8_t>(n, 0));
+  for (size_t i = 0; i < n; ++i) inv[i][i] = 1;
+
+  for (size_t col = 0; col < n; ++col) {
+    size_t pivot = col;
+    while (pivot < n && m[pivot][col] == 0) ++pivot;
+    if (pivot == n) return false;
+    std::swap(m[pivot], m[col]);
+    std::swap(inv[pivot], inv[col]);
+
+    uint8_t scale = gf().inv(m[col][col]);
+    for (size_t k = 0; k < n; ++k) {
+      m[col][k] = gf().mul[scale][m[col][k]];
+      inv[col][k] = gf().mul[scale][inv[col][k]];
+    }
+    for (size_t row = 0; row < n; ++row) {
+      uint8_t factor = m[row][col];
+      if (row == col || factor == 0) continue;
+      mulAdd(m[row].data(), m[col].data(), factor, n);
+      mulAdd(inv[row].data(), inv[col].data(), factor, n);
+    }
+  }
+  m.swap(inv);
+  return true;
+}
+
+// A data shard as protected by parity: 2-byte length, payload, zero padding.
+std::vector<uint8_t> padShard(const std::vector<uint8_t> &payload,
+                              size_t length) {
+  std::vector<uint8_t> shard(length, 0);
+  shard[0] = static_cast<uint8_t>(payload.size() >> 8);
+  shard[1] = static_cast<uint8_t>(payload.size());
+  std::copy(payload.begin(), payload.end(), shard.begin() + kLengthPrefix);
+  return shard;
+}
+
+std::vector<uint8_t> unpadShard(const std::vector<uint8_t> &shard) {
+  size_t length = (static_cast<size_t>(shard[0]) << 8) | shard[1];
+  if (length + kLengthPrefix > shard.size()) return {};
+  return std::vector<uint8_t>(shard.begin() + kLengthPrefix,
+                              shard.begin() + kLengthPrefix + length);
+}
+
+void writeHeader(std::vector<uint8_t> &out, FecScheme scheme, uint8_t flags,
+                 uint32_t blockId, unsigned index, unsigned k, unsigned m) {
+  out.push_back(kMagic);
+  out.push_back(
+      static_cast<uint8_t>((static_cast<unsigned>(scheme) << 4) | flags));
+  out.push_back(static_cast<uint8_t>(blockId >> 24));
+  out.push_back(static_cast<uint8_t>(blockId >> 16));
+  out.push_back(static_cast<uint8_t>(blockId >> 8));
+  out.push_back(static_cast<uint8_t>(blockId));
+  out.push_back(static_cast<uint8_t>(index));
+  out.push_back(static_cast<uint8_t>(k));
+  out.push_back(static_cast<uint8_t>(m));
+}
+
+FecConfig validate(FecConfig config) {
+  if (config.scheme == FecScheme::XOR) config.parityShards = 1;
+  if (config.dataShards == 0 || config.parityShards == 0 ||
+      config.dataShards + config.parityShards > 255) {
+    throw std::runtime_error(
+        "Invalid FEC block size, need 1 <= K, 1 <= M and K + M <= 255; "
+        "FecConfig");
+  }
+  if (config.maxPendingBlocks == 0) config.maxPendingBlocks = 1;
+  if (config.maxPeers == 0) config.maxPeers = 1;
+  return config;
+}
+
+}  // namespace
+
+FecEncoder::FecEncoder(const FecConfig &config) : config(validate(config)) {
+  block.reserve(this->config.dataShards);
+}
+
+std::vector<std::vector<uint8_t>> FecEncoder::encode(
+    const std::vector<uint8_t> &payload) {
+  if (payload.size() > 0xFFFF) {
+    throw std::runtime_error("Payload too large for FEC; FecEncoder::encode()");
+  }
+  std::vector<std::vector<uint8_t>> out;
+  const unsigned k = config.dataShards;
+  const unsigned m = config.parityShards;
+
+  std::vector<uint8_t> data;
+  data.reserve(kHeaderSize + payload.size());
+  writeHeader(data, config.scheme, 0, blockId,
+              static_cast<unsigned>(block.size()), k, m);
+  data.insert(data.end(), payload.begin(), payload.end());
+  out.push_back(std::move(data));
+  ++counters.dataSent;
+
+  if (block.empty()) opened = std::chrono::steady_clock::now();
+  block.push_back(payload);
+  if (block.size() == k) closeBlock(out);
+  return out;
+}
+
+std::vector<std::vector<uint8_t>> FecEncoder::flush() {
+  std::vector<std::vector<uint8_t>> out;
+  if (!block.empty()) closeBlock(out);
+  return out;
+}
+
+size_t FecEncoder::overhead() {
+  // Header, parity length, and the length every shard is padded with.
+  return kHeaderSize + kLengthPrefix + kLengthPrefix;
+}
+
+std::chrono::steady_clock::time_point FecEncoder::deadline() const {
+  if (block.empty() || config.parityDeadline.count() <= 0) {
+    return std::chrono::steady_clock::time_point::max();
+  }
+  return opened + config.parityDeadline;
+}
+
+void FecEncoder::closeBlock(std::vector<std::vector<uint8_t>> &out) {
+  const unsigned k = static_cast<unsigned>(block.size());
+  const unsigned m = config.parityShards;
+  const uint8_t flags =
+      kParityFlag | (k < config.dataShards ? kShortFlag : 0);
+
+  size_t length = 0;
+  for (auto &shard : block) {
+    length = std::max(length, shard.size() + kLengthPrefix);
+  }
+  std::vector<std::vector<uint8_t>> shards;
+  shards.reserve(k);
+  for (auto &shard : block) shards.push_back(padShard(shard, length));
+
+  for (unsigned p = 0; p < m; ++p) {
+    std::vector<uint8_t> parity;
+    parity.reserve(kHeaderSize + kLengthPrefix + length);
+    writeHeader(parity, config.scheme, flags, blockId, k + p, k, m);
+    parity.push_back(static_cast<uint8_t>(length >> 8));
+    parity.push_back(static_cast<uint8_t>(length));
+    parity.resize(kHeaderSize + kLengthPrefix + length, 0);
+    uint8_t *dst = parity.data() + kHeaderSize + kLengthPrefix;
+    for (unsigned j = 0; j < k; ++j) {
+      if (config.scheme == FecScheme::XOR) {
+        xorRegion(dst, shards[j].data(), length);
+      } else {
+        mulAdd(dst, shards[j].data(), cauchy(p, j, m), length);
+      }
+    }
+    out.push_back(std::move(parity));
+    ++counters.paritySent;
+  }
+
+  block.clear();
+  ++blockId;
+}
+
+FecDecoder::FecDecoder(const FecConfig &config) : config(validate(config)) {}
+
+std::vector<std::vector<uint8_t>> FecDecoder::decode(
+    const std::vector<uint8_t> &datagram) {
+  return decode(std::string(), datagram, std::chrono::steady_clock::now());
+}
+
+std::vector<std::vector<uint8_t>> FecDecoder::decode(
+    const std::string &peerKey, const std::vector<uint8_t> &datagram,
+    std::chrono::steady_clock::time_point now) {
+  std::vector<std::vector<uint8_t>> output;
+  if (datagram.size() < kHeaderSize || datagram[0] != kMagic) {
+    output.push_back(datagram);
+    return output;
+  }
+
+  FecScheme scheme = static_cast<FecScheme>(datagram[1] >> 4);
+  bool parity = (datagram[1] & kParityFlag) != 0;
+  bool shortBlock = (datagram[1] & kShortFlag) != 0;
+  uint32_t id = (static_cast<uint32_t>(datagram[2]) << 24) |
+                (static_cast<uint32_t>(datagram[3]) << 16) |
+                (static_cast<uint32_t>(datagram[4]) << 8) | datagram[5];
+  unsigned index = datagram[6];
+  unsigned k = datagram[7];
+  unsigned m = datagram[8];
+
+  if (k == 0 || m == 0 || k + m > 255 || index >= k + m ||
+      parity != (index >= k) || (shortBlock && !parity) ||
+      (scheme != FecScheme::XOR && scheme != FecScheme::REED_SOLOMON) ||
+      (parity && datagram.size() < kHeaderSize + kLengthPrefix)) {
+    spdlog::warn("Malformed FEC datagram dropped; FecDecoder::decode()");
+    return output;
+  }
+
+  auto known = peers.find(peerKey);
+  if (known == peers.end()) {
+    if (peers.size() >= config.maxPeers) forgetOldest();
+    Peer fresh;
+    fresh.newest = id;
+    known = peers.emplace(peerKey, std::move(fresh)).first;
+  } else if (now - known->second.lastSeen >= config.peerIdleTimeout) {
+    reset(known->second);
+    known->second.newest = id;
+  }
+  Peer &peer = known->second;
+  peer.lastSeen = now;
+
+  auto it = peer.blocks.find(id);
+  int32_t distance = static_cast<int32_t>(id - peer.newest);
+  if (distance > 0) {
+    peer.newest = id;
+  } else if (it == peer.blocks.end() &&
+             -static_cast<int64_t>(distance) >
+                 static_cast<int64_t>(config.maxPendingBlocks)) {
+    // Stragglers trail within the window; anything further back is a
+    // sender that started over.
+    reset(peer);
+    peer.newest = id;
+  }
+
+  if (it == peer.blocks.end()) {
+    Block fresh;
+    fresh.scheme = scheme;
+    fresh.dataShards = k;
+    fresh.parityShards = m;
+    fresh.shards.resize(k + m);
+    fresh.present.assign(k + m, false);
+    fresh.shortened = shortBlock;
+    it = peer.blocks.emplace(id, std::move(fresh)).first;
+    peer.order.push_back(id);
+    while (peer.order.size() > config.maxPendingBlocks) {
+      evict(peer, peer.order.front());
+      peer.order.pop_front();
+    }
+    it = peer.blocks.find(id);
+    if (it == peer.blocks.end()) return output;
+  }
+
+  Block &block = it->second;
+  // Data datagrams of a short block still carry the configured K.
+  bool fits = block.dataShards == k ||
+              (shortBlock && !block.shortened && k < block.dataShards &&
+               shorten(block, k)) ||
+              (!parity && block.shortened && k > block.dataShards &&
+               index < block.dataShards);
+  if (!fits || block.parityShards != m || block.scheme != scheme) {
+    spdlog::warn("FEC block {0} changed geometry; FecDecoder::decode()", id);
+    return output;
+  }
+  if (block.complete || block.present[index]) return output;
+
+  if (parity) {
+    size_t length = (static_cast<size_t>(datagram[kHeaderSize]) << 8) |
+                    datagram[kHeaderSize + 1];
+    if (datagram.size() != kHeaderSize + kLengthPrefix + length ||
+        (block.shardLength != 0 && block.shardLength != length)) {
+      spdlog::warn("FEC parity length mismatch; FecDecoder::decode()");
+      return output;
+    }
+    block.shardLength = length;
+    block.shards[index].assign(datagram.begin() + kHeaderSize + kLengthPrefix,
+                               datagram.end());
+    ++counters.parityReceived;
+  } else {
+    block.shards[index].assign(datagram.begin() + kHeaderSize, datagram.end());
+    output.push_back(block.shards[index]);
+    ++counters.dataReceived;
+  }
+  block.present[index] = true;
+  ++block.received;
+
+  recover(block, output);
+  return output;
+}
+
+bool FecDecoder::shorten(Block &block, unsigned dataShards) {
+  for (unsigned j = dataShards; j < block.dataShards; ++j) {
+    if (block.present[j]) return false;
+  }
+  block.shards.erase(block.shards.begin() + dataShards,
+                     block.shards.begin() + block.dataShards);
+  block.present.erase(block.present.begin() + dataShards,
+                      block.present.begin() + block.dataShards);
+  block.dataShards = dataShards;
+  block.shortened = true;
+  return true;
+}
+
+void FecDecoder::recover(Block &block,
+                         std::vector<std::vector<uint8_t>> &output) {
+  const unsigned k = block.dataShards;
+  std::vector<unsigned> missing;
+  for (unsigned j = 0; j < k; ++j) {
+    if (!block.present[j]) missing.push_back(j);
+  }
+  if (missing.empty()) {
+    block.complete = true;
+    block.shards.clear();
+    return;
+  }
+  if (block.received < k || block.shardLength == 0) return;
+
+  const size_t length = block.shardLength;
+  std::vector<std::vector<uint8_t>> rebuilt(missing.size(),
+                                            std::vector<uint8_t>(length, 0));
+
+  if (block.scheme == FecScheme::XOR) {
+    // received >= k with one parity row means exactly one data shard is
+    // missing.
+    std::vector<uint8_t> &shard = rebuilt[0];
+    xorRegion(shard.data(), block.shards[k].data(), length);
+    for (unsigned j = 0; j < k; ++j) {
+      if (j == missing[0]) continue;
+      if (block.shards[j].size() + kLengthPrefix > length) return;
+      std::vector<uint8_t> padded = padShard(block.shards[j], length);
+      xorRegion(shard.data(), padded.data(), length);
+    }
+  } else {
+    // Pick K available rows of the systematic generator [I; C], invert the
+    // K x K submatrix and apply the rows that yield the missing shards.
+    std::vector<unsigned> rows;
+    for (unsigned r = 0; r < k + block.parityShards && rows.size() < k; ++r) {
+      if (block.present[r]) rows.push_back(r);
+    }
+    std::vector<std::vector<uint8_t>> matrix(k, std::vector<uint8_t>(k, 0));
+    std::vector<std::vector<uint8_t>> inputs(k);
+    for (unsigned i = 0; i < k; ++i) {
+      unsigned r = rows[i];
+      if (r < k) {
+        matrix[i][r] = 1;
+        if (block.shards[r].size() + kLengthPrefix > length) return;
+        inputs[i] = padShard(block.shards[r], length);
+      } else {
+        for (unsigned j = 0; j < k; ++j) {
+          matrix[i][j] = cauchy(r - k, j, block.parityShards);
+        }
+        inputs[i] = block.shards[r];
+      }
+    }
+    if (!invert(matrix)) {
+      spdlog::error("Singular FEC decode matrix; FecDecoder::recover()");
+      return;
+    }
+    for (size_t n = 0; n < missing.size(); ++n) {
+      for (unsigned i = 0; i < k; ++i) {
+        mulAdd(rebuilt[n].data(), inputs[i].data(), matrix[missing[n]][i],
+               length);
+      }
+    }
+  }
+
+  for (size_t n = 0; n < missing.size(); ++n) {
+    output.push_back(unpadShard(rebuilt[n]));
+    ++counters.recovered;
+  }
+  block.complete = true;
+  block.shards.clear();
+}
+
+void FecDecoder::expire(std::chrono::steady_clock::time_point now) {
+  for (auto it = peers.begin(); it != peers.end();) {
+    if (now - it->second.lastSeen >= config.peerIdleTimeout) {
+      reset(it->second);
+      it = peers.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void FecDecoder::reset(Peer &peer) {
+  for (uint32_t id : peer.order) evict(peer, id);
+  peer.order.clear();
+}
+
+void FecDecoder::forgetOldest() {
+  auto oldest = peers.begin();
+  for (auto it = peers.begin(); it != peers.end(); ++it) {
+    if (it->second.lastSeen < oldest->second.lastSeen) oldest = it;
+  }
+  reset(oldest->second);
+  peers.erase(oldest);
+}
+
+void FecDecoder::evict(Peer &peer, uint32_t id) {
+  auto it = peer.blocks.find(id);
+  if (it == peer.blocks.end()) return;
+  const Block &block = it->second;
+  if (!block.complete) {
+    unsigned have = 0;
+    for (unsigned j = 0; j < block.dataShards; ++j) {
+      if (block.present[j]) ++have;
+    }
+    counters.unrecoverable += block.dataShards - have;
+  }
+  peer.blocks.erase(it);
+}
@@ -0,0 +1,332 @@
+#include "socket/IoUring.h"
+
+#ifdef SOCKET_LIB_HAS_IO_URING
+
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+int ioUringSetup(unsigned entries, io_uring_params *params) {
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int ioUringRegister(int fd, unsigned opcode, const void *arg,
+                    unsigned count) {
+  return static_cast<int>(
+      syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+bool opsSupported(int ringFd) {
+  const unsigned kOps = 64;
+  std::vector<uint8_t> storage(sizeof(io_uring_probe) +
+                               kOps * sizeof(io_uring_probe_op));
+  auto *probe = reinterpret_cast<io_uring_probe *>(storage.data());
+  if (ioUringRegister(ringFd, IORING_REGISTER_PROBE, probe, kOps) < 0) {
+    return false;
+  }
+  for (int op : {IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_RECVMSG,
+                 IORING_OP_SENDMSG, IORING_OP_POLL_ADD,
+                 IORING_OP_ASYNC_CANCEL}) {
+    if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+      return false;
+  }
+  return true;
+}
+
+// Feature flags and opcodes do not say whether multishot receive works, so
+// the probe runs one over a socket pair.
+bool probe() {
+  try {
+    IoUring ring(8, 1, 8, 256);
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) != 0) {
+      return false;
+    }
+    bool works = false;
+    if (ring.setFile(0, pair[0])) {
+      ring.recvMultishot(0, 1);
+      const char byte = 'x';
+      if (ring.submitAndWait(std::chrono::nanoseconds(0)) &&
+          ::write(pair[1], &byte, 1) == 1 &&
+          ring.submitAndWait(std::chrono::milliseconds(500))) {
+        ring.completions([&](const io_uring_cqe &cqe) {
+          works = cqe.res == 1 && (cqe.flags & IORING_CQE_F_MORE) &&
+                  IoUring::bufferId(cqe) >= 0;
+        });
+      }
+    }
+    ::close(pair[0]);
+    ::close(pair[1]);
+    return works;
+  } catch (const std::exception &) {
+    return false;
+  }
+}
+
+}  // namespace
+
+bool IoUring::supported() {
+  static const bool available = probe();
+  return available;
+}
+
+IoUring::IoUring(unsigned entries, unsigned files, unsigned buffers,
+                 unsigned bufferSize)
+    : bufferCount(buffers), bufferSize(bufferSize) {
+  io_uring_params params{};
+  ringFd = ioUringSetup(entries, &params);
+  if (ringFd < 0) {
+    throw std::runtime_error(std::string("io_uring_setup failed: ") +
+                             strerror(errno) + "; IoUring::IoUring()");
+  }
+  if (!(params.features & IORING_FEAT_EXT_ARG) || !opsSupported(ringFd)) {
+    ::close(ringFd);
+    throw std::runtime_error("io_uring lacks required features; IoUring::IoUring()");
+  }
+
+  sqEntries = params.sq_entries;
+  sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+  sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+  cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+  void *sqeMemory = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+  if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqeMemory == MAP_FAILED) {
+    if (sqRing == MAP_FAILED) sqRing = nullptr;
+    if (cqRing == MAP_FAILED) cqRing = nullptr;
+    sqes = sqeMemory == MAP_FAILED ? nullptr : static_cast<io_uring_sqe *>(sqeMemory);
+    release();
+    throw std::runtime_error("Mapping io_uring failed; IoUring::IoUring()");
+  }
+  sqes = static_cast<io_uring_sqe *>(sqeMemory);
+
+  auto *sq = static_cast<uint8_t *>(sqRing);
+  auto *cq = static_cast<uint8_t *>(cqRing);
+  sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+  sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  sqMask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  cqMask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+  for (unsigned i = 0; i < sqEntries; ++i) sqArray[i] = i;
+
+  io_uring_rsrc_register table{};
+  table.nr = files;
+  table.flags = IORING_RSRC_REGISTER_SPARSE;
+  if (ioUringRegister(ringFd, IORING_REGISTER_FILES2, &table,
+                      sizeof(table)) < 0) {
+    release();
+    throw std::runtime_error("Registering files failed; IoUring::IoUring()");
+  }
+
+  // The kernel picks a buffer per receive; the data then needs no copy
+  // before it reaches deliver(). Send-only rings go without.
+  if (buffers == 0) return;
+  bufferRingSize = buffers * sizeof(io_uring_buf);
+  void *ringMemory = mmap(nullptr, bufferRingSize, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ringMemory == MAP_FAILED) {
+    release();
+    throw std::runtime_error("Allocating buffer ring failed; IoUring::IoUring()");
+  }
+  bufferRing = static_cast<io_uring_buf_ring *>(ringMemory);
+  // Touch the pages first: the kernel pins them at registration and must
+  // see the entries we write afterwards, not a copy-on-write zero page.
+  memset(ringMemory, 0, bufferRingSize);
+  io_uring_buf_reg registration{};
+  registration.ring_addr = reinterpret_cast<uint64_t>(bufferRing);
+  registration.ring_entries = buffers;
+  registration.bgid = 0;
+  if (ioUringRegister(ringFd, IORING_REGISTER_PBUF_RING, &registration, 1) <
+      0) {
+    release();
+    throw std::runtime_error("Registering buffer ring failed; IoUring::IoUring()");
+  }
+  bufferStorage.resize(static_cast<size_t>(buffers) * bufferSize);
+  bufferMemory = bufferStorage.data();
+  for (unsigned id = 0; id < buffers; ++id) recycle(id);
+}
+
+IoUring::~IoUring() { release(); }
+
+void IoUring::release() {
+  if (ringFd != -1) ::close(ringFd);
+  ringFd = -1;
+  if (sqes) munmap(sqes, sqesSize);
+  sqes = nullptr;
+  if (sqRing) munmap(sqRing, sqRingSize);
+  sqRing = nullptr;
+  if (cqRing) munmap(cqRing, cqRingSize);
+  cqRing = nullptr;
+  if (bufferRing) munmap(bufferRing, bufferRingSize);
+  bufferRing = nullptr;
+}
+
+bool IoUring::setFile(unsigned slot, int fd) {
+  io_uring_files_update update{};
+  update.offset = slot;
+  update.fds = reinterpret_cast<uint64_t>(&fd);
+  return ioUringRegister(ringFd, IORING_REGISTER_FILES_UPDATE, &update, 1) ==
+         1;
+}
+
+bool IoUring::releaseFiles() {
+  return ioUringRegister(ringFd, IORING_UNREGISTER_FILES, nullptr, 0) == 0;
+}
+
+int IoUring::enter(unsigned submit, unsigned wait, unsigned flags, void *arg,
+                   size_t argSize) {
+  return static_cast<int>(syscall(__NR_io_uring_enter, ringFd, submit, wait,
+                                  flags, arg, argSize));
+}
+
+io_uring_sqe *IoUring::nextSqe() {
+  unsigned tail = *sqTail;
+  if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) == sqEntries) {
+    // Queue full: hand what we have to the kernel first.
+    int submitted = enter(pending, 0, 0, nullptr, 0);
+    if (submitted > 0) pending -= submitted;
+  }
+  io_uring_sqe *sqe = &sqes[tail & *sqMask];
+  memset(sqe, 0, sizeof(*sqe));
+  // Without SQPOLL the kernel only reads the queue in io_uring_enter(), so
+  // publishing the tail before the caller fills the entry is safe.
+  __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+  ++pending;
+  return sqe;
+}
+
+void IoUring::pollMultishot(int fd, uint64_t userData) {
+  io_uring_sqe *sqe = nextSqe();
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = fd;
+  sqe->poll32_events = POLLIN;
+  sqe->len = IORING_POLL_ADD_MULTI;
+  sqe->user_data = userData;
+}
+
+void IoUring::acceptMultishot(int fd, uint64_t userData) {
+  io_uring_sqe *sqe = nextSqe();
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = fd;
+  sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+  sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+  sqe->user_data = userData;
+}
+
+void IoUring::recvMultishot(unsigned slot, uint64_t userData) {
+  io_uring_sqe *sqe = nextSqe();
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = static_cast<int>(slot);
+  sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->buf_group = 0;
+  sqe->user_data = userData;
+}
+
+void IoUring::recvmsgMultishot(unsigned slot, msghdr *layout,
+                               uint64_t userData) {
+  io_uring_sqe *sqe = nextSqe();
+  sqe->opcode = IORING_OP_RECVMSG;
+  sqe->fd = static_cast<int>(slot);
+  sqe->addr = reinterpret_cast<uint64_t>(layout);
+  sqe->len = 1;
+  sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->buf_group = 0;
+  sqe->user_data = userData;
+}
+
+void IoUring::sendmsg(unsigned slot, const msghdr *message,
+                      uint64_t userData) {
+  io_uring_sqe *sqe = nextSqe();
+  sqe->opcode = IORING_OP_SENDMSG;
+  sqe->fd = static_cast<int>(slot);
+  sqe->flags = IOSQE_FIXED_FILE;
+  sqe->addr = reinterpret_cast<uint64_t>(message);
+  sqe->len = 1;
+  sqe->msg_flags = MSG_NOSIGNAL;
+  sqe->user_data = userData;
+}
+
+void IoUring::cancel(uint64_t userData) {
+  io_uring_sqe *sqe = nextSqe();
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = -1;
+  sqe->addr = userData;
+  sqe->user_data = 0;
+}
+
+bool IoUring::cancelSync(uint64_t userData) {
+  io_uring_sync_cancel_reg request{};
+  request.addr = userData;
+  request.fd = -1;
+  request.flags = IORING_ASYNC_CANCEL_ALL;
+  request.timeout.tv_sec = 1;
+  // ENOENT: it had already completed.
+  return ioUringRegister(ringFd, IORING_REGISTER_SYNC_CANCEL, &request, 1) >=
+             0 ||
+         errno == ENOENT;
+}
+
+bool IoUring::submitAndWait(std::chrono::nanoseconds timeout) {
+  bool ready = *cqHead != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+  if (timeout.count() == 0 || ready) {
+    if (pending == 0) return true;
+    int submitted = enter(pending, 0, 0, nullptr, 0);
+    if (submitted < 0) return errno == EINTR || errno == EBUSY;
+    pending -= submitted;
+    return true;
+  }
+
+  int result;
+  if (timeout.count() < 0) {
+    result = enter(pending, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+  } else {
+    __kernel_timespec ts{};
+    ts.tv_sec = timeout.count() / 1000000000;
+    ts.tv_nsec = timeout.count() % 1000000000;
+    io_uring_getevents_arg arg{};
+    arg.ts = reinterpret_cast<uint64_t>(&ts);
+    result = enter(pending, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                   &arg, sizeof(arg));
+  }
+  if (result >= 0) {
+    pending -= result;
+    return true;
+  }
+  // ETIME is the timeout, the rest are transient.
+  return errno == ETIME || errno == EINTR || errno == EBUSY || errno == EAGAIN;
+}
+
+int IoUring::bufferId(const io_uring_cqe &cqe) {
+  if (!(cqe.flags & IORING_CQE_F_BUFFER)) return -1;
+  return static_cast<int>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+}
+
+void IoUring::recycle(unsigned id) {
+  uint16_t tail = bufferRing->tail;
+  // Index the ring by hand: in C++ the kernel header's flexible array member
+  // sits 8 bytes too far, the empty struct it is built from has size 1.
+  io_uring_buf &slot =
+      reinterpret_cast<io_uring_buf *>(bufferRing)[tail & (bufferCount - 1)];
+  slot.addr = reinterpret_cast<uint64_t>(buffer(id));
+  slot.len = bufferSize;
+  slot.bid = static_cast<uint16_t>(id);
+  __atomic_store_n(&bufferRing->tail, static_cast<uint16_t>(tail + 1),
+                   __ATOMIC_RELEASE);
+}
+
+#endif  // SOCKET_LIB_HAS_IO_URING
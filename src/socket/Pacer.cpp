@@ -0,0 +1,94 @@
+#include "socket/Pacer.h"
+
+#include <algorithm>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#endif
+
+namespace {
+
+// sleep_until overshoots by the scheduler slack, so the last stretch of a
+// wait is spun on the monotonic clock.
+const std::chrono::microseconds kSpinThreshold(50);
+
+void waitUntil(std::chrono::steady_clock::time_point target) {
+  auto now = std::chrono::steady_clock::now();
+  if (target - now > kSpinThreshold) {
+    std::this_thread::sleep_until(target - kSpinThreshold);
+  }
+  while (std::chrono::steady_clock::now() < target) {
+    std::this_thread::yield();
+  }
+}
+
+}  // namespace
+
+void Pacer::configure(const PacingConfig &config, bool kernelPacing) {
+  std::lock_guard<std::mutex> lock(mtx);
+  current = config;
+  kernel = kernelPacing;
+  tokens = static_cast<double>(config.burstBytes);
+  refilled = std::chrono::steady_clock::now();
+  counters.kernelPacing = config.enabled && kernelPacing;
+}
+
+std::chrono::nanoseconds Pacer::acquire(size_t bytes) {
+  std::chrono::steady_clock::time_point target;
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!current.enabled || kernel || current.rateBytesPerSecond == 0) {
+      return std::chrono::nanoseconds(0);
+    }
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - refilled).count();
+    refilled = now;
+    tokens = std::min(static_cast<double>(current.burstBytes),
+                      tokens + elapsed * current.rateBytesPerSecond);
+    tokens -= static_cast<double>(bytes);
+    ++counters.pacedWrites;
+    if (tokens >= 0) return std::chrono::nanoseconds(0);
+
+    target = now + std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::duration<double>(
+                           -tokens / current.rateBytesPerSecond));
+    auto delay = target - now;
+    ++counters.delayedWrites;
+    counters.totalDelay += delay;
+    counters.maxDelay = std::max<std::chrono::nanoseconds>(counters.maxDelay,
+                                                           delay);
+  }
+  auto start = std::chrono::steady_clock::now();
+  waitUntil(target);
+  return std::chrono::steady_clock::now() - start;
+}
+
+PacingStats Pacer::stats() const {
+  std::lock_guard<std::mutex> lock(mtx);
+  return counters;
+}
+
+PacingConfig Pacer::config() const {
+  std::lock_guard<std::mutex> lock(mtx);
+  return current;
+}
+
+bool setKernelPacingRate(int fd, uint64_t rateBytesPerSecond) {
+#if defined(SO_MAX_PACING_RATE)
+  if (fd < 0) return false;
+  if (rateBytesPerSecond != 0 && rateBytesPerSecond < ~0U) {
+    unsigned rate = static_cast<unsigned>(rateBytesPerSecond);
+    return setsockopt(fd, SOL_SOCKET, SO_MAX_PACING_RATE, &rate,
+                      sizeof(rate)) == 0;
+  }
+  // All ones means unlimited; 64-bit rates need Linux 4.20 or later.
+  uint64_t rate = rateBytesPerSecond == 0 ? ~0ULL : rateBytesPerSecond;
+  return setsockopt(fd, SOL_SOCKET, SO_MAX_PACING_RATE, &rate, sizeof(rate)) ==
+         0;
+#else
+  (void)fd;
+  (void)rateBytesPerSecond;
+  return false;
+#endif
+}
@@ -0,0 +1,244 @@
+#include "socket/Reactor.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+const uint64_t kWakeId = 0;
+const int kMaxEvents = 64;
+const size_t kTaskCapacity = 4096;
+
+// Entry being dispatched by this thread, so remove() from a subscriber
+// does not wait for itself.
+thread_local const void *currentEntry = nullptr;
+
+}  // namespace
+
+Reactor::Reactor(unsigned threadCount) : tasks(kTaskCapacity) {
+  epollFd = epoll_create1(EPOLL_CLOEXEC);
+  wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (epollFd == -1 || wakeFd == -1) {
+    if (epollFd != -1) ::close(epollFd);
+    if (wakeFd != -1) ::close(wakeFd);
+    throw std::runtime_error("Error creating epoll; Reactor::Reactor()");
+  }
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.u64 = kWakeId;
+  epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+  for (unsigned i = 0; i < std::max(threadCount, 1u); ++i) {
+    threads.emplace_back(&Reactor::loop, this);
+  }
+}
+
+Reactor::~Reactor() {
+  running = false;
+  wake();
+  for (auto &thread : threads) {
+    if (thread.get_id() == std::this_thread::get_id()) {
+      thread.detach();
+    } else {
+      thread.join();
+    }
+  }
+  ::close(epollFd);
+  ::close(wakeFd);
+}
+
+bool Reactor::add(Socket &socket) {
+  int fd = socket.reactorHandle();
+  if (fd == -1) {
+    spdlog::error("Socket has no descriptor to watch; Reactor::add()");
+    return false;
+  }
+  auto entry = std::make_shared<Entry>();
+  entry->socket = &socket;
+  entry->fd = fd;
+  {
+    std::lock_guard<std::mutex> lock(entriesMutex);
+    if (ids.count(&socket) != 0) {
+      spdlog::warn("Socket already added; Reactor::add()");
+      return false;
+    }
+    entry->id = nextId++;
+    // One-shot: only one thread sees an event until the dispatch re-arms.
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLONESHOT;
+    event.data.u64 = entry->id;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == -1) {
+      spdlog::error("Error registering descriptor: {0}; Reactor::add()",
+                    strerror(errno));
+      return false;
+    }
+    entries[entry->id] = entry;
+    ids[&socket] = entry->id;
+  }
+  // A first dispatch takes what arrived before the socket was added and
+  // lets the socket arm whatever it waits on.
+  schedule(*entry, Clock::now());
+  return true;
+}
+
+void Reactor::remove(Socket &socket) {
+  std::shared_ptr<Entry> entry;
+  {
+    std::lock_guard<std::mutex> lock(entriesMutex);
+    auto it = ids.find(&socket);
+    if (it == ids.end()) return;
+    entry = entries[it->second];
+    entries.erase(it->second);
+    ids.erase(it);
+    timers.cancel(entry->timer);
+    entry->removed = true;
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, entry->fd, nullptr);
+  }
+  if (currentEntry == entry.get()) return;
+  while (entry->requests != 0) {
+    std::this_thread::yield();
+  }
+}
+
+size_t Reactor::size() {
+  std::lock_guard<std::mutex> lock(entriesMutex);
+  return entries.size();
+}
+
+bool Reactor::post(std::function<void()> task) {
+  if (!tasks.tryPush(std::move(task))) return false;
+  // One eventfd write per batch: posts made before the woken thread gets
+  // to the queue ride on the pending wake.
+  if (!tasksWoken.exchange(true)) wake();
+  return true;
+}
+
+void Reactor::runTasks() {
+  // The queue has one consumer at a time; a thread finding another one at
+  // work leaves the tasks to it, which looks again after letting go.
+  while (!tasks.empty()) {
+    if (runningTasks.exchange(true)) return;
+    std::function<void()> task;
+    while (tasks.tryPop(task)) {
+      try {
+        task();
+      } catch (const std::exception &e) {
+        spdlog::error("Posted task failed: {0}; Reactor::runTasks()",
+                      e.what());
+      }
+    }
+    runningTasks = false;
+  }
+}
+
+void Reactor::wake() {
+  uint64_t one = 1;
+  ssize_t ignored = ::write(wakeFd, &one, sizeof(one));
+  (void)ignored;
+}
+
+void Reactor::schedule(Entry &entry, Clock::time_point due) {
+  bool earliest;
+  {
+    std::lock_guard<std::mutex> lock(entriesMutex);
+    if (entry.removed) return;
+    timers.cancel(entry.timer);
+    entry.timer = 0;
+    if (due == Clock::time_point::max()) return;
+    earliest = due < timers.nextExpiry();
+    entry.timer = timers.schedule(due, entry.id);
+  }
+  // Waiting threads sleep until the old earliest deadline.
+  if (earliest) wake();
+}
+
+int Reactor::nextTimeout() {
+  std::lock_guard<std::mutex> lock(entriesMutex);
+  Clock::time_point next = timers.nextExpiry();
+  if (next == Clock::time_point::max()) return -1;
+  auto remaining = next - Clock::now();
+  if (remaining <= Clock::duration::zero()) return 0;
+  // Round up, epoll_wait would otherwise wake just before the deadline.
+  return static_cast<int>(
+             std::chrono::duration_cast<std::chrono::milliseconds>(remaining)
+                 .count()) +
+         1;
+}
+
+void Reactor::loop() {
+  epoll_event events[kMaxEvents];
+  std::vector<uint64_t> expired;
+  while (running) {
+    int ready = epoll_wait(epollFd, events, kMaxEvents, nextTimeout());
+    if (ready == -1 && errno != EINTR) {
+      spdlog::error("Error in epoll_wait: {0}; Reactor::loop()",
+                    strerror(errno));
+      return;
+    }
+    // The wake counter is reset before the tasks run, so a post() that
+    // misses this round wakes the next one.
+    for (int i = 0; i < ready && running; ++i) {
+      // Left set when stopping, so every thread sees it.
+      if (events[i].data.u64 == kWakeId) {
+        uint64_t value;
+        ssize_t ignored = ::read(wakeFd, &value, sizeof(value));
+        (void)ignored;
+        tasksWoken = false;
+      }
+    }
+    runTasks();
+    std::vector<std::shared_ptr<Entry>> work;
+    {
+      std::lock_guard<std::mutex> lock(entriesMutex);
+      for (int i = 0; i < ready; ++i) {
+        if (events[i].data.u64 == kWakeId) continue;
+        auto it = entries.find(events[i].data.u64);
+        if (it != entries.end()) work.push_back(it->second);
+      }
+      expired.clear();
+      timers.advance(Clock::now(), expired);
+      for (uint64_t id : expired) {
+        auto it = entries.find(id);
+        if (it == entries.end()) continue;
+        it->second->timer = 0;
+        work.push_back(it->second);
+      }
+    }
+    for (auto &entry : work) dispatch(entry);
+  }
+}
+
+void Reactor::dispatch(const std::shared_ptr<Entry> &entry) {
+  if (entry->requests.fetch_add(1) != 0) return;
+  const void *previous = currentEntry;
+  currentEntry = entry.get();
+  unsigned runs = 1;
+  while (true) {
+    auto due = Clock::time_point::max();
+    if (!entry->removed) {
+      try {
+        due = entry->socket->reactorDispatch();
+      } catch (const std::exception &e) {
+        spdlog::error("Socket dispatch failed: {0}; Reactor::dispatch()",
+                      e.what());
+      }
+    }
+    schedule(*entry, due);
+    if (!entry->removed) {
+      epoll_event event{};
+      event.events = EPOLLIN | EPOLLONESHOT;
+      event.data.u64 = entry->id;
+      epoll_ctl(epollFd, EPOLL_CTL_MOD, entry->fd, &event);
+    }
+    // Requests that came in while running are served by one more run.
+    unsigned left = entry->requests.fetch_sub(runs) - runs;
+    if (left == 0) break;
+    runs = left;
+  }
+  currentEntry = previous;
+}
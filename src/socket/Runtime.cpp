@@ -0,0 +1,173 @@
+#include "socket/Runtime.h"
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <stdexcept>
+
+#include "socket/TCP/LinuxTCP/LinuxTCPSocket.h"
+
+namespace {
+
+thread_local int currentCoreIndex = -1;
+
+std::vector<int> allowedCpus() {
+  std::vector<int> cpus;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) != 0) return cpus;
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+// The node directory sysfs lists under the CPU, absent without NUMA.
+int nodeOf(int cpu) {
+  std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+  DIR *directory = opendir(path.c_str());
+  if (directory == nullptr) return -1;
+  int node = -1;
+  while (dirent *entry = readdir(directory)) {
+    if (std::strncmp(entry->d_name, "node", 4) == 0 &&
+        entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+      node = std::atoi(entry->d_name + 4);
+      break;
+    }
+  }
+  closedir(directory);
+  return node;
+}
+
+}  // namespace
+
+BufferPool::BufferPool(size_t bufferSize, size_t count)
+    : size(bufferSize), owner(std::this_thread::get_id()), returned(count) {
+  slabBytes = bufferSize * count;
+  void *memory = mmap(nullptr, slabBytes, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    throw std::runtime_error("Error allocating buffer pool; BufferPool::BufferPool()");
+  }
+  slab = static_cast<uint8_t *>(memory);
+  // First touch: the pages are placed on this thread's node now rather
+  // than wherever the first use happens to run.
+  std::memset(slab, 0, slabBytes);
+  freeBuffers.reserve(count);
+  for (size_t i = count; i > 0; --i) {
+    freeBuffers.push_back(slab + (i - 1) * bufferSize);
+  }
+}
+
+BufferPool::~BufferPool() {
+  if (slab != nullptr) munmap(slab, slabBytes);
+}
+
+uint8_t *BufferPool::acquire() {
+  if (freeBuffers.empty()) {
+    uint8_t *buffer;
+    while (returned.tryPop(buffer)) freeBuffers.push_back(buffer);
+    if (freeBuffers.empty()) return nullptr;
+  }
+  uint8_t *buffer = freeBuffers.back();
+  freeBuffers.pop_back();
+  return buffer;
+}
+
+void BufferPool::release(uint8_t *buffer) {
+  if (std::this_thread::get_id() == owner) {
+    freeBuffers.push_back(buffer);
+    return;
+  }
+  // Holds every buffer of the pool, so it is never full.
+  returned.tryPush(std::move(buffer));
+}
+
+Runtime::Runtime(const RuntimeConfig &config) {
+  std::vector<int> cpus = config.cpus.empty() ? allowedCpus() : config.cpus;
+  if (cpus.empty()) {
+    throw std::runtime_error("No CPU to run on; Runtime::Runtime()");
+  }
+  coreList.resize(cpus.size());
+  std::vector<std::future<void>> started;
+  for (size_t core = 0; core < cpus.size(); ++core) {
+    Core &slot = coreList[core];
+    slot.cpu = cpus[core];
+    slot.node = nodeOf(slot.cpu);
+    slot.reactor.reset(new Reactor(1));
+    auto ready = std::make_shared<std::promise<void>>();
+    started.push_back(ready->get_future());
+    // Pinned before the pool is touched, so the pool lands on its node.
+    slot.reactor->post([&slot, &config, core, ready]() {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(slot.cpu, &set);
+      int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+      if (error != 0) {
+        spdlog::warn("Error pinning core {0} to CPU {1}: {2}; Runtime::Runtime()",
+                     core, slot.cpu, strerror(error));
+      }
+      currentCoreIndex = static_cast<int>(core);
+      try {
+        slot.pool.reset(new BufferPool(config.bufferSize, config.buffersPerCore));
+        ready->set_value();
+      } catch (...) {
+        ready->set_exception(std::current_exception());
+      }
+    });
+  }
+  for (auto &future : started) future.get();
+}
+
+Runtime::~Runtime() {
+  for (auto &core : coreList) core.reactor.reset();
+}
+
+size_t Runtime::coreFor(const std::string &key) const {
+  return std::hash<std::string>()(key) % coreList.size();
+}
+
+bool Runtime::add(Socket &socket, size_t core) {
+  if (core >= coreList.size()) {
+    spdlog::error("No core {0}; Runtime::add()", core);
+    return false;
+  }
+  if (LinuxTCPSocket *tcp = dynamic_cast<LinuxTCPSocket *>(&socket)) {
+    tcp->setReactor(coreList[core].reactor.get());
+    return true;
+  }
+  std::lock_guard<std::mutex> lock(assignedMutex);
+  if (!coreList[core].reactor->add(socket)) return false;
+  assigned[&socket] = core;
+  return true;
+}
+
+bool Runtime::add(Socket &socket, const std::string &key) {
+  return add(socket, coreFor(key));
+}
+
+void Runtime::remove(Socket &socket) {
+  size_t core;
+  {
+    std::lock_guard<std::mutex> lock(assignedMutex);
+    auto it = assigned.find(&socket);
+    if (it == assigned.end()) return;
+    core = it->second;
+    assigned.erase(it);
+  }
+  coreList[core].reactor->remove(socket);
+}
+
+bool Runtime::post(size_t core, std::function<void()> task) {
+  if (core >= coreList.size()) return false;
+  return coreList[core].reactor->post(std::move(task));
+}
+
+int Runtime::currentCore() {
+  return currentCoreIndex;
+}
@@ -1,11 +1,37 @@
 #include "socket/Serial/SerialSocket.h"
 
+#include <algorithm>
 #include <iomanip>
 #include <sstream>
+#include <thread>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#endif
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
 
 #include "spdlog/spdlog.h"
 // to use the serial port in linux
 
+namespace {
+
+// How long read() waits for data, as the Windows read timeouts do.
+const std::chrono::milliseconds kReadTimeout(50);
+
+// Without an eventfd to wake it, a waiting read() looks for cancel() this
+// often.
+const std::chrono::milliseconds kCancelPoll(10);
+
+}  // namespace
+
 SerialSocket::SerialSocket(std::string portName, int baudRate, int dataBits,
                            int stopBits, int parity)
     : portName(portName),
@@ -14,13 +40,10 @@ SerialSocket::SerialSocket(std::string portName, int baudRate, int dataBits,
       stopBits(stopBits),
       parity(parity) {}
 
-SerialSocket::~SerialSocket() {
-  close();
-  spdlog::shutdown();
-}
+SerialSocket::~SerialSocket() { close(); }
 
 void SerialSocket::open() {
-  std::lock_guard<std::mutex> lock(mtx);
+  std::unique_lock<std::mutex> lock(mtx);
   spdlog::info("Opening serial port...");
 #ifdef _WIN32
   // Try to connect to the given port through CreateFile
@@ -377,11 +400,19 @@ void SerialSocket::open() {
   }
   // Flush serial port
   tcflush(serialPort, TCIOFLUSH);
+#ifdef __linux__
+  wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
 #endif
   spdlog::info("Serial port opened successfully");
+  lock.unlock();
+  startAsyncWriter();
 }
 
 void SerialSocket::close() {
+  cancel();
+  // The writer writes under mtx, so it stops first.
+  stopAsyncWriter(true);
   std::lock_guard<std::mutex> lock(mtx);
   spdlog::info("Closing serial port");
 #ifdef _WIN32
@@ -395,11 +426,19 @@ void SerialSocket::close() {
     ::close(serialPort);
     serialPort = -1;
   }
+  if (wakeFd != -1) {
+    ::close(wakeFd);
+    wakeFd = -1;
+  }
 #endif
   spdlog::info("Serial port closed");
 }
 
 void SerialSocket::write(Serializable serializable) {
+  if (std::shared_ptr<AsyncWriter> writer = std::atomic_load(&asyncWriter)) {
+    writer->enqueue(static_cast<std::vector<uint8_t>>(serializable));
+    return;
+  }
   std::lock_guard<std::mutex> lock(mtx);
   std::vector<uint8_t> data = static_cast<std::vector<uint8_t>>(serializable);
 
@@ -410,6 +449,7 @@ void SerialSocket::write(Serializable serializable) {
   }
 
   DWORD bytesWritten;
+  pacer.acquire(data.size());
   if (!WriteFile(hSerial, data.data(), data.size(), &bytesWritten, NULL)) {
     spdlog::error("Error writing to serial port: {0}", GetLastError());
     return;
@@ -417,6 +457,7 @@ void SerialSocket::write(Serializable serializable) {
   spdlog::info("Data sent to {0}", portName);
 #else
 
+  pacer.acquire(data.size());
   ssize_t bytesSent = ::write(serialPort, data.data(), data.size());
   if (bytesSent != static_cast<ssize_t>(data.size())) {
     spdlog::error("Error sending data; LinuxSerialSocket::write()", nullptr);
@@ -435,7 +476,203 @@ void SerialSocket::write(Serializable serializable) {
   }
 }
 
+bool SerialSocket::writeBatch(std::vector<std::vector<uint8_t>> &messages) {
+  std::lock_guard<std::mutex> lock(mtx);
+  size_t total = 0;
+  for (auto &message : messages) total += message.size();
+#ifdef _WIN32
+  if (hSerial == INVALID_HANDLE_VALUE) {
+    spdlog::error("Serial port is not open; SerialSocket::writeBatch()");
+    return false;
+  }
+  std::vector<uint8_t> data;
+  data.reserve(total);
+  for (auto &message : messages) {
+    data.insert(data.end(), message.begin(), message.end());
+  }
+  DWORD bytesWritten;
+  pacer.acquire(data.size());
+  if (!WriteFile(hSerial, data.data(), data.size(), &bytesWritten, NULL)) {
+    spdlog::error("Error writing to serial port: {0}", GetLastError());
+    return false;
+  }
+#else
+  if (serialPort <= 0) {
+    spdlog::error("Serial port is not open; SerialSocket::writeBatch()");
+    return false;
+  }
+  std::vector<iovec> iov;
+  iov.reserve(messages.size());
+  for (auto &message : messages) {
+    if (!message.empty()) iov.push_back({message.data(), message.size()});
+  }
+  pacer.acquire(total);
+  size_t next = 0;
+  while (next < iov.size()) {
+    int count = static_cast<int>(std::min<size_t>(iov.size() - next, IOV_MAX));
+    ssize_t written = ::writev(serialPort, &iov[next], count);
+    if (written == -1) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        // The port is opened non-blocking; wait for the driver to drain.
+        pollfd state{serialPort, POLLOUT, 0};
+        poll(&state, 1, 100);
+        continue;
+      }
+      spdlog::error("Error sending data: {0}; SerialSocket::writeBatch()",
+                    strerror(errno));
+      return false;
+    }
+    // Skip what went out, possibly ending inside a message.
+    size_t left = static_cast<size_t>(written);
+    while (next < iov.size() && left >= iov[next].iov_len) {
+      left -= iov[next].iov_len;
+      ++next;
+    }
+    if (left > 0) {
+      iov[next].iov_base = static_cast<uint8_t *>(iov[next].iov_base) + left;
+      iov[next].iov_len -= left;
+    }
+  }
+#endif
+  spdlog::debug("Sent {0} queued messages, {1} bytes, to {2}",
+                messages.size(), total, portName);
+  return true;
+}
+
+void SerialSocket::setAsyncWrite(const AsyncWriteConfig &config) {
+  stopAsyncWriter(false);
+  {
+    std::lock_guard<std::mutex> lock(asyncWriteMutex);
+    asyncWriteConfig = config;
+  }
+  bool open;
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+#ifdef _WIN32
+    open = hSerial != INVALID_HANDLE_VALUE;
+#else
+    open = serialPort > 0;
+#endif
+  }
+  if (open) startAsyncWriter();
+}
+
+bool SerialSocket::drainWrites(std::chrono::steady_clock::duration timeout) {
+  std::shared_ptr<AsyncWriter> writer = std::atomic_load(&asyncWriter);
+  return !writer || writer->drain(timeout);
+}
+
+AsyncWriteStats SerialSocket::getAsyncWriteStats() {
+  std::lock_guard<std::mutex> lock(asyncWriteMutex);
+  std::shared_ptr<AsyncWriter> writer = std::atomic_load(&asyncWriter);
+  return writer ? asyncWriteTotals + writer->stats() : asyncWriteTotals;
+}
+
+void SerialSocket::startAsyncWriter() {
+  std::lock_guard<std::mutex> lock(asyncWriteMutex);
+  if (!asyncWriteConfig.enabled || std::atomic_load(&asyncWriter)) return;
+  std::atomic_store(
+      &asyncWriter,
+      std::make_shared<AsyncWriter>(
+          asyncWriteConfig, [this](std::vector<std::vector<uint8_t>> &batch) {
+            return writeBatch(batch);
+          }));
+}
+
+void SerialSocket::stopAsyncWriter(bool closing) {
+  std::lock_guard<std::mutex> lock(asyncWriteMutex);
+  std::shared_ptr<AsyncWriter> writer =
+      std::atomic_exchange(&asyncWriter, std::shared_ptr<AsyncWriter>());
+  if (!writer) return;
+  writer->stop(!closing || asyncWriteConfig.drainOnClose);
+  asyncWriteTotals = asyncWriteTotals + writer->stats();
+}
+
 Serializable SerialSocket::read() {
+  return read(std::chrono::steady_clock::now() + kReadTimeout);
+}
+
+Serializable SerialSocket::tryRead() {
+  return read(std::chrono::steady_clock::time_point::min());
+}
+
+Serializable SerialSocket::read(std::chrono::steady_clock::time_point deadline) {
+  uint64_t generation = readGeneration;
+#ifdef _WIN32
+  // ReadFile() is only called for what the driver already holds.
+  while (true) {
+    Serializable received = receive();
+    auto now = std::chrono::steady_clock::now();
+    if (!received.empty() || readGeneration != generation || now >= deadline) {
+      return received;
+    }
+    std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(
+        kCancelPoll, deadline - now));
+  }
+#else
+  // The port is non-blocking with VMIN = VTIME = 0; wait outside the lock,
+  // so that writes go on meanwhile.
+  bool waited = false;  // A past deadline still looks once.
+  while (readGeneration == generation) {
+    auto now = std::chrono::steady_clock::now();
+    if (waited && now >= deadline) return {};
+    waited = true;
+    int port;
+    int wake;
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      port = serialPort;
+      wake = wakeFd;
+    }
+    if (port <= 0) break;
+    int timeout = -1;
+    if (deadline != std::chrono::steady_clock::time_point::max() ||
+        wake == -1) {
+      std::chrono::steady_clock::duration wait =
+          deadline <= now ? std::chrono::steady_clock::duration::zero()
+                          : deadline - now;
+      if (wake == -1) wait = std::min<decltype(wait)>(wait, kCancelPoll);
+      // Rounded up, so that poll() does not return just before the deadline.
+      auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(
+          wait + std::chrono::milliseconds(1) - std::chrono::nanoseconds(1));
+      timeout = static_cast<int>(std::min<std::chrono::milliseconds::rep>(
+          milliseconds.count(), INT_MAX));
+    }
+    pollfd fds[2] = {{port, POLLIN, 0}, {wake, POLLIN, 0}};
+    int ready = poll(fds, wake != -1 ? 2 : 1, timeout);
+    if (ready == -1 && errno != EINTR) {
+      spdlog::error("Error in poll: {0}; SerialSocket::read()",
+                    strerror(errno));
+      return {};
+    }
+    if (ready <= 0) continue;
+    if (wake != -1 && (fds[1].revents & POLLIN)) {
+      // Also clears wakes left by a cancel() nobody was waiting for.
+      uint64_t value;
+      ssize_t ignored = ::read(wake, &value, sizeof(value));
+      (void)ignored;
+      continue;
+    }
+    return receive();
+  }
+  return {};
+#endif
+}
+
+void SerialSocket::cancel() {
+  ++readGeneration;
+#ifdef __linux__
+  std::lock_guard<std::mutex> lock(mtx);
+  if (wakeFd != -1) {
+    uint64_t one = 1;
+    ssize_t ignored = ::write(wakeFd, &one, sizeof(one));
+    (void)ignored;
+  }
+#endif
+}
+
+Serializable SerialSocket::receive() {
   std::lock_guard<std::mutex> lock(mtx);
 #ifdef _WIN32
 
@@ -481,15 +718,28 @@ Serializable SerialSocket::read() {
     spdlog::debug("Data received: " + stream.str());
   }
 #else
+  // Take everything the driver holds in one call; bytes left unread stay
+  // queued for the next read(), so callers see an unbroken stream.
+  if (serialPort <= 0) {
+    spdlog::error("Serial port is not open; SerialSocket::read()");
+    return {};
+  }
+  int available = 0;
+  ioctl(serialPort, FIONREAD, &available);
   std::vector<uint8_t> data;
-  data.resize(1024);
+  data.resize(std::max(available, 1024));
   ssize_t bytesRead = ::read(serialPort, data.data(), data.size());
   if (bytesRead == -1) {
-    spdlog::error("Error reading data; LinuxSerialSocket::read()", nullptr);
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+      return {};  // Nothing arrived within the timeout.
+    }
+    spdlog::error("Error reading data: {0}; LinuxSerialSocket::read()",
+                  strerror(errno));
     throw std::runtime_error("Error reading data; LinuxSerialSocket::read()");
   }
-  // Flush serial port
-  tcflush(serialPort, TCIOFLUSH);
+  if (bytesRead == 0) {
+    return {};
+  }
 
   data.resize(bytesRead);
   spdlog::info("Data received from serial port {0} ,{1} bytes received.",
@@ -510,5 +760,33 @@ Serializable SerialSocket::read() {
   return Serializable(buffer);
 }
 
+int SerialSocket::reactorHandle() {
+#ifdef _WIN32
+  return -1;
+#else
+  return serialPort > 0 ? serialPort : -1;
+#endif
+}
+
+std::chrono::steady_clock::time_point SerialSocket::reactorDispatch() {
+#ifndef _WIN32
+  int available = 0;
+  ioctl(serialPort, FIONREAD, &available);
+  if (available > 0) {
+    receive();
+  } else {
+    // Woken with nothing queued: a hung-up port stays readable forever, so
+    // close it rather than being dispatched again and again.
+    pollfd state{serialPort, POLLIN, 0};
+    if (poll(&state, 1, 0) == 1 && (state.revents & (POLLHUP | POLLERR))) {
+      spdlog::error("Serial port {0} hung up; SerialSocket::reactorDispatch()",
+                    portName);
+      close();
+    }
+  }
+#endif
+  return std::chrono::steady_clock::time_point::max();
+}
+
 SerialSocket::SerialSocket(const std::string &portName)
     : SerialSocket(portName, 115200, 8, 1, 0) {}
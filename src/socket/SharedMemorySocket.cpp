@@ -0,0 +1,380 @@
+#include "socket/SharedMemory/SharedMemorySocket.h"
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+const uint64_t kMagic = 0x534c53484d524e31ULL;  // "SLSHMRN1"
+const uint64_t kHeader = 8;  ///< Record header: state word and padding.
+const uint32_t kCommitted = 1u << 31;
+const uint32_t kPadding = 1u << 30;  ///< Filler up to the end of the ring.
+const uint32_t kLengthMask = kPadding - 1;
+const size_t kMinCapacity = 4096;
+
+uint64_t recordSize(uint64_t length) {
+  return (kHeader + length + 7) & ~uint64_t(7);
+}
+
+std::atomic<uint32_t> *stateOf(uint8_t *record) {
+  return reinterpret_cast<std::atomic<uint32_t> *>(record);
+}
+
+long futex(std::atomic<uint32_t> *word, int op, uint32_t value,
+           const timespec *timeout) {
+  // Not FUTEX_PRIVATE: the word is shared with another process.
+  return syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), op, value,
+                 timeout, nullptr, 0);
+}
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+}  // namespace
+
+/**
+ * Indices are byte positions that only grow; the ring offset is the
+ * position modulo the capacity. Each index has a cache line of its own so
+ * the writer and the reader do not invalidate each other's.
+ */
+struct alignas(64) SharedMemorySocket::Ring {
+  alignas(64) std::atomic<uint64_t> head{0};  ///< Reserved up to, by writers.
+  alignas(64) std::atomic<uint64_t> tail{0};  ///< Read up to, by the reader.
+  alignas(64) std::atomic<uint32_t> sequence{0};  ///< Futex word.
+  std::atomic<uint32_t> sleeping{0};  ///< The reader waits on sequence.
+};
+
+struct alignas(64) SharedMemorySocket::Segment {
+  std::atomic<uint64_t> magic{0};  ///< Set last by the creator.
+  uint64_t capacity = 0;
+  uint32_t multiProducer = 0;
+  Ring toCreator;
+  Ring toAttached;
+};
+
+SharedMemorySocket::SharedMemorySocket(std::string name, Role role,
+                                       const ShmRingConfig &config)
+    : name(std::move(name)), role(role), config(config) {}
+
+SharedMemorySocket::~SharedMemorySocket() { close(); }
+
+void SharedMemorySocket::open() {
+  std::lock_guard<std::mutex> lock(mapMutex);
+  if (segment != nullptr) return;
+
+  int fd;
+  size_t size;
+  if (role == CREATOR) {
+    uint64_t ringCapacity = kMinCapacity;
+    while (ringCapacity < config.capacity) ringCapacity <<= 1;
+    size = sizeof(Segment) + 2 * ringCapacity;
+    ::shm_unlink(name.c_str());
+    fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600);
+    if (fd == -1 || ::ftruncate(fd, size) == -1) {
+      spdlog::error("Creating segment {0} failed: {1}; "
+                    "SharedMemorySocket::open()",
+                    name, strerror(errno));
+      if (fd != -1) ::close(fd);
+      throw std::runtime_error(
+          "Creating segment failed; SharedMemorySocket::open()");
+    }
+    capacity = ringCapacity;
+  } else {
+    fd = ::shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+    struct stat info;
+    if (fd == -1 || ::fstat(fd, &info) == -1 ||
+        static_cast<size_t>(info.st_size) < sizeof(Segment)) {
+      spdlog::error("Opening segment {0} failed: {1}; "
+                    "SharedMemorySocket::open()",
+                    name, fd == -1 ? strerror(errno) : "too small");
+      if (fd != -1) ::close(fd);
+      throw std::runtime_error(
+          "Opening segment failed; SharedMemorySocket::open()");
+    }
+    size = static_cast<size_t>(info.st_size);
+  }
+
+  void *address =
+      ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (address == MAP_FAILED) {
+    spdlog::error("Mapping segment {0} failed: {1}; SharedMemorySocket::open()",
+                  name, strerror(errno));
+    if (role == CREATOR) ::shm_unlink(name.c_str());
+    throw std::runtime_error(
+        "Mapping segment failed; SharedMemorySocket::open()");
+  }
+
+  Segment *mapped;
+  if (role == CREATOR) {
+    mapped = new (address) Segment();
+    mapped->capacity = capacity;
+    mapped->multiProducer = config.multiProducer ? 1 : 0;
+    mapped->magic.store(kMagic, std::memory_order_release);
+  } else {
+    mapped = static_cast<Segment *>(address);
+    capacity = mapped->capacity;
+    if (mapped->magic.load(std::memory_order_acquire) != kMagic ||
+        size < sizeof(Segment) + 2 * capacity) {
+      spdlog::error("{0} is not a SharedMemorySocket segment; "
+                    "SharedMemorySocket::open()",
+                    name);
+      ::munmap(address, size);
+      throw std::runtime_error(
+          "Not a SharedMemorySocket segment; SharedMemorySocket::open()");
+    }
+  }
+
+  segment = mapped;
+  mappedSize = size;
+  multiProducer = mapped->multiProducer != 0;
+  uint8_t *toCreatorData = static_cast<uint8_t *>(address) + sizeof(Segment);
+  uint8_t *toAttachedData = toCreatorData + capacity;
+  if (role == CREATOR) {
+    in = &mapped->toCreator;
+    inData = toCreatorData;
+    out = &mapped->toAttached;
+    outData = toAttachedData;
+  } else {
+    in = &mapped->toAttached;
+    inData = toAttachedData;
+    out = &mapped->toCreator;
+    outData = toCreatorData;
+  }
+  // Spinning only pays off while the writer runs on another CPU.
+  spinLimit =
+      std::thread::hardware_concurrency() > 1 ? config.spinIterations : 0;
+  closing = false;
+  spdlog::info("Shared memory segment {0} open, {1} bytes per ring", name,
+               capacity);
+}
+
+void SharedMemorySocket::close() {
+  {
+    std::lock_guard<std::mutex> lock(mapMutex);
+    if (segment == nullptr) return;
+    // Wake our own reader so it releases readMutex.
+    closing = true;
+    in->sequence.fetch_add(1);
+    futex(&in->sequence, FUTEX_WAKE, INT32_MAX, nullptr);
+  }
+  // Writers that got in before closing was set still use the rings.
+  while (writers.load() != 0) {
+    std::this_thread::yield();
+  }
+  std::lock_guard<std::mutex> readLock(readMutex);
+  std::lock_guard<std::mutex> lock(mapMutex);
+  ::munmap(segment, mappedSize);
+  if (role == CREATOR) ::shm_unlink(name.c_str());
+  segment = nullptr;
+  in = out = nullptr;
+  inData = outData = nullptr;
+  spdlog::info("Shared memory segment {0} closed", name);
+}
+
+bool SharedMemorySocket::enterWriter() {
+  writers.fetch_add(1);
+  // Both sequentially consistent: close() either sees this writer or it
+  // is seen closing.
+  if (!closing.load()) return true;
+  leaveWriter();
+  return false;
+}
+
+void SharedMemorySocket::leaveWriter() { writers.fetch_sub(1); }
+
+ShmSlot SharedMemorySocket::reserve(size_t size) {
+  if (!enterWriter()) {
+    spdlog::error("Segment is not open; SharedMemorySocket::reserve()");
+    return ShmSlot();
+  }
+  ShmSlot slot = reserveSpace(size);
+  // A reserved slot keeps the segment mapped until commit().
+  if (slot.data == nullptr) leaveWriter();
+  return slot;
+}
+
+ShmSlot SharedMemorySocket::reserveSpace(size_t size) {
+  ShmSlot slot;
+  uint64_t total = recordSize(size);
+  if (size > kLengthMask || total > capacity) {
+    spdlog::error("Message of {0} bytes does not fit the ring; "
+                  "SharedMemorySocket::reserve()",
+                  size);
+    return slot;
+  }
+  uint64_t mask = capacity - 1;
+  uint64_t head = out->head.load(std::memory_order_relaxed);
+  uint64_t padding;
+  while (true) {
+    // A record never wraps: the end of the ring is skipped instead.
+    uint64_t offset = head & mask;
+    padding = offset + total > capacity ? capacity - offset : 0;
+    uint64_t tail = out->tail.load(std::memory_order_acquire);
+    if (head + padding + total - tail > capacity) return slot;
+    if (!multiProducer) {
+      out->head.store(head + padding + total, std::memory_order_relaxed);
+      break;
+    }
+    if (out->head.compare_exchange_weak(head, head + padding + total,
+                                        std::memory_order_relaxed)) {
+      break;
+    }
+  }
+  if (padding != 0) {
+    stateOf(outData + (head & mask))
+        ->store(static_cast<uint32_t>(padding) | kCommitted | kPadding,
+                std::memory_order_release);
+  }
+  slot.position = head + padding;
+  slot.data = outData + (slot.position & mask) + kHeader;
+  slot.size = size;
+  return slot;
+}
+
+void SharedMemorySocket::commit(const ShmSlot &slot) {
+  if (slot.data == nullptr) return;
+  publish(slot);
+  leaveWriter();
+}
+
+void SharedMemorySocket::publish(const ShmSlot &slot) {
+  stateOf(outData + (slot.position & (capacity - 1)))
+      ->store(static_cast<uint32_t>(slot.size) | kCommitted,
+              std::memory_order_release);
+  wakeReader(*out);
+}
+
+void SharedMemorySocket::wakeReader(Ring &ring) {
+  // Pairs with the fence in read(): either the reader sees the record or
+  // this sees it sleeping.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (ring.sleeping.load(std::memory_order_relaxed) != 0) {
+    ring.sequence.fetch_add(1, std::memory_order_release);
+    futex(&ring.sequence, FUTEX_WAKE, 1, nullptr);
+  }
+}
+
+bool SharedMemorySocket::take(std::vector<uint8_t> &message) {
+  uint64_t mask = capacity - 1;
+  uint64_t tail = in->tail.load(std::memory_order_relaxed);
+  while (true) {
+    uint8_t *record = inData + (tail & mask);
+    uint32_t state = stateOf(record)->load(std::memory_order_acquire);
+    if ((state & kCommitted) == 0) return false;
+    uint64_t length = state & kLengthMask;
+    bool padding = (state & kPadding) != 0;
+    uint64_t total = padding ? length : recordSize(length);
+    if (!padding) {
+      message.assign(record + kHeader, record + kHeader + length);
+    }
+    // Zero the record so stale bytes never look like a committed header
+    // when a later record starts inside it.
+    std::memset(record, 0, total);
+    tail += total;
+    in->tail.store(tail, std::memory_order_release);
+    if (!padding) return true;
+  }
+}
+
+Serializable SharedMemorySocket::read() {
+  std::lock_guard<std::mutex> readLock(readMutex);
+  if (in == nullptr) {
+    spdlog::error("Segment is not open; SharedMemorySocket::read()");
+    return Serializable();
+  }
+  std::vector<uint8_t> message;
+  auto deadline = std::chrono::steady_clock::now() + config.readTimeout;
+  unsigned spins = 0;
+  while (!closing) {
+    if (take(message)) {
+      Serializable received(message);
+      notify(received);
+      return received;
+    }
+    if (spins < spinLimit) {
+      ++spins;
+      cpuRelax();
+      continue;
+    }
+    auto remaining = deadline - std::chrono::steady_clock::now();
+    if (remaining <= std::chrono::steady_clock::duration::zero()) break;
+    if (!config.wakeup) {
+      std::this_thread::yield();
+      continue;
+    }
+    uint32_t sequence = in->sequence.load(std::memory_order_acquire);
+    in->sleeping.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if ((stateOf(inData + (in->tail.load(std::memory_order_relaxed) &
+                           (capacity - 1)))
+             ->load(std::memory_order_acquire) &
+         kCommitted) == 0 &&
+        !closing) {
+      auto nanoseconds =
+          std::chrono::duration_cast<std::chrono::nanoseconds>(remaining)
+              .count();
+      timespec timeout{static_cast<time_t>(nanoseconds / 1000000000),
+                       static_cast<long>(nanoseconds % 1000000000)};
+      futex(&in->sequence, FUTEX_WAIT, sequence, &timeout);
+    }
+    in->sleeping.store(0, std::memory_order_relaxed);
+  }
+  spdlog::debug("No data received from {0}", name);
+  return Serializable();
+}
+
+void SharedMemorySocket::write(Serializable serializableObj) {
+  std::vector<uint8_t> data =
+      static_cast<std::vector<uint8_t>>(serializableObj);
+  if (!enterWriter()) {
+    spdlog::error("Segment is not open; SharedMemorySocket::write()");
+    return;
+  }
+  if (data.size() > kLengthMask || recordSize(data.size()) > capacity) {
+    spdlog::error("Message of {0} bytes does not fit the ring; "
+                  "SharedMemorySocket::write()",
+                  data.size());
+    leaveWriter();
+    return;
+  }
+  auto deadline = std::chrono::steady_clock::now() + config.readTimeout;
+  while (true) {
+    ShmSlot slot = reserveSpace(data.size());
+    if (slot.data != nullptr) {
+      std::memcpy(slot.data, data.data(), data.size());
+      publish(slot);
+      break;
+    }
+    if (closing || std::chrono::steady_clock::now() >= deadline) {
+      spdlog::error("Ring of {0} full, message dropped; "
+                    "SharedMemorySocket::write()",
+                    name);
+      break;
+    }
+    std::this_thread::yield();
+  }
+  leaveWriter();
+}
+
+size_t SharedMemorySocket::pending() const {
+  if (in == nullptr) return 0;
+  return static_cast<size_t>(in->head.load(std::memory_order_relaxed) -
+                             in->tail.load(std::memory_order_relaxed));
+}
@@ -0,0 +1,186 @@
+#include "socket/StreamReader.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+StreamReader::StreamReader(Socket &socket, size_t capacity, bool mirror)
+    : socket(&socket) {
+  allocate(capacity, mirror);
+}
+
+#ifndef _WIN32
+StreamReader::StreamReader(int fd, size_t capacity, bool mirror) : fd(fd) {
+  allocate(capacity, mirror);
+}
+#endif
+
+StreamReader::~StreamReader() {
+#ifdef __linux__
+  if (mirrored) {
+    munmap(base, 2 * cap);
+  }
+#endif
+}
+
+void StreamReader::allocate(size_t capacity, bool mirror) {
+#ifdef __linux__
+  size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  cap = (std::max<size_t>(capacity, 1) + page - 1) / page * page;
+  // Reserve twice the size, then map the same memfd pages into both halves.
+  int memory = mirror ? memfd_create("StreamReader", MFD_CLOEXEC) : -1;
+  if (memory != -1 && ftruncate(memory, static_cast<off_t>(cap)) == 0) {
+    void *reserved = mmap(nullptr, 2 * cap, PROT_NONE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reserved != MAP_FAILED) {
+      uint8_t *area = static_cast<uint8_t *>(reserved);
+      if (mmap(area, cap, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+               memory, 0) != MAP_FAILED &&
+          mmap(area + cap, cap, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_FIXED, memory, 0) != MAP_FAILED) {
+        base = area;
+        mirrored = true;
+      } else {
+        munmap(reserved, 2 * cap);
+      }
+    }
+  }
+  if (memory != -1) {
+    ::close(memory);
+  }
+  if (mirror && !mirrored) {
+    spdlog::warn("Mirrored ring unavailable ({0}), compacting instead; "
+                 "StreamReader::allocate()",
+                 strerror(errno));
+  }
+#else
+  (void)mirror;
+  cap = std::max<size_t>(capacity, 1);
+#endif
+  if (!mirrored) {
+    fallback.resize(cap);
+    base = fallback.data();
+  }
+}
+
+uint8_t *StreamReader::writePosition() {
+  if (mirrored) {
+    // The free space continues into the mirror, so it is contiguous too.
+    return base + (head + size) % cap;
+  }
+  if (head != 0) {
+    std::memmove(base, base + head, size);
+    head = 0;
+  }
+  return base + size;
+}
+
+size_t StreamReader::fromSocket(uint8_t *target, size_t space) {
+  if (pendingOffset == pending.size()) {
+    Serializable chunk = socket->read();
+    if (chunk.empty()) {
+      return 0;
+    }
+    pending = static_cast<std::vector<uint8_t>>(chunk);
+    pendingOffset = 0;
+  }
+  size_t count = std::min(space, pending.size() - pendingOffset);
+  std::memcpy(target, pending.data() + pendingOffset, count);
+  pendingOffset += count;
+  return count;
+}
+
+bool StreamReader::fill() {
+  size_t space = cap - size;
+  if (space == 0) {
+    return false;
+  }
+  uint8_t *target = writePosition();
+  size_t count = 0;
+  if (socket != nullptr) {
+    count = fromSocket(target, space);
+  }
+#ifndef _WIN32
+  else {
+    if (ended) {
+      return false;
+    }
+    ssize_t bytesRead;
+    do {
+      bytesRead = ::read(fd, target, space);
+    } while (bytesRead == -1 && errno == EINTR);
+    if (bytesRead == -1) {
+      spdlog::error("Error reading: {0}; StreamReader::fill()",
+                    strerror(errno));
+      return false;
+    }
+    ended = bytesRead == 0;
+    count = static_cast<size_t>(bytesRead);
+  }
+#endif
+  size += count;
+  return count > 0;
+}
+
+StreamView StreamReader::peek(size_t n) {
+  if (n > cap) {
+    spdlog::error("{0} bytes do not fit the {1} byte buffer; "
+                  "StreamReader::peek()",
+                  n, cap);
+    return StreamView{};
+  }
+  while (size < n) {
+    if (!fill()) {
+      return StreamView{};
+    }
+  }
+  return StreamView{base + head, n};
+}
+
+StreamView StreamReader::readExact(size_t n) {
+  StreamView view = peek(n);
+  consume(view.size);
+  return view;
+}
+
+StreamView StreamReader::readUntil(uint8_t delimiter, size_t maxLength) {
+  size_t limit = std::min(maxLength, cap);
+  size_t scanned = 0;
+  while (true) {
+    const uint8_t *start = base + head;
+    size_t window = std::min(size, limit);
+    const void *found =
+        std::memchr(start + scanned, delimiter, window - scanned);
+    if (found != nullptr) {
+      size_t length = static_cast<const uint8_t *>(found) - start + 1;
+      consume(length);
+      return StreamView{start, length};
+    }
+    scanned = window;
+    if (scanned == limit) {
+      spdlog::error("No delimiter within {0} bytes; StreamReader::readUntil()",
+                    limit);
+      return StreamView{};
+    }
+    if (!fill()) {
+      return StreamView{};
+    }
+  }
+}
+
+void StreamReader::consume(size_t n) {
+  n = std::min(n, size);
+  size -= n;
+  head = size == 0 ? 0 : head + n;
+  if (mirrored && head >= cap) {
+    head -= cap;
+  }
+}
@@ -1,84 +1,350 @@
-#include "LinuxTCPSocket.h"
+#include "socket/TCP/LinuxTCP/LinuxTCPSocket.h"
+#include "socket/Reactor.h"
 #include <arpa/inet.h>
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/filter.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
 #include <spdlog/spdlog.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <thread>
-#include <future>
 #include <iostream>
 #include <stdexcept>
 #include <unistd.h>
 
-LinuxTCPSocket::~LinuxTCPSocket() {
-    close();
-}
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#include <linux/errqueue.h>
+#define SOCKET_LIB_HAS_ZEROCOPY 1
+#endif
 
-bool LinuxTCPSocket::connectWithRetries() {
-    unsigned retry = 1;
-    clientSocket = socket(AF_INET, SOCK_STREAM, 0);
+namespace {
 
-    if (clientSocket == -1) {
-        spdlog::error("Error creating socket: {0}; LinuxTCPSocket::connectWithRetries()", strerror(errno));
-        return false;
-    }
+const uint64_t kListenToken = 1;
+const uint64_t kWakeToken = 2;
+const uint64_t kConnectToken = 3;
+const int kMaxEvents = 256;
+const size_t kReceiveBufferSize = 64 * 1024;
+const size_t kInboxCapacity = 1024;
+const size_t kMaxIov = 64;
+const size_t kTransferChunk = 1024 * 1024;
+const int kTransferPollMs = 100; ///< Upper bound of a transfer wait, so a closed connection is noticed.
 
-    sockaddr_in clientAddress{};
-    clientAddress.sin_family = AF_INET;
-    clientAddress.sin_port = htons(remotePort);
-    clientAddress.sin_addr.s_addr = inet_addr(remoteIp.c_str());
-    spdlog::info("Connecting to server: {0}", remoteIp);
+// io_uring backend sizing: 512 x 8 KB of receive buffers are shared by all
+// connections of a socket.
+const unsigned kRingEntries = 1024;
+const unsigned kFixedFiles = 16384;
+const unsigned kReceiveBuffers = 512;
+const unsigned kReceiveBufferBytes = 8 * 1024;
 
-    while (retry <= maxRetries || maxRetries == INFINITERETRIES) {
-        if (connect(clientSocket, reinterpret_cast<sockaddr*>(&clientAddress), sizeof(clientAddress)) != -1) {
-            spdlog::info("Connected to server: {0}", remoteIp);
-            return true;
-        }
+// io_uring user_data: connection id << 3 | operation.
+const uint64_t kOpPoll = 1;
+const uint64_t kOpAccept = 2;
+const uint64_t kOpRecv = 3;
+const uint64_t kOpSend = 4;
+const unsigned kOpBits = 3;
 
-        spdlog::warn("Error connecting to server: {0}; LinuxTCPSocket::connectWithRetries()\nRetry number: {1}", strerror(errno), retry);
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        ++retry;
-    }
+// Timer tokens: connection id << 2 | kind. Liveness of connection 0 stands
+// for every connection.
+const uint64_t kLingerTimer = 0;
+const uint64_t kConnectTimer = 1;
+const uint64_t kFlushTimer = 2;
+const uint64_t kLivenessTimer = 3;
+const unsigned kTimerBits = 2;
 
-    struct timeval tv = retryTimeout;
-    setsockopt(clientSocket, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&tv), sizeof(struct timeval));
+std::string peerName(const sockaddr_storage& address, socklen_t length) {
+    return Endpoint(reinterpret_cast<const sockaddr*>(&address), length).toString();
+}
 
-    return false; // All attempts failed
+bool setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
 }
 
+} // namespace
+
+LinuxTCPSocket::~LinuxTCPSocket() {
+    close();
+}
 
-void LinuxTCPSocket::openthread() {
+void LinuxTCPSocket::open() {
     switch (actualMode) {
         case mode::SERVER:
+            startLoop();
             spdlog::info("Server mode initialized");
             startListening();
+            if (!listening) {
+                return;
+            }
             break;
 
         case mode::CLIENT:
-            if (!connectWithRetries()) {
-                spdlog::error("Error connecting. No mode initialized for TCP socket; LinuxTCPSocket::openthread()", nullptr);
+            if (!openAsync().get()) {
+                spdlog::error("Error connecting. No mode initialized for TCP socket; LinuxTCPSocket::open()", nullptr);
             }
-            break;
+            return;
         default:
-            spdlog::error("Error connecting. No mode initialized for TCP socket; LinuxTCPSocket::openthread()", nullptr);
+            spdlog::error("Error connecting. No mode initialized for TCP socket; LinuxTCPSocket::open()", nullptr);
     }
     socketopen = true;
+    if (pacer.config().enabled) {
+        setPacing(pacer.config());
+    }
 }
 
-void LinuxTCPSocket::open() {
-    std::thread t1(&LinuxTCPSocket::openthread, this);
-    if (actualMode != mode::SERVER) {
-        t1.join();
+std::future<bool> LinuxTCPSocket::openAsync(std::function<void(bool)> onComplete) {
+    std::promise<bool> immediate;
+    if (actualMode != mode::CLIENT) {
+        open();
+        if (onComplete) {
+            onComplete(listening);
+        }
+        immediate.set_value(listening);
+        return immediate.get_future();
+    }
+
+    startLoop();
+    socketopen = true;
+    if (pacer.config().enabled) {
+        setPacing(pacer.config());
+    }
+
+    auto pending = std::unique_ptr<PendingConnect>(new PendingConnect());
+    pending->due = std::chrono::steady_clock::now();
+    pending->onComplete = std::move(onComplete);
+    // Resolved here, on the caller's thread, so the loop never waits on DNS
+    // unless this lookup failed and a retry repeats it.
+    pending->addresses = Endpoint::resolve(remoteIp, remotePort, SOCK_STREAM);
+    std::future<bool> result = pending->result.get_future();
+    bool alreadyConnected;
+    {
+        std::lock_guard<std::mutex> lock(connectMutex);
+        if (!pendingConnect && clientConnection == 0) {
+            pendingConnect = std::move(pending);
+        }
+        alreadyConnected = clientConnection != 0;
+    }
+    if (pending) {
+        spdlog::warn("Connect already in progress or established; LinuxTCPSocket::openAsync()");
+        if (pending->onComplete) {
+            pending->onComplete(alreadyConnected);
+        }
+        immediate.set_value(alreadyConnected);
+        return immediate.get_future();
+    }
+    spdlog::info("Connecting to server: {0}", remoteIp);
+    wakeLoop();
+    return result;
+}
+
+void LinuxTCPSocket::setBackoff(const BackoffConfig& config) {
+    std::lock_guard<std::mutex> lock(connectMutex);
+    backoff = config;
+}
+
+std::chrono::steady_clock::time_point LinuxTCPSocket::nextDeadline() {
+    std::lock_guard<std::mutex> lock(timersMutex);
+    return timers.nextExpiry();
+}
+
+bool LinuxTCPSocket::armTimer(TimerId& timer, std::chrono::steady_clock::time_point due, uint64_t token) {
+    std::lock_guard<std::mutex> lock(timersMutex);
+    timers.cancel(timer);
+    // The loop sleeps until the earliest deadline it saw.
+    bool earliest = due < timers.nextExpiry();
+    timer = timers.schedule(due, token);
+    return earliest;
+}
+
+int LinuxTCPSocket::loopTimeout() {
+    auto next = nextDeadline();
+    if (next == std::chrono::steady_clock::time_point::max()) {
+        return -1;
+    }
+    auto remaining = next - std::chrono::steady_clock::now();
+    if (remaining <= std::chrono::steady_clock::duration::zero()) {
+        return 0;
+    }
+    // Round up, epoll_wait would otherwise wake just before the deadline.
+    return static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count()) + 1;
+}
+
+void LinuxTCPSocket::driveConnect(bool writable) {
+    std::unique_ptr<PendingConnect> finished;
+    int connectedFd = -1;
+    {
+        std::lock_guard<std::mutex> lock(connectMutex);
+        if (!pendingConnect) {
+            return;
+        }
+        PendingConnect& pending = *pendingConnect;
+        bool due = std::chrono::steady_clock::now() >= pending.due;
+
+        if (pending.fd != -1) {
+            if (!writable && !due) {
+                return;
+            }
+            int error = 0;
+            socklen_t len = sizeof(error);
+            if (writable && getsockopt(pending.fd, SOL_SOCKET, SO_ERROR, &error, &len) == 0 && error == 0) {
+                epoll_ctl(epollFd, EPOLL_CTL_DEL, pending.fd, nullptr);
+                connectedFd = pending.fd;
+                pending.fd = -1;
+                finished = std::move(pendingConnect);
+            } else {
+                if (writable) {
+                    spdlog::warn("Error connecting to server: {0}; LinuxTCPSocket::driveConnect()\nRetry number: {1}", strerror(error), pending.attempt);
+                } else {
+                    spdlog::warn("Timeout connecting to server; LinuxTCPSocket::driveConnect()\nRetry number: {0}", pending.attempt);
+                }
+                epoll_ctl(epollFd, EPOLL_CTL_DEL, pending.fd, nullptr);
+                ::close(pending.fd);
+                pending.fd = -1;
+                if (!scheduleRetry(pending)) {
+                    finished = std::move(pendingConnect);
+                }
+            }
+        } else if (due) {
+            if (!startConnectAttempt(pending, connectedFd)) {
+                if (!scheduleRetry(pending)) {
+                    finished = std::move(pendingConnect);
+                }
+            } else if (connectedFd != -1) {
+                finished = std::move(pendingConnect);
+            }
+        }
+    }
+    if (finished) {
+        completeConnect(std::move(finished), connectedFd);
+    }
+}
+
+bool LinuxTCPSocket::startConnectAttempt(PendingConnect& pending, int& connectedFd) {
+    ++pending.attempt;
+    if (pending.addresses.empty()) {
+        pending.addresses = Endpoint::resolve(remoteIp, remotePort, SOCK_STREAM);
+        if (pending.addresses.empty()) {
+            spdlog::warn("Cannot resolve {0}; LinuxTCPSocket::startConnectAttempt()\nRetry number: {1}", remoteIp, pending.attempt);
+            return false;
+        }
+    }
+    // Each retry moves on to the next address, so an unreachable family
+    // does not hold up the other.
+    const Endpoint& serverAddress = pending.addresses[(pending.attempt - 1) % pending.addresses.size()];
+
+    // A socket whose connect() failed is in an unspecified state, so every
+    // attempt starts from a new one.
+    int fd = socket(serverAddress.family(), SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        spdlog::error("Error creating socket: {0}; LinuxTCPSocket::startConnectAttempt()", strerror(errno));
+        return false;
+    }
+
+    if (connect(fd, serverAddress.address(), serverAddress.length()) == 0) {
+        connectedFd = fd;
+        return true;
+    }
+    if (errno != EINPROGRESS) {
+        spdlog::warn("Error connecting to server: {0}; LinuxTCPSocket::startConnectAttempt()\nRetry number: {1}", strerror(errno), pending.attempt);
+        ::close(fd);
+        return false;
+    }
+
+    epoll_event event{};
+    event.events = EPOLLOUT | EPOLLONESHOT;
+    event.data.u64 = kConnectToken;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == -1) {
+        spdlog::error("Error registering connect: {0}; LinuxTCPSocket::startConnectAttempt()", strerror(errno));
+        ::close(fd);
+        return false;
+    }
+    pending.fd = fd;
+    pending.due = std::chrono::steady_clock::now() + std::chrono::seconds(retryTimeout.tv_sec) + std::chrono::microseconds(retryTimeout.tv_usec);
+    armTimer(pending.timer, pending.due, kConnectTimer);
+    return true;
+}
+
+bool LinuxTCPSocket::scheduleRetry(PendingConnect& pending) {
+    if (maxRetries != static_cast<unsigned>(INFINITERETRIES) && pending.attempt >= maxRetries) {
+        return false;
+    }
+    double delay = backoff.initialDelay.count() * std::pow(backoff.multiplier, pending.attempt - 1);
+    delay = std::min(delay, static_cast<double>(backoff.maxDelay.count()));
+    std::uniform_real_distribution<double> spread(1.0 - std::min(std::max(backoff.jitter, 0.0), 1.0), 1.0);
+    delay *= spread(jitterEngine);
+    pending.due = std::chrono::steady_clock::now() + std::chrono::microseconds(static_cast<int64_t>(delay * 1000));
+    armTimer(pending.timer, pending.due, kConnectTimer);
+    return true;
+}
+
+void LinuxTCPSocket::completeConnect(std::unique_ptr<PendingConnect> pending, int connectedFd) {
+    bool connected = false;
+    if (connectedFd != -1) {
+        sockaddr_storage serverAddress{};
+        socklen_t len = sizeof(serverAddress);
+        getpeername(connectedFd, reinterpret_cast<sockaddr*>(&serverAddress), &len);
+        ConnectionId id = addConnection(connectedFd, peerName(serverAddress, len));
+        if (id != 0) {
+            clientSocket = connectedFd;
+            clientConnection = id;
+            connected = true;
+            spdlog::info("Connected to server: {0}", remoteIp);
+        }
     } else {
-        t1.detach();
+        if (pending->fd != -1) {
+            ::close(pending->fd);
+        }
+        spdlog::error("Error connecting to server {0} after {1} attempts; LinuxTCPSocket::completeConnect()", remoteIp, pending->attempt);
     }
+    if (pending->onComplete) {
+        pending->onComplete(connected);
+    }
+    pending->result.set_value(connected);
 }
 
 void LinuxTCPSocket::close() {
-    if (clientSocket != -1) {
-        ::shutdown(clientSocket, SHUT_RDWR);
-        ::close(clientSocket);
-        clientSocket = -1;
+    cancel();
+    stopLoop();
+    std::unique_ptr<PendingConnect> cancelled;
+    {
+        std::lock_guard<std::mutex> lock(connectMutex);
+        cancelled = std::move(pendingConnect);
+    }
+    if (cancelled) {
+        completeConnect(std::move(cancelled), -1);
+    }
+    std::vector<ConnectionId> ids;
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        for (auto& entry : connections) {
+            ids.push_back(entry.first);
+        }
+    }
+    for (ConnectionId id : ids) {
+        closeConnection(id);
+    }
+    // Closed connections still waiting for zero-copy completions.
+    ids.clear();
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        for (auto& entry : retired) {
+            ids.push_back(entry.first);
+        }
     }
+    for (ConnectionId id : ids) {
+        reapClosed(id, true);
+    }
+    listening = false;
     if (serverSocket != -1) {
         ::shutdown(serverSocket, SHUT_RDWR);
         ::close(serverSocket);
@@ -88,157 +354,1766 @@ void LinuxTCPSocket::close() {
 }
 
 void LinuxTCPSocket::startListening() {
-    serverSocket = socket(AF_INET, SOCK_STREAM, 0);
+    int family = dualStack ? AF_INET6 : AF_INET;
+    serverSocket = socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (serverSocket == -1 && family == AF_INET6) {
+        spdlog::warn("IPv6 unavailable ({0}), listening on IPv4 only; LinuxTCPSocket::startListening()", strerror(errno));
+        family = AF_INET;
+        serverSocket = socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    }
     if (serverSocket == -1) {
         spdlog::error("Error creating socket: {0}; LinuxTCPSocket::startListening()", strerror(errno));
         return;
     }
+    if (family == AF_INET6) {
+        // Accept IPv4 as mapped addresses whatever net.ipv6.bindv6only says.
+        int v6Only = 0;
+        setsockopt(serverSocket, IPPROTO_IPV6, IPV6_V6ONLY, &v6Only, sizeof(v6Only));
+    }
 
-    sockaddr_in serverAddr{};
-    serverAddr.sin_family = AF_INET;
-    serverAddr.sin_port = htons(localPort);
-    serverAddr.sin_addr.s_addr = INADDR_ANY;
+    int reuse = 1;
+    setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (reusePort && setsockopt(serverSocket, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) == -1) {
+        spdlog::error("Error setting SO_REUSEPORT: {0}; LinuxTCPSocket::startListening()", strerror(errno));
+    }
 
-    if (bind(serverSocket, reinterpret_cast<sockaddr*>(&serverAddr), sizeof(serverAddr)) == -1) {
+    Endpoint serverAddr = Endpoint::wildcard(family, localPort);
+    if (bind(serverSocket, serverAddr.address(), serverAddr.length()) == -1) {
         spdlog::error("Error binding socket: {0}; LinuxTCPSocket::startListening()", strerror(errno));
+        ::close(serverSocket);
+        serverSocket = -1;
         return;
     }
 
-    listen(serverSocket, SOMAXCONN);
-
-    spdlog::info("Waiting for connections...");
+    if (listen(serverSocket, SOMAXCONN) == -1) {
+        spdlog::error("Error listening on socket: {0}; LinuxTCPSocket::startListening()", strerror(errno));
+        ::close(serverSocket);
+        serverSocket = -1;
+        return;
+    }
 
-    int clientAddrSize = sizeof(sockaddr_in);
-    clientSocket = accept(serverSocket, nullptr, reinterpret_cast<socklen_t*>(&clientAddrSize));
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+    if (reusePortSteering) {
+        // Return the receiving CPU as the group index; the program is
+        // shared by the whole group and an index out of range falls back
+        // to hashing.
+        sock_filter code[] = {
+            {BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)},
+            {BPF_RET | BPF_A, 0, 0, 0},
+        };
+        sock_fprog program{};
+        program.len = sizeof(code) / sizeof(code[0]);
+        program.filter = code;
+        if (setsockopt(serverSocket, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program)) == -1) {
+            spdlog::warn("Error attaching CPU steering: {0}; LinuxTCPSocket::startListening()", strerror(errno));
+        }
+    }
+#endif
 
-    if (clientSocket == -1) {
-        spdlog::error("Error accepting connection: {0}; LinuxTCPSocket::startListening()", strerror(errno));
-        return;
+    if (usingUring) {
+        // The loop arms a multishot accept once it sees the flag.
+        listening = true;
+        wakeLoop();
+    } else {
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLET;
+        event.data.u64 = kListenToken;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, serverSocket, &event) == -1) {
+            spdlog::error("Error registering listen socket: {0}; LinuxTCPSocket::startListening()", strerror(errno));
+            ::close(serverSocket);
+            serverSocket = -1;
+            return;
+        }
+        listening = true;
     }
-    sockaddr_in clientAddr{};
-    socklen_t clientAddrLen = sizeof(clientAddr);
-    getpeername(clientSocket, reinterpret_cast<sockaddr*>(&clientAddr), &clientAddrLen);
-    spdlog::info("Client connected: {0}", inet_ntoa(clientAddr.sin_addr));
+
+    spdlog::info("Waiting for connections...");
 }
 
-void LinuxTCPSocket::write( Serializable serializableObj) {
-    if (!isConnected()) {
-        spdlog::error("Socket not connected; LinuxTCPSocket::write()");
+void LinuxTCPSocket::startLoop() {
+    if (loopRunning) {
         return;
     }
-    auto now = std::chrono::system_clock::now();
-    unsigned retry = 1;
+    if (onLoop()) {
+        // The stopped loop still owns the descriptors until it returns.
+        throw std::runtime_error("Cannot reopen from the socket's own event loop; LinuxTCPSocket::startLoop()");
+    }
+    // A loop stopped from inside has returned or is about to; join it.
+    stopLoop();
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd == -1 || wakeFd == -1) {
+        throw std::runtime_error("Error creating event loop; LinuxTCPSocket::startLoop()");
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = kWakeToken;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
 
-    while (true) {
-        auto elapsedMilliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - now).count();
-        if (elapsedMilliseconds > (retryTimeout.tv_sec * 1000 + retryTimeout.tv_usec / 1000)) {
-            spdlog::error("Timeout while sending data. Stop sending data; LinuxTCPSocket::write()", nullptr);
+    if (reactor) {
+        if (ioBackend == IoBackend::IO_URING) {
+            spdlog::warn("io_uring is not used on a Reactor, using epoll; LinuxTCPSocket::startLoop()");
+        }
+        loopRunning = true;
+        onReactor = true;
+        if (reactor->add(*this)) {
             return;
         }
+        onReactor = false;
+        spdlog::warn("Reactor refused the socket, using a loop thread; LinuxTCPSocket::startLoop()");
+    }
 
-        spdlog::debug("Sending data to {0}:{1}, retry number: {2}", remoteIp, remotePort, retry);
-
+#ifdef SOCKET_LIB_HAS_IO_URING
+    if (!reactor && ioBackend != IoBackend::EPOLL && IoUring::supported()) {
         try {
-            if (clientSocket == -1) {
-                throw std::runtime_error("Socket is not open; LinuxTCPSocket::write()");
+            uring.reset(new IoUring(kRingEntries, kFixedFiles, kReceiveBuffers, kReceiveBufferBytes));
+            std::lock_guard<std::mutex> lock(connectionsMutex);
+            freeSlots.clear();
+            for (unsigned slot = kFixedFiles; slot > 0; --slot) {
+                freeSlots.push_back(slot - 1);
             }
+        } catch (const std::exception& e) {
+            spdlog::warn("Error creating io_uring: {0}; LinuxTCPSocket::startLoop()", e.what());
+        }
+    }
+    usingUring = uring != nullptr;
+#endif
+    if (ioBackend == IoBackend::IO_URING && !usingUring && !reactor) {
+        spdlog::warn("io_uring not supported by this kernel, using epoll; LinuxTCPSocket::startLoop()");
+    }
 
-            const std::vector<uint8_t>& serializedData = serializableObj.operator const std::vector<uint8_t>();
-            int bytesSent = send(clientSocket, reinterpret_cast<const char*>(serializedData.data()), static_cast<int>(serializedData.size()), 0);
+    loopRunning = true;
+    loopThread = std::thread(usingUring ? &LinuxTCPSocket::uringLoop : &LinuxTCPSocket::eventLoop, this);
+    if (loopCpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(loopCpu, &cpus);
+        int error = pthread_setaffinity_np(loopThread.native_handle(), sizeof(cpus), &cpus);
+        if (error != 0) {
+            spdlog::warn("Error pinning event loop to CPU {0}: {1}; LinuxTCPSocket::startLoop()", loopCpu, strerror(error));
+        }
+    }
+}
 
-            if (bytesSent == -1) {
-                throw std::runtime_error("Error sending data; LinuxTCPSocket::write()");
-            }
-            return;
-        } catch (const std::exception& e) {
-            spdlog::error("Exception caught: {0}", e.what());
-            std::this_thread::sleep_for(std::chrono::seconds(1));
-            reconnect();
+void LinuxTCPSocket::setReusePort(bool enabled, bool steerByCpu) {
+    reusePort = enabled;
+    reusePortSteering = enabled && steerByCpu;
+}
+
+void LinuxTCPSocket::setDualStack(bool enabled) {
+    dualStack = enabled;
+}
+
+void LinuxTCPSocket::setLoopAffinity(int cpu) {
+    loopCpu = cpu;
+}
+
+void LinuxTCPSocket::setReactor(Reactor* reactor) {
+    this->reactor = reactor;
+}
+
+int LinuxTCPSocket::reactorHandle() {
+    return onReactor ? epollFd : -1;
+}
+
+std::chrono::steady_clock::time_point LinuxTCPSocket::reactorDispatch() {
+    // One turn of eventLoop() that does not wait.
+    if (!loopRunning) {
+        return std::chrono::steady_clock::time_point::max();
+    }
+    dispatchThread = std::this_thread::get_id();
+    dispatchEvents(0);
+    resumeReceives();
+    driveConnect(false);
+    runTimers();
+    std::chrono::steady_clock::time_point next = nextDeadline();
+    dispatchThread = std::thread::id();
+    if (releaseAfterDispatch) {
+        // close() ran in a subscriber; nothing uses the descriptors now.
+        releaseAfterDispatch = false;
+        releaseLoop();
+        return std::chrono::steady_clock::time_point::max();
+    }
+    return next;
+}
+
+void LinuxTCPSocket::stopLoop() {
+    if (onReactor) {
+        loopRunning = false;
+        reactor->remove(*this);
+        onReactor = false;
+    }
+    if (onLoop()) {
+        // close() called from a subscriber running on the loop itself. The
+        // loop returns once the subscriber does and still uses the
+        // descriptors until then; they are released by reactorDispatch(),
+        // or by the next stopLoop() from another thread, which joins it.
+        loopRunning = false;
+        if (dispatchThread == std::this_thread::get_id()) {
+            releaseAfterDispatch = true;
         }
-        ++retry;
+        return;
     }
+    if (loopThread.joinable()) {
+        loopRunning = false;
+        wakeLoop();
+        loopThread.join();
+    }
+    releaseLoop();
 }
 
-Serializable LinuxTCPSocket::read() {
-    auto now = std::chrono::system_clock::now();
-    unsigned retry = 1;
+bool LinuxTCPSocket::onLoop() const {
+    std::thread::id self = std::this_thread::get_id();
+    return loopThread.get_id() == self || dispatchThread == self;
+}
 
-    while (true) {
-        auto elapsedMilliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - now).count();
-        if (elapsedMilliseconds > (retryTimeout.tv_sec * 1000 + retryTimeout.tv_usec / 1000)) {
-            spdlog::error("Timeout while receiving data. Stop receiving data; LinuxTCPSocket::read()", nullptr);
-            return Serializable(); // Return an empty Serializable object
+void LinuxTCPSocket::releaseLoop() {
+#ifdef SOCKET_LIB_HAS_IO_URING
+    uring.reset();
+#endif
+    if (epollFd != -1) {
+        ::close(epollFd);
+        epollFd = -1;
+    }
+    if (wakeFd != -1) {
+        ::close(wakeFd);
+        wakeFd = -1;
+    }
+    usingUring = false;
+}
+
+void LinuxTCPSocket::wakeLoop() {
+    uint64_t one = 1;
+    ssize_t ignored = ::write(wakeFd, &one, sizeof(one));
+    (void)ignored;
+}
+
+void LinuxTCPSocket::eventLoop() {
+    while (loopRunning) {
+        dispatchEvents(loopTimeout());
+        resumeReceives();
+        driveConnect(false);
+        runTimers();
+    }
+}
+
+void LinuxTCPSocket::dispatchEvents(int timeoutMs) {
+    epoll_event events[kMaxEvents];
+    int ready = epoll_wait(epollFd, events, kMaxEvents, timeoutMs);
+    if (ready == -1) {
+        if (errno != EINTR) {
+            spdlog::error("Error in epoll_wait: {0}; LinuxTCPSocket::dispatchEvents()", strerror(errno));
+        }
+        return;
+    }
+    for (int i = 0; i < ready && loopRunning; ++i) {
+        uint64_t token = events[i].data.u64;
+        if (token == kWakeToken) {
+            uint64_t value;
+            ssize_t ignored = ::read(wakeFd, &value, sizeof(value));
+            (void)ignored;
+        } else if (token == kListenToken) {
+            acceptConnections();
+        } else if (token == kConnectToken) {
+            driveConnect(true);
+        } else {
+            std::shared_ptr<Connection> connection = findConnection(token);
+            if (!connection) {
+                // Completions for a closed connection's zero-copy sends.
+                reapClosed(token, false);
+                continue;
+            }
+            bool alive = true;
+            if (events[i].events & EPOLLERR) {
+                // Zero-copy completions arrive as errors; reap them so that
+                // only a real error reaches receiveFrom().
+                std::lock_guard<std::mutex> lock(connection->writeMutex);
+                reapZeroCopy(*connection);
+            }
+            if (events[i].events & EPOLLOUT) {
+                alive = flushQueue(*connection);
+            }
+            if (alive && (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+                alive = receiveFrom(*connection);
+            }
+            if (!alive) {
+                closeConnection(token);
+            }
         }
+    }
+}
 
-        spdlog::debug("Receiving data from {0}:{1}, retry number: {2}", remoteIp, remotePort, retry);
+void LinuxTCPSocket::acceptConnections() {
+    // Edge-triggered: drain the whole backlog before waiting again.
+    while (true) {
+        sockaddr_storage clientAddr{};
+        socklen_t clientAddrLen = sizeof(clientAddr);
+        int fd = accept4(serverSocket, reinterpret_cast<sockaddr*>(&clientAddr), &clientAddrLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                spdlog::error("Error accepting connection: {0}; LinuxTCPSocket::acceptConnections()", strerror(errno));
+            }
+            return;
+        }
+        ConnectionId id = addConnection(fd, peerName(clientAddr, clientAddrLen));
+        if (id != 0) {
+            spdlog::info("Client connected: {0} (connection {1})", peerName(clientAddr, clientAddrLen), id);
+        }
+    }
+}
 
-        try {
-            if (clientSocket == -1) {
-                throw std::runtime_error("Socket is not open; LinuxTCPSocket::read()");
+ConnectionId LinuxTCPSocket::addConnection(int fd, const std::string& peer) {
+    if (!setNonBlocking(fd)) {
+        spdlog::error("Error setting non-blocking mode: {0}; LinuxTCPSocket::addConnection()", strerror(errno));
+        ::close(fd);
+        return 0;
+    }
+    auto connection = std::make_shared<Connection>();
+    connection->fd = fd;
+    connection->peer = peer;
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        if (usingUring) {
+            if (freeSlots.empty()) {
+                spdlog::error("No io_uring file slot left for {0}; LinuxTCPSocket::addConnection()", peer);
+                ::close(fd);
+                return 0;
             }
+            connection->slot = static_cast<int>(freeSlots.back());
+            freeSlots.pop_back();
+        }
+        connection->id = nextConnectionId++;
+        connections[connection->id] = connection;
+    }
+    if (pacer.stats().kernelPacing) {
+        setKernelPacingRate(fd, pacer.config().rateBytesPerSecond);
+    }
+    {
+        std::lock_guard<std::mutex> lock(sendQueueMutex);
+        applyWriteMode(fd, writeMode.mode);
+    }
+    connection->lastReceive = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(livenessMutex);
+        applyLiveness(fd, liveness);
+        connection->heartbeatDue = connection->lastReceive + liveness.heartbeatInterval;
+        armLiveness(*connection, liveness);
+    }
+    bool zeroCopy;
+    {
+        std::lock_guard<std::mutex> lock(zeroCopyMutex);
+        zeroCopy = zeroCopyConfig.enabled && !usingUring;
+    }
+    if (zeroCopy) {
+        std::lock_guard<std::mutex> lock(connection->writeMutex);
+        enableZeroCopy(*connection);
+    }
 
-            fd_set readSet;
-            FD_ZERO(&readSet);
-            FD_SET(clientSocket, &readSet);
+#ifdef SOCKET_LIB_HAS_IO_URING
+    if (usingUring) {
+        // Called on the loop thread, which owns the ring.
+        if (!uring->setFile(connection->slot, fd)) {
+            spdlog::error("Error registering connection: {0}; LinuxTCPSocket::addConnection()", strerror(errno));
+            closeConnection(connection->id);
+            return 0;
+        }
+        uring->recvMultishot(connection->slot, connection->id << kOpBits | kOpRecv);
+        notifyConnectionEvent(connection->id, ConnectionEvent::CONNECTED);
+        return connection->id;
+    }
+#endif
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    event.data.u64 = connection->id;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == -1) {
+        spdlog::error("Error registering connection: {0}; LinuxTCPSocket::addConnection()", strerror(errno));
+        closeConnection(connection->id);
+        return 0;
+    }
+    notifyConnectionEvent(connection->id, ConnectionEvent::CONNECTED);
+    return connection->id;
+}
 
-            timeval timeout = retryTimeout;
+std::shared_ptr<LinuxTCPSocket::Connection> LinuxTCPSocket::findConnection(ConnectionId id) {
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    auto it = connections.find(id);
+    return it == connections.end() ? nullptr : it->second;
+}
 
-            int selectResult = select(clientSocket + 1, &readSet, nullptr, nullptr, &timeout);
-            if (selectResult == -1) {
-                spdlog::error("Error in select(); LinuxTCPSocket::read()", nullptr);
-                throw std::runtime_error("Error in select(); LinuxTCPSocket::read()");
-            } else if (selectResult == 0) {
-                // Timeout occurred
-                spdlog::error("Timeout while waiting for data; LinuxTCPSocket::read()", nullptr);
-                return Serializable{}; // Return empty Serializable object
+bool LinuxTCPSocket::receiveFrom(Connection& connection) {
+    if (connection.receivePaused) {
+        // The kernel keeps the data, and a hang-up, until resumeReceives().
+        return true;
+    }
+    std::vector<uint8_t> receiveBuffer(kReceiveBufferSize);
+    while (true) {
+        ssize_t bytesRead;
+        int error;
+        {
+            // disconnect() and failed writes close the descriptor from other
+            // threads; without the lock recv() could read a reused one.
+            std::lock_guard<std::mutex> lock(connection.writeMutex);
+            if (connection.fd == -1) {
+                // Closed already, perhaps by a subscriber.
+                return true;
+            }
+            bytesRead = recv(connection.fd, receiveBuffer.data(), receiveBuffer.size(), 0);
+            error = errno;
+        }
+        if (bytesRead > 0) {
+            connection.bytesIn += bytesRead;
+            noteReceive(connection);
+            if (!deliver(connection.id, std::vector<uint8_t>(receiveBuffer.begin(), receiveBuffer.begin() + bytesRead))) {
+                pauseReceive(connection);
+                return true;
             }
+            continue;
+        }
+        if (bytesRead == 0) {
+            spdlog::info("Connection {0} closed by peer {1}", connection.id, connection.peer);
+            return false;
+        }
+        if (error == EINTR) {
+            continue;
+        }
+        if (error == EAGAIN || error == EWOULDBLOCK) {
+            return true;
+        }
+        spdlog::error("Error receiving data: {0}; LinuxTCPSocket::receiveFrom()", strerror(error));
+        return false;
+    }
+}
 
-            const int bufferSize = 1024;
-            std::vector<uint8_t> receiveBuffer(bufferSize);
-            int bytesRead = recv(clientSocket, reinterpret_cast<char*>(receiveBuffer.data()), bufferSize, 0);
+bool LinuxTCPSocket::deliver(ConnectionId id, std::vector<uint8_t> data) {
+    Serializable received(data);
+    bool room = true;
+    {
+        std::lock_guard<std::mutex> lock(inboxMutex);
+        if (readQueue) {
+            inbox.emplace_back(id, std::move(data));
+            room = inbox.size() < kInboxCapacity;
+        }
+    }
+    inboxCv.notify_one();
+    notify(received, id);
+    return room;
+}
 
-            if (bytesRead == -1 || bytesRead == 0) {
-                throw std::runtime_error("Error receiving data; LinuxTCPSocket::read()");
-            }
+void LinuxTCPSocket::pauseReceive(Connection& connection) {
+    connection.receivePaused = true;
+    bool warn = false;
+    {
+        std::lock_guard<std::mutex> lock(inboxMutex);
+        pausedReceives.push_back(connection.id);
+        // read() may have made room before the connection was listed.
+        if (!readQueue || inbox.size() <= kInboxCapacity / 2) {
+            resumePending = true;
+        }
+        warn = !readCalled && pausedReceives.size() == 1;
+    }
+    if (warn) {
+        spdlog::warn("The read() queue is full and read() has not been called, connection {0} stops; use setReadQueue(false) if only subscribers take the data; LinuxTCPSocket::pauseReceive()", connection.id);
+    } else {
+        spdlog::debug("The read() queue is full, connection {0} stops until read() catches up", connection.id);
+    }
+#ifdef SOCKET_LIB_HAS_IO_URING
+    if (usingUring) {
+        uring->cancel(connection.id << kOpBits | kOpRecv);
+    }
+#endif
+}
 
-            receiveBuffer.resize(bytesRead);
-            notify(Serializable(receiveBuffer));
-            return Serializable(receiveBuffer);
-        } catch (const std::exception& e) {
-            spdlog::error("Exception caught: {0}", e.what());
-            //reconnect();
+void LinuxTCPSocket::resumeReceives() {
+    if (!resumePending.exchange(false)) {
+        return;
+    }
+    std::vector<ConnectionId> ids;
+    {
+        std::lock_guard<std::mutex> lock(inboxMutex);
+        ids.swap(pausedReceives);
+    }
+    for (ConnectionId id : ids) {
+        std::shared_ptr<Connection> connection = findConnection(id);
+        if (!connection) {
+            continue;
+        }
+        connection->receivePaused = false;
+#ifdef SOCKET_LIB_HAS_IO_URING
+        if (usingUring) {
+            std::lock_guard<std::mutex> lock(connection->writeMutex);
+            if (connection->slot != -1) {
+                uring->recvMultishot(connection->slot, id << kOpBits | kOpRecv);
+            }
+            continue;
+        }
+#endif
+        // Edge-triggered: what arrived while paused raises no new event.
+        if (!receiveFrom(*connection)) {
+            closeConnection(id);
         }
-        ++retry;
     }
 }
 
-void LinuxTCPSocket::reconnect() {
-    unsigned retry = 1;
-    while(retry <= maxRetries || maxRetries == INFINITERETRIES) {
-        if (!socketopen) {
+void LinuxTCPSocket::closeConnection(ConnectionId id) {
+    std::shared_ptr<Connection> connection;
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        auto it = connections.find(id);
+        if (it == connections.end()) {
             return;
+        }
+        connection = it->second;
+        connections.erase(it);
+    }
+    {
+        std::lock_guard<std::mutex> lock(timersMutex);
+        timers.cancel(connection->livenessTimer);
+        timers.cancel(connection->flushTimer);
+    }
+    {
+        std::lock_guard<std::mutex> lock(connection->writeMutex);
+        if (connection->queuedBytes > 0) {
+            spdlog::warn("Dropping {0} unsent bytes to {1}; LinuxTCPSocket::closeConnection()", connection->queuedBytes.load(), connection->peer);
+            connection->queuedBytes = 0;
+        }
+        if (connection->sendInFlight) {
+            // The kernel still reads sendIov and the queued buffers; keep
+            // them until the send completes.
+            std::lock_guard<std::mutex> retiredLock(connectionsMutex);
+            retired[id] = connection;
+        } else {
+            if (connection->frontZeroCopy >= 0) {
+                // Partly sent with MSG_ZEROCOPY; the kernel reads the rest.
+                connection->zeroCopyPinned.emplace_back(static_cast<uint32_t>(connection->frontZeroCopy), std::move(connection->sendQueue.front()));
+                connection->frontZeroCopy = -1;
+            }
+            connection->sendQueue.clear();
+        }
+        reapZeroCopy(*connection);
+        ::shutdown(connection->fd, SHUT_RDWR);
+        if (!connection->zeroCopyPinned.empty() && epollFd != -1) {
+            // The kernel may still send, and resend, from the pinned
+            // buffers, and only this descriptor reports when it is done.
+            // Both stay, shut down, until then or the linger timeout.
+            connection->lingerFd = connection->fd;
+            {
+                std::lock_guard<std::mutex> retiredLock(connectionsMutex);
+                retired[id] = connection;
+            }
+            std::chrono::milliseconds lingerTimeout;
+            {
+                std::lock_guard<std::mutex> zeroCopyLock(zeroCopyMutex);
+                lingerTimeout = zeroCopyConfig.lingerTimeout;
+            }
+            if (armTimer(connection->livenessTimer, std::chrono::steady_clock::now() + lingerTimeout, (id << kTimerBits) | kLingerTimer)) {
+                wakeLoop();
+            }
         } else {
-            close();
-            try {
-                open();
-                return; // Successful reconnection, exit method
-            } catch (const std::exception& e) {
-                spdlog::warn("Reconnection attempt {0} failed: {1}", retry, e.what());
-                std::this_thread::sleep_for(std::chrono::seconds(1));
-                ++retry;
+            if (!connection->zeroCopyPinned.empty()) {
+                // No loop left to reap completions: reset the connection, so
+                // the kernel drops what it would resend from the buffers.
+                abortConnection(connection->fd);
+                connection->zeroCopyPinned.clear();
+            }
+            if (epollFd != -1 && connection->slot == -1) {
+                epoll_ctl(epollFd, EPOLL_CTL_DEL, connection->fd, nullptr);
             }
+            ::close(connection->fd);
         }
+        connection->fd = -1;
+        connection->transferCv.notify_all();
+#ifdef SOCKET_LIB_HAS_IO_URING
+        if (connection->slot != -1) {
+            // Requests in flight hold their own reference to the file.
+            if (usingUring) {
+                uring->setFile(connection->slot, -1);
+            }
+            std::lock_guard<std::mutex> slotLock(connectionsMutex);
+            freeSlots.push_back(connection->slot);
+            connection->slot = -1;
+        }
+#endif
+    }
+    ConnectionId expected = id;
+    if (clientConnection.compare_exchange_strong(expected, 0)) {
+        clientSocket = -1;
     }
+    notifyConnectionEvent(id, ConnectionEvent::DISCONNECTED);
+}
 
-    if(retry > maxRetries && maxRetries != INFINITERETRIES) {
-        throw std::runtime_error("Max number of reconnection attempts reached.");
+void LinuxTCPSocket::reapClosed(ConnectionId id, bool expired) {
+    std::shared_ptr<Connection> closed;
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        auto it = retired.find(id);
+        if (it == retired.end()) {
+            return;
+        }
+        closed = it->second;
+    }
+    {
+        std::lock_guard<std::mutex> lock(closed->writeMutex);
+        if (closed->lingerFd == -1) {
+            return;
+        }
+        reapZeroCopy(*closed);
+        if (!closed->zeroCopyPinned.empty()) {
+            if (!expired) {
+                return;
+            }
+            spdlog::warn("{0} zero-copy sends to {1} still incomplete, resetting the connection; LinuxTCPSocket::reapClosed()", closed->zeroCopyPinned.size(), closed->peer);
+            abortConnection(closed->lingerFd);
+            closed->zeroCopyPinned.clear();
+        }
+        if (epollFd != -1) {
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, closed->lingerFd, nullptr);
+        }
+        ::close(closed->lingerFd);
+        closed->lingerFd = -1;
+    }
+    {
+        std::lock_guard<std::mutex> lock(timersMutex);
+        timers.cancel(closed->livenessTimer);
     }
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    retired.erase(id);
 }
 
-bool LinuxTCPSocket::isConnected() {
-    int error = 0;
-    socklen_t len = sizeof(error);
-    int retval = getsockopt(clientSocket, SOL_SOCKET, SO_ERROR, &error, &len);
+void LinuxTCPSocket::abortConnection(int fd) {
+    linger abort{};
+    abort.l_onoff = 1;
+    abort.l_linger = 0;
+    setsockopt(fd, SOL_SOCKET, SO_LINGER, &abort, sizeof(abort));
+}
 
-    return (retval == 0 && error == 0);
+void LinuxTCPSocket::disconnect(ConnectionId connection) {
+    closeConnection(connection);
+}
+
+std::vector<ConnectionInfo> LinuxTCPSocket::getConnections() {
+    std::vector<std::shared_ptr<Connection>> open;
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        for (auto& entry : connections) {
+            open.push_back(entry.second);
+        }
+    }
+    std::vector<ConnectionInfo> list;
+    for (auto& connection : open) {
+        ConnectionInfo info;
+        info.id = connection->id;
+        info.peer = connection->peer;
+        info.bytesIn = connection->bytesIn;
+        info.bytesOut = connection->bytesOut;
+        info.queuedBytes = connection->queuedBytes;
+        info.heartbeatRtt = std::chrono::microseconds(connection->heartbeatRttMicros.load());
+        tcp_info tcpInfo{};
+        socklen_t len = sizeof(tcpInfo);
+        std::lock_guard<std::mutex> lock(connection->writeMutex);
+        if (connection->fd != -1 && getsockopt(connection->fd, IPPROTO_TCP, TCP_INFO, &tcpInfo, &len) == 0) {
+            info.rtt = std::chrono::microseconds(tcpInfo.tcpi_rtt);
+            info.rttVariance = std::chrono::microseconds(tcpInfo.tcpi_rttvar);
+        }
+        list.push_back(info);
+    }
+    return list;
+}
+
+void LinuxTCPSocket::applyLiveness(int fd, const LivenessConfig& config) {
+    int keepAlive = config.keepAlive ? 1 : 0;
+    bool applied = setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &keepAlive, sizeof(keepAlive)) == 0;
+    if (config.keepAlive) {
+        int idle = static_cast<int>(std::max<int64_t>(1, config.keepIdle.count()));
+        int interval = static_cast<int>(std::max<int64_t>(1, config.keepInterval.count()));
+        int count = std::max(1, config.keepCount);
+        applied = applied && setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle)) == 0;
+        applied = applied && setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval)) == 0;
+        applied = applied && setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count)) == 0;
+    }
+    unsigned userTimeout = static_cast<unsigned>(std::max<int64_t>(0, config.userTimeout.count()));
+    applied = applied && setsockopt(fd, IPPROTO_TCP, TCP_USER_TIMEOUT, &userTimeout, sizeof(userTimeout)) == 0;
+    if (!applied) {
+        spdlog::warn("Error setting keepalive options: {0}; LinuxTCPSocket::applyLiveness()", strerror(errno));
+    }
+}
+
+void LinuxTCPSocket::setLiveness(const LivenessConfig& config) {
+    if (config.heartbeatInterval.count() > 0 && config.heartbeatPayload.empty()) {
+        spdlog::warn("Heartbeat interval set without a payload, no heartbeat is sent; LinuxTCPSocket::setLiveness()");
+    }
+    {
+        std::lock_guard<std::mutex> lock(livenessMutex);
+        liveness = config;
+    }
+    armTimer(livenessSweep, std::chrono::steady_clock::now(), kLivenessTimer);
+    std::vector<std::shared_ptr<Connection>> targets;
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        for (auto& entry : connections) {
+            targets.push_back(entry.second);
+        }
+    }
+    for (auto& connection : targets) {
+        std::lock_guard<std::mutex> lock(connection->writeMutex);
+        if (connection->fd != -1) {
+            applyLiveness(connection->fd, config);
+        }
+    }
+    if (loopRunning) {
+        wakeLoop();
+    }
+}
+
+void LinuxTCPSocket::noteReceive(Connection& connection) {
+    connection.lastReceive = std::chrono::steady_clock::now();
+    if (connection.heartbeatOutstanding) {
+        connection.heartbeatOutstanding = false;
+        connection.heartbeatRttMicros = std::chrono::duration_cast<std::chrono::microseconds>(connection.lastReceive - connection.heartbeatSent).count();
+    }
+}
+
+void LinuxTCPSocket::armLiveness(Connection& connection, const LivenessConfig& config) {
+    auto due = std::chrono::steady_clock::time_point::max();
+    if (config.heartbeatInterval.count() > 0 && !config.heartbeatPayload.empty()) {
+        due = connection.heartbeatDue;
+    }
+    if (config.heartbeatTimeout.count() > 0) {
+        // Receives do not touch the timer; when it fires on a connection that
+        // heard from its peer since, it is simply moved on.
+        due = std::min(due, connection.lastReceive + config.heartbeatTimeout);
+    }
+    armTimer(connection.livenessTimer, due, (connection.id << kTimerBits) | kLivenessTimer);
+}
+
+bool LinuxTCPSocket::checkLiveness(Connection& connection, const LivenessConfig& config, std::chrono::steady_clock::time_point now) {
+    if (config.heartbeatTimeout.count() > 0 && connection.lastReceive + config.heartbeatTimeout <= now) {
+        return false;
+    }
+    if (config.heartbeatInterval.count() > 0 && !config.heartbeatPayload.empty() && connection.heartbeatDue <= now) {
+        // An unanswered heartbeat keeps its time, so the round trip covers
+        // the whole wait.
+        if (!connection.heartbeatOutstanding) {
+            connection.heartbeatOutstanding = true;
+            connection.heartbeatSent = now;
+        }
+        connection.heartbeatDue = now + config.heartbeatInterval;
+        if (enqueue(connection, config.heartbeatPayload)) {
+            flushConnection(connection);
+        }
+    }
+    armLiveness(connection, config);
+    return true;
+}
+
+void LinuxTCPSocket::setSendQueue(const SendQueueConfig& config) {
+    std::lock_guard<std::mutex> lock(sendQueueMutex);
+    sendQueueConfig = config;
+}
+
+void LinuxTCPSocket::setReadQueue(bool enabled) {
+    bool resume = false;
+    {
+        std::lock_guard<std::mutex> lock(inboxMutex);
+        readQueue = enabled;
+        if (!enabled) {
+            inbox.clear();
+            resume = !pausedReceives.empty();
+        }
+    }
+    if (resume) {
+        resumePending = true;
+        wakeLoop();
+    }
+}
+
+void LinuxTCPSocket::setBackpressureCallback(BackpressureCallback callback) {
+    std::lock_guard<std::mutex> lock(sendQueueMutex);
+    backpressureCallback = std::move(callback);
+}
+
+void LinuxTCPSocket::signalBackpressure(ConnectionId id, bool paused) {
+    BackpressureCallback callback;
+    {
+        std::lock_guard<std::mutex> lock(sendQueueMutex);
+        callback = backpressureCallback;
+    }
+    spdlog::debug("Connection {0} send queue {1}", id, paused ? "above high watermark" : "drained");
+    if (callback) {
+        callback(id, paused);
+    }
+}
+
+void LinuxTCPSocket::armWrite(Connection& connection, bool arm) {
+    if (connection.writeArmed == arm || epollFd == -1 || usingUring) {
+        return;
+    }
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLRDHUP | EPOLLET | (arm ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    event.data.u64 = connection.id;
+    if (epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event) == 0) {
+        connection.writeArmed = arm;
+    }
+}
+
+bool LinuxTCPSocket::drainLocked(Connection& connection) {
+    ZeroCopyConfig zeroCopy;
+    if (connection.zeroCopy) {
+        std::lock_guard<std::mutex> lock(zeroCopyMutex);
+        zeroCopy = zeroCopyConfig;
+    }
+    bool copyOnly = !zeroCopy.enabled;
+    while (sendable(connection)) {
+        // A large message goes out alone with MSG_ZEROCOPY; copied batches
+        // stop short of the next one.
+        bool useZeroCopy = !copyOnly && connection.sendQueue.front().size() - connection.sendOffset >= zeroCopy.threshold;
+        iovec iov[kMaxIov];
+        size_t count = 0;
+        size_t limit = connection.transferring ? std::min<uint64_t>(kMaxIov, connection.transferBarrier - connection.poppedBuffers) : kMaxIov;
+        for (auto it = connection.sendQueue.begin(); it != connection.sendQueue.end() && count < limit; ++it, ++count) {
+            if (count > 0 && (useZeroCopy || (!copyOnly && it->size() >= zeroCopy.threshold))) {
+                break;
+            }
+            size_t skip = count == 0 ? connection.sendOffset : 0;
+            iov[count].iov_base = it->data() + skip;
+            iov[count].iov_len = it->size() - skip;
+        }
+        // sendmsg() is writev() with flags; MSG_NOSIGNAL turns SIGPIPE into EPIPE.
+        msghdr message{};
+        message.msg_iov = iov;
+        message.msg_iovlen = count;
+        int flags = MSG_NOSIGNAL;
+#ifdef SOCKET_LIB_HAS_ZEROCOPY
+        if (useZeroCopy) {
+            flags |= MSG_ZEROCOPY;
+        }
+#endif
+        ssize_t bytesSent = sendmsg(connection.fd, &message, flags);
+        if (bytesSent == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (useZeroCopy && errno == ENOBUFS) {
+                // Over the optmem limit for pinned pages; copy meanwhile.
+                copyOnly = true;
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true;
+            }
+            spdlog::error("Error sending data to {0}: {1}; LinuxTCPSocket::drainLocked()", connection.peer, strerror(errno));
+            return false;
+        }
+        if (connection.zeroCopy) {
+            std::lock_guard<std::mutex> lock(zeroCopyMutex);
+            (useZeroCopy ? zeroCopyStats.zeroCopySends : zeroCopyStats.copiedSends) += 1;
+            (useZeroCopy ? zeroCopyStats.zeroCopyBytes : zeroCopyStats.copiedBytes) += bytesSent;
+        }
+        if (useZeroCopy) {
+            connection.frontZeroCopy = connection.zeroCopyNext++;
+        }
+        consumeSent(connection, static_cast<size_t>(bytesSent));
+    }
+    return true;
+}
+
+void LinuxTCPSocket::enableZeroCopy(Connection& connection) {
+#ifdef SOCKET_LIB_HAS_ZEROCOPY
+    if (connection.zeroCopy || connection.fd == -1) {
+        return;
+    }
+    int enable = 1;
+    if (setsockopt(connection.fd, SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(enable)) == 0) {
+        connection.zeroCopy = true;
+    } else {
+        spdlog::warn("SO_ZEROCOPY not supported, sends to {0} copy: {1}; LinuxTCPSocket::enableZeroCopy()", connection.peer, strerror(errno));
+    }
+#else
+    (void)connection;
+#endif
+}
+
+void LinuxTCPSocket::reapZeroCopy(Connection& connection) {
+#ifdef SOCKET_LIB_HAS_ZEROCOPY
+    if (!connection.zeroCopy) {
+        return;
+    }
+    uint64_t completed = 0;
+    uint64_t copied = 0;
+    int fd = connection.fd != -1 ? connection.fd : connection.lingerFd;
+    while (fd != -1) {
+        char control[128];
+        msghdr message{};
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        if (recvmsg(fd, &message, MSG_ERRQUEUE) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break; // EAGAIN: nothing left.
+        }
+        for (cmsghdr* header = CMSG_FIRSTHDR(&message); header != nullptr; header = CMSG_NXTHDR(&message, header)) {
+            // Connections accepted by the dual-stack listener are IPv6
+            // sockets, even when the peer is IPv4.
+            bool ipv4 = header->cmsg_level == SOL_IP && header->cmsg_type == IP_RECVERR;
+            bool ipv6 = header->cmsg_level == SOL_IPV6 && header->cmsg_type == IPV6_RECVERR;
+            if (!ipv4 && !ipv6) {
+                continue;
+            }
+            sock_extended_err error;
+            memcpy(&error, CMSG_DATA(header), sizeof(error));
+            if (error.ee_origin != SO_EE_ORIGIN_ZEROCOPY || error.ee_errno != 0) {
+                continue;
+            }
+            // Sends ee_info to ee_data are done; TCP reports them in order.
+            uint32_t sends = error.ee_data - error.ee_info + 1;
+            completed += sends;
+            if (error.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                copied += sends;
+            }
+            while (!connection.zeroCopyPinned.empty() && static_cast<int32_t>(connection.zeroCopyPinned.front().first - error.ee_data) <= 0) {
+                connection.zeroCopyPinned.pop_front();
+            }
+        }
+    }
+    if (completed > 0) {
+        std::lock_guard<std::mutex> lock(zeroCopyMutex);
+        zeroCopyStats.completions += completed;
+        zeroCopyStats.kernelCopied += copied;
+    }
+#else
+    (void)connection;
+#endif
+}
+
+void LinuxTCPSocket::setZeroCopy(const ZeroCopyConfig& config) {
+    {
+        std::lock_guard<std::mutex> lock(zeroCopyMutex);
+        zeroCopyConfig = config;
+    }
+    if (!config.enabled || usingUring) {
+        return;
+    }
+    std::vector<std::shared_ptr<Connection>> targets;
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        for (auto& entry : connections) {
+            targets.push_back(entry.second);
+        }
+    }
+    for (auto& connection : targets) {
+        std::lock_guard<std::mutex> lock(connection->writeMutex);
+        enableZeroCopy(*connection);
+    }
+}
+
+ZeroCopyStats LinuxTCPSocket::getZeroCopyStats() {
+    std::vector<std::shared_ptr<Connection>> targets;
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        for (auto& entry : connections) {
+            targets.push_back(entry.second);
+        }
+        for (auto& entry : retired) {
+            targets.push_back(entry.second);
+        }
+    }
+    size_t pinned = 0;
+    for (auto& connection : targets) {
+        std::lock_guard<std::mutex> lock(connection->writeMutex);
+        pinned += connection->zeroCopyPinned.size();
+    }
+    std::lock_guard<std::mutex> lock(zeroCopyMutex);
+    ZeroCopyStats stats = zeroCopyStats;
+    stats.pinnedBuffers = pinned;
+    return stats;
+}
+
+void LinuxTCPSocket::consumeSent(Connection& connection, size_t bytes) {
+    connection.bytesOut += bytes;
+    connection.queuedBytes -= std::min<size_t>(bytes, connection.queuedBytes);
+    while (bytes > 0) {
+        size_t left = connection.sendQueue.front().size() - connection.sendOffset;
+        if (bytes < left) {
+            connection.sendOffset += bytes;
+            return;
+        }
+        bytes -= left;
+        if (connection.frontZeroCopy >= 0) {
+            // The kernel may still read it until the send is reported done.
+            connection.zeroCopyPinned.emplace_back(static_cast<uint32_t>(connection.frontZeroCopy), std::move(connection.sendQueue.front()));
+            connection.frontZeroCopy = -1;
+        }
+        connection.sendQueue.pop_front();
+        connection.sendOffset = 0;
+        if (++connection.poppedBuffers == connection.transferBarrier && connection.transferring) {
+            connection.transferCv.notify_all();
+        }
+    }
+}
+
+bool LinuxTCPSocket::enqueue(Connection& connection, std::vector<uint8_t> data) {
+    pacer.acquire(data.size());
+    size_t highWatermark;
+    WriteModeConfig batching;
+    {
+        std::lock_guard<std::mutex> lock(sendQueueMutex);
+        highWatermark = sendQueueConfig.highWatermark;
+        batching = writeMode;
+    }
+    bool throughput = batching.mode == WriteMode::THROUGHPUT_CORK || batching.mode == WriteMode::THROUGHPUT_COALESCE;
+
+    bool sent;
+    bool pausedNow = false;
+    bool scheduleFlush = false;
+    {
+        std::lock_guard<std::mutex> lock(connection.writeMutex);
+        if (connection.fd == -1) {
+            return false;
+        }
+        if (data.empty()) {
+            return true;
+        }
+        connection.queuedBytes += data.size();
+        connection.sendQueue.push_back(std::move(data));
+        ++connection.pushedBuffers;
+        bool hold = !connection.writeArmed && batching.mode == WriteMode::THROUGHPUT_COALESCE && connection.queuedBytes < batching.maxBatchBytes;
+        // While EPOLLOUT is armed the socket was full; the loop sends next.
+        if (usingUring) {
+            if (!hold) {
+                scheduleSend(connection);
+            }
+            sent = true;
+        } else {
+            sent = connection.writeArmed || hold || drainLocked(connection);
+        }
+        if (throughput && !connection.flushPending) {
+            connection.flushPending = true;
+            scheduleFlush = true;
+        }
+        if (sent) {
+            armWrite(connection, !hold && sendable(connection));
+            if (!connection.paused && connection.queuedBytes > highWatermark) {
+                connection.paused = true;
+                pausedNow = true;
+            }
+        }
+    }
+    if (!sent) {
+        closeConnection(connection.id);
+        return false;
+    }
+    if (scheduleFlush && armTimer(connection.flushTimer, std::chrono::steady_clock::now() + batching.flushDeadline, (connection.id << kTimerBits) | kFlushTimer)) {
+        wakeLoop();
+    }
+    if (pausedNow) {
+        signalBackpressure(connection.id, true);
+    }
+    return true;
+}
+
+void LinuxTCPSocket::applyWriteMode(int fd, WriteMode mode) {
+    int noDelay = mode == WriteMode::LOW_LATENCY || mode == WriteMode::THROUGHPUT_COALESCE;
+    int cork = mode == WriteMode::THROUGHPUT_CORK;
+    // Clearing TCP_CORK pushes out whatever it was holding.
+    setsockopt(fd, IPPROTO_TCP, TCP_CORK, &cork, sizeof(cork));
+    if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay)) == -1) {
+        spdlog::warn("Error setting TCP_NODELAY: {0}; LinuxTCPSocket::applyWriteMode()", strerror(errno));
+    }
+}
+
+void LinuxTCPSocket::setWriteMode(const WriteModeConfig& config) {
+    {
+        std::lock_guard<std::mutex> lock(sendQueueMutex);
+        writeMode = config;
+    }
+    std::vector<std::shared_ptr<Connection>> targets;
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        for (auto& entry : connections) {
+            targets.push_back(entry.second);
+        }
+    }
+    for (auto& connection : targets) {
+        {
+            std::lock_guard<std::mutex> lock(connection->writeMutex);
+            if (connection->fd != -1) {
+                applyWriteMode(connection->fd, config.mode);
+            }
+        }
+        flush(connection->id);
+    }
+}
+
+bool LinuxTCPSocket::flushConnection(Connection& connection) {
+    WriteMode mode;
+    {
+        std::lock_guard<std::mutex> lock(sendQueueMutex);
+        mode = writeMode.mode;
+    }
+    std::lock_guard<std::mutex> lock(connection.writeMutex);
+    if (connection.fd == -1) {
+        return true;
+    }
+    connection.flushPending = false;
+    if (usingUring) {
+        scheduleSend(connection);
+    } else if (!connection.writeArmed) {
+        if (!drainLocked(connection)) {
+            return false;
+        }
+        armWrite(connection, sendable(connection));
+    }
+    if (mode == WriteMode::THROUGHPUT_CORK) {
+        int cork = 0;
+        setsockopt(connection.fd, IPPROTO_TCP, TCP_CORK, &cork, sizeof(cork));
+        cork = 1;
+        setsockopt(connection.fd, IPPROTO_TCP, TCP_CORK, &cork, sizeof(cork));
+    }
+    return true;
+}
+
+void LinuxTCPSocket::flush(ConnectionId id) {
+    std::shared_ptr<Connection> connection = findConnection(id);
+    if (connection && !flushConnection(*connection)) {
+        closeConnection(id);
+    }
+}
+
+void LinuxTCPSocket::flush() {
+    std::vector<ConnectionId> ids;
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        for (auto& entry : connections) {
+            ids.push_back(entry.first);
+        }
+    }
+    for (ConnectionId id : ids) {
+        flush(id);
+    }
+}
+
+void LinuxTCPSocket::runTimers() {
+    auto now = std::chrono::steady_clock::now();
+    expiredTimers.clear();
+    {
+        std::lock_guard<std::mutex> lock(timersMutex);
+        timers.advance(now, expiredTimers);
+    }
+    if (expiredTimers.empty()) {
+        return;
+    }
+    LivenessConfig config;
+    {
+        std::lock_guard<std::mutex> lock(livenessMutex);
+        config = liveness;
+    }
+    std::vector<ConnectionId> silent;
+    for (uint64_t token : expiredTimers) {
+        ConnectionId id = token >> kTimerBits;
+        switch (token & ((1u << kTimerBits) - 1)) {
+        case kLingerTimer:
+            reapClosed(id, true);
+            break;
+        case kFlushTimer:
+            flush(id);
+            break;
+        case kLivenessTimer: {
+            std::vector<std::shared_ptr<Connection>> targets;
+            if (id == 0) {
+                std::lock_guard<std::mutex> lock(connectionsMutex);
+                for (auto& entry : connections) {
+                    targets.push_back(entry.second);
+                }
+            } else if (std::shared_ptr<Connection> connection = findConnection(id)) {
+                targets.push_back(connection);
+            }
+            for (auto& connection : targets) {
+                if (!checkLiveness(*connection, config, now)) {
+                    silent.push_back(connection->id);
+                }
+            }
+            break;
+        }
+        default:
+            // Connect deadlines only wake the loop for driveConnect().
+            break;
+        }
+    }
+    for (ConnectionId id : silent) {
+        spdlog::warn("Nothing received on connection {0} for {1} ms, closing it; LinuxTCPSocket::runTimers()", id, config.heartbeatTimeout.count());
+        closeConnection(id);
+    }
+}
+
+bool LinuxTCPSocket::flushQueue(Connection& connection) {
+    size_t lowWatermark;
+    {
+        std::lock_guard<std::mutex> lock(sendQueueMutex);
+        lowWatermark = sendQueueConfig.lowWatermark;
+    }
+
+    bool resumed = false;
+    {
+        std::lock_guard<std::mutex> lock(connection.writeMutex);
+        if (connection.fd == -1) {
+            return true;
+        }
+        if (!drainLocked(connection)) {
+            return false;
+        }
+        armWrite(connection, sendable(connection));
+        if (connection.paused && connection.queuedBytes <= lowWatermark) {
+            connection.paused = false;
+            resumed = true;
+        }
+    }
+    if (resumed) {
+        signalBackpressure(connection.id, false);
+    }
+    return true;
+}
+
+bool LinuxTCPSocket::sendable(const Connection& connection) {
+    return !connection.sendQueue.empty() && !(connection.transferring && connection.poppedBuffers == connection.transferBarrier);
+}
+
+ConnectionId LinuxTCPSocket::clientTarget(const char* where) {
+    if (actualMode == mode::SERVER) {
+        spdlog::error("No single peer in SERVER mode, use the ...To() variant; LinuxTCPSocket::{0}()", where);
+        return 0;
+    }
+    return clientConnection;
+}
+
+TransferResult LinuxTCPSocket::sendFile(int fd, off_t offset, size_t length, TransferProgress progress) {
+    return transfer(clientTarget("sendFile"), fd, offset, length, false, progress);
+}
+
+TransferResult LinuxTCPSocket::sendFileTo(ConnectionId connection, int fd, off_t offset, size_t length, TransferProgress progress) {
+    return transfer(connection, fd, offset, length, false, progress);
+}
+
+TransferResult LinuxTCPSocket::relay(int fd, size_t length, TransferProgress progress) {
+    return transfer(clientTarget("relay"), fd, 0, length, true, progress);
+}
+
+TransferResult LinuxTCPSocket::relayTo(ConnectionId connection, int fd, size_t length, TransferProgress progress) {
+    return transfer(connection, fd, 0, length, true, progress);
+}
+
+bool LinuxTCPSocket::beginTransfer(Connection& connection) {
+    bool failed = false;
+    {
+        std::unique_lock<std::mutex> lock(connection.writeMutex);
+        connection.transferring = true;
+        connection.transferBarrier = connection.pushedBuffers;
+        // Send what the write mode holds back, then wait until it is out.
+        if (usingUring) {
+            scheduleSend(connection);
+        } else if (!connection.writeArmed && connection.fd != -1) {
+            failed = !drainLocked(connection);
+            if (!failed) {
+                armWrite(connection, sendable(connection));
+            }
+        }
+        if (!failed) {
+            connection.transferCv.wait(lock, [&connection] {
+                return connection.fd == -1 || (connection.poppedBuffers == connection.transferBarrier && !connection.sendInFlight);
+            });
+            return connection.fd != -1;
+        }
+    }
+    closeConnection(connection.id);
+    return false;
+}
+
+void LinuxTCPSocket::endTransfer(Connection& connection) {
+    bool failed = false;
+    {
+        std::lock_guard<std::mutex> lock(connection.writeMutex);
+        connection.transferring = false;
+        if (connection.fd == -1) {
+            return;
+        }
+        // Writes made during the transfer go out now.
+        if (usingUring) {
+            scheduleSend(connection);
+        } else if (!connection.writeArmed) {
+            failed = !drainLocked(connection);
+            if (!failed) {
+                armWrite(connection, sendable(connection));
+            }
+        }
+    }
+    if (failed) {
+        closeConnection(connection.id);
+    }
+}
+
+TransferResult LinuxTCPSocket::transfer(ConnectionId id, int fd, off_t offset, size_t length, bool useSplice, const TransferProgress& progress) {
+    TransferResult result;
+    result.nextOffset = offset;
+    std::shared_ptr<Connection> connection = findConnection(id);
+    if (!connection) {
+        spdlog::error("Unknown connection {0}; LinuxTCPSocket::transfer()", id);
+        result.error = ENOTCONN;
+        return result;
+    }
+    std::lock_guard<std::mutex> transferLock(connection->transferMutex);
+    if (!beginTransfer(*connection)) {
+        result.error = ENOTCONN;
+        endTransfer(*connection);
+        return result;
+    }
+
+    // splice() needs a pipe on one side; other sources go through our own.
+    struct stat status{};
+    bool direct = !useSplice || (fstat(fd, &status) == 0 && S_ISFIFO(status.st_mode));
+    int pipeFds[2] = {-1, -1};
+    if (!direct) {
+        if (pipe2(pipeFds, O_NONBLOCK | O_CLOEXEC) == -1) {
+            result.error = errno;
+            spdlog::error("Error creating relay pipe: {0}; LinuxTCPSocket::transfer()", strerror(errno));
+            endTransfer(*connection);
+            return result;
+        }
+        fcntl(pipeFds[1], F_SETPIPE_SZ, static_cast<int>(kTransferChunk));
+    }
+
+    const uint64_t total = useSplice && length == SIZE_MAX ? 0 : length;
+    size_t remaining = length; // Not yet taken from the source.
+    size_t buffered = 0;       // In our pipe, not yet in the socket.
+    bool sourceEnded = false;
+    while (true) {
+        if (buffered == 0 && (sourceEnded || remaining == 0)) {
+            result.complete = remaining == 0 || useSplice;
+            break;
+        }
+        ssize_t moved;
+        int error;
+        int socketFd;
+        bool intoSocket = direct || buffered > 0;
+        if (intoSocket) {
+            std::lock_guard<std::mutex> lock(connection->writeMutex);
+            socketFd = connection->fd;
+            if (socketFd == -1) {
+                result.error = ENOTCONN;
+                break;
+            }
+            if (!useSplice) {
+                moved = sendfile(socketFd, fd, &result.nextOffset, std::min(remaining, kTransferChunk));
+            } else if (direct) {
+                moved = splice(fd, nullptr, socketFd, nullptr, std::min(remaining, kTransferChunk), SPLICE_F_MOVE | SPLICE_F_NONBLOCK | SPLICE_F_MORE);
+            } else {
+                moved = splice(pipeFds[0], nullptr, socketFd, nullptr, buffered, SPLICE_F_MOVE | SPLICE_F_NONBLOCK | SPLICE_F_MORE);
+            }
+            error = errno;
+            if (moved > 0) {
+                connection->bytesOut += moved;
+            }
+        } else {
+            socketFd = -1;
+            moved = splice(fd, nullptr, pipeFds[1], nullptr, std::min(remaining, kTransferChunk), SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            error = errno;
+        }
+
+        if (moved > 0) {
+            if (!intoSocket) {
+                buffered += moved;
+                remaining -= moved;
+                continue;
+            }
+            result.bytesSent += moved;
+            if (direct) {
+                remaining -= moved;
+            } else {
+                buffered -= moved;
+            }
+            // Only stop with our pipe empty, so no source data is lost.
+            if (buffered == 0 && progress && !progress(result.bytesSent, total)) {
+                break;
+            }
+            continue;
+        }
+        if (moved == 0) {
+            if (intoSocket && !direct) {
+                result.error = EIO;
+                break;
+            }
+            sourceEnded = true;
+            continue;
+        }
+        if (error == EINTR) {
+            continue;
+        }
+        if (error != EAGAIN && error != EWOULDBLOCK) {
+            result.error = error;
+            spdlog::error("Error sending to {0}: {1}; LinuxTCPSocket::transfer()", connection->peer, strerror(error));
+            break;
+        }
+        // A direct splice does not say which side would block.
+        pollfd wait{};
+        wait.fd = socketFd;
+        wait.events = POLLOUT;
+        if (!intoSocket || (useSplice && direct && poll(&wait, 1, 0) == 1)) {
+            wait.fd = fd;
+            wait.events = POLLIN;
+        }
+        poll(&wait, 1, kTransferPollMs);
+    }
+
+    if (!direct) {
+        ::close(pipeFds[0]);
+        ::close(pipeFds[1]);
+    }
+    endTransfer(*connection);
+    return result;
+}
+
+void LinuxTCPSocket::setIoBackend(IoBackend backend) {
+    ioBackend = backend;
+}
+
+IoBackend LinuxTCPSocket::getIoBackend() const {
+    return usingUring ? IoBackend::IO_URING : IoBackend::EPOLL;
+}
+
+void LinuxTCPSocket::scheduleSend(Connection& connection) {
+    if (connection.sendInFlight || connection.sendScheduled || !sendable(connection)) {
+        return;
+    }
+    connection.sendScheduled = true;
+    bool first;
+    {
+        std::lock_guard<std::mutex> lock(uringSendsMutex);
+        first = uringSends.empty();
+        uringSends.push_back(connection.id);
+    }
+    // Writes arriving before the loop runs join the same submission.
+    if (first) {
+        wakeLoop();
+    }
+}
+
+#ifdef SOCKET_LIB_HAS_IO_URING
+void LinuxTCPSocket::uringLoop() {
+    bool listenArmed = false;
+    uring->pollMultishot(epollFd, kOpPoll);
+    while (loopRunning) {
+        if (listening && !listenArmed) {
+            uring->acceptMultishot(serverSocket, kOpAccept);
+            listenArmed = true;
+        }
+        submitSends();
+
+        int timeoutMs = loopTimeout();
+        std::chrono::nanoseconds timeout = timeoutMs < 0 ? std::chrono::nanoseconds(-1) : std::chrono::milliseconds(timeoutMs);
+        if (!uring->submitAndWait(timeout)) {
+            spdlog::error("Error in io_uring_enter: {0}; LinuxTCPSocket::uringLoop()", strerror(errno));
+            break;
+        }
+        uring->completions([&](const io_uring_cqe& cqe) {
+            uint64_t op = cqe.user_data & ((1u << kOpBits) - 1);
+            ConnectionId id = cqe.user_data >> kOpBits;
+            bool more = cqe.flags & IORING_CQE_F_MORE;
+            if (op == kOpPoll) {
+                // Something on the epoll set: wake-ups, connects, timers.
+                dispatchEvents(0);
+                if (!more) {
+                    uring->pollMultishot(epollFd, kOpPoll);
+                }
+            } else if (op == kOpAccept) {
+                if (cqe.res >= 0) {
+                    sockaddr_storage clientAddr{};
+                    socklen_t clientAddrLen = sizeof(clientAddr);
+                    getpeername(cqe.res, reinterpret_cast<sockaddr*>(&clientAddr), &clientAddrLen);
+                    ConnectionId accepted = addConnection(cqe.res, peerName(clientAddr, clientAddrLen));
+                    if (accepted != 0) {
+                        spdlog::info("Client connected: {0} (connection {1})", peerName(clientAddr, clientAddrLen), accepted);
+                    }
+                } else if (cqe.res != -ECANCELED && cqe.res != -EINVAL) {
+                    spdlog::error("Error accepting connection: {0}; LinuxTCPSocket::uringLoop()", strerror(-cqe.res));
+                }
+                if (!more) {
+                    listenArmed = false;
+                }
+            } else if (op == kOpRecv) {
+                completeReceive(id, cqe.res, IoUring::bufferId(cqe), more);
+            } else if (op == kOpSend) {
+                completeSend(id, cqe.res);
+            }
+        });
+        resumeReceives();
+        driveConnect(false);
+        runTimers();
+    }
+}
+
+void LinuxTCPSocket::completeReceive(ConnectionId id, int result, int bufferId, bool more) {
+    std::shared_ptr<Connection> connection = findConnection(id);
+    if (result > 0 && bufferId >= 0) {
+        if (connection) {
+            connection->bytesIn += result;
+            noteReceive(*connection);
+            const uint8_t* data = uring->buffer(bufferId);
+            // Completions already under way when the receive was
+            // cancelled are still delivered.
+            if (!deliver(id, std::vector<uint8_t>(data, data + result)) && !connection->receivePaused) {
+                pauseReceive(*connection);
+            }
+        }
+        uring->recycle(bufferId);
+    }
+    if (!connection || result == -ECANCELED) {
+        // Paused; resumeReceives() arms a new receive.
+        return;
+    }
+    if (result == 0) {
+        spdlog::info("Connection {0} closed by peer {1}", id, connection->peer);
+        closeConnection(id);
+    } else if (result < 0 && result != -ENOBUFS) {
+        spdlog::error("Error receiving data: {0}; LinuxTCPSocket::completeReceive()", strerror(-result));
+        closeConnection(id);
+    } else if (!more && !connection->receivePaused) {
+        // Ran out of buffers or the kernel ended the multishot; re-arm.
+        std::lock_guard<std::mutex> lock(connection->writeMutex);
+        if (connection->slot != -1) {
+            uring->recvMultishot(connection->slot, id << kOpBits | kOpRecv);
+        }
+    }
+}
+
+void LinuxTCPSocket::submitSends() {
+    std::vector<ConnectionId> ids;
+    {
+        std::lock_guard<std::mutex> lock(uringSendsMutex);
+        ids.swap(uringSends);
+    }
+    for (ConnectionId id : ids) {
+        std::shared_ptr<Connection> connection = findConnection(id);
+        if (!connection) {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(connection->writeMutex);
+        connection->sendScheduled = false;
+        submitSendLocked(*connection);
+    }
+}
+
+void LinuxTCPSocket::submitSendLocked(Connection& connection) {
+    if (connection.fd == -1 || connection.sendInFlight || !sendable(connection)) {
+        return;
+    }
+    size_t count = 0;
+    size_t limit = connection.transferring ? std::min<uint64_t>(kMaxIov, connection.transferBarrier - connection.poppedBuffers) : kMaxIov;
+    for (auto it = connection.sendQueue.begin(); it != connection.sendQueue.end() && count < limit; ++it, ++count) {
+        size_t skip = count == 0 ? connection.sendOffset : 0;
+        connection.sendIov[count].iov_base = it->data() + skip;
+        connection.sendIov[count].iov_len = it->size() - skip;
+    }
+    connection.sendMessage = msghdr{};
+    connection.sendMessage.msg_iov = connection.sendIov;
+    connection.sendMessage.msg_iovlen = count;
+    uring->sendmsg(connection.slot, &connection.sendMessage, connection.id << kOpBits | kOpSend);
+    connection.sendInFlight = true;
+}
+
+void LinuxTCPSocket::completeSend(ConnectionId id, int result) {
+    std::shared_ptr<Connection> connection = findConnection(id);
+    if (!connection) {
+        std::shared_ptr<Connection> closed;
+        {
+            std::lock_guard<std::mutex> lock(connectionsMutex);
+            auto it = retired.find(id);
+            if (it == retired.end()) {
+                return;
+            }
+            closed = it->second;
+            retired.erase(it);
+        }
+        std::lock_guard<std::mutex> lock(closed->writeMutex);
+        closed->sendInFlight = false;
+        closed->sendQueue.clear();
+        return;
+    }
+
+    size_t lowWatermark;
+    {
+        std::lock_guard<std::mutex> lock(sendQueueMutex);
+        lowWatermark = sendQueueConfig.lowWatermark;
+    }
+    bool resumed = false;
+    {
+        std::lock_guard<std::mutex> lock(connection->writeMutex);
+        connection->sendInFlight = false;
+        connection->transferCv.notify_all();
+        if (result < 0) {
+            spdlog::error("Error sending data to {0}: {1}; LinuxTCPSocket::completeSend()", connection->peer, strerror(-result));
+        } else {
+            consumeSent(*connection, static_cast<size_t>(result));
+            // Short sends and data queued meanwhile go out straight away.
+            submitSendLocked(*connection);
+            if (connection->paused && connection->queuedBytes <= lowWatermark) {
+                connection->paused = false;
+                resumed = true;
+            }
+        }
+    }
+    if (result < 0) {
+        closeConnection(id);
+    } else if (resumed) {
+        signalBackpressure(id, false);
+    }
+}
+#else
+void LinuxTCPSocket::uringLoop() {}
+void LinuxTCPSocket::submitSends() {}
+void LinuxTCPSocket::submitSendLocked(Connection&) {}
+void LinuxTCPSocket::completeSend(ConnectionId, int) {}
+void LinuxTCPSocket::completeReceive(ConnectionId, int, int, bool) {}
+#endif
+
+bool LinuxTCPSocket::writeTo(ConnectionId id, const Serializable& serializableObj) {
+    std::shared_ptr<Connection> connection = findConnection(id);
+    if (!connection) {
+        spdlog::error("Unknown connection {0}; LinuxTCPSocket::writeTo()", id);
+        return false;
+    }
+    std::vector<uint8_t> serializedData = static_cast<const std::vector<uint8_t>>(serializableObj);
+    return enqueue(*connection, std::move(serializedData));
+}
+
+size_t LinuxTCPSocket::broadcast(const Serializable& serializableObj) {
+    const std::vector<uint8_t> serializedData = static_cast<const std::vector<uint8_t>>(serializableObj);
+    std::vector<std::shared_ptr<Connection>> targets;
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        for (auto& entry : connections) {
+            targets.push_back(entry.second);
+        }
+    }
+    size_t delivered = 0;
+    for (auto& connection : targets) {
+        if (enqueue(*connection, serializedData)) {
+            ++delivered;
+        }
+    }
+    return delivered;
+}
+
+void LinuxTCPSocket::write(Serializable serializableObj) {
+    if (actualMode == mode::SERVER) {
+        broadcast(serializableObj);
+        return;
+    }
+    if (!isConnected()) {
+        spdlog::error("Socket not connected; LinuxTCPSocket::write()");
+        return;
+    }
+    spdlog::debug("Sending data to {0}:{1}", remoteIp, remotePort);
+    if (!writeTo(clientConnection, serializableObj)) {
+        // The connection is gone; reconnect in the background with backoff.
+        spdlog::error("Error sending data, reconnecting; LinuxTCPSocket::write()");
+        openAsync();
+    }
+}
+
+Serializable LinuxTCPSocket::read() {
+    ConnectionId connection;
+    return read(connection);
+}
+
+Serializable LinuxTCPSocket::read(ConnectionId& connection) {
+    auto timeout = std::chrono::seconds(retryTimeout.tv_sec) + std::chrono::microseconds(retryTimeout.tv_usec);
+    return read(connection, std::chrono::steady_clock::now() + timeout);
+}
+
+Serializable LinuxTCPSocket::read(std::chrono::steady_clock::time_point deadline) {
+    ConnectionId connection;
+    return read(connection, deadline);
+}
+
+Serializable LinuxTCPSocket::tryRead() {
+    ConnectionId connection;
+    return tryRead(connection);
+}
+
+Serializable LinuxTCPSocket::tryRead(ConnectionId& connection) {
+    return read(connection, std::chrono::steady_clock::time_point::min());
+}
+
+void LinuxTCPSocket::cancel() {
+    {
+        std::lock_guard<std::mutex> lock(inboxMutex);
+        ++readGeneration;
+    }
+    inboxCv.notify_all();
+}
+
+Serializable LinuxTCPSocket::read(ConnectionId& connection, std::chrono::steady_clock::time_point deadline) {
+    spdlog::debug("Receiving data from {0}:{1}", remoteIp, remotePort);
+    std::unique_lock<std::mutex> lock(inboxMutex);
+    readCalled = true;
+    uint64_t generation = readGeneration;
+    auto ready = [&] { return !inbox.empty() || readGeneration != generation; };
+    if (deadline == std::chrono::steady_clock::time_point::max()) {
+        inboxCv.wait(lock, ready);
+    } else if (!inboxCv.wait_until(lock, deadline, ready)) {
+        // A tryRead() finding nothing is not worth an error.
+        if (deadline != std::chrono::steady_clock::time_point::min()) {
+            spdlog::error("Timeout while waiting for data; LinuxTCPSocket::read()", nullptr);
+        }
+        connection = 0;
+        return Serializable{}; // Return empty Serializable object
+    }
+    if (inbox.empty()) {
+        connection = 0;
+        return Serializable{}; // Cancelled
+    }
+    connection = inbox.front().first;
+    Serializable received(inbox.front().second);
+    inbox.pop_front();
+    // Hysteresis, so a paused connection is not woken for every chunk.
+    bool resume = !pausedReceives.empty() && !resumePending && inbox.size() <= kInboxCapacity / 2;
+    if (resume) {
+        resumePending = true;
+    }
+    lock.unlock();
+    if (resume) {
+        wakeLoop();
+    }
+    return received;
+}
+
+bool LinuxTCPSocket::isConnected() {
+    if (clientConnection == 0) {
+        return false;
+    }
+    int error = 0;
+    socklen_t len = sizeof(error);
+    int retval = getsockopt(clientSocket, SOL_SOCKET, SO_ERROR, &error, &len);
+
+    return (retval == 0 && error == 0);
+}
+
+bool LinuxTCPSocket::applyKernelPacing(const PacingConfig& config) {
+    bool kernel = config.enabled && config.mode != PacingMode::USER;
+    std::vector<int> fds;
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        for (auto& entry : connections) {
+            fds.push_back(entry.second->fd);
+        }
+    }
+    // TCP paces internally since Linux 4.13, whatever the qdisc. Connections
+    // opened later pick the rate up in addConnection().
+    for (int fd : fds) {
+        if (!setKernelPacingRate(fd, kernel ? config.rateBytesPerSecond : 0) && kernel) {
+            return false;
+        }
+    }
+    return kernel;
 }
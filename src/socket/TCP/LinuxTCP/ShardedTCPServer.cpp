@@ -0,0 +1,194 @@
+#include "socket/TCP/LinuxTCP/ShardedTCPServer.h"
+#include <spdlog/spdlog.h>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+const size_t kInboxCapacity = 1024;
+
+} // namespace
+
+void ShardedTCPServer::Forwarder::update(Serializable updateData, ConnectionId connection) {
+    Shard& state = *server.shards[shard];
+    std::vector<uint8_t> data = static_cast<std::vector<uint8_t>>(updateData);
+    ++state.messagesIn;
+    state.bytesIn += data.size();
+    ConnectionId id = server.globalId(shard, connection);
+    {
+        std::unique_lock<std::mutex> lock(server.inboxMutex);
+        // Holding the shard's loop stops reading its connections until
+        // read() makes room.
+        server.roomCv.wait(lock, [this] {
+            return !server.readQueue || server.closing || server.inbox.size() < kInboxCapacity;
+        });
+        if (server.readQueue && !server.closing) {
+            server.inbox.emplace_back(id, std::move(data));
+        }
+    }
+    server.inboxCv.notify_one();
+    server.notify(updateData, id);
+}
+
+void ShardedTCPServer::Forwarder::onConnectionEvent(ConnectionId connection, ConnectionEvent event) {
+    Shard& state = *server.shards[shard];
+    if (event == ConnectionEvent::CONNECTED) {
+        ++state.accepted;
+        ++state.active;
+    } else {
+        --state.active;
+    }
+    server.notifyConnectionEvent(server.globalId(shard, connection), event);
+}
+
+ShardedTCPServer::ShardedTCPServer(int localPort, const ShardConfig& config, unsigned readTimeout) : readTimeout(readTimeout) {
+    unsigned count = config.shards;
+    if (count == 0) {
+        count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    bool steer = config.steerByCpu;
+    for (unsigned i = 0; i < count; ++i) {
+        int cpu = i < config.cpus.size() ? config.cpus[i] : (config.cpus.empty() ? static_cast<int>(i) : -1);
+        if (cpu != static_cast<int>(i)) {
+            steer = false;
+        }
+        std::unique_ptr<Shard> shard(new Shard());
+        shard->cpu = cpu;
+        shard->socket.reset(new LinuxTCPSocket("0.0.0.0", localPort, 0, TCPSocket::SERVER, 0, readTimeout));
+        shard->socket->setIoBackend(config.ioBackend);
+        shard->socket->setLoopAffinity(cpu);
+        shard->socket->setReadQueue(false);
+        shards.push_back(std::move(shard));
+    }
+    if (config.steerByCpu && !steer) {
+        spdlog::warn("CPU steering needs shard i on CPU i, hashing instead; ShardedTCPServer::ShardedTCPServer()");
+    }
+    for (unsigned i = 0; i < shards.size(); ++i) {
+        shards[i]->socket->setReusePort(true, steer);
+        shards[i]->socket->addSubscriber(std::make_shared<Forwarder>(*this, i));
+    }
+}
+
+ShardedTCPServer::~ShardedTCPServer() {
+    close();
+}
+
+ConnectionId ShardedTCPServer::globalId(unsigned shard, ConnectionId local) const {
+    return local * shards.size() + shard;
+}
+
+ShardedTCPServer::Shard* ShardedTCPServer::shardOf(ConnectionId global, ConnectionId& local) {
+    local = global / shards.size();
+    return shards[global % shards.size()].get();
+}
+
+void ShardedTCPServer::open() {
+    {
+        std::lock_guard<std::mutex> lock(inboxMutex);
+        closing = false;
+    }
+    // Shards join the SO_REUSEPORT group in order, which CPU steering
+    // relies on to map CPU i to shard i.
+    for (auto& shard : shards) {
+        shard->socket->open();
+    }
+    spdlog::info("Serving with {0} shards", shards.size());
+}
+
+void ShardedTCPServer::close() {
+    {
+        std::lock_guard<std::mutex> lock(inboxMutex);
+        closing = true;
+    }
+    roomCv.notify_all();
+    for (auto& shard : shards) {
+        shard->socket->close();
+    }
+}
+
+Serializable ShardedTCPServer::read() {
+    ConnectionId connection;
+    return read(connection);
+}
+
+Serializable ShardedTCPServer::read(ConnectionId& connection) {
+    std::unique_lock<std::mutex> lock(inboxMutex);
+    if (!inboxCv.wait_for(lock, std::chrono::seconds(readTimeout), [this] { return !inbox.empty(); })) {
+        spdlog::error("Timeout while waiting for data; ShardedTCPServer::read()", nullptr);
+        connection = 0;
+        return Serializable{};
+    }
+    connection = inbox.front().first;
+    Serializable received(inbox.front().second);
+    inbox.pop_front();
+    lock.unlock();
+    roomCv.notify_one();
+    return received;
+}
+
+void ShardedTCPServer::setReadQueue(bool enabled) {
+    {
+        std::lock_guard<std::mutex> lock(inboxMutex);
+        readQueue = enabled;
+        if (!enabled) {
+            inbox.clear();
+        }
+    }
+    roomCv.notify_all();
+}
+
+void ShardedTCPServer::write(Serializable serializableObj) {
+    broadcast(serializableObj);
+}
+
+bool ShardedTCPServer::writeTo(ConnectionId connection, const Serializable& serializableObj) {
+    ConnectionId local;
+    Shard* shard = shardOf(connection, local);
+    if (!shard->socket->writeTo(local, serializableObj)) {
+        return false;
+    }
+    shard->bytesOut += static_cast<std::vector<uint8_t>>(serializableObj).size();
+    return true;
+}
+
+size_t ShardedTCPServer::broadcast(const Serializable& serializableObj) {
+    size_t size = static_cast<std::vector<uint8_t>>(serializableObj).size();
+    size_t sent = 0;
+    for (auto& shard : shards) {
+        size_t reached = shard->socket->broadcast(serializableObj);
+        shard->bytesOut += reached * size;
+        sent += reached;
+    }
+    return sent;
+}
+
+void ShardedTCPServer::disconnect(ConnectionId connection) {
+    ConnectionId local;
+    shardOf(connection, local)->socket->disconnect(local);
+}
+
+std::vector<ConnectionInfo> ShardedTCPServer::getConnections() {
+    std::vector<ConnectionInfo> all;
+    for (unsigned i = 0; i < shards.size(); ++i) {
+        for (ConnectionInfo& info : shards[i]->socket->getConnections()) {
+            info.id = globalId(i, info.id);
+            all.push_back(std::move(info));
+        }
+    }
+    return all;
+}
+
+std::vector<ShardStats> ShardedTCPServer::getShardStats() {
+    std::vector<ShardStats> list;
+    for (auto& shard : shards) {
+        ShardStats stats;
+        stats.cpu = shard->cpu;
+        stats.accepted = shard->accepted;
+        stats.active = shard->active;
+        stats.messagesIn = shard->messagesIn;
+        stats.bytesIn = shard->bytesIn;
+        stats.bytesOut = shard->bytesOut;
+        list.push_back(stats);
+    }
+    return list;
+}
@@ -0,0 +1,304 @@
+#include "socket/TCP/LinuxTCP/TCPConnectionPool.h"
+#include <spdlog/spdlog.h>
+#include <utility>
+
+namespace {
+
+/**
+* @brief Marks a pooled connection dead when its socket reports it closed.
+*/
+class LivenessWatch : public Subscriber {
+public:
+    explicit LivenessWatch(std::shared_ptr<std::atomic<bool>> alive) : alive(std::move(alive)) {}
+
+    void update(Serializable) override {}
+
+    void onConnectionEvent(ConnectionId, ConnectionEvent event) override {
+        if (event == ConnectionEvent::DISCONNECTED) {
+            *alive = false;
+        }
+    }
+
+private:
+    std::shared_ptr<std::atomic<bool>> alive;
+};
+
+std::string endpointKey(const std::string& ip, int port) {
+    return ip + ":" + std::to_string(port);
+}
+
+} // namespace
+
+TCPConnectionPool::Handle::Handle(TCPConnectionPool* pool, Endpoint* endpoint, std::unique_ptr<Member> member)
+    : pool(pool), endpoint(endpoint), member(std::move(member)) {}
+
+TCPConnectionPool::Handle::Handle(Handle&& other) noexcept
+    : pool(other.pool), endpoint(other.endpoint), member(std::move(other.member)) {}
+
+TCPConnectionPool::Handle& TCPConnectionPool::Handle::operator=(Handle&& other) noexcept {
+    if (this != &other) {
+        release();
+        pool = other.pool;
+        endpoint = other.endpoint;
+        member = std::move(other.member);
+    }
+    return *this;
+}
+
+TCPConnectionPool::Handle::~Handle() {
+    release();
+}
+
+LinuxTCPSocket* TCPConnectionPool::Handle::operator->() const {
+    return member->socket.get();
+}
+
+LinuxTCPSocket& TCPConnectionPool::Handle::operator*() const {
+    return *member->socket;
+}
+
+void TCPConnectionPool::Handle::release() {
+    if (member) {
+        pool->giveBack(endpoint, std::move(member), true);
+    }
+}
+
+void TCPConnectionPool::Handle::discard() {
+    if (member) {
+        pool->giveBack(endpoint, std::move(member), false);
+    }
+}
+
+TCPConnectionPool::TCPConnectionPool(const TCPPoolConfig& config) : config(config) {
+    if (this->config.maxPerEndpoint == 0) {
+        spdlog::warn("maxPerEndpoint 0 raised to 1; TCPConnectionPool::TCPConnectionPool()");
+        this->config.maxPerEndpoint = 1;
+    }
+    if (this->config.minIdle > this->config.maxPerEndpoint) {
+        this->config.minIdle = this->config.maxPerEndpoint;
+    }
+    maintenanceThread = std::thread(&TCPConnectionPool::maintain, this);
+}
+
+TCPConnectionPool::~TCPConnectionPool() {
+    close();
+}
+
+TCPConnectionPool::Endpoint& TCPConnectionPool::endpointLocked(const std::string& ip, int port) {
+    std::unique_ptr<Endpoint>& endpoint = endpoints[endpointKey(ip, port)];
+    if (!endpoint) {
+        endpoint.reset(new Endpoint());
+        endpoint->ip = ip;
+        endpoint->port = port;
+    }
+    return *endpoint;
+}
+
+std::unique_ptr<TCPConnectionPool::Member> TCPConnectionPool::connect(const Endpoint& endpoint) {
+    std::unique_ptr<Member> member(new Member());
+    member->socket.reset(new LinuxTCPSocket(endpoint.ip, 0, endpoint.port, TCPSocket::CLIENT, config.maxRetries, config.retryTimeout));
+    member->socket->setIoBackend(config.ioBackend);
+    member->socket->setWriteMode(config.writeMode);
+    member->alive = std::make_shared<std::atomic<bool>>(true);
+    member->watch = std::make_shared<LivenessWatch>(member->alive);
+    member->socket->addSubscriber(member->watch);
+    if (!member->socket->openAsync().get()) {
+        spdlog::error("Could not open a pooled connection to {0}:{1}; TCPConnectionPool::connect()", endpoint.ip, endpoint.port);
+        return nullptr;
+    }
+    return member;
+}
+
+size_t TCPConnectionPool::warm(const std::string& ip, int port) {
+    Endpoint* endpoint;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        if (closed) {
+            return 0;
+        }
+        endpoint = &endpointLocked(ip, port);
+    }
+    refill(*endpoint);
+    std::lock_guard<std::mutex> lock(poolMutex);
+    return endpoint->idle.size();
+}
+
+TCPConnectionPool::Handle TCPConnectionPool::acquire(const std::string& ip, int port) {
+    // Declared before the lock so dead sockets are closed after it is released.
+    std::vector<std::unique_ptr<Member>> dead;
+    std::unique_lock<std::mutex> lock(poolMutex);
+    if (closed) {
+        spdlog::error("Pool is closed; TCPConnectionPool::acquire()");
+        return Handle();
+    }
+    Endpoint& endpoint = endpointLocked(ip, port);
+    auto deadline = std::chrono::steady_clock::now() + config.acquireTimeout;
+    while (true) {
+        while (!endpoint.idle.empty()) {
+            std::unique_ptr<Member> member = std::move(endpoint.idle.back());
+            endpoint.idle.pop_back();
+            if (*member->alive) {
+                ++endpoint.inUse;
+                ++stats.reused;
+                return Handle(this, &endpoint, std::move(member));
+            }
+            ++stats.unhealthy;
+            dead.push_back(std::move(member));
+        }
+        if (endpoint.inUse + endpoint.connecting < config.maxPerEndpoint) {
+            ++endpoint.connecting;
+            lock.unlock();
+            std::unique_ptr<Member> member = connect(endpoint);
+            lock.lock();
+            --endpoint.connecting;
+            if (!member) {
+                ++stats.failed;
+                released.notify_all();
+                return Handle();
+            }
+            ++stats.created;
+            ++endpoint.inUse;
+            return Handle(this, &endpoint, std::move(member));
+        }
+        bool timedOut = released.wait_until(lock, deadline) == std::cv_status::timeout;
+        if (closed) {
+            return Handle();
+        }
+        if (timedOut && endpoint.idle.empty() && endpoint.inUse + endpoint.connecting >= config.maxPerEndpoint) {
+            ++stats.timeouts;
+            spdlog::error("No connection to {0}:{1} within the acquire timeout; TCPConnectionPool::acquire()", ip, port);
+            return Handle();
+        }
+    }
+}
+
+void TCPConnectionPool::giveBack(Endpoint* endpoint, std::unique_ptr<Member> member, bool reuse) {
+    std::unique_ptr<Member> dead;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        --endpoint->inUse;
+        if (reuse && !*member->alive) {
+            ++stats.unhealthy;
+        }
+        if (reuse && !closed && *member->alive) {
+            member->idleSince = std::chrono::steady_clock::now();
+            endpoint->idle.push_back(std::move(member));
+        } else {
+            dead = std::move(member);
+        }
+    }
+    released.notify_all();
+}
+
+void TCPConnectionPool::refill(Endpoint& endpoint) {
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(poolMutex);
+            size_t ready = endpoint.idle.size() + endpoint.connecting;
+            size_t total = ready + endpoint.inUse;
+            if (closed || ready >= config.minIdle || total >= config.maxPerEndpoint) {
+                return;
+            }
+            ++endpoint.connecting;
+        }
+        std::unique_ptr<Member> member = connect(endpoint);
+        {
+            std::lock_guard<std::mutex> lock(poolMutex);
+            --endpoint.connecting;
+            if (!member) {
+                ++stats.failed;
+                return;
+            }
+            ++stats.created;
+            if (!closed) {
+                member->idleSince = std::chrono::steady_clock::now();
+                endpoint.idle.push_back(std::move(member));
+            }
+        }
+        if (member) {
+            return; // Closed meanwhile; the socket closes with member.
+        }
+        released.notify_all();
+    }
+}
+
+void TCPConnectionPool::maintain() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(maintenanceMutex);
+            if (maintenanceCv.wait_for(lock, config.healthInterval, [this] { return stopping; })) {
+                return;
+            }
+        }
+        std::vector<std::unique_ptr<Member>> dead;
+        std::vector<Endpoint*> below;
+        {
+            std::lock_guard<std::mutex> lock(poolMutex);
+            auto now = std::chrono::steady_clock::now();
+            for (auto& entry : endpoints) {
+                auto& idle = entry.second->idle;
+                // Oldest first, so expiry stops at the first young connection.
+                size_t kept = 0;
+                size_t remaining = idle.size();
+                for (size_t i = 0; i < idle.size(); ++i) {
+                    bool alive = *idle[i]->alive;
+                    bool expired = remaining > config.minIdle && now - idle[i]->idleSince > config.idleTimeout;
+                    if (!alive || expired) {
+                        ++(alive ? stats.expired : stats.unhealthy);
+                        --remaining;
+                        dead.push_back(std::move(idle[i]));
+                    } else {
+                        idle[kept++] = std::move(idle[i]);
+                    }
+                }
+                idle.resize(kept);
+                if (idle.size() + entry.second->connecting < config.minIdle) {
+                    below.push_back(entry.second.get());
+                }
+            }
+        }
+        dead.clear();
+        for (Endpoint* endpoint : below) {
+            {
+                std::lock_guard<std::mutex> lock(maintenanceMutex);
+                if (stopping) {
+                    return;
+                }
+            }
+            refill(*endpoint);
+        }
+    }
+}
+
+TCPPoolStats TCPConnectionPool::getStats() {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    TCPPoolStats snapshot = stats;
+    for (auto& entry : endpoints) {
+        snapshot.idle += entry.second->idle.size();
+        snapshot.inUse += entry.second->inUse;
+    }
+    return snapshot;
+}
+
+void TCPConnectionPool::close() {
+    {
+        std::lock_guard<std::mutex> lock(maintenanceMutex);
+        stopping = true;
+    }
+    maintenanceCv.notify_all();
+    if (maintenanceThread.joinable()) {
+        maintenanceThread.join();
+    }
+    std::vector<std::unique_ptr<Member>> dead;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        closed = true;
+        for (auto& entry : endpoints) {
+            for (auto& member : entry.second->idle) {
+                dead.push_back(std::move(member));
+            }
+            entry.second->idle.clear();
+        }
+    }
+    released.notify_all();
+}
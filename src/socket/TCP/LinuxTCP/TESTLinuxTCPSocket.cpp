@@ -39,8 +39,6 @@ void TestSocket::TearDown() {
     delete socket2;
     socket1 = nullptr;
     socket2 = nullptr;
-    
-    std::this_thread::sleep_for(std::chrono::milliseconds(500)); // Esperando medio segundo
 }
 
 int main(int argc, char **argv) {
@@ -142,10 +142,10 @@ void WindowsTCPSocket::close() {
 }
 
 void WindowsTCPSocket::write(Serializable serializableObj) {
-    auto now = std::chrono::system_clock::now();
+    auto now = std::chrono::steady_clock::now();
     unsigned retry = 1;
     do {
-        auto elapsedMilliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - now).count();
+        auto elapsedMilliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - now).count();
         if (elapsedMilliseconds > (retryTimeout.tv_sec * 1000 + retryTimeout.tv_usec / 1000)) { // Convertir segundos y microsegundos a milisegundos
             spdlog::error("Timeout while sending data. Stop sending data; WindowsTCPSocket::write()", nullptr);
             return;
@@ -183,10 +183,10 @@ void WindowsTCPSocket::write(Serializable serializableObj) {
 }
 
 Serializable WindowsTCPSocket::read() {
-    auto now = std::chrono::system_clock::now();
+    auto now = std::chrono::steady_clock::now();
     unsigned retry = 1;
     do {
-        auto elapsedMilliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - now).count();
+        auto elapsedMilliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - now).count();
         if (elapsedMilliseconds > (retryTimeout.tv_sec * 1000 + retryTimeout.tv_usec / 1000)) {
             spdlog::error("Timeout while receiving data. Stop receiving data; WindowsTCPSocket::read()", nullptr);
             return Serializable(); // Return an empty Serializable object
@@ -0,0 +1,194 @@
+#include "socket/TimerWheel.h"
+
+#include <algorithm>
+
+namespace {
+
+// Slot lists: wheel 0 has 256 slots of one tick, wheels 1 to 3 have 64
+// slots of 2^8, 2^14 and 2^20 ticks. List kOverflow holds timers beyond
+// 2^26 ticks.
+const int kShift[5] = {0, 8, 14, 20, 26};
+const uint32_t kFirstSlot[4] = {0, 256, 320, 384};
+const uint32_t kOverflow = 448;
+
+int lowestBit(uint64_t bits) { return __builtin_ctzll(bits); }
+
+// Bits above position in a 64-bit slot mask.
+uint64_t above(uint64_t position) {
+  return position == 63 ? 0 : ~0ull << (position + 1);
+}
+
+}  // namespace
+
+const uint32_t TimerWheel::kNone;
+
+TimerWheel::TimerWheel(Clock::duration tick)
+    : origin(Clock::now()),
+      tick(tick.count() > 0 ? tick : Clock::duration(1)),
+      heads(kOverflow + 1, kNone) {}
+
+uint64_t TimerWheel::tickOf(Clock::time_point due) const {
+  Clock::duration elapsed = due - origin;
+  if (elapsed.count() <= 0) return 0;
+  // Rounded up, so a timer never fires before its deadline.
+  return static_cast<uint64_t>((elapsed.count() + tick.count() - 1) /
+                               tick.count());
+}
+
+TimerId TimerWheel::schedule(Clock::time_point due, uint64_t token) {
+  if (due == Clock::time_point::max()) return 0;
+  uint32_t index;
+  if (freeNodes.empty()) {
+    index = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+  } else {
+    index = freeNodes.back();
+    freeNodes.pop_back();
+  }
+  Node &node = nodes[index];
+  // Already due: the next tick processed.
+  node.expires = std::max(tickOf(due), current + 1);
+  node.token = token;
+  place(index);
+  ++pending;
+  return (static_cast<uint64_t>(node.generation) << 32) | index;
+}
+
+bool TimerWheel::cancel(TimerId timer) {
+  uint32_t index = static_cast<uint32_t>(timer);
+  uint32_t generation = static_cast<uint32_t>(timer >> 32);
+  if (timer == 0 || index >= nodes.size() ||
+      nodes[index].generation != generation || nodes[index].list == kNone) {
+    return false;
+  }
+  unlink(index);
+  release(index);
+  return true;
+}
+
+void TimerWheel::place(uint32_t index) {
+  // The finest wheel whose coarser digits match the current tick's: the
+  // slot is then ahead of the current one within the same rotation.
+  uint64_t expires = nodes[index].expires;
+  for (int level = 0; level < 4; ++level) {
+    if ((expires >> kShift[level + 1]) == (current >> kShift[level + 1])) {
+      uint64_t mask = level == 0 ? 255 : 63;
+      link(index, kFirstSlot[level] +
+                      static_cast<uint32_t>((expires >> kShift[level]) & mask));
+      return;
+    }
+  }
+  link(index, kOverflow);
+}
+
+void TimerWheel::link(uint32_t index, uint32_t list) {
+  Node &node = nodes[index];
+  node.list = list;
+  node.previous = kNone;
+  node.next = heads[list];
+  if (node.next != kNone) nodes[node.next].previous = index;
+  heads[list] = index;
+  if (list != kOverflow) occupied[list >> 6] |= 1ull << (list & 63);
+}
+
+void TimerWheel::unlink(uint32_t index) {
+  Node &node = nodes[index];
+  if (node.previous != kNone) {
+    nodes[node.previous].next = node.next;
+  } else {
+    heads[node.list] = node.next;
+  }
+  if (node.next != kNone) nodes[node.next].previous = node.previous;
+  if (heads[node.list] == kNone && node.list != kOverflow) {
+    occupied[node.list >> 6] &= ~(1ull << (node.list & 63));
+  }
+}
+
+void TimerWheel::release(uint32_t index) {
+  Node &node = nodes[index];
+  node.list = kNone;
+  if (++node.generation == 0) node.generation = 1;
+  freeNodes.push_back(index);
+  --pending;
+}
+
+uint64_t TimerWheel::nextTick() const {
+  uint64_t best = UINT64_MAX;
+  uint64_t slot = current & 255;
+  for (uint64_t word = slot >> 6; word < 4; ++word) {
+    uint64_t bits = occupied[word];
+    if (word == slot >> 6) bits &= above(slot & 63);
+    if (bits != 0) {
+      return (current & ~255ull) | (word * 64 + lowestBit(bits));
+    }
+  }
+  for (int level = 1; level < 4; ++level) {
+    uint64_t bits = occupied[3 + level] &
+                    above((current >> kShift[level]) & 63);
+    if (bits == 0) continue;
+    uint64_t rotation = current >> kShift[level + 1] << kShift[level + 1];
+    best = std::min(best, rotation | (static_cast<uint64_t>(lowestBit(bits))
+                                      << kShift[level]));
+  }
+  if (heads[kOverflow] != kNone) {
+    best = std::min(best, ((current >> kShift[4]) + 1) << kShift[4]);
+  }
+  return best;
+}
+
+void TimerWheel::processTick(std::vector<uint64_t> &expired) {
+  // Coarsest first, so a timer can move down several levels in one tick.
+  uint32_t lists[4];
+  int count = 0;
+  if ((current & ((1ull << kShift[4]) - 1)) == 0) lists[count++] = kOverflow;
+  for (int level = 3; level >= 1; --level) {
+    if ((current & ((1ull << kShift[level]) - 1)) == 0) {
+      lists[count++] =
+          kFirstSlot[level] +
+          static_cast<uint32_t>((current >> kShift[level]) & 63);
+    }
+  }
+  for (int i = 0; i < count; ++i) {
+    uint32_t index = heads[lists[i]];
+    heads[lists[i]] = kNone;
+    if (lists[i] != kOverflow) {
+      occupied[lists[i] >> 6] &= ~(1ull << (lists[i] & 63));
+    }
+    while (index != kNone) {
+      uint32_t next = nodes[index].next;
+      place(index);
+      index = next;
+    }
+  }
+
+  uint32_t list = static_cast<uint32_t>(current & 255);
+  uint32_t index = heads[list];
+  heads[list] = kNone;
+  occupied[list >> 6] &= ~(1ull << (list & 63));
+  while (index != kNone) {
+    uint32_t next = nodes[index].next;
+    expired.push_back(nodes[index].token);
+    release(index);
+    index = next;
+  }
+}
+
+void TimerWheel::advance(Clock::time_point now,
+                         std::vector<uint64_t> &expired) {
+  // Only ticks that are fully over.
+  Clock::duration elapsed = now - origin;
+  uint64_t target =
+      elapsed.count() <= 0 ? 0 : static_cast<uint64_t>(elapsed / tick);
+  // Jumps straight to the ticks with work, however long the gap.
+  for (uint64_t next = nextTick(); next <= target; next = nextTick()) {
+    current = next;
+    processTick(expired);
+  }
+  if (target > current) current = target;
+}
+
+TimerWheel::Clock::time_point TimerWheel::nextExpiry() const {
+  uint64_t next = nextTick();
+  if (next == UINT64_MAX) return Clock::time_point::max();
+  return origin + tick * static_cast<Clock::rep>(next);
+}
@@ -0,0 +1,89 @@
+#include "socket/UDP/UDPCoalescer.h"
+
+namespace {
+
+const uint8_t kMagic = 0xC0;
+
+size_t varintSize(size_t value) {
+  size_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    ++size;
+  }
+  return size;
+}
+
+void putVarint(std::vector<uint8_t> &out, size_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+}  // namespace
+
+UDPCoalescer::UDPCoalescer(const CoalescingConfig &config)
+    : config(config), limit(config.maxDatagramSize) {
+  open.reserve(limit);
+}
+
+void UDPCoalescer::setLimit(size_t size) { limit = size; }
+
+std::vector<std::vector<uint8_t>> UDPCoalescer::add(
+    const std::vector<uint8_t> &message,
+    std::chrono::steady_clock::time_point now) {
+  std::vector<std::vector<uint8_t>> ready;
+  size_t frameSize = varintSize(message.size()) + message.size();
+
+  if (!open.empty() && open.size() + frameSize > limit) {
+    ready.push_back(flush());
+  }
+  if (open.empty()) {
+    open.push_back(kMagic);
+    opened = now;
+  }
+  putVarint(open, message.size());
+  open.insert(open.end(), message.begin(), message.end());
+
+  // Oversized messages travel alone; a datagram with no room left goes now.
+  if (open.size() + 2 > limit) ready.push_back(flush());
+  return ready;
+}
+
+std::vector<uint8_t> UDPCoalescer::flush() {
+  std::vector<uint8_t> datagram;
+  datagram.swap(open);
+  open.reserve(limit);
+  return datagram;
+}
+
+std::chrono::steady_clock::time_point UDPCoalescer::deadline() const {
+  if (open.empty()) return std::chrono::steady_clock::time_point::max();
+  return opened + config.flushDeadline;
+}
+
+bool UDPCoalescer::unpack(const std::vector<uint8_t> &datagram,
+                          std::deque<std::vector<uint8_t>> &output) {
+  if (datagram.empty() || datagram[0] != kMagic) {
+    output.push_back(datagram);
+    return true;
+  }
+  size_t pos = 1;
+  while (pos < datagram.size()) {
+    size_t length = 0;
+    unsigned shift = 0;
+    while (true) {
+      if (pos >= datagram.size() || shift > 28) return false;
+      uint8_t byte = datagram[pos++];
+      length |= static_cast<size_t>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) break;
+      shift += 7;
+    }
+    if (length > datagram.size() - pos) return false;
+    output.emplace_back(datagram.begin() + pos,
+                        datagram.begin() + pos + length);
+    pos += length;
+  }
+  return true;
+}
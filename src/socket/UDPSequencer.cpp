@@ -0,0 +1,193 @@
+#include "socket/UDP/UDPSequencer.h"
+
+namespace {
+
+// Datagram layout: [0] magic, [1..4] big endian sequence number, payload.
+const uint8_t kMagic = 0x5E;
+const size_t kHeaderSize = 5;
+const size_t kLostHistory = 64;
+
+}  // namespace
+
+UDPSequencer::UDPSequencer(const SequencerConfig &config) : config(config) {
+  if (this->config.reorderWindow == 0) this->config.reorderWindow = 1;
+  if (this->config.maxPeers == 0) this->config.maxPeers = 1;
+}
+
+size_t UDPSequencer::overhead() { return kHeaderSize; }
+
+std::vector<uint8_t> UDPSequencer::stamp(const std::vector<uint8_t> &payload) {
+  std::vector<uint8_t> datagram;
+  datagram.reserve(kHeaderSize + payload.size());
+  uint32_t sequence = nextSequence++;
+  datagram.push_back(kMagic);
+  datagram.push_back(static_cast<uint8_t>(sequence >> 24));
+  datagram.push_back(static_cast<uint8_t>(sequence >> 16));
+  datagram.push_back(static_cast<uint8_t>(sequence >> 8));
+  datagram.push_back(static_cast<uint8_t>(sequence));
+  datagram.insert(datagram.end(), payload.begin(), payload.end());
+  return datagram;
+}
+
+void UDPSequencer::receive(const std::string &peerKey,
+                           const std::string &peerName,
+                           const std::vector<uint8_t> &datagram,
+                           std::chrono::steady_clock::time_point now,
+                           std::deque<std::vector<uint8_t>> &output,
+                           std::vector<SequenceGap> &gaps) {
+  if (datagram.size() < kHeaderSize || datagram[0] != kMagic) {
+    // Unsequenced sender, pass through untouched.
+    output.push_back(datagram);
+    return;
+  }
+  uint32_t sequence = (static_cast<uint32_t>(datagram[1]) << 24) |
+                      (static_cast<uint32_t>(datagram[2]) << 16) |
+                      (static_cast<uint32_t>(datagram[3]) << 8) | datagram[4];
+  std::vector<uint8_t> payload(datagram.begin() + kHeaderSize, datagram.end());
+
+  auto it = peers.find(peerKey);
+  if (it == peers.end()) {
+    if (peers.size() >= config.maxPeers) forgetOldest(output, gaps);
+    Peer fresh;
+    fresh.name = peerName;
+    fresh.expected = sequence;
+    it = peers.emplace(peerKey, std::move(fresh)).first;
+  } else if (now - it->second.lastSeen >= config.peerIdleTimeout &&
+             sequence != static_cast<uint32_t>(it->second.expected)) {
+    restart(it->second, sequence, output, gaps);
+  }
+  Peer &peer = it->second;
+  peer.lastSeen = now;
+
+  int32_t distance =
+      static_cast<int32_t>(sequence - static_cast<uint32_t>(peer.expected));
+  if (distance < 0) {
+    uint64_t extended = peer.expected + static_cast<int64_t>(distance);
+    for (auto &range : peer.lost) {
+      if (extended >= range.first && extended < range.first + range.second) {
+        ++counters.late;
+        return;
+      }
+    }
+    // Duplicates trail closely; anything further back is a sender that
+    // started over.
+    if (-static_cast<int64_t>(distance) <=
+        static_cast<int64_t>(config.reorderWindow)) {
+      ++counters.duplicates;
+      return;
+    }
+    restart(peer, sequence, output, gaps);
+    distance = 0;
+  }
+
+  uint64_t extended = peer.expected + static_cast<uint64_t>(distance);
+  if (distance == 0) {
+    output.push_back(std::move(payload));
+    ++counters.delivered;
+    ++peer.expected;
+    drain(peer, output);
+    return;
+  }
+
+  if (peer.held.count(extended) != 0) {
+    ++counters.duplicates;
+    return;
+  }
+  // Only beyond everything seen does it uncover sequence numbers not
+  // already known to be missing.
+  uint64_t seen = peer.held.empty() ? peer.expected
+                                    : peer.held.rbegin()->first + 1;
+  if (extended > seen) {
+    gaps.push_back(SequenceGap{peer.name, static_cast<uint32_t>(seen),
+                               static_cast<uint32_t>(extended - seen),
+                               GapEvent::DETECTED});
+  }
+  peer.held[extended] = Held{std::move(payload), now};
+  ++counters.reordered;
+
+  // A full buffer, or a datagram too far ahead to ever fit, gives up on the
+  // oldest hole immediately.
+  while (!peer.held.empty() &&
+         (peer.held.size() > config.reorderWindow ||
+          peer.held.rbegin()->first - peer.expected >= config.reorderWindow)) {
+    releaseGap(peer, output, gaps);
+  }
+}
+
+void UDPSequencer::expire(std::chrono::steady_clock::time_point now,
+                          std::deque<std::vector<uint8_t>> &output,
+                          std::vector<SequenceGap> &gaps) {
+  for (auto it = peers.begin(); it != peers.end();) {
+    Peer &peer = it->second;
+    while (!peer.held.empty() &&
+           now - peer.held.begin()->second.arrival >= config.reorderTimeout) {
+      releaseGap(peer, output, gaps);
+    }
+    if (peer.held.empty() && now - peer.lastSeen >= config.peerIdleTimeout) {
+      it = peers.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+std::chrono::steady_clock::time_point UDPSequencer::nextDeadline() const {
+  auto deadline = std::chrono::steady_clock::time_point::max();
+  for (auto &entry : peers) {
+    const Peer &peer = entry.second;
+    if (peer.held.empty()) continue;
+    auto candidate = peer.held.begin()->second.arrival + config.reorderTimeout;
+    if (candidate < deadline) deadline = candidate;
+  }
+  return deadline;
+}
+
+void UDPSequencer::drain(Peer &peer, std::deque<std::vector<uint8_t>> &output) {
+  auto it = peer.held.begin();
+  while (it != peer.held.end() && it->first == peer.expected) {
+    output.push_back(std::move(it->second.payload));
+    ++counters.delivered;
+    ++peer.expected;
+    it = peer.held.erase(it);
+  }
+}
+
+void UDPSequencer::restart(Peer &peer, uint32_t sequence,
+                           std::deque<std::vector<uint8_t>> &output,
+                           std::vector<SequenceGap> &gaps) {
+  // What the old sequence left behind is delivered first.
+  while (!peer.held.empty()) releaseGap(peer, output, gaps);
+  peer.lost.clear();
+  peer.expected = sequence;
+  ++counters.restarts;
+}
+
+void UDPSequencer::forgetOldest(std::deque<std::vector<uint8_t>> &output,
+                                std::vector<SequenceGap> &gaps) {
+  auto oldest = peers.begin();
+  for (auto it = peers.begin(); it != peers.end(); ++it) {
+    if (it->second.lastSeen < oldest->second.lastSeen) oldest = it;
+  }
+  while (!oldest->second.held.empty()) {
+    releaseGap(oldest->second, output, gaps);
+  }
+  peers.erase(oldest);
+}
+
+void UDPSequencer::releaseGap(Peer &peer,
+                              std::deque<std::vector<uint8_t>> &output,
+                              std::vector<SequenceGap> &gaps) {
+  uint64_t next = peer.held.begin()->first;
+  uint64_t missing = next - peer.expected;
+  if (missing > 0) {
+    gaps.push_back(SequenceGap{peer.name, static_cast<uint32_t>(peer.expected),
+                               static_cast<uint32_t>(missing),
+                               GapEvent::LOST});
+    peer.lost.push_back(std::make_pair(peer.expected, missing));
+    if (peer.lost.size() > kLostHistory) peer.lost.pop_front();
+    counters.lost += missing;
+    ++counters.gaps;
+    peer.expected = next;
+  }
+  drain(peer, output);
+}
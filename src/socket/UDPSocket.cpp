@@ -1,6 +1,9 @@
 #include "socket/UDP/UDPSocket.h"
 
+#include <algorithm>
+#include <cerrno>
 #include <chrono>
+#include <cstring>
 #include <iomanip>
 #include <sstream>
 
@@ -10,19 +13,63 @@
 #ifdef _WIN32
 #include <windows.h>
 #include <winsock2.h>
+#include <ws2tcpip.h>
 #pragma comment(lib, "ws2_32.lib")
 #else
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
 #define SOCKET int
 #define SOCKET_ERROR -1
 #define INVALID_SOCKET (SOCKET)(~0)
 
 #endif
 
+#ifdef SOCKET_LIB_HAS_IO_URING
+namespace {
+
+const unsigned kRecvEntries = 8;
+const unsigned kSendEntries = 64;
+const unsigned kRecvBuffers = 32;
+const uint64_t kRecvData = 1;  ///< user_data of the armed recvmsg.
+const uint64_t kWakeData = 2;  ///< user_data of the poll on the wake eventfd.
+// Every buffer holds the recvmsg header and the sender's address in front of
+// a datagram of up to 64 KB.
+const unsigned kRecvBufferSize =
+    65536 + sizeof(io_uring_recvmsg_out) + sizeof(sockaddr_storage);
+
+}  // namespace
+#endif
+
+namespace {
+
+void closeDescriptor(SOCKET fd) {
+#ifdef _WIN32
+  closesocket(fd);
+#else
+  ::close(fd);
+#endif
+}
+
+}  // namespace
+
+#ifndef __linux__
+namespace {
+
+// Without an eventfd to wake it, a waiting read() looks for cancel() this
+// often.
+const std::chrono::milliseconds kCancelPoll(100);
+
+}  // namespace
+#endif
+
 UDPSocket::UDPSocket() : UDPSocket("", 0, 0) {}
 
 UDPSocket::UDPSocket(const std::string &ip, int localPort, int remotePort)
@@ -35,51 +82,145 @@ UDPSocket::UDPSocket(const std::string &ip, int localPort, int remotePort)
   udpSocket = INVALID_SOCKET;
 #else
   udpSocket = -1;
+#endif
+#ifdef __linux__
+  wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wakeFd == -1) {
+    throw std::runtime_error("Error creating eventfd; UDPSocket::UDPSocket()");
+  }
 #endif
   // initialize logger
 }
 
 UDPSocket::~UDPSocket() {
+  stopFlushThread();
   close();
 
 #ifdef _WIN32
   WSACleanup();
 #endif
+#ifdef __linux__
+  ::close(wakeFd);
+#endif
 }
 
 void UDPSocket::open() {
-  std::lock_guard<std::mutex> lock(socketMutex);
-  udpSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  std::unique_lock<std::mutex> lock(socketMutex);
+  std::vector<Endpoint> remotes = Endpoint::resolve(ip, remotePort, SOCK_DGRAM);
+  remoteAddr = remotes.empty() ? Endpoint() : remotes.front();
+  if (!ip.empty() && !remoteAddr.valid()) {
+    spdlog::warn("Cannot resolve {0}, sending disabled; UDPSocket::open()",
+                 ip);
+  }
+  wireFamily = remoteAddr.family() == AF_INET6 ? AF_INET6 : AF_INET;
+  fitCoalescer();
+  int family =
+      dualStack || remoteAddr.family() == AF_INET6 ? AF_INET6 : AF_INET;
+  // Set up on the side: read() only looks at udpSocket under readMutex.
+  SOCKET fd = socket(family, SOCK_DGRAM, IPPROTO_UDP);
 
-  if (udpSocket == INVALID_SOCKET) {
+  if (fd == INVALID_SOCKET) {
     throw std::runtime_error("Socket creation failed; UDPSocket::open()");
   }
 
-  localAddr.sin_family = AF_INET;
-  localAddr.sin_addr.s_addr = INADDR_ANY;
-  localAddr.sin_port = htons(localPort);
+  if (family == AF_INET6) {
+    // IPv4 peers appear as mapped addresses, whatever the system default.
+    int v6Only = 0;
+    setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY,
+               reinterpret_cast<const char *>(&v6Only), sizeof(v6Only));
+    remoteAddr = remoteAddr.toV6Mapped();
+  }
+  localAddr = Endpoint::wildcard(family, localPort);
 
-  remoteAddr.sin_family = AF_INET;
-  remoteAddr.sin_addr.s_addr = inet_addr(ip.c_str());
-  remoteAddr.sin_port = htons(remotePort);
+  if (reuseAddress) {
+    int enable = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR,
+                   reinterpret_cast<const char *>(&enable),
+                   sizeof(enable)) == SOCKET_ERROR) {
+      closeDescriptor(fd);
+      throw std::runtime_error("Setting SO_REUSEADDR failed; UDPSocket::open()");
+    }
+  }
 
-  if (bind(udpSocket, (struct sockaddr *)&localAddr, sizeof(localAddr)) ==
-      SOCKET_ERROR) {
+  if (bind(fd, localAddr.address(), localAddr.length()) == SOCKET_ERROR) {
+    closeDescriptor(fd);
     throw std::runtime_error("Binding failed; UDPSocket::open()");
   }
+  {
+    std::lock_guard<std::mutex> readLock(readMutex);
+    udpSocket = fd;
+  }
+#ifdef SOCKET_LIB_HAS_IO_URING
+  {
+    std::lock_guard<std::mutex> readLock(readMutex);
+    recvRing.reset();
+    sendRing.reset();
+    recvArmed = false;
+    wakeArmed = false;
+    if (ioBackend != IoBackend::EPOLL && IoUring::supported()) {
+      try {
+        recvRing.reset(
+            new IoUring(kRecvEntries, 1, kRecvBuffers, kRecvBufferSize));
+        sendRing.reset(new IoUring(kSendEntries, 1, 0, 0));
+        if (!recvRing->setFile(0, udpSocket) ||
+            !sendRing->setFile(0, udpSocket)) {
+          throw std::runtime_error("registering the socket failed");
+        }
+        recvLayout = msghdr{};
+        recvLayout.msg_namelen = sizeof(sockaddr_storage);
+      } catch (const std::exception &e) {
+        spdlog::warn("io_uring setup failed ({0}), using select; "
+                     "UDPSocket::open()",
+                     e.what());
+        recvRing.reset();
+        sendRing.reset();
+      }
+    } else if (ioBackend == IoBackend::IO_URING) {
+      spdlog::warn("io_uring not supported by this kernel, using select; "
+                   "UDPSocket::open()");
+    }
+  }
+#endif
+  readsClosed = false;
   spdlog::info("Socket opened");
+  if (pacer.config().enabled) setPacing(pacer.config());
+  lock.unlock();
+  startAsyncWriter();
 }
 
 void UDPSocket::close() {
+  readsClosed = true;
+  cancel();
+  // The writer sends under socketMutex, so it stops first.
+  stopAsyncWriter(true);
   std::lock_guard<std::mutex> lock(socketMutex);
+  if (udpSocket != INVALID_SOCKET) {
+    sendPending(std::chrono::steady_clock::time_point::max());
+  }
 #ifdef _WIN32
   if (udpSocket != INVALID_SOCKET) {
     shutdown(udpSocket, SD_BOTH);
+    // A waiting read() notices the cancel within kCancelPoll.
+    std::lock_guard<std::mutex> readLock(readMutex);
     closesocket(udpSocket);
     udpSocket = INVALID_SOCKET;
   }
 #else
+#ifdef SOCKET_LIB_HAS_IO_URING
+  if (recvRing && udpSocket != -1) {
+    // The armed recvmsg holds its own reference to the socket and would
+    // keep the port bound. Cancelling it wakes a waiting read(); once that
+    // has left the ring the reference is gone.
+    recvRing->cancelSync(kRecvData);
+    std::lock_guard<std::mutex> readLock(readMutex);
+    recvRing->releaseFiles();
+    sendRing->releaseFiles();
+    recvArmed = false;
+  }
+#endif
   if (udpSocket != -1) {
+    // The cancelled read() leaves select() before the descriptor goes.
+    std::lock_guard<std::mutex> readLock(readMutex);
     ::close(udpSocket);
     udpSocket = -1;
   }
@@ -87,28 +228,187 @@ void UDPSocket::close() {
   spdlog::info("Socket closed");
 }
 
-void UDPSocket::write(Serializable serializableObj) {
-  std::lock_guard<std::mutex> lock(socketMutex);
-  std::vector<uint8_t> serializedData =
-      serializableObj.operator const std::vector<uint8_t>();
-  spdlog::debug("port:{0} sending data to {1}:{2}", localPort, ip, remotePort);
+bool UDPSocket::sendDatagram(const std::vector<uint8_t> &datagram) {
+  pacer.acquire(datagram.size());
   int bytesSent =
-      sendto(udpSocket, reinterpret_cast<const char *>(serializedData.data()),
-             serializedData.size(), 0, (struct sockaddr *)&remoteAddr,
-             sizeof(remoteAddr));
+      sendto(udpSocket, reinterpret_cast<const char *>(datagram.data()),
+             datagram.size(), 0, remoteAddr.address(), remoteAddr.length());
 #ifdef _WIN32
   if (bytesSent == SOCKET_ERROR) {
 #else
   if (bytesSent == -1) {
 #endif
     spdlog::error("Error sending data");
-    return;
+    return false;
   }
 
-  if (bytesSent != static_cast<int>(serializedData.size())) {
+  if (bytesSent != static_cast<int>(datagram.size())) {
     spdlog::error("Mismatch in sent data size");
+    return false;
+  }
+  return true;
+}
+
+bool UDPSocket::sendFrame(const std::vector<uint8_t> &frame) {
+  std::vector<std::vector<uint8_t>> datagrams;
+  encodeFrame(frame, datagrams);
+  return sendDatagrams(datagrams);
+}
+
+void UDPSocket::encodeFrame(const std::vector<uint8_t> &frame,
+                            std::vector<std::vector<uint8_t>> &datagrams) {
+  std::vector<uint8_t> datagram = sequencer ? sequencer->stamp(frame) : frame;
+  if (!fecEncoder) {
+    datagrams.push_back(std::move(datagram));
     return;
   }
+  for (auto &encoded : fecEncoder->encode(datagram)) {
+    datagrams.push_back(std::move(encoded));
+  }
+}
+
+bool UDPSocket::sendDatagrams(
+    const std::vector<std::vector<uint8_t>> &datagrams) {
+#ifdef SOCKET_LIB_HAS_IO_URING
+  // User-space pacing spaces the datagrams out one by one, so only unpaced
+  // or kernel-paced sockets batch.
+  if (sendRing && datagrams.size() > 1 &&
+      (!pacer.config().enabled || pacer.stats().kernelPacing)) {
+    return sendBatch(datagrams);
+  }
+#endif
+#ifdef __linux__
+  if (datagrams.size() > 1 &&
+      (!pacer.config().enabled || pacer.stats().kernelPacing)) {
+    return sendMany(datagrams);
+  }
+#endif
+  for (auto &datagram : datagrams) {
+    if (!sendDatagram(datagram)) return false;
+  }
+  return true;
+}
+
+#ifdef __linux__
+bool UDPSocket::sendMany(const std::vector<std::vector<uint8_t>> &datagrams) {
+  std::vector<iovec> iov(datagrams.size());
+  std::vector<mmsghdr> messages(datagrams.size());
+  for (size_t i = 0; i < datagrams.size(); ++i) {
+    iov[i].iov_base = const_cast<uint8_t *>(datagrams[i].data());
+    iov[i].iov_len = datagrams[i].size();
+    messages[i].msg_hdr.msg_name = const_cast<sockaddr *>(remoteAddr.address());
+    messages[i].msg_hdr.msg_namelen = remoteAddr.length();
+    messages[i].msg_hdr.msg_iov = &iov[i];
+    messages[i].msg_hdr.msg_iovlen = 1;
+  }
+  size_t done = 0;
+  while (done < messages.size()) {
+    unsigned count = static_cast<unsigned>(
+        std::min<size_t>(messages.size() - done, UIO_MAXIOV));
+    int sent = sendmmsg(udpSocket, &messages[done], count, 0);
+    if (sent == -1) {
+      if (errno == EINTR) continue;
+      spdlog::error("Error sending data: {0}; UDPSocket::sendMany()",
+                    strerror(errno));
+      return false;
+    }
+    for (int i = 0; i < sent; ++i) {
+      if (messages[done + i].msg_len != datagrams[done + i].size()) {
+        spdlog::error("Mismatch in sent data size");
+        return false;
+      }
+    }
+    done += sent;
+  }
+  return true;
+}
+#endif
+
+bool UDPSocket::writeBatch(std::vector<std::vector<uint8_t>> &messages) {
+  std::lock_guard<std::mutex> lock(socketMutex);
+  if (udpSocket == INVALID_SOCKET) {
+    spdlog::error("Socket is not open; UDPSocket::writeBatch()");
+    return false;
+  }
+  std::vector<std::vector<uint8_t>> datagrams;
+  auto due = nextFlush();
+  auto now = std::chrono::steady_clock::now();
+  for (auto &message : messages) {
+    if (coalescer) {
+      for (auto &frame : coalescer->add(message, now)) {
+        encodeFrame(frame, datagrams);
+      }
+    } else {
+      encodeFrame(message, datagrams);
+    }
+  }
+  if (!sendDatagrams(datagrams)) return false;
+  if (nextFlush() < due) flushCv.notify_one();
+  spdlog::debug("port:{0} sent {1} queued messages to {2}:{3}", localPort,
+                messages.size(), ip, remotePort);
+  return true;
+}
+
+#ifdef SOCKET_LIB_HAS_IO_URING
+bool UDPSocket::sendBatch(const std::vector<std::vector<uint8_t>> &datagrams) {
+  std::vector<iovec> iov(datagrams.size());
+  std::vector<msghdr> messages(datagrams.size());
+  for (size_t i = 0; i < datagrams.size(); ++i) {
+    iov[i].iov_base = const_cast<uint8_t *>(datagrams[i].data());
+    iov[i].iov_len = datagrams[i].size();
+    messages[i].msg_name = const_cast<sockaddr *>(remoteAddr.address());
+    messages[i].msg_namelen = remoteAddr.length();
+    messages[i].msg_iov = &iov[i];
+    messages[i].msg_iovlen = 1;
+    sendRing->sendmsg(0, &messages[i], i);
+  }
+
+  // The requests point into this frame, so every one must complete here.
+  size_t completed = 0;
+  bool sent = true;
+  while (completed < datagrams.size()) {
+    if (!sendRing->submitAndWait(std::chrono::nanoseconds(-1))) {
+      // Closing the ring cancels what is left; later writes use sendto().
+      spdlog::error("io_uring send failed: {0}; UDPSocket::write()",
+                    strerror(errno));
+      sendRing.reset();
+      return false;
+    }
+    completed += sendRing->completions([&](const io_uring_cqe &cqe) {
+      if (cqe.res < 0) {
+        spdlog::error("Error sending data");
+        sent = false;
+      } else if (cqe.res != static_cast<int>(datagrams[cqe.user_data].size())) {
+        spdlog::error("Mismatch in sent data size");
+        sent = false;
+      }
+    });
+  }
+  return sent;
+}
+#endif
+
+void UDPSocket::write(Serializable serializableObj) {
+  if (std::shared_ptr<AsyncWriter> writer = std::atomic_load(&asyncWriter)) {
+    writer->enqueue(serializableObj.operator const std::vector<uint8_t>());
+    return;
+  }
+  std::lock_guard<std::mutex> lock(socketMutex);
+  std::vector<uint8_t> serializedData =
+      serializableObj.operator const std::vector<uint8_t>();
+  spdlog::debug("port:{0} sending data to {1}:{2}", localPort, ip, remotePort);
+  auto due = nextFlush();
+  if (coalescer) {
+    std::vector<std::vector<uint8_t>> datagrams;
+    for (auto &frame :
+         coalescer->add(serializedData, std::chrono::steady_clock::now())) {
+      encodeFrame(frame, datagrams);
+    }
+    if (!sendDatagrams(datagrams)) return;
+  } else if (!sendFrame(serializedData)) {
+    return;
+  }
+  if (nextFlush() < due) flushCv.notify_one();
 
   spdlog::debug("Data sent to {0}:{1}", ip, remotePort);
   std::stringstream stream;
@@ -121,72 +421,643 @@ void UDPSocket::write(Serializable serializableObj) {
   spdlog::info("Data sent: " + stream.str());
 }
 
-Serializable UDPSocket::read() {
-  std::lock_guard<std::mutex> lock(socketMutex);
-  auto now = std::chrono::system_clock::now();
-  do {
-    try {
-      spdlog::debug("port:{0} waiting for data from {1}:{2}", localPort, ip,
-                    remotePort);
-      std::vector<unsigned char> buffer(1024);
-      int bytesRead = 0;
+Serializable UDPSocket::deliver(std::vector<uint8_t> payload) {
+  Serializable receivedData(payload);
+  notify(receivedData);
+  spdlog::debug("Data received {0} from {1}", ip, remotePort);
+  std::stringstream stream;
+  stream << std::hex << std::setfill('0');
+  for (uint8_t &byte : payload) {
+    stream << std::setw(2) << static_cast<int>(byte);
+    // add space between bytes
+    stream << " ";
+  }
+  spdlog::info("Data received: " + stream.str());
+  return receivedData;
+}
 
-      fd_set readSet;
-      FD_ZERO(&readSet);
-      FD_SET(udpSocket, &readSet);
+Serializable UDPSocket::read() {
+  std::chrono::steady_clock::duration timeout;
+  {
+    std::lock_guard<std::mutex> lock(readMutex);
+    timeout = readTimeout;
+  }
+  if (timeout == std::chrono::steady_clock::duration::max()) {
+    return read(std::chrono::steady_clock::time_point::max());
+  }
+  return read(std::chrono::steady_clock::now() + timeout);
+}
 
-      struct timeval timeout;
-      timeout.tv_sec = 1;
-      timeout.tv_usec = 0;
+Serializable UDPSocket::tryRead() {
+  return read(std::chrono::steady_clock::time_point::min());
+}
 
-      int ready = select(udpSocket + 1, &readSet, nullptr, nullptr, &timeout);
+Serializable UDPSocket::read(std::chrono::steady_clock::time_point deadline) {
+  // Taken before the lock, so a read queued behind another one is
+  // cancelled too.
+  uint64_t generation = readGeneration;
+  std::vector<uint8_t> payload;
+  bool received;
+  while (true) {
+    std::vector<SequenceGap> gaps;
+    std::function<void(const SequenceGap &)> onGap;
+    {
+      std::lock_guard<std::mutex> lock(readMutex);
+      received = receivePayload(payload, gaps, deadline, generation);
+      if (!gaps.empty()) onGap = gapCallback;
+    }
+    // A new gap is reported while the read goes on waiting.
+    reportGaps(gaps, onGap);
+    if (received || gaps.empty()) break;
+  }
+  if (!received) {
+    spdlog::debug("No data received from {0}:{1}", ip, remotePort);
+    return Serializable();
+  }
+  return deliver(std::move(payload));
+}
 
+int UDPSocket::reactorHandle() {
 #ifdef _WIN32
-      if (ready == SOCKET_ERROR) {
+  return -1;
 #else
-      if (ready == -1) {
+  std::lock_guard<std::mutex> lock(readMutex);
+#ifdef SOCKET_LIB_HAS_IO_URING
+  if (recvRing) return recvRing->fd();
+#endif
+  return udpSocket;
 #endif
-        throw std::runtime_error(
-            "Error receiving data; connection may have been closed; "
-            "UDPSocket::read()");
+}
+
+std::chrono::steady_clock::time_point UDPSocket::reactorDispatch() {
+  std::vector<std::vector<uint8_t>> payloads;
+  std::vector<SequenceGap> gaps;
+  std::function<void(const SequenceGap &)> onGap;
+  auto next = std::chrono::steady_clock::time_point::max();
+  {
+    std::lock_guard<std::mutex> lock(readMutex);
+    if (udpSocket == INVALID_SOCKET) return next;
+    std::vector<uint8_t> payload;
+    while (true) {
+      std::vector<SequenceGap> found;
+      bool received =
+          receivePayload(payload, found,
+                         std::chrono::steady_clock::time_point::min(),
+                         readGeneration);
+      gaps.insert(gaps.end(), found.begin(), found.end());
+      if (received) {
+        payloads.push_back(std::move(payload));
+      } else if (found.empty()) {
+        break;
       }
+    }
+    if (!gaps.empty()) onGap = gapCallback;
+    // Held-back datagrams are released on their deadline.
+    if (sequencer) next = sequencer->nextDeadline();
+  }
+  reportGaps(gaps, onGap);
+  for (auto &received : payloads) deliver(std::move(received));
+  return next;
+}
+
+void UDPSocket::reportGaps(
+    const std::vector<SequenceGap> &gaps,
+    const std::function<void(const SequenceGap &)> &onGap) {
+  for (const SequenceGap &gap : gaps) {
+    if (gap.event == GapEvent::LOST) {
+      spdlog::warn("Sequence gap from {0}: {1} datagram(s) lost from #{2}",
+                   gap.peer, gap.count, gap.firstMissing);
+    } else {
+      spdlog::debug("Sequence gap from {0}: {1} datagram(s) missing from #{2}",
+                    gap.peer, gap.count, gap.firstMissing);
+    }
+    if (onGap) onGap(gap);
+  }
+}
+
+void UDPSocket::cancel() {
+  ++readGeneration;
+#ifdef __linux__
+  uint64_t one = 1;
+  ssize_t ignored = ::write(wakeFd, &one, sizeof(one));
+  (void)ignored;
+#endif
+}
+
+void UDPSocket::setReadTimeout(std::chrono::steady_clock::duration timeout) {
+  std::lock_guard<std::mutex> lock(readMutex);
+  readTimeout = timeout;
+}
 
-      if (ready > 0) {
-        bytesRead = recv(udpSocket, reinterpret_cast<char *>(buffer.data()),
-                         buffer.size(), 0);
+bool UDPSocket::receivePayload(std::vector<uint8_t> &payload,
+                               std::vector<SequenceGap> &gaps,
+                               std::chrono::steady_clock::time_point deadline,
+                               uint64_t generation) {
+  bool waited = false;  // A past deadline still looks once.
+  while (true) {
+    if (!pendingReads.empty()) {
+      payload = std::move(pendingReads.front());
+      pendingReads.pop_front();
+      return true;
+    }
+    // Returns so the caller reports the gap without waiting any longer.
+    if (!gaps.empty()) return false;
+    if (readsClosed || readGeneration != generation) return false;
+
+    auto now = std::chrono::steady_clock::now();
+    auto wakeup = deadline;
+    if (fecDecoder) fecDecoder->expire(now);
+    if (sequencer) {
+      std::deque<std::vector<uint8_t>> released;
+      sequencer->expire(now, released, gaps);
+      for (auto &frame : released) enqueueReceived(frame);
+      if (!pendingReads.empty()) continue;
+      wakeup = std::min(wakeup, sequencer->nextDeadline());
+    }
+    if (waited && now >= deadline) return false;
+    waited = true;
+    // Not wakeup - now: tryRead() passes time_point::min().
+    auto left = wakeup > now ? wakeup - now
+                             : std::chrono::steady_clock::duration::zero();
+
+    spdlog::debug("port:{0} waiting for data from {1}:{2}", localPort, ip,
+                  remotePort);
+#ifdef SOCKET_LIB_HAS_IO_URING
+    if (recvRing) {
+      auto wait = wakeup == std::chrono::steady_clock::time_point::max()
+                      ? std::chrono::nanoseconds(-1)
+                      : std::chrono::duration_cast<std::chrono::nanoseconds>(left);
+      if (!receiveUring(wait, gaps)) return false;
+      continue;
+    }
+#endif
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    FD_SET(udpSocket, &readSet);
+    int highest = static_cast<int>(udpSocket);
+#ifdef __linux__
+    FD_SET(wakeFd, &readSet);
+    highest = std::max(highest, wakeFd);
+#else
+    if (left > kCancelPoll) {
+      left = kCancelPoll;
+      wakeup = now;  // Anything but max().
+    }
+#endif
+
+    struct timeval timeout;
+    struct timeval *wait = nullptr;
+    if (wakeup != std::chrono::steady_clock::time_point::max()) {
+      auto micros =
+          std::chrono::duration_cast<std::chrono::microseconds>(left);
+      timeout.tv_sec = static_cast<long>(micros.count() / 1000000);
+      timeout.tv_usec = static_cast<long>(micros.count() % 1000000);
+      wait = &timeout;
+    }
+
+    int ready = select(highest + 1, &readSet, nullptr, nullptr, wait);
 
 #ifdef _WIN32
-        if (bytesRead == SOCKET_ERROR) {
+    if (ready == SOCKET_ERROR) {
 #else
-        if (bytesRead < 0) {
+    if (ready == -1) {
+#endif
+      spdlog::debug(
+          "Error receiving data; connection may have been closed; "
+          "UDPSocket::read()");
+      return false;
+    }
+    if (ready == 0) continue;
+#ifdef __linux__
+    if (FD_ISSET(wakeFd, &readSet)) {
+      // Also clears wakes left by a cancel() nobody was waiting for.
+      uint64_t value;
+      ssize_t ignored = ::read(wakeFd, &value, sizeof(value));
+      (void)ignored;
+      continue;
+    }
 #endif
-          throw std::runtime_error(
-              "Error receiving data; connection may have been closed; "
-              "UDPSocket::read()");
-        }
-      }
 
-      if (bytesRead <= 0) {
-        spdlog::debug("No data received from {0}:{1}", ip, remotePort);
-        return Serializable();
-      }
+    sockaddr_storage peer{};
+    socklen_t peerLen = sizeof(peer);
+    int bytesRead =
+        recvfrom(udpSocket, reinterpret_cast<char *>(receiveBuffer.data()),
+                 receiveBuffer.size(), 0,
+                 reinterpret_cast<sockaddr *>(&peer), &peerLen);
 
-      buffer.resize(bytesRead);
-      Serializable receivedData(buffer);
-      notify(receivedData);
-      spdlog::debug("Data received {0} from {1}", ip, remotePort);
-      std::stringstream stream;
-      stream << std::hex << std::setfill('0');
-      auto serializedData = receivedData.operator const std::vector<uint8_t>();
-      for (uint8_t &byte : serializedData) {
-        stream << std::setw(2) << static_cast<int>(byte);
-        // add space between bytes
-        stream << " ";
-      }
-      spdlog::info("Data received: " + stream.str());
-      return receivedData;
-    } catch (std::exception &e) {
-      spdlog::debug("Excepción capturada: {}", e.what());
+#ifdef _WIN32
+    if (bytesRead == SOCKET_ERROR) {
+#else
+    if (bytesRead < 0) {
+#endif
+      spdlog::debug(
+          "Error receiving data; connection may have been closed; "
+          "UDPSocket::read()");
+      return false;
+    }
+
+    processDatagram(std::vector<uint8_t>(receiveBuffer.begin(),
+                                         receiveBuffer.begin() + bytesRead),
+                    Endpoint(reinterpret_cast<sockaddr *>(&peer), peerLen),
+                    gaps);
+  }
+}
+
+#ifdef SOCKET_LIB_HAS_IO_URING
+bool UDPSocket::receiveUring(std::chrono::nanoseconds timeout,
+                             std::vector<SequenceGap> &gaps) {
+  if (!recvArmed) {
+    recvRing->recvmsgMultishot(0, &recvLayout, kRecvData);
+    recvArmed = true;
+  }
+  if (!wakeArmed) {
+    recvRing->pollMultishot(wakeFd, kWakeData);
+    wakeArmed = true;
+  }
+  if (!recvRing->submitAndWait(timeout)) {
+    spdlog::debug("Error receiving data; UDPSocket::read()");
+    return false;
+  }
+  bool open = true;
+  recvRing->completions([&](const io_uring_cqe &cqe) {
+    if (cqe.user_data == kWakeData) {
+      if (!(cqe.flags & IORING_CQE_F_MORE)) wakeArmed = false;
+      uint64_t value;
+      ssize_t ignored = ::read(wakeFd, &value, sizeof(value));
+      (void)ignored;
+      return;
+    }
+    if (!(cqe.flags & IORING_CQE_F_MORE)) recvArmed = false;
+    int id = IoUring::bufferId(cqe);
+    if (id < 0) {
+      // Out of buffers is re-armed on the next call; anything else means
+      // the socket was shut down or closed.
+      if (cqe.res != -ENOBUFS) open = false;
+      return;
+    }
+    uint8_t *base = recvRing->buffer(id);
+    io_uring_recvmsg_out out;
+    memcpy(&out, base, sizeof(out));
+    const uint8_t *name = base + sizeof(out);
+    const uint8_t *data =
+        name + recvLayout.msg_namelen + recvLayout.msg_controllen;
+    Endpoint peer(reinterpret_cast<const sockaddr *>(name),
+                  std::min<socklen_t>(out.namelen, recvLayout.msg_namelen));
+    if (out.flags & MSG_TRUNC) {
+      spdlog::warn("Dropping truncated datagram; UDPSocket::read()");
+    } else {
+      processDatagram(std::vector<uint8_t>(data, data + out.payloadlen), peer,
+                      gaps);
+    }
+    recvRing->recycle(id);
+  });
+  return open;
+}
+#endif
+
+void UDPSocket::processDatagram(std::vector<uint8_t> datagram,
+                                const Endpoint &peer,
+                                std::vector<SequenceGap> &gaps) {
+  std::string key = peer.key();
+  auto now = std::chrono::steady_clock::now();
+  std::vector<std::vector<uint8_t>> payloads;
+  if (fecDecoder) {
+    payloads = fecDecoder->decode(key, datagram, now);
+  } else {
+    payloads.push_back(std::move(datagram));
+  }
+  if (!sequencer) {
+    for (auto &payload : payloads) enqueueReceived(payload);
+    return;
+  }
+
+  std::string name = peer.toString();
+  std::deque<std::vector<uint8_t>> ordered;
+  for (auto &payload : payloads) {
+    sequencer->receive(key, name, payload, now, ordered, gaps);
+  }
+  for (auto &frame : ordered) enqueueReceived(frame);
+}
+
+void UDPSocket::enqueueReceived(const std::vector<uint8_t> &payload) {
+  if (!unpackCoalesced) {
+    pendingReads.push_back(payload);
+  } else if (!UDPCoalescer::unpack(payload, pendingReads)) {
+    spdlog::warn("Malformed coalesced datagram dropped; UDPSocket::read()");
+  }
+}
+
+void UDPSocket::setFec(const FecConfig &config) {
+  stopFlushThread();
+  {
+    std::lock(socketMutex, readMutex);
+    std::lock_guard<std::mutex> lock(socketMutex, std::adopt_lock);
+    std::lock_guard<std::mutex> readLock(readMutex, std::adopt_lock);
+    if (fecEncoder && udpSocket != INVALID_SOCKET) {
+      sendDatagrams(fecEncoder->flush());
+    }
+    if (config.scheme == FecScheme::NONE) {
+      fecEncoder.reset();
+      fecDecoder.reset();
+    } else {
+      fecEncoder.reset(new FecEncoder(config));
+      fecDecoder.reset(new FecDecoder(config));
+    }
+    parityOnDeadline =
+        config.scheme != FecScheme::NONE && config.parityDeadline.count() > 0;
+    fitCoalescer();
+  }
+  startFlushThread();
+}
+
+FecStats UDPSocket::getFecStats() {
+  std::lock(socketMutex, readMutex);
+  std::lock_guard<std::mutex> lock(socketMutex, std::adopt_lock);
+  std::lock_guard<std::mutex> readLock(readMutex, std::adopt_lock);
+  FecStats stats;
+  if (fecEncoder) {
+    stats.dataSent = fecEncoder->stats().dataSent;
+    stats.paritySent = fecEncoder->stats().paritySent;
+  }
+  if (fecDecoder) {
+    stats.dataReceived = fecDecoder->stats().dataReceived;
+    stats.parityReceived = fecDecoder->stats().parityReceived;
+    stats.recovered = fecDecoder->stats().recovered;
+    stats.unrecoverable = fecDecoder->stats().unrecoverable;
+  }
+  return stats;
+}
+
+void UDPSocket::setSequencing(const SequencerConfig &config) {
+  std::lock(socketMutex, readMutex);
+  std::lock_guard<std::mutex> lock(socketMutex, std::adopt_lock);
+  std::lock_guard<std::mutex> readLock(readMutex, std::adopt_lock);
+  sequencer.reset(config.enabled ? new UDPSequencer(config) : nullptr);
+  fitCoalescer();
+}
+
+void UDPSocket::setGapCallback(
+    std::function<void(const SequenceGap &)> callback) {
+  std::lock_guard<std::mutex> lock(readMutex);
+  gapCallback = std::move(callback);
+}
+
+SequencerStats UDPSocket::getSequenceStats() {
+  std::lock_guard<std::mutex> lock(readMutex);
+  return sequencer ? sequencer->stats() : SequencerStats();
+}
+
+void UDPSocket::setCoalescing(const CoalescingConfig &config) {
+  stopFlushThread();
+  {
+    std::lock(socketMutex, readMutex);
+    std::lock_guard<std::mutex> lock(socketMutex, std::adopt_lock);
+    std::lock_guard<std::mutex> readLock(readMutex, std::adopt_lock);
+    unpackCoalesced = config.enabled;
+    if (coalescer) {
+      std::vector<uint8_t> frame = coalescer->flush();
+      if (!frame.empty()) sendFrame(frame);
+    }
+    coalescer.reset(config.enabled ? new UDPCoalescer(config) : nullptr);
+    coalesceSize = config.maxDatagramSize;
+    fitCoalescer();
+  }
+  startFlushThread();
+}
+
+void UDPSocket::fitCoalescer() {
+  if (!coalescer) return;
+  // The IPv6 header is 20 bytes longer than the IPv4 one.
+  size_t overhead = wireFamily == AF_INET6 ? 20 : 0;
+  if (sequencer) overhead += UDPSequencer::overhead();
+  if (fecEncoder) overhead += FecEncoder::overhead();
+  coalescer->setLimit(coalesceSize > overhead ? coalesceSize - overhead : 1);
+}
+
+void UDPSocket::flush() {
+  drainWrites(std::chrono::steady_clock::duration::max());
+  std::lock_guard<std::mutex> lock(socketMutex);
+  if (udpSocket == INVALID_SOCKET) return;
+  sendPending(std::chrono::steady_clock::time_point::max());
+}
+
+std::chrono::steady_clock::time_point UDPSocket::nextFlush() {
+  auto next = std::chrono::steady_clock::time_point::max();
+  if (coalescer) next = coalescer->deadline();
+  if (fecEncoder) next = std::min(next, fecEncoder->deadline());
+  return next;
+}
+
+void UDPSocket::sendPending(std::chrono::steady_clock::time_point now) {
+  // The coalesced frame first, so the parity that follows protects it.
+  if (coalescer && now >= coalescer->deadline()) {
+    std::vector<uint8_t> frame = coalescer->flush();
+    if (!frame.empty()) sendFrame(frame);
+  }
+  if (fecEncoder && now >= fecEncoder->deadline()) {
+    std::vector<std::vector<uint8_t>> parity = fecEncoder->flush();
+    if (!parity.empty()) sendDatagrams(parity);
+  }
+}
+
+void UDPSocket::flushLoop() {
+  std::unique_lock<std::mutex> lock(socketMutex);
+  while (!flushStop) {
+    auto deadline = nextFlush();
+    if (deadline == std::chrono::steady_clock::time_point::max()) {
+      flushCv.wait(lock);
+      continue;
     }
-  } while (true);
+    flushCv.wait_until(lock, deadline);
+    sendPending(std::chrono::steady_clock::now());
+  }
+}
+
+void UDPSocket::startFlushThread() {
+  {
+    std::lock_guard<std::mutex> lock(socketMutex);
+    if (!coalescer && !parityOnDeadline) return;
+    flushStop = false;
+  }
+  flushThread = std::thread(&UDPSocket::flushLoop, this);
+}
+
+void UDPSocket::stopFlushThread() {
+  {
+    std::lock_guard<std::mutex> lock(socketMutex);
+    flushStop = true;
+  }
+  flushCv.notify_all();
+  if (flushThread.joinable()) flushThread.join();
+}
+
+void UDPSocket::setAsyncWrite(const AsyncWriteConfig &config) {
+  stopAsyncWriter(false);
+  {
+    std::lock_guard<std::mutex> lock(asyncWriteMutex);
+    asyncWriteConfig = config;
+  }
+  bool open;
+  {
+    std::lock_guard<std::mutex> lock(socketMutex);
+    open = udpSocket != INVALID_SOCKET;
+  }
+  if (open) startAsyncWriter();
+}
+
+bool UDPSocket::drainWrites(std::chrono::steady_clock::duration timeout) {
+  std::shared_ptr<AsyncWriter> writer = std::atomic_load(&asyncWriter);
+  return !writer || writer->drain(timeout);
+}
+
+AsyncWriteStats UDPSocket::getAsyncWriteStats() {
+  std::lock_guard<std::mutex> lock(asyncWriteMutex);
+  std::shared_ptr<AsyncWriter> writer = std::atomic_load(&asyncWriter);
+  return writer ? asyncWriteTotals + writer->stats() : asyncWriteTotals;
+}
+
+void UDPSocket::startAsyncWriter() {
+  std::lock_guard<std::mutex> lock(asyncWriteMutex);
+  if (!asyncWriteConfig.enabled || std::atomic_load(&asyncWriter)) return;
+  std::atomic_store(
+      &asyncWriter,
+      std::make_shared<AsyncWriter>(
+          asyncWriteConfig, [this](std::vector<std::vector<uint8_t>> &batch) {
+            return writeBatch(batch);
+          }));
+}
+
+void UDPSocket::stopAsyncWriter(bool closing) {
+  std::lock_guard<std::mutex> lock(asyncWriteMutex);
+  std::shared_ptr<AsyncWriter> writer =
+      std::atomic_exchange(&asyncWriter, std::shared_ptr<AsyncWriter>());
+  if (!writer) return;
+  // A write() that picked the writer up just before still enqueues to it
+  // and has its message counted as dropped.
+  writer->stop(!closing || asyncWriteConfig.drainOnClose);
+  asyncWriteTotals = asyncWriteTotals + writer->stats();
+}
+
+void UDPSocket::setIoBackend(IoBackend backend) {
+  std::lock_guard<std::mutex> lock(socketMutex);
+  ioBackend = backend;
+}
+
+IoBackend UDPSocket::getIoBackend() {
+  std::lock_guard<std::mutex> lock(socketMutex);
+  if (udpSocket == INVALID_SOCKET) return ioBackend;
+#ifdef SOCKET_LIB_HAS_IO_URING
+  if (sendRing) return IoBackend::IO_URING;
+#endif
+  return IoBackend::EPOLL;
+}
+
+void UDPSocket::setReuseAddress(bool enable) {
+  std::lock_guard<std::mutex> lock(socketMutex);
+  reuseAddress = enable;
+}
+
+void UDPSocket::setDualStack(bool enable) {
+  std::lock_guard<std::mutex> lock(socketMutex);
+  dualStack = enable;
+}
+
+void UDPSocket::setOption(int level, int option, const void *value, int length,
+                          const char *where) {
+  std::lock_guard<std::mutex> lock(socketMutex);
+  if (udpSocket == INVALID_SOCKET) {
+    throw std::runtime_error(std::string("Socket is not open; ") + where);
+  }
+  if (setsockopt(udpSocket, level, option,
+                 reinterpret_cast<const char *>(value),
+                 length) == SOCKET_ERROR) {
+    throw std::runtime_error(std::string("setsockopt failed; ") + where);
+  }
+}
+
+void UDPSocket::changeMembership(int option, const std::string &group,
+                                 const std::string &source,
+                                 const std::string &interfaceIp,
+                                 const char *where) {
+#ifdef IP_MULTICAST_ALL
+  // Linux otherwise delivers every group joined by any socket on the host
+  // to all sockets bound to the port.
+  int all = 0;
+  setOption(IPPROTO_IP, IP_MULTICAST_ALL, &all, sizeof(all), where);
+#endif
+  if (source.empty()) {
+    ip_mreq request{};
+    request.imr_multiaddr.s_addr = inet_addr(group.c_str());
+    request.imr_interface.s_addr = inet_addr(interfaceIp.c_str());
+    setOption(IPPROTO_IP, option, &request, sizeof(request), where);
+  } else {
+    ip_mreq_source request{};
+    request.imr_multiaddr.s_addr = inet_addr(group.c_str());
+    request.imr_sourceaddr.s_addr = inet_addr(source.c_str());
+    request.imr_interface.s_addr = inet_addr(interfaceIp.c_str());
+    setOption(IPPROTO_IP, option, &request, sizeof(request), where);
+  }
+  spdlog::info("{0} group {1} source {2} on {3}", where, group,
+               source.empty() ? "*" : source, interfaceIp);
+}
+
+void UDPSocket::joinGroup(const std::string &group,
+                          const std::string &interfaceIp) {
+  changeMembership(IP_ADD_MEMBERSHIP, group, "", interfaceIp,
+                   "UDPSocket::joinGroup()");
+}
+
+void UDPSocket::leaveGroup(const std::string &group,
+                           const std::string &interfaceIp) {
+  changeMembership(IP_DROP_MEMBERSHIP, group, "", interfaceIp,
+                   "UDPSocket::leaveGroup()");
+}
+
+void UDPSocket::joinSourceGroup(const std::string &group,
+                                const std::string &source,
+                                const std::string &interfaceIp) {
+  changeMembership(IP_ADD_SOURCE_MEMBERSHIP, group, source, interfaceIp,
+                   "UDPSocket::joinSourceGroup()");
+}
+
+void UDPSocket::leaveSourceGroup(const std::string &group,
+                                 const std::string &source,
+                                 const std::string &interfaceIp) {
+  changeMembership(IP_DROP_SOURCE_MEMBERSHIP, group, source, interfaceIp,
+                   "UDPSocket::leaveSourceGroup()");
+}
+
+void UDPSocket::setMulticastTTL(int ttl) {
+  setOption(IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl),
+            "UDPSocket::setMulticastTTL()");
+}
+
+void UDPSocket::setMulticastLoop(bool enable) {
+  int value = enable ? 1 : 0;
+  setOption(IPPROTO_IP, IP_MULTICAST_LOOP, &value, sizeof(value),
+            "UDPSocket::setMulticastLoop()");
+}
+
+void UDPSocket::setMulticastInterface(const std::string &interfaceIp) {
+  in_addr address{};
+  address.s_addr = inet_addr(interfaceIp.c_str());
+  setOption(IPPROTO_IP, IP_MULTICAST_IF, &address, sizeof(address),
+            "UDPSocket::setMulticastInterface()");
+}
+
+bool UDPSocket::applyKernelPacing(const PacingConfig &config) {
+#ifdef _WIN32
+  (void)config;
+  return false;
+#else
+  if (udpSocket == INVALID_SOCKET) return false;
+  if (!config.enabled) {
+    setKernelPacingRate(udpSocket, 0);
+    return false;
+  }
+  // The kernel only paces UDP under the fq qdisc, which cannot be detected
+  // from here, so AUTO stays in user space.
+  if (config.mode != PacingMode::KERNEL) return false;
+  return setKernelPacingRate(udpSocket, config.rateBytesPerSecond);
+#endif
 }
@@ -0,0 +1,518 @@
+#include "socket/Unix/UnixSocket.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+const size_t kMaxFds = 64;  ///< Descriptors accepted per received message.
+
+bool makeAddress(const std::string &path, sockaddr_un &address,
+                 socklen_t &length) {
+  address = sockaddr_un{};
+  address.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+    return false;
+  }
+  // '@' stands for the leading zero byte of an abstract address, whose
+  // length then excludes any terminator.
+  std::memcpy(address.sun_path, path.data(), path.size());
+  if (path[0] == '@') {
+    address.sun_path[0] = '\0';
+    length = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) +
+                                    path.size());
+  } else {
+    length = static_cast<socklen_t>(sizeof(address));
+  }
+  return true;
+}
+
+std::string addressKey(const sockaddr_un &address, socklen_t length) {
+  size_t offset = offsetof(sockaddr_un, sun_path);
+  if (length <= offset) return std::string();
+  return std::string(address.sun_path, length - offset);
+}
+
+}  // namespace
+
+UnixSocket::UnixSocket(std::string path, Role role, UnixSocketType type,
+                       std::chrono::milliseconds readTimeout)
+    : path(std::move(path)),
+      role(role),
+      type(type),
+      readTimeout(readTimeout) {}
+
+UnixSocket::~UnixSocket() { close(); }
+
+int UnixSocket::socketType() const {
+  switch (type) {
+    case UnixSocketType::SEQPACKET:
+      return SOCK_SEQPACKET;
+    case UnixSocketType::DATAGRAM:
+      return SOCK_DGRAM;
+    default:
+      return SOCK_STREAM;
+  }
+}
+
+void UnixSocket::open() {
+  std::lock_guard<std::mutex> lock(socketMutex);
+  if (socketFd != -1) return;
+
+  sockaddr_un address;
+  socklen_t length;
+  if (!makeAddress(path, address, length)) {
+    spdlog::error("Invalid socket path '{0}'; UnixSocket::open()", path);
+    throw std::runtime_error("Invalid socket path; UnixSocket::open()");
+  }
+  int fd = socket(AF_UNIX, socketType() | SOCK_CLOEXEC, 0);
+  if (fd == -1) {
+    spdlog::error("Socket creation failed: {0}; UnixSocket::open()",
+                  strerror(errno));
+    throw std::runtime_error("Socket creation failed; UnixSocket::open()");
+  }
+
+  if (role == SERVER) {
+    if (!abstractAddress()) ::unlink(path.c_str());
+    if (bind(fd, reinterpret_cast<sockaddr *>(&address), length) == -1) {
+      spdlog::error("Binding {0} failed: {1}; UnixSocket::open()", path,
+                    strerror(errno));
+      ::close(fd);
+      throw std::runtime_error("Binding failed; UnixSocket::open()");
+    }
+    if (type != UnixSocketType::DATAGRAM) {
+      if (listen(fd, SOMAXCONN) == -1) {
+        spdlog::error("Listening failed: {0}; UnixSocket::open()",
+                      strerror(errno));
+        ::close(fd);
+        throw std::runtime_error("Listening failed; UnixSocket::open()");
+      }
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    }
+  } else {
+    if (type == UnixSocketType::DATAGRAM) {
+      // Autobind to an abstract address so the server can answer.
+      sa_family_t family = AF_UNIX;
+      bind(fd, reinterpret_cast<sockaddr *>(&family), sizeof(family));
+    }
+    if (connect(fd, reinterpret_cast<sockaddr *>(&address), length) == -1) {
+      spdlog::error("Connecting to {0} failed: {1}; UnixSocket::open()", path,
+                    strerror(errno));
+      ::close(fd);
+      throw std::runtime_error("Connecting failed; UnixSocket::open()");
+    }
+  }
+  socketFd = fd;
+  wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  spdlog::info("Unix socket {0} open", path);
+}
+
+void UnixSocket::close() {
+  // Wake a read() polling these descriptors, and let it finish before they
+  // are closed and their numbers reused.
+  {
+    std::lock_guard<std::mutex> lock(socketMutex);
+    if (socketFd == -1) return;
+  }
+  cancel();
+  std::vector<ConnectionId> closed;
+  {
+    std::lock_guard<std::mutex> readLock(readMutex);
+    std::lock_guard<std::mutex> lock(socketMutex);
+    for (auto &entry : peers) {
+      if (entry.second.fd != -1) ::close(entry.second.fd);
+      closed.push_back(entry.first);
+    }
+    peers.clear();
+    datagramPeers.clear();
+    for (int fd : receivedFds) ::close(fd);
+    receivedFds.clear();
+    if (socketFd != -1) {
+      ::close(socketFd);
+      socketFd = -1;
+    }
+    if (wakeFd != -1) {
+      ::close(wakeFd);
+      wakeFd = -1;
+    }
+    if (role == SERVER && !abstractAddress()) ::unlink(path.c_str());
+  }
+  for (ConnectionId id : closed) {
+    notifyConnectionEvent(id, ConnectionEvent::DISCONNECTED);
+  }
+  spdlog::info("Unix socket {0} closed", path);
+}
+
+void UnixSocket::acceptPeers() {
+  while (true) {
+    ConnectionId id;
+    {
+      std::lock_guard<std::mutex> lock(socketMutex);
+      int fd = accept4(socketFd, nullptr, nullptr, SOCK_CLOEXEC);
+      if (fd == -1) {
+        if (errno == EINTR || errno == ECONNABORTED) continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINVAL) {
+          spdlog::error("Error accepting connection: {0}; UnixSocket::read()",
+                        strerror(errno));
+        }
+        return;
+      }
+      id = nextPeerId++;
+      peers[id].fd = fd;
+    }
+    spdlog::info("Client connected to {0} (connection {1})", path, id);
+    notifyConnectionEvent(id, ConnectionEvent::CONNECTED);
+  }
+}
+
+void UnixSocket::dropPeer(ConnectionId id) {
+  {
+    std::lock_guard<std::mutex> lock(socketMutex);
+    auto it = peers.find(id);
+    if (it == peers.end()) return;
+    if (it->second.fd != -1) ::close(it->second.fd);
+    peers.erase(it);
+  }
+  notifyConnectionEvent(id, ConnectionEvent::DISCONNECTED);
+}
+
+bool UnixSocket::receive(ConnectionId &id, int fd, std::vector<uint8_t> &data,
+                         bool &closed) {
+  sockaddr_un from{};
+  iovec iov{receiveBuffer.data(), receiveBuffer.size()};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * kMaxFds)];
+  msghdr message{};
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+  if (type == UnixSocketType::DATAGRAM) {
+    message.msg_name = &from;
+    message.msg_namelen = sizeof(from);
+  }
+  ssize_t received = recvmsg(fd, &message, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+  if (received == -1) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+      return false;
+    }
+    if (errno == ECONNRESET) {
+      closed = true;
+      return false;
+    }
+    spdlog::error("Error receiving data: {0}; UnixSocket::read()",
+                  strerror(errno));
+    closed = type != UnixSocketType::DATAGRAM;
+    return false;
+  }
+
+  for (cmsghdr *header = CMSG_FIRSTHDR(&message); header != nullptr;
+       header = CMSG_NXTHDR(&message, header)) {
+    if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS) {
+      size_t count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      const int *fds = reinterpret_cast<const int *>(CMSG_DATA(header));
+      std::lock_guard<std::mutex> lock(socketMutex);
+      receivedFds.insert(receivedFds.end(), fds, fds + count);
+    }
+  }
+  if (message.msg_flags & MSG_CTRUNC) {
+    spdlog::warn("Passed descriptors dropped, more than {0}; "
+                 "UnixSocket::read()",
+                 kMaxFds);
+  }
+  if (message.msg_flags & MSG_TRUNC) {
+    spdlog::warn("Message truncated to {0} bytes; UnixSocket::read()",
+                 receiveBuffer.size());
+  }
+
+  if (received == 0 && type != UnixSocketType::DATAGRAM) {
+    closed = true;
+    return false;
+  }
+  if (type == UnixSocketType::DATAGRAM && role == SERVER) {
+    std::string key = addressKey(from, message.msg_namelen);
+    id = 0;  // Unbound senders cannot be answered.
+    if (!key.empty()) {
+      bool added = false;
+      {
+        std::lock_guard<std::mutex> lock(socketMutex);
+        auto it = datagramPeers.find(key);
+        if (it == datagramPeers.end()) {
+          id = nextPeerId++;
+          datagramPeers[key] = id;
+          Peer &peer = peers[id];
+          peer.address = from;
+          peer.addressLength = message.msg_namelen;
+          added = true;
+        } else {
+          id = it->second;
+        }
+      }
+      if (added) notifyConnectionEvent(id, ConnectionEvent::CONNECTED);
+    }
+  }
+  data.assign(receiveBuffer.begin(), receiveBuffer.begin() + received);
+  return true;
+}
+
+Serializable UnixSocket::read() {
+  ConnectionId connection;
+  return read(connection);
+}
+
+Serializable UnixSocket::read(ConnectionId &connection) {
+  return read(connection, std::chrono::steady_clock::now() + readTimeout);
+}
+
+Serializable UnixSocket::read(std::chrono::steady_clock::time_point deadline) {
+  ConnectionId connection;
+  return read(connection, deadline);
+}
+
+Serializable UnixSocket::tryRead() {
+  ConnectionId connection;
+  return read(connection, std::chrono::steady_clock::time_point::min());
+}
+
+void UnixSocket::cancel() {
+  ++readGeneration;
+  std::lock_guard<std::mutex> lock(socketMutex);
+  if (wakeFd != -1) eventfd_write(wakeFd, 1);
+}
+
+Serializable UnixSocket::read(ConnectionId &connection,
+                              std::chrono::steady_clock::time_point deadline) {
+  connection = 0;
+  // Taken before the lock, so a read queued behind another one is
+  // cancelled too.
+  uint64_t generation = readGeneration;
+  std::lock_guard<std::mutex> readLock(readMutex);
+  bool listener = role == SERVER && type != UnixSocketType::DATAGRAM;
+  bool waited = false;  // A past deadline still looks once.
+  while (readGeneration == generation) {
+    std::vector<pollfd> fds;
+    std::vector<ConnectionId> ids;
+    {
+      std::lock_guard<std::mutex> lock(socketMutex);
+      if (socketFd == -1) {
+        spdlog::error("Socket is not open; UnixSocket::read()");
+        return Serializable();
+      }
+      fds.push_back(pollfd{wakeFd, POLLIN, 0});
+      ids.push_back(0);
+      fds.push_back(pollfd{socketFd, POLLIN, 0});
+      ids.push_back(0);
+      if (listener) {
+        for (auto &entry : peers) {
+          fds.push_back(pollfd{entry.second.fd, POLLIN, 0});
+          ids.push_back(entry.first);
+        }
+      }
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (waited && now >= deadline) break;
+    waited = true;
+    int timeout = -1;
+    if (deadline != std::chrono::steady_clock::time_point::max()) {
+      // Rounded up, so that poll() does not return just before the deadline.
+      auto remaining =
+          deadline <= now
+              ? std::chrono::milliseconds(0)
+              : std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - now + std::chrono::milliseconds(1) -
+                    std::chrono::nanoseconds(1));
+      timeout = static_cast<int>(std::min<std::chrono::milliseconds::rep>(
+          remaining.count(), INT_MAX));
+    }
+    int ready = poll(fds.data(), fds.size(), timeout);
+    if (ready == -1 && errno != EINTR) {
+      spdlog::error("Error in poll: {0}; UnixSocket::read()", strerror(errno));
+      return Serializable();
+    }
+    for (size_t i = 0; i < fds.size() && ready > 0; ++i) {
+      if (fds[i].revents == 0) continue;
+      if (i == 0) {
+        // Also clears wakes left by a cancel() nobody was waiting for.
+        eventfd_t value;
+        eventfd_read(wakeFd, &value);
+        break;
+      }
+      if (listener && i == 1) {
+        acceptPeers();
+        continue;
+      }
+      ConnectionId id = ids[i];
+      std::vector<uint8_t> data;
+      bool closed = false;
+      if (receive(id, fds[i].fd, data, closed)) {
+        connection = id;
+        Serializable received(data);
+        notify(received, id);
+        return received;
+      }
+      if (closed && listener) {
+        spdlog::info("Connection {0} to {1} closed by peer", id, path);
+        dropPeer(id);
+      } else if (closed) {
+        spdlog::info("Connection to {0} closed by peer", path);
+        {
+          std::lock_guard<std::mutex> lock(socketMutex);
+          ::close(socketFd);
+          socketFd = -1;
+          ::close(wakeFd);
+          wakeFd = -1;
+        }
+        notifyConnectionEvent(0, ConnectionEvent::DISCONNECTED);
+        return Serializable();
+      }
+    }
+  }
+  if (readGeneration != generation) {
+    spdlog::debug("Read of {0} cancelled", path);
+  } else {
+    spdlog::debug("No data received from {0}", path);
+  }
+  return Serializable();
+}
+
+bool UnixSocket::sendTo(const Peer &peer, const std::vector<uint8_t> &data,
+                        const std::vector<int> &fds) {
+  int fd = peer.fd != -1 ? peer.fd : socketFd;
+  if (fd == -1) {
+    spdlog::error("Socket is not open; UnixSocket::write()");
+    return false;
+  }
+  uint8_t filler = 0;
+  iovec iov{};
+  iov.iov_base = const_cast<uint8_t *>(data.empty() ? &filler : data.data());
+  iov.iov_len = data.empty() ? 1 : data.size();
+  if (data.empty() && fds.empty()) {
+    return true;
+  }
+  std::vector<char> control;
+  msghdr message{};
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  if (peer.addressLength != 0) {
+    message.msg_name = const_cast<sockaddr_un *>(&peer.address);
+    message.msg_namelen = peer.addressLength;
+  }
+  if (!fds.empty()) {
+    control.resize(CMSG_SPACE(sizeof(int) * fds.size()));
+    message.msg_control = control.data();
+    message.msg_controllen = control.size();
+    cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    std::memcpy(CMSG_DATA(header), fds.data(), sizeof(int) * fds.size());
+  }
+  // Only a stream may take part of a message; the descriptors go with the
+  // first part.
+  while (true) {
+    ssize_t sent = sendmsg(fd, &message, MSG_NOSIGNAL);
+    if (sent == -1) {
+      if (errno == EINTR) continue;
+      spdlog::error("Error sending data: {0}; UnixSocket::write()",
+                    strerror(errno));
+      return false;
+    }
+    if (static_cast<size_t>(sent) == iov.iov_len) return true;
+    iov.iov_base = static_cast<uint8_t *>(iov.iov_base) + sent;
+    iov.iov_len -= sent;
+    message.msg_control = nullptr;
+    message.msg_controllen = 0;
+  }
+}
+
+void UnixSocket::write(Serializable serializableObj) {
+  if (role == SERVER) {
+    broadcast(serializableObj);
+    return;
+  }
+  writeTo(0, serializableObj);
+}
+
+bool UnixSocket::writeTo(ConnectionId connection,
+                         const Serializable &serializableObj) {
+  return sendFdsTo(connection, std::vector<int>(), serializableObj);
+}
+
+size_t UnixSocket::broadcast(const Serializable &serializableObj) {
+  std::vector<uint8_t> data =
+      static_cast<std::vector<uint8_t>>(serializableObj);
+  std::lock_guard<std::mutex> lock(socketMutex);
+  size_t sent = 0;
+  for (auto &entry : peers) {
+    if (sendTo(entry.second, data, std::vector<int>())) ++sent;
+  }
+  return sent;
+}
+
+bool UnixSocket::sendFds(const std::vector<int> &fds,
+                         const Serializable &data) {
+  return sendFdsTo(0, fds, data);
+}
+
+bool UnixSocket::sendFdsTo(ConnectionId connection,
+                           const std::vector<int> &fds,
+                           const Serializable &data) {
+  std::vector<uint8_t> payload = static_cast<std::vector<uint8_t>>(data);
+  std::lock_guard<std::mutex> lock(socketMutex);
+  if (role == CLIENT) {
+    return sendTo(Peer(), payload, fds);
+  }
+  auto it = peers.find(connection);
+  if (it == peers.end()) {
+    spdlog::error("Unknown connection {0}; UnixSocket::write()", connection);
+    return false;
+  }
+  return sendTo(it->second, payload, fds);
+}
+
+std::vector<int> UnixSocket::takeReceivedFds() {
+  std::lock_guard<std::mutex> lock(socketMutex);
+  std::vector<int> fds;
+  fds.swap(receivedFds);
+  return fds;
+}
+
+void UnixSocket::disconnect(ConnectionId connection) {
+  bool forgotten = false;
+  {
+    std::lock_guard<std::mutex> lock(socketMutex);
+    auto it = peers.find(connection);
+    if (it == peers.end()) return;
+    if (it->second.fd != -1) {
+      // read() sees the end of the stream, closes it and notifies.
+      ::shutdown(it->second.fd, SHUT_RDWR);
+    } else {
+      datagramPeers.erase(addressKey(it->second.address,
+                                     it->second.addressLength));
+      peers.erase(it);
+      forgotten = true;
+    }
+  }
+  if (forgotten) {
+    notifyConnectionEvent(connection, ConnectionEvent::DISCONNECTED);
+  }
+}
+
+std::vector<ConnectionId> UnixSocket::getConnections() {
+  std::lock_guard<std::mutex> lock(socketMutex);
+  std::vector<ConnectionId> ids;
+  if (role == CLIENT) {
+    if (socketFd != -1) ids.push_back(0);
+    return ids;
+  }
+  for (auto &entry : peers) ids.push_back(entry.first);
+  return ids;
+}
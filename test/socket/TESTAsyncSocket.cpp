@@ -0,0 +1,251 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "socket/Async/AsyncSocket.h"
+#include "socket/TCP/LinuxTCP/LinuxTCPSocket.h"
+#include "socket/UDP/UDPSocket.h"
+
+namespace {
+
+// Below the ephemeral range (32768 up by default): a port there can be
+// held by a client's connection, or one in TIME_WAIT, and bind() fails.
+int getRandomPort() {
+  std::random_device rd;
+  std::mt19937 gen(rd());
+  std::uniform_int_distribution<> distrib(10000, 32000);
+  return distrib(gen);
+}
+
+Serializable message(const std::string &text) {
+  return Serializable(std::vector<uint8_t>(text.begin(), text.end()));
+}
+
+std::string text(Serializable serializable) {
+  std::vector<uint8_t> data = static_cast<std::vector<uint8_t>>(serializable);
+  return std::string(data.begin(), data.end());
+}
+
+Task<void> echo(AsyncSocket &server, ConnectionId id,
+                std::atomic<int> &sessions) {
+  while (true) {
+    Serializable received = co_await server.async_receive(id);
+    if (received.empty()) break;
+    co_await server.async_write(id, received);
+  }
+  --sessions;
+}
+
+Task<void> serve(AsyncSocket &server, std::atomic<int> &sessions,
+                 std::promise<void> &stopped) {
+  while (ConnectionId id = co_await server.async_accept()) {
+    ++sessions;
+    spawn(echo(server, id, sessions));
+  }
+  stopped.set_value();
+}
+
+// Sends each message and reads until all of it has come back; TCP may
+// split or join what the peer wrote.
+Task<std::vector<std::string>> roundTrips(AsyncSocket &client, int count) {
+  std::vector<std::string> replies;
+  if (!co_await client.async_open()) co_return replies;
+  for (int i = 0; i < count; ++i) {
+    std::string sent = "message " + std::to_string(i);
+    co_await client.async_write(message(sent));
+    std::string reply;
+    while (reply.size() < sent.size()) {
+      Serializable part = co_await client.async_read();
+      if (part.empty()) co_return replies;
+      reply += text(part);
+    }
+    replies.push_back(reply);
+  }
+  co_return replies;
+}
+
+Task<int> failAfterRead(AsyncSocket &socket) {
+  Serializable received = co_await socket.async_read();
+  throw std::runtime_error("failed after " + text(received));
+  co_return 0;
+}
+
+Task<int> nested(AsyncSocket &socket) {
+  int value = co_await failAfterRead(socket);
+  co_return value + 1;
+}
+
+template <typename T>
+bool ready(std::future<T> &future) {
+  return future.wait_for(std::chrono::seconds(2)) ==
+         std::future_status::ready;
+}
+
+}  // namespace
+
+TEST(AsyncSocket, TcpEchoOverLoopback) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  Reactor reactor(2);
+  LinuxTCPSocket server("127.0.0.1", port, 0, TCPSocket::SERVER, 3, 1);
+  LinuxTCPSocket first("127.0.0.1", 0, port, TCPSocket::CLIENT, 3, 1);
+  LinuxTCPSocket second("127.0.0.1", 0, port, TCPSocket::CLIENT, 3, 1);
+  AsyncSocket asyncServer(server, reactor);
+  AsyncSocket asyncFirst(first, reactor);
+  AsyncSocket asyncSecond(second, reactor);
+
+  ASSERT_TRUE(syncWait(asyncServer.async_open()));
+  std::atomic<int> sessions{0};
+  std::promise<void> stopped;
+  spawn(serve(asyncServer, sessions, stopped));
+
+  // Two clients at once, each with its own session on the server.
+  auto firstReplies = std::async(std::launch::async, [&] {
+    return syncWait(roundTrips(asyncFirst, 50));
+  });
+  std::vector<std::string> secondReplies =
+      syncWait(roundTrips(asyncSecond, 50));
+  ASSERT_TRUE(ready(firstReplies));
+  std::vector<std::string> expected;
+  for (int i = 0; i < 50; ++i) {
+    expected.push_back("message " + std::to_string(i));
+  }
+  EXPECT_EQ(firstReplies.get(), expected);
+  EXPECT_EQ(secondReplies, expected);
+  EXPECT_EQ(sessions, 2);
+
+  // A client leaving ends its session's async_receive().
+  asyncFirst.close();
+  asyncSecond.close();
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (sessions != 0 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  EXPECT_EQ(sessions, 0);
+
+  // close() resumes the acceptor with no connection.
+  std::future<void> serving = stopped.get_future();
+  EXPECT_EQ(serving.wait_for(std::chrono::milliseconds(20)),
+            std::future_status::timeout);
+  asyncServer.close();
+  EXPECT_TRUE(ready(serving));
+}
+
+TEST(AsyncSocket, UdpReadAndWrite) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  Reactor reactor(1);
+  UDPSocket receiver("127.0.0.1", port, port + 1);
+  UDPSocket sender("127.0.0.1", port + 1, port);
+  AsyncSocket asyncReceiver(receiver, reactor);
+  AsyncSocket asyncSender(sender, reactor);
+  ASSERT_TRUE(syncWait(asyncReceiver.async_open()));
+  ASSERT_TRUE(syncWait(asyncSender.async_open()));
+
+  // Sent before anyone reads: queued for the first async_read().
+  EXPECT_TRUE(syncWait([&]() -> Task<bool> {
+    co_return co_await asyncSender.async_write(message("queued"));
+  }()));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(text(syncWait([&]() -> Task<Serializable> {
+              co_return co_await asyncReceiver.async_read();
+            }())),
+            "queued");
+
+  // Read first, then written: the reader is resumed by the reactor.
+  auto reading = std::async(std::launch::async, [&] {
+    return text(syncWait([&]() -> Task<Serializable> {
+      co_return co_await asyncReceiver.async_read();
+    }()));
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  syncWait([&]() -> Task<void> {
+    co_await asyncSender.async_write(message("awaited"));
+  }());
+  ASSERT_TRUE(ready(reading));
+  EXPECT_EQ(reading.get(), "awaited");
+  asyncReceiver.close();
+  asyncSender.close();
+}
+
+TEST(AsyncSocket, CloseResumesEveryWaiter) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  Reactor reactor(1);
+  LinuxTCPSocket server("127.0.0.1", port, 0, TCPSocket::SERVER, 3, 1);
+  AsyncSocket asyncServer(server, reactor);
+  ASSERT_TRUE(syncWait(asyncServer.async_open()));
+
+  auto accepting = std::async(std::launch::async, [&] {
+    return syncWait([&]() -> Task<ConnectionId> {
+      co_return co_await asyncServer.async_accept();
+    }());
+  });
+  auto reading = std::async(std::launch::async, [&] {
+    return syncWait([&]() -> Task<Serializable> {
+      co_return co_await asyncServer.async_read();
+    }());
+  });
+  auto receiving = std::async(std::launch::async, [&] {
+    return syncWait([&]() -> Task<Serializable> {
+      co_return co_await asyncServer.async_receive(42);
+    }());
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(accepting.wait_for(std::chrono::seconds(0)),
+            std::future_status::timeout);
+
+  asyncServer.close();
+  ASSERT_TRUE(ready(accepting));
+  ASSERT_TRUE(ready(reading));
+  ASSERT_TRUE(ready(receiving));
+  EXPECT_EQ(accepting.get(), 0u);
+  EXPECT_TRUE(reading.get().empty());
+  EXPECT_TRUE(receiving.get().empty());
+
+  // Once closed, nothing waits.
+  EXPECT_EQ(syncWait([&]() -> Task<ConnectionId> {
+              co_return co_await asyncServer.async_accept();
+            }()),
+            0u);
+}
+
+TEST(AsyncSocket, ExceptionsReachSyncWait) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  Reactor reactor(1);
+  UDPSocket receiver("127.0.0.1", port, 0);
+  UDPSocket sender("127.0.0.1", port + 1, port);
+  AsyncSocket asyncReceiver(receiver, reactor);
+  ASSERT_TRUE(syncWait(asyncReceiver.async_open()));
+  sender.open();
+
+  // Thrown on the reactor thread that resumed the inner task, rethrown
+  // through the outer one and then on this thread.
+  auto failing = std::async(std::launch::async,
+                            [&] { return syncWait(nested(asyncReceiver)); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  sender.write(message("data"));
+  ASSERT_TRUE(ready(failing));
+  try {
+    failing.get();
+    FAIL() << "no exception";
+  } catch (const std::runtime_error &e) {
+    EXPECT_STREQ(e.what(), "failed after data");
+  }
+
+  // Thrown before the first suspension.
+  EXPECT_THROW(syncWait([]() -> Task<void> {
+                 throw std::logic_error("at once");
+                 co_return;
+               }()),
+               std::logic_error);
+  asyncReceiver.close();
+}
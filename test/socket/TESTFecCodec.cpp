@@ -0,0 +1,341 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "socket/UDP/FecCodec.h"
+
+namespace {
+
+using Datagrams = std::vector<std::vector<uint8_t>>;
+
+const size_t kHeaderSize = 9;
+const size_t kLengthPrefix = 2;
+
+// Payloads of uneven lengths, so shards are padded and the SIMD loops run
+// with tails.
+Datagrams payloads(unsigned count, size_t base) {
+  Datagrams result;
+  for (unsigned i = 0; i < count; ++i) {
+    std::vector<uint8_t> payload(base + i * 7);
+    for (size_t b = 0; b < payload.size(); ++b) {
+      payload[b] = static_cast<uint8_t>(b * 31 + i * 17 + 5);
+    }
+    result.push_back(payload);
+  }
+  return result;
+}
+
+Datagrams encodeBlock(FecEncoder &encoder, const Datagrams &block) {
+  Datagrams out;
+  for (auto &payload : block) {
+    for (auto &datagram : encoder.encode(payload)) out.push_back(datagram);
+  }
+  return out;
+}
+
+// Feeds every datagram whose bit is clear in dropped and returns what the
+// decoder delivered, sorted.
+Datagrams deliver(const FecConfig &config, const Datagrams &datagrams,
+                  uint64_t dropped) {
+  FecDecoder decoder(config);
+  Datagrams out;
+  for (size_t i = 0; i < datagrams.size(); ++i) {
+    if (dropped & (1ull << i)) continue;
+    for (auto &payload : decoder.decode(datagrams[i])) out.push_back(payload);
+  }
+  std::sort(out.begin(), out.end());
+  return out;
+}
+
+int bits(uint64_t value) {
+  int count = 0;
+  for (; value != 0; value &= value - 1) ++count;
+  return count;
+}
+
+// Every loss pattern of at most parityShards datagrams rebuilds the block.
+void checkAllLosses(const FecConfig &config, size_t base) {
+  FecEncoder encoder(config);
+  Datagrams block = payloads(config.dataShards, base);
+  Datagrams datagrams = encodeBlock(encoder, block);
+  unsigned parity = config.scheme == FecScheme::XOR ? 1 : config.parityShards;
+  ASSERT_EQ(datagrams.size(), config.dataShards + parity);
+
+  Datagrams expected = block;
+  std::sort(expected.begin(), expected.end());
+  for (uint64_t dropped = 0; dropped < (1ull << datagrams.size());
+       ++dropped) {
+    if (bits(dropped) > static_cast<int>(parity)) continue;
+    ASSERT_EQ(deliver(config, datagrams, dropped), expected)
+        << "dropped mask " << dropped;
+  }
+}
+
+// GF(256) over 0x11D, the slow way, as a reference for the table and SIMD
+// paths.
+uint8_t multiply(uint8_t a, uint8_t b) {
+  unsigned result = 0;
+  unsigned x = a;
+  for (; b != 0; b >>= 1) {
+    if (b & 1) result ^= x;
+    x <<= 1;
+    if (x & 0x100) x ^= 0x11D;
+  }
+  return static_cast<uint8_t>(result);
+}
+
+uint8_t inverse(uint8_t a) {
+  for (unsigned b = 1; b < 256; ++b) {
+    if (multiply(a, static_cast<uint8_t>(b)) == 1) {
+      return static_cast<uint8_t>(b);
+    }
+  }
+  return 0;
+}
+
+}  // namespace
+
+TEST(FecCodec, XorRebuildsAnySingleLoss) {
+  FecConfig config;
+  config.scheme = FecScheme::XOR;
+  config.dataShards = 6;
+  checkAllLosses(config, 1);
+}
+
+TEST(FecCodec, ReedSolomonRebuildsEveryLossPattern) {
+  FecConfig config;
+  config.scheme = FecScheme::REED_SOLOMON;
+  for (unsigned k : {1u, 4u, 10u}) {
+    for (unsigned m : {1u, 2u, 4u}) {
+      config.dataShards = k;
+      config.parityShards = m;
+      checkAllLosses(config, 40);
+    }
+  }
+}
+
+TEST(FecCodec, ReedSolomonFailsBeyondParity) {
+  FecConfig config;
+  config.scheme = FecScheme::REED_SOLOMON;
+  config.dataShards = 4;
+  config.parityShards = 2;
+  FecEncoder encoder(config);
+  Datagrams datagrams = encodeBlock(encoder, payloads(4, 20));
+  // Three data shards lost with two parity shards.
+  EXPECT_EQ(deliver(config, datagrams, 0x7).size(), 1u);
+}
+
+TEST(FecCodec, ParityMatchesScalarReference) {
+  FecConfig config;
+  config.scheme = FecScheme::REED_SOLOMON;
+  config.dataShards = 3;
+  config.parityShards = 3;
+  // Lengths around the 16- and 32-byte SIMD widths.
+  for (size_t length : {1u, 13u, 14u, 15u, 30u, 31u, 62u, 63u, 64u, 200u}) {
+    FecEncoder encoder(config);
+    Datagrams block;
+    for (unsigned j = 0; j < config.dataShards; ++j) {
+      std::vector<uint8_t> payload(length);
+      for (size_t b = 0; b < length; ++b) {
+        payload[b] = static_cast<uint8_t>((b + 1) * (j + 3) * 29);
+      }
+      block.push_back(payload);
+    }
+    Datagrams datagrams = encodeBlock(encoder, block);
+    ASSERT_EQ(datagrams.size(), 6u);
+
+    const size_t shardLength = length + kLengthPrefix;
+    for (unsigned p = 0; p < config.parityShards; ++p) {
+      std::vector<uint8_t> expected(shardLength, 0);
+      for (unsigned j = 0; j < config.dataShards; ++j) {
+        std::vector<uint8_t> shard(shardLength, 0);
+        shard[0] = static_cast<uint8_t>(length >> 8);
+        shard[1] = static_cast<uint8_t>(length);
+        std::copy(block[j].begin(), block[j].end(), shard.begin() + 2);
+        uint8_t c = inverse(
+            static_cast<uint8_t>(p ^ (config.parityShards + j)));
+        for (size_t b = 0; b < shardLength; ++b) {
+          expected[b] ^= multiply(c, shard[b]);
+        }
+      }
+      const std::vector<uint8_t> &parity = datagrams[config.dataShards + p];
+      ASSERT_EQ(parity.size(), kHeaderSize + kLengthPrefix + shardLength);
+      EXPECT_TRUE(std::equal(expected.begin(), expected.end(),
+                             parity.begin() + kHeaderSize + kLengthPrefix))
+          << "length " << length << " parity " << p;
+    }
+  }
+}
+
+TEST(FecCodec, FlushProtectsPartialBlock) {
+  FecConfig config;
+  config.scheme = FecScheme::REED_SOLOMON;
+  config.dataShards = 8;
+  config.parityShards = 2;
+  FecEncoder encoder(config);
+  Datagrams block = payloads(3, 10);
+  Datagrams datagrams = encodeBlock(encoder, block);
+  ASSERT_EQ(datagrams.size(), 3u);
+  EXPECT_EQ(encoder.deadline(), std::chrono::steady_clock::time_point::max());
+  for (auto &parity : encoder.flush()) datagrams.push_back(parity);
+  ASSERT_EQ(datagrams.size(), 5u);
+  EXPECT_TRUE(encoder.flush().empty());
+
+  Datagrams expected = block;
+  std::sort(expected.begin(), expected.end());
+  for (uint64_t dropped = 0; dropped < 32; ++dropped) {
+    if (bits(dropped) > 2) continue;
+    ASSERT_EQ(deliver(config, datagrams, dropped), expected)
+        << "dropped mask " << dropped;
+  }
+
+  // Parity ahead of the data it protects.
+  FecDecoder decoder(config);
+  Datagrams out;
+  for (size_t i : {3u, 4u, 0u}) {
+    for (auto &payload : decoder.decode(datagrams[i])) out.push_back(payload);
+  }
+  std::sort(out.begin(), out.end());
+  EXPECT_EQ(out, expected);
+  EXPECT_EQ(decoder.stats().recovered, 2u);
+}
+
+TEST(FecCodec, ParityDeadlineFollowsFirstPayload) {
+  FecConfig config;
+  config.scheme = FecScheme::XOR;
+  config.dataShards = 4;
+  config.parityDeadline = std::chrono::milliseconds(5);
+  FecEncoder encoder(config);
+  auto before = std::chrono::steady_clock::now();
+  encoder.encode(std::vector<uint8_t>(8, 1));
+  auto due = encoder.deadline();
+  EXPECT_GE(due, before + config.parityDeadline);
+  EXPECT_LE(due, std::chrono::steady_clock::now() + config.parityDeadline);
+  encoder.flush();
+  EXPECT_EQ(encoder.deadline(), std::chrono::steady_clock::time_point::max());
+}
+
+TEST(FecCodec, DecoderEvictsOldestIncompleteBlock) {
+  FecConfig config;
+  config.scheme = FecScheme::XOR;
+  config.dataShards = 4;
+  config.maxPendingBlocks = 2;
+  FecEncoder encoder(config);
+  Datagrams first = encodeBlock(encoder, payloads(4, 8));
+  Datagrams second = encodeBlock(encoder, payloads(4, 8));
+  Datagrams third = encodeBlock(encoder, payloads(4, 8));
+
+  FecDecoder decoder(config);
+  EXPECT_EQ(decoder.decode(first[0]).size(), 1u);
+  EXPECT_EQ(decoder.decode(second[0]).size(), 1u);
+  EXPECT_EQ(decoder.stats().unrecoverable, 0u);
+  // A third block pushes the first out with three data shards missing.
+  EXPECT_EQ(decoder.decode(third[0]).size(), 1u);
+  EXPECT_EQ(decoder.stats().unrecoverable, 3u);
+
+  // The first block's parity can no longer rebuild anything.
+  EXPECT_TRUE(decoder.decode(first[4]).empty());
+  EXPECT_EQ(decoder.stats().recovered, 0u);
+}
+
+TEST(FecCodec, PassesThroughForeignDatagrams) {
+  FecConfig config;
+  config.scheme = FecScheme::XOR;
+  FecDecoder decoder(config);
+  std::vector<uint8_t> plain = {1, 2, 3};
+  Datagrams out = decoder.decode(plain);
+  ASSERT_EQ(out.size(), 1u);
+  EXPECT_EQ(out[0], plain);
+}
+
+TEST(FecCodec, SendersDecodeIndependently) {
+  FecConfig config;
+  config.scheme = FecScheme::XOR;
+  config.dataShards = 4;
+  // Both number their blocks from 0, and their shards have one length.
+  FecEncoder a(config);
+  FecEncoder b(config);
+  Datagrams fromA = encodeBlock(a, payloads(4, 12));
+  Datagrams fromB = payloads(4, 12);
+  for (auto &payload : fromB) payload[0] ^= 0xFF;
+  Datagrams expected = payloads(4, 12);
+  expected.insert(expected.end(), fromB.begin(), fromB.end());
+  std::sort(expected.begin(), expected.end());
+  fromB = encodeBlock(b, fromB);
+
+  FecDecoder decoder(config);
+  auto now = std::chrono::steady_clock::now();
+  Datagrams out;
+  // Interleaved, each losing a different data shard.
+  for (size_t i = 0; i < fromA.size(); ++i) {
+    if (i != 0) {
+      for (auto &payload : decoder.decode("b", fromB[i], now)) {
+        out.push_back(payload);
+      }
+    }
+    if (i != 2) {
+      for (auto &payload : decoder.decode("a", fromA[i], now)) {
+        out.push_back(payload);
+      }
+    }
+  }
+  std::sort(out.begin(), out.end());
+  EXPECT_EQ(out, expected);
+  EXPECT_EQ(decoder.stats().recovered, 2u);
+}
+
+TEST(FecCodec, RestartedSenderStartsOver) {
+  FecConfig config;
+  config.scheme = FecScheme::XOR;
+  config.dataShards = 2;
+  config.maxPendingBlocks = 4;
+  config.peerIdleTimeout = std::chrono::milliseconds(100);
+  auto now = std::chrono::steady_clock::now();
+  FecDecoder decoder(config);
+
+  // A long run, then blocks from 0 again: further back than the window.
+  FecEncoder before(config);
+  for (int i = 0; i < 10; ++i) {
+    for (auto &datagram : encodeBlock(before, payloads(2, 5))) {
+      decoder.decode("a", datagram, now);
+    }
+  }
+  FecEncoder after(config);
+  Datagrams again = encodeBlock(after, payloads(2, 30));
+  EXPECT_EQ(decoder.decode("a", again[0], now).size(), 1u);
+  // Its lost shard is rebuilt from its own parity.
+  Datagrams rebuilt = decoder.decode("a", again[2], now);
+  ASSERT_EQ(rebuilt.size(), 1u);
+  EXPECT_EQ(rebuilt[0], payloads(2, 30)[1]);
+
+  // A short run is within the window; silence tells the restart apart.
+  FecEncoder third(config);
+  Datagrams once = encodeBlock(third, payloads(2, 50));
+  EXPECT_TRUE(decoder.decode("a", once[0], now).empty());
+  EXPECT_EQ(decoder.decode("a", once[0], now + std::chrono::milliseconds(150))
+                .size(),
+            1u);
+}
+
+TEST(FecCodec, ForgetsIdleAndLeastRecentSenders) {
+  FecConfig config;
+  config.scheme = FecScheme::XOR;
+  config.dataShards = 4;
+  config.maxPeers = 2;
+  config.peerIdleTimeout = std::chrono::milliseconds(100);
+  FecEncoder encoder(config);
+  Datagrams datagrams = encodeBlock(encoder, payloads(4, 8));
+  auto now = std::chrono::steady_clock::now();
+
+  FecDecoder decoder(config);
+  decoder.decode("a", datagrams[0], now);
+  decoder.decode("b", datagrams[0], now + std::chrono::milliseconds(1));
+  // A third sender pushes a out with three data shards missing.
+  decoder.decode("c", datagrams[0], now + std::chrono::milliseconds(2));
+  EXPECT_EQ(decoder.stats().unrecoverable, 3u);
+  decoder.expire(now + std::chrono::milliseconds(200));
+  EXPECT_EQ(decoder.stats().unrecoverable, 9u);
+}
@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "socket/Pacer.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// 1 MB/s: 10 000 bytes take 10 ms.
+PacingConfig megabyte(uint64_t burst) {
+  PacingConfig config;
+  config.enabled = true;
+  config.rateBytesPerSecond = 1000000;
+  config.burstBytes = burst;
+  config.mode = PacingMode::USER;
+  return config;
+}
+
+}  // namespace
+
+TEST(Pacer, DisabledAndKernelPacingNeverWait) {
+  Pacer pacer;
+  EXPECT_EQ(pacer.acquire(1 << 20).count(), 0);
+  EXPECT_EQ(pacer.stats().pacedWrites, 0u);
+
+  PacingConfig config = megabyte(0);
+  config.enabled = false;
+  pacer.configure(config, false);
+  EXPECT_EQ(pacer.acquire(1 << 20).count(), 0);
+
+  // The kernel paces; write() goes straight through.
+  pacer.configure(megabyte(0), true);
+  auto start = Clock::now();
+  for (int i = 0; i < 10; ++i) EXPECT_EQ(pacer.acquire(100000).count(), 0);
+  EXPECT_LT(Clock::now() - start, std::chrono::milliseconds(50));
+  EXPECT_TRUE(pacer.stats().kernelPacing);
+  EXPECT_EQ(pacer.stats().pacedWrites, 0u);
+}
+
+TEST(Pacer, BurstPassesThenRateHolds) {
+  Pacer pacer;
+  pacer.configure(megabyte(10000), false);
+  auto start = Clock::now();
+  EXPECT_EQ(pacer.acquire(10000).count(), 0);
+  EXPECT_EQ(pacer.stats().delayedWrites, 0u);
+
+  for (int i = 0; i < 10; ++i) pacer.acquire(10000);
+  auto elapsed = Clock::now() - start;
+  EXPECT_GE(elapsed, std::chrono::milliseconds(95));
+  EXPECT_LT(elapsed, std::chrono::milliseconds(300));
+
+  PacingStats stats = pacer.stats();
+  EXPECT_FALSE(stats.kernelPacing);
+  EXPECT_EQ(stats.pacedWrites, 11u);
+  EXPECT_EQ(stats.delayedWrites, 10u);
+}
+
+TEST(Pacer, DelayAccounting) {
+  Pacer pacer;
+  pacer.configure(megabyte(0), false);
+  std::chrono::nanoseconds waited{0};
+  for (int i = 0; i < 5; ++i) waited += pacer.acquire(10000);
+
+  // Each write owes 10 ms; time passing while one waits pays off part of
+  // the next.
+  PacingStats stats = pacer.stats();
+  EXPECT_EQ(stats.delayedWrites, 5u);
+  EXPECT_GE(stats.totalDelay, std::chrono::milliseconds(30));
+  EXPECT_LE(stats.totalDelay, std::chrono::milliseconds(51));
+  EXPECT_GE(stats.maxDelay, std::chrono::milliseconds(9));
+  EXPECT_LE(stats.maxDelay, std::chrono::milliseconds(10));
+  // The waits returned are the delays, give or take the clock reads.
+  EXPECT_GE(waited, stats.totalDelay - std::chrono::milliseconds(1));
+  EXPECT_LT(waited, stats.totalDelay + std::chrono::milliseconds(20));
+}
+
+TEST(Pacer, ConcurrentWritersShareTheRate) {
+  Pacer pacer;
+  pacer.configure(megabyte(5000), false);
+  auto start = Clock::now();
+  std::vector<std::thread> writers;
+  for (int t = 0; t < 4; ++t) {
+    writers.emplace_back([&pacer] {
+      for (int i = 0; i < 5; ++i) pacer.acquire(5000);
+    });
+  }
+  for (auto &writer : writers) writer.join();
+  // 100 000 bytes, less the 5 000 byte burst.
+  EXPECT_GE(Clock::now() - start, std::chrono::milliseconds(90));
+  EXPECT_EQ(pacer.stats().pacedWrites, 20u);
+}
+
+TEST(Pacer, ReconfiguringRefillsTheBucket) {
+  Pacer pacer;
+  pacer.configure(megabyte(10000), false);
+  pacer.acquire(10000);
+  pacer.configure(megabyte(10000), false);
+  EXPECT_EQ(pacer.acquire(10000).count(), 0);
+  EXPECT_EQ(pacer.stats().delayedWrites, 0u);
+}
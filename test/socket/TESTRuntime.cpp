@@ -0,0 +1,485 @@
+#include <gtest/gtest.h>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "socket/MpscQueue.h"
+#include "socket/Reactor.h"
+#include "socket/Runtime.h"
+#include "socket/UDP/UDPSocket.h"
+
+namespace {
+
+// Runs task on core and waits for it.
+template <typename Task>
+void runOn(Runtime &runtime, size_t core, Task task) {
+  std::promise<void> done;
+  ASSERT_TRUE(runtime.post(core, [&] {
+    task();
+    done.set_value();
+  }));
+  ASSERT_EQ(done.get_future().wait_for(std::chrono::seconds(5)),
+            std::future_status::ready);
+}
+
+RuntimeConfig smallConfig() {
+  RuntimeConfig config;
+  config.bufferSize = 4096;
+  config.buffersPerCore = 8;
+  return config;
+}
+
+using Clock = std::chrono::steady_clock;
+
+// Below the ephemeral range (32768 up by default): a port there can be
+// held by a client's connection, or one in TIME_WAIT, and bind() fails.
+int getRandomPort() {
+  std::random_device rd;
+  std::mt19937 gen(rd());
+  std::uniform_int_distribution<> distrib(10000, 32000);
+  return distrib(gen);
+}
+
+Serializable message(const std::string &text) {
+  return Serializable(std::vector<uint8_t>(text.begin(), text.end()));
+}
+
+// Collects what a socket hands its subscribers, and on which thread.
+class Inbox : public Subscriber {
+ public:
+  void update(Serializable data) override {
+    std::vector<uint8_t> bytes = static_cast<std::vector<uint8_t>>(data);
+    if (onUpdate) onUpdate();
+    std::lock_guard<std::mutex> lock(mutex);
+    messages.emplace_back(bytes.begin(), bytes.end());
+    threads.insert(std::this_thread::get_id());
+    arrived.notify_all();
+  }
+
+  bool waitFor(size_t count) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return arrived.wait_for(lock, std::chrono::seconds(2),
+                            [&] { return messages.size() >= count; });
+  }
+
+  std::vector<std::string> received() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return messages;
+  }
+
+  std::function<void()> onUpdate;  ///< Set before the socket is added.
+  std::mutex mutex;
+  std::condition_variable arrived;
+  std::vector<std::string> messages;
+  std::set<std::thread::id> threads;
+};
+
+// A socket that only asks to be dispatched again after each delay in turn.
+class TimedSocket : public Socket {
+ public:
+  explicit TimedSocket(std::vector<Clock::duration> delays)
+      : delays(std::move(delays)),
+        fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+
+  ~TimedSocket() override { ::close(fd); }
+
+  Serializable read() override { return Serializable(); }
+  void write(Serializable) override {}
+  void open() override {}
+  void close() override {}
+
+  int reactorHandle() override { return fd; }
+
+  Clock::time_point reactorDispatch() override {
+    std::lock_guard<std::mutex> lock(mutex);
+    Clock::time_point now = Clock::now();
+    calls.push_back(now);
+    if (calls.size() > delays.size()) return Clock::time_point::max();
+    due.push_back(now + delays[calls.size() - 1]);
+    return due.back();
+  }
+
+  // Dispatch times, and the deadline each one asked for.
+  std::pair<std::vector<Clock::time_point>, std::vector<Clock::time_point>>
+  history() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return {calls, due};
+  }
+
+  size_t dispatches() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return calls.size();
+  }
+
+ private:
+  std::vector<Clock::duration> delays;
+  int fd;
+  std::mutex mutex;
+  std::vector<Clock::time_point> calls;
+  std::vector<Clock::time_point> due;
+};
+
+bool eventually(const std::function<bool()> &condition) {
+  auto deadline = Clock::now() + std::chrono::seconds(2);
+  while (!condition()) {
+    if (Clock::now() > deadline) return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+}  // namespace
+
+TEST(MpscQueue, CapacityIsAPowerOfTwo) {
+  EXPECT_EQ(MpscQueue<int>(0).capacity(), 2u);
+  EXPECT_EQ(MpscQueue<int>(5).capacity(), 8u);
+  EXPECT_EQ(MpscQueue<int>(64).capacity(), 64u);
+}
+
+TEST(MpscQueue, FullAndEmpty) {
+  MpscQueue<std::vector<int>> queue(4);
+  int popped = 0;
+  std::vector<int> value;
+  EXPECT_TRUE(queue.empty());
+  EXPECT_FALSE(queue.tryPop(value));
+  for (int i = 0; i < 4; ++i) EXPECT_TRUE(queue.tryPush(std::vector<int>{i}));
+  EXPECT_FALSE(queue.empty());
+
+  // A failed push leaves the value with the caller.
+  std::vector<int> rejected{99};
+  EXPECT_FALSE(queue.tryPush(std::move(rejected)));
+  EXPECT_EQ(rejected, std::vector<int>{99});
+
+  while (queue.tryPop(value)) EXPECT_EQ(value[0], popped++);
+  EXPECT_EQ(popped, 4);
+  EXPECT_TRUE(queue.empty());
+  // The cells are reused after a wrap.
+  EXPECT_TRUE(queue.tryPush(std::vector<int>{4}));
+  ASSERT_TRUE(queue.tryPop(value));
+  EXPECT_EQ(value[0], 4);
+}
+
+TEST(MpscQueue, KeepsEachProducersOrder) {
+  const int producers = 4;
+  const uint32_t perProducer = 100000;
+  // Small, so producers keep finding it full.
+  MpscQueue<std::pair<int, uint32_t>> queue(64);
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&, p] {
+      for (uint32_t i = 0; i < perProducer; ++i) {
+        while (!queue.tryPush(std::make_pair(p, i))) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  std::vector<uint32_t> next(producers, 0);
+  bool ordered = true;
+  uint64_t received = 0;
+  std::pair<int, uint32_t> item;
+  while (received < producers * static_cast<uint64_t>(perProducer)) {
+    if (!queue.tryPop(item)) {
+      std::this_thread::yield();
+      continue;
+    }
+    ordered = ordered && item.second == next[item.first];
+    next[item.first] = item.second + 1;
+    ++received;
+  }
+  for (auto &thread : threads) thread.join();
+
+  EXPECT_TRUE(ordered);
+  for (int p = 0; p < producers; ++p) EXPECT_EQ(next[p], perProducer);
+  EXPECT_TRUE(queue.empty());
+  EXPECT_FALSE(queue.tryPop(item));
+}
+
+TEST(BufferPool, OtherThreadsReleaseToTheOwner) {
+  BufferPool pool(256, 4);
+  std::set<uint8_t *> taken;
+  for (int i = 0; i < 4; ++i) {
+    uint8_t *buffer = pool.acquire();
+    ASSERT_NE(buffer, nullptr);
+    taken.insert(buffer);
+  }
+  EXPECT_EQ(taken.size(), 4u);
+  EXPECT_EQ(pool.acquire(), nullptr);
+
+  // Released concurrently from other threads; they queue up for the owner.
+  std::vector<std::thread> threads;
+  for (uint8_t *buffer : taken) {
+    threads.emplace_back([&pool, buffer] { pool.release(buffer); });
+  }
+  for (auto &thread : threads) thread.join();
+
+  std::set<uint8_t *> again;
+  for (int i = 0; i < 4; ++i) again.insert(pool.acquire());
+  EXPECT_EQ(again, taken);
+  EXPECT_EQ(pool.acquire(), nullptr);
+
+  // The owner's own release is available at once.
+  pool.release(*taken.begin());
+  EXPECT_EQ(pool.acquire(), *taken.begin());
+}
+
+TEST(BufferPool, BuffersDoNotOverlap) {
+  BufferPool pool(100, 3);
+  std::vector<uint8_t *> buffers;
+  for (int i = 0; i < 3; ++i) buffers.push_back(pool.acquire());
+  std::sort(buffers.begin(), buffers.end());
+  for (size_t i = 1; i < buffers.size(); ++i) {
+    EXPECT_GE(buffers[i] - buffers[i - 1], 100);
+  }
+}
+
+TEST(Runtime, PostRunsInOrderOnTheCore) {
+  spdlog::set_level(spdlog::level::off);
+  Runtime runtime(smallConfig());
+  ASSERT_GT(runtime.cores(), 0u);
+  EXPECT_EQ(Runtime::currentCore(), -1);
+  EXPECT_FALSE(runtime.post(runtime.cores(), [] {}));
+
+  size_t core = runtime.cores() - 1;
+  const int count = 2000;
+  std::vector<int> order;
+  std::atomic<bool> offCore{false};
+  for (int i = 0; i < count; ++i) {
+    // The queue is bounded; a full queue is retried.
+    while (!runtime.post(core, [&, i] {
+      if (Runtime::currentCore() != static_cast<int>(core)) offCore = true;
+      order.push_back(i);
+    })) {
+      std::this_thread::yield();
+    }
+  }
+  runOn(runtime, core, [] {});
+
+  EXPECT_FALSE(offCore);
+  ASSERT_EQ(order.size(), static_cast<size_t>(count));
+  for (int i = 0; i < count; ++i) ASSERT_EQ(order[i], i);
+}
+
+TEST(Runtime, PostsFromSeveralThreadsKeepTheirOrder) {
+  spdlog::set_level(spdlog::level::off);
+  Runtime runtime(smallConfig());
+  const int threads = 3;
+  const int count = 1000;
+  // Only touched on core 0.
+  std::vector<std::vector<int>> seen(threads);
+  std::vector<std::thread> posters;
+  for (int t = 0; t < threads; ++t) {
+    posters.emplace_back([&, t] {
+      for (int i = 0; i < count; ++i) {
+        while (!runtime.post(0, [&seen, t, i] { seen[t].push_back(i); })) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (auto &poster : posters) poster.join();
+  runOn(runtime, 0, [] {});
+
+  for (int t = 0; t < threads; ++t) {
+    ASSERT_EQ(seen[t].size(), static_cast<size_t>(count));
+    EXPECT_TRUE(std::is_sorted(seen[t].begin(), seen[t].end()));
+  }
+}
+
+TEST(Runtime, BuffersComeBackToTheirCore) {
+  spdlog::set_level(spdlog::level::off);
+  Runtime runtime(smallConfig());
+  BufferPool &pool = runtime.buffers(0);
+  EXPECT_EQ(pool.bufferSize(), 4096u);
+
+  std::vector<uint8_t *> taken;
+  runOn(runtime, 0, [&] {
+    while (uint8_t *buffer = pool.acquire()) taken.push_back(buffer);
+  });
+  ASSERT_EQ(taken.size(), 8u);
+
+  // Released here, off the core, as a consumer on another thread would.
+  for (uint8_t *buffer : taken) pool.release(buffer);
+
+  size_t reacquired = 0;
+  runOn(runtime, 0, [&] {
+    while (pool.acquire() != nullptr) ++reacquired;
+  });
+  EXPECT_EQ(reacquired, taken.size());
+}
+
+TEST(Reactor, DispatchesAUdpSocketAsDatagramsArrive) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  UDPSocket receiver("127.0.0.1", port, 0);
+  UDPSocket sender("127.0.0.1", port + 1, port);
+  receiver.open();
+  sender.open();
+  auto inbox = std::make_shared<Inbox>();
+  receiver.addSubscriber(inbox);
+
+  Reactor reactor(2);
+  // Sent before the socket is added: the first dispatch takes it.
+  sender.write(message("early"));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  ASSERT_TRUE(reactor.add(receiver));
+  EXPECT_FALSE(reactor.add(receiver));
+  EXPECT_EQ(reactor.size(), 1u);
+  ASSERT_TRUE(inbox->waitFor(1));
+
+  // No one calls read(); each later datagram is dispatched on arrival.
+  for (int i = 0; i < 20; ++i) {
+    sender.write(message("datagram " + std::to_string(i)));
+    ASSERT_TRUE(inbox->waitFor(static_cast<size_t>(i) + 2)) << "datagram " << i;
+  }
+  std::vector<std::string> received = inbox->received();
+  EXPECT_EQ(received.front(), "early");
+  for (int i = 0; i < 20; ++i) {
+    EXPECT_EQ(received[static_cast<size_t>(i) + 1],
+              "datagram " + std::to_string(i));
+  }
+  EXPECT_EQ(inbox->threads.count(std::this_thread::get_id()), 0u);
+
+  reactor.remove(receiver);
+  EXPECT_EQ(reactor.size(), 0u);
+  receiver.close();
+}
+
+TEST(Reactor, DeadlinesDispatchAgain) {
+  spdlog::set_level(spdlog::level::off);
+  Reactor reactor(1);
+  TimedSocket timed(std::vector<Clock::duration>(
+      5, std::chrono::milliseconds(20)));
+  ASSERT_TRUE(reactor.add(timed));
+  // The first dispatch and one per deadline, then none.
+  ASSERT_TRUE(eventually([&] { return timed.dispatches() == 6; }));
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(timed.dispatches(), 6u);
+  auto history = timed.history();
+  for (size_t i = 0; i < history.second.size(); ++i) {
+    // Never before the deadline, and not long after it.
+    EXPECT_GE(history.first[i + 1], history.second[i]) << "dispatch " << i;
+    EXPECT_LT(history.first[i + 1] - history.second[i],
+              std::chrono::milliseconds(100))
+        << "dispatch " << i;
+  }
+
+  // A nearer deadline wakes the thread sleeping until a far one.
+  TimedSocket far({std::chrono::seconds(30)});
+  ASSERT_TRUE(reactor.add(far));
+  ASSERT_TRUE(eventually([&] { return far.dispatches() == 1; }));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  TimedSocket near({std::chrono::milliseconds(30)});
+  ASSERT_TRUE(reactor.add(near));
+  ASSERT_TRUE(eventually([&] { return near.dispatches() == 2; }));
+  auto nearHistory = near.history();
+  EXPECT_LT(nearHistory.first[1] - nearHistory.second[0],
+            std::chrono::milliseconds(100));
+  EXPECT_EQ(far.dispatches(), 1u);
+
+  // A removed socket's deadline does not fire.
+  TimedSocket removed({std::chrono::milliseconds(30)});
+  ASSERT_TRUE(reactor.add(removed));
+  ASSERT_TRUE(eventually([&] { return removed.dispatches() == 1; }));
+  reactor.remove(removed);
+  std::this_thread::sleep_for(std::chrono::milliseconds(80));
+  EXPECT_EQ(removed.dispatches(), 1u);
+  reactor.remove(far);
+  reactor.remove(near);
+  reactor.remove(timed);
+}
+
+TEST(Reactor, SubscriberRemovesItsOwnSocket) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  UDPSocket receiver("127.0.0.1", port, 0);
+  UDPSocket sender("127.0.0.1", port + 1, port);
+  receiver.open();
+  sender.open();
+  Reactor reactor(2);
+  auto inbox = std::make_shared<Inbox>();
+  // Would wait for its own dispatch to end if remove() did not know it.
+  inbox->onUpdate = [&] { reactor.remove(receiver); };
+  receiver.addSubscriber(inbox);
+  ASSERT_TRUE(reactor.add(receiver));
+
+  sender.write(message("last dispatched"));
+  ASSERT_TRUE(inbox->waitFor(1));
+  EXPECT_TRUE(eventually([&] { return reactor.size() == 0; }));
+
+  // Left for read() now, which hands it to the subscriber too.
+  sender.write(message("read by hand"));
+  std::vector<uint8_t> bytes = static_cast<std::vector<uint8_t>>(
+      receiver.read(Clock::now() + std::chrono::seconds(1)));
+  EXPECT_EQ(std::string(bytes.begin(), bytes.end()), "read by hand");
+  EXPECT_EQ(inbox->received(),
+            (std::vector<std::string>{"last dispatched", "read by hand"}));
+  receiver.close();
+}
+
+TEST(Reactor, PostedTasksRunInOrder) {
+  spdlog::set_level(spdlog::level::off);
+  Reactor reactor(3);
+  const int threads = 3;
+  const int count = 1000;
+  std::mutex mutex;
+  std::vector<std::vector<int>> seen(threads);
+  std::set<std::thread::id> ranOn;
+  std::vector<std::thread> posters;
+  for (int t = 0; t < threads; ++t) {
+    posters.emplace_back([&, t] {
+      for (int i = 0; i < count; ++i) {
+        // A failing task does not stop those behind it.
+        if (i == count / 2) {
+          reactor.post([] { throw std::runtime_error("failed task"); });
+        }
+        while (!reactor.post([&, t, i] {
+          std::lock_guard<std::mutex> lock(mutex);
+          seen[t].push_back(i);
+          ranOn.insert(std::this_thread::get_id());
+        })) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  std::set<std::thread::id> posterIds;
+  for (auto &poster : posters) {
+    posterIds.insert(poster.get_id());
+    poster.join();
+  }
+  ASSERT_TRUE(eventually([&] {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t total = 0;
+    for (auto &each : seen) total += each.size();
+    return total == static_cast<size_t>(threads * count);
+  }));
+
+  std::lock_guard<std::mutex> lock(mutex);
+  for (int t = 0; t < threads; ++t) {
+    ASSERT_EQ(seen[t].size(), static_cast<size_t>(count));
+    for (int i = 0; i < count; ++i) ASSERT_EQ(seen[t][i], i) << "poster " << t;
+  }
+  for (auto id : ranOn) {
+    EXPECT_EQ(posterIds.count(id), 0u);
+    EXPECT_NE(id, std::this_thread::get_id());
+  }
+}
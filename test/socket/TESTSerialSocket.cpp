@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "socket/Serial/SerialSocket.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// The slave end of a pseudo-terminal, standing in for a serial port.
+class Pty {
+ public:
+  Pty() {
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master != -1 && grantpt(master) == 0 && unlockpt(master) == 0) {
+      name = ptsname(master);
+    }
+  }
+  ~Pty() {
+    if (master != -1) ::close(master);
+  }
+
+  bool send(const std::string &text) {
+    return ::write(master, text.data(), text.size()) ==
+           static_cast<ssize_t>(text.size());
+  }
+
+  int master = -1;
+  std::string name;
+};
+
+std::string text(Serializable serializable) {
+  std::vector<uint8_t> data = static_cast<std::vector<uint8_t>>(serializable);
+  return std::string(data.begin(), data.end());
+}
+
+}  // namespace
+
+TEST(SerialSocket, ReadsWaitNoLongerThanTheirDeadline) {
+  spdlog::set_level(spdlog::level::off);
+  Pty pty;
+  ASSERT_FALSE(pty.name.empty());
+  SerialSocket port(pty.name);
+  port.open();
+
+  auto start = Clock::now();
+  EXPECT_TRUE(port.tryRead().empty());
+  EXPECT_TRUE(port.read().empty());
+  EXPECT_TRUE(port.read(Clock::now() + std::chrono::milliseconds(100)).empty());
+  auto waited = Clock::now() - start;
+  // read() waits 50 ms.
+  EXPECT_GE(waited, std::chrono::milliseconds(150));
+  EXPECT_LT(waited, std::chrono::seconds(1));
+
+  ASSERT_TRUE(pty.send("hello"));
+  EXPECT_EQ(text(port.read(Clock::now() + std::chrono::seconds(5))), "hello");
+  ASSERT_TRUE(pty.send("again"));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(text(port.tryRead()), "again");
+}
+
+TEST(SerialSocket, CancelWakesAWaitingRead) {
+  spdlog::set_level(spdlog::level::off);
+  Pty pty;
+  ASSERT_FALSE(pty.name.empty());
+  SerialSocket port(pty.name);
+  port.open();
+
+  // A cancel() nobody waits for does not end later reads.
+  port.cancel();
+  EXPECT_TRUE(port.read(Clock::now() + std::chrono::milliseconds(50)).empty());
+
+  auto reader = std::async(std::launch::async, [&] {
+    return port.read(Clock::time_point::max());
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  auto cancelled = Clock::now();
+  port.cancel();
+  ASSERT_EQ(reader.wait_for(std::chrono::seconds(1)),
+            std::future_status::ready);
+  EXPECT_TRUE(reader.get().empty());
+  EXPECT_LT(Clock::now() - cancelled, std::chrono::milliseconds(100));
+
+  ASSERT_TRUE(pty.send("after"));
+  EXPECT_EQ(text(port.read(Clock::now() + std::chrono::seconds(5))), "after");
+}
+
+TEST(SerialSocket, CloseWakesAWaitingRead) {
+  spdlog::set_level(spdlog::level::off);
+  Pty pty;
+  ASSERT_FALSE(pty.name.empty());
+  SerialSocket port(pty.name);
+  port.open();
+
+  auto reader = std::async(std::launch::async, [&] {
+    return port.read(Clock::time_point::max());
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  port.close();
+  ASSERT_EQ(reader.wait_for(std::chrono::seconds(1)),
+            std::future_status::ready);
+  EXPECT_TRUE(reader.get().empty());
+  EXPECT_TRUE(port.tryRead().empty());
+}
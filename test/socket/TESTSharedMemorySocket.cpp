@@ -0,0 +1,256 @@
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "socket/SharedMemory/SharedMemorySocket.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// The smallest ring the socket makes.
+const size_t kCapacity = 4096;
+
+// A segment name no other test run uses.
+std::string segmentName() {
+  std::random_device rd;
+  return "/socketlib-test-" + std::to_string(getpid()) + "-" +
+         std::to_string(rd());
+}
+
+Serializable message(const std::string &text) {
+  return Serializable(std::vector<uint8_t>(text.begin(), text.end()));
+}
+
+std::string text(Serializable serializable) {
+  std::vector<uint8_t> data = static_cast<std::vector<uint8_t>>(serializable);
+  return std::string(data.begin(), data.end());
+}
+
+// Distinct bytes, so a message read from the wrong offset shows.
+std::string pattern(size_t size, int seed) {
+  std::string bytes(size, '\0');
+  for (size_t i = 0; i < size; ++i) {
+    bytes[i] =
+        static_cast<char>('a' + (i * 7 + static_cast<size_t>(seed)) % 26);
+  }
+  return bytes;
+}
+
+ShmRingConfig smallRing(std::chrono::milliseconds readTimeout =
+                            std::chrono::milliseconds(1000)) {
+  ShmRingConfig config;
+  config.capacity = kCapacity;
+  config.readTimeout = readTimeout;
+  return config;
+}
+
+}  // namespace
+
+TEST(SharedMemorySocket, RecordsSkipTheEndOfTheRing) {
+  spdlog::set_level(spdlog::level::off);
+  std::string name = segmentName();
+  SharedMemorySocket creator(name, SharedMemorySocket::CREATOR, smallRing());
+  creator.open();
+  SharedMemorySocket attached(name, SharedMemorySocket::ATTACH, smallRing());
+  attached.open();
+
+  // Sizes that leave every record boundary at a different offset, so the
+  // rings wrap many times with padding of many lengths. Both directions are
+  // filled before either is read, so a record running past the end of one
+  // ring would land in the other.
+  size_t written = 0;
+  for (int i = 0; i < 200; ++i) {
+    size_t size = 500 + static_cast<size_t>(i) * 37 % 900;
+    std::string sent = pattern(size, i);
+    std::string reply = pattern(size, i + 1);
+    attached.write(message(sent));
+    attached.write(message(sent.substr(0, 3)));
+    creator.write(message(reply));
+    written += size;
+    ASSERT_EQ(text(creator.read()), sent) << "message " << i;
+    ASSERT_EQ(text(creator.read()), sent.substr(0, 3)) << "message " << i;
+    ASSERT_EQ(text(attached.read()), reply) << "message " << i;
+    EXPECT_EQ(creator.pending(), 0u);
+    EXPECT_EQ(attached.pending(), 0u);
+  }
+  EXPECT_GT(written, 20 * kCapacity);
+}
+
+TEST(SharedMemorySocket, FullRingRefusesUntilRead) {
+  spdlog::set_level(spdlog::level::off);
+  std::string name = segmentName();
+  auto config = smallRing(std::chrono::milliseconds(50));
+  SharedMemorySocket creator(name, SharedMemorySocket::CREATOR, config);
+  creator.open();
+  SharedMemorySocket attached(name, SharedMemorySocket::ATTACH, config);
+  attached.open();
+
+  // 1016 bytes plus the header fill the 4096-byte ring in four.
+  std::vector<std::string> sent;
+  for (int i = 0; i < 4; ++i) {
+    sent.push_back(pattern(1016, i));
+    attached.write(message(sent.back()));
+  }
+  EXPECT_EQ(creator.pending(), kCapacity);
+  EXPECT_EQ(attached.reserve(1).data, nullptr);
+
+  // write() waits the timeout for space, then drops the message.
+  auto start = Clock::now();
+  attached.write(message("dropped"));
+  EXPECT_GE(Clock::now() - start, std::chrono::milliseconds(50));
+
+  // A message larger than the ring is dropped straight away.
+  EXPECT_EQ(attached.reserve(kCapacity).data, nullptr);
+  attached.write(message(pattern(kCapacity, 0)));
+
+  EXPECT_EQ(text(creator.read()), sent[0]);
+  ShmSlot slot = attached.reserve(7);
+  ASSERT_NE(slot.data, nullptr);
+  std::memcpy(slot.data, "after 0", 7);
+  attached.commit(slot);
+  for (int i = 1; i < 4; ++i) EXPECT_EQ(text(creator.read()), sent[i]);
+  EXPECT_EQ(text(creator.read()), "after 0");
+  EXPECT_TRUE(creator.read().empty());
+}
+
+TEST(SharedMemorySocket, ReadersWaitForSlotsCommittedOutOfOrder) {
+  spdlog::set_level(spdlog::level::off);
+  std::string name = segmentName();
+  auto config = smallRing(std::chrono::milliseconds(50));
+  config.multiProducer = true;
+  SharedMemorySocket creator(name, SharedMemorySocket::CREATOR, config);
+  creator.open();
+  SharedMemorySocket attached(name, SharedMemorySocket::ATTACH, config);
+  attached.open();
+
+  ShmSlot first = attached.reserve(5);
+  ShmSlot second = attached.reserve(6);
+  ASSERT_NE(first.data, nullptr);
+  ASSERT_NE(second.data, nullptr);
+  EXPECT_GT(second.position, first.position);
+  std::memcpy(second.data, "second", 6);
+  attached.commit(second);
+  // The second is ready but the reader reads in reservation order.
+  EXPECT_TRUE(creator.read().empty());
+  std::memcpy(first.data, "first", 5);
+  attached.commit(first);
+  EXPECT_EQ(text(creator.read()), "first");
+  EXPECT_EQ(text(creator.read()), "second");
+
+  // close() waits for a reserved slot to be committed.
+  ShmSlot open = attached.reserve(4);
+  ASSERT_NE(open.data, nullptr);
+  auto closed = std::async(std::launch::async, [&] { attached.close(); });
+  EXPECT_EQ(closed.wait_for(std::chrono::milliseconds(100)),
+            std::future_status::timeout);
+  std::memcpy(open.data, "last", 4);
+  attached.commit(open);
+  EXPECT_EQ(closed.wait_for(std::chrono::seconds(1)),
+            std::future_status::ready);
+  EXPECT_EQ(text(creator.read()), "last");
+  EXPECT_EQ(attached.reserve(1).data, nullptr);
+}
+
+TEST(SharedMemorySocket, SeveralWritersShareTheRing) {
+  spdlog::set_level(spdlog::level::off);
+  const int kWriters = 4;
+  const int kMessages = 5000;
+  std::string name = segmentName();
+  auto config = smallRing(std::chrono::milliseconds(5000));
+  config.multiProducer = true;
+  SharedMemorySocket creator(name, SharedMemorySocket::CREATOR, config);
+  creator.open();
+
+  // Half the writers share a socket, half have their own; the small ring
+  // keeps them contending for space as well as for the head.
+  SharedMemorySocket shared(name, SharedMemorySocket::ATTACH, config);
+  shared.open();
+  std::vector<std::unique_ptr<SharedMemorySocket>> own;
+  std::vector<std::thread> writers;
+  for (int w = 0; w < kWriters; ++w) {
+    SharedMemorySocket *socket = &shared;
+    if (w % 2 == 1) {
+      own.push_back(std::make_unique<SharedMemorySocket>(
+          name, SharedMemorySocket::ATTACH, config));
+      own.back()->open();
+      socket = own.back().get();
+    }
+    writers.emplace_back([socket, w] {
+      for (int i = 0; i < kMessages; ++i) {
+        std::string body = std::to_string(w) + ":" + std::to_string(i) + ":";
+        socket->write(
+            message(body + pattern(static_cast<size_t>(i % 200), i)));
+      }
+    });
+  }
+
+  // Checked once the writers are done, so a failure does not leave them
+  // running.
+  std::vector<std::string> received;
+  while (received.size() < static_cast<size_t>(kWriters * kMessages)) {
+    std::string got = text(creator.read());
+    if (got.empty()) break;
+    received.push_back(got);
+  }
+  for (std::thread &writer : writers) writer.join();
+  ASSERT_EQ(received.size(), static_cast<size_t>(kWriters * kMessages));
+
+  std::vector<int> next(kWriters, 0);
+  for (const std::string &got : received) {
+    size_t colon = got.find(':');
+    size_t second = got.find(':', colon + 1);
+    ASSERT_NE(second, std::string::npos) << got;
+    int w = std::stoi(got.substr(0, colon));
+    int i = std::stoi(got.substr(colon + 1, second - colon - 1));
+    ASSERT_GE(w, 0);
+    ASSERT_LT(w, kWriters);
+    // Each writer's messages arrive whole and in its order.
+    ASSERT_EQ(i, next[w]) << "writer " << w;
+    ASSERT_EQ(got.substr(second + 1),
+              pattern(static_cast<size_t>(i % 200), i));
+    ++next[w];
+  }
+  EXPECT_EQ(creator.pending(), 0u);
+}
+
+TEST(SharedMemorySocket, SleepingReaderIsWoken) {
+  spdlog::set_level(spdlog::level::off);
+  std::string name = segmentName();
+  auto config = smallRing(std::chrono::milliseconds(5000));
+  // Straight to the futex.
+  config.spinIterations = 0;
+  SharedMemorySocket creator(name, SharedMemorySocket::CREATOR, config);
+  creator.open();
+  SharedMemorySocket attached(name, SharedMemorySocket::ATTACH, config);
+  attached.open();
+
+  for (int round = 0; round < 5; ++round) {
+    auto reading =
+        std::async(std::launch::async, [&] { return text(creator.read()); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    auto sent = Clock::now();
+    attached.write(message("wake " + std::to_string(round)));
+    ASSERT_EQ(reading.wait_for(std::chrono::seconds(1)),
+              std::future_status::ready);
+    EXPECT_EQ(reading.get(), "wake " + std::to_string(round));
+    EXPECT_LT(Clock::now() - sent, std::chrono::milliseconds(500));
+  }
+
+  // close() wakes it too.
+  auto reading = std::async(std::launch::async, [&] { return creator.read(); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  creator.close();
+  ASSERT_EQ(reading.wait_for(std::chrono::seconds(1)),
+            std::future_status::ready);
+  EXPECT_TRUE(reading.get().empty());
+}
@@ -0,0 +1,196 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "socket/Serial/SerialSocket.h"
+#include "socket/StreamReader.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Hands out scripted chunks, one per read(); empty once they run out.
+class ScriptedSocket : public Socket {
+ public:
+  Serializable read() override {
+    ++reads;
+    if (chunks.empty()) return Serializable();
+    std::vector<uint8_t> chunk = chunks.front();
+    chunks.pop_front();
+    return Serializable(chunk);
+  }
+  void write(Serializable) override {}
+  void open() override {}
+  void close() override {}
+
+  void add(const std::string &text) {
+    chunks.emplace_back(text.begin(), text.end());
+  }
+  void add(const std::vector<uint8_t> &chunk) { chunks.push_back(chunk); }
+
+  std::deque<std::vector<uint8_t>> chunks;
+  int reads = 0;
+};
+
+std::string text(const StreamView &view) {
+  return std::string(view.data, view.data + view.size);
+}
+
+// Bytes of message i, of a length that is not a divisor of the capacity.
+std::vector<uint8_t> payload(size_t i, size_t length) {
+  std::vector<uint8_t> result(length);
+  for (size_t b = 0; b < length; ++b) {
+    result[b] = static_cast<uint8_t>(i * 13 + b * 7);
+  }
+  return result;
+}
+
+// Reads messages of a third to over half the capacity, so most of them
+// start near the end of the ring. Returns how many were intact and counts
+// those that straddled the end of the buffer.
+size_t readAcrossEnd(bool mirror, size_t &straddled) {
+  ScriptedSocket source;
+  StreamReader reader(source, 4096, mirror);
+  EXPECT_EQ(reader.isMirrored(), mirror);
+  const size_t count = 50;
+  auto length = [&](size_t i) {
+    return reader.capacity() / 3 + i * reader.capacity() / 200;
+  };
+  std::vector<uint8_t> stream;
+  for (size_t i = 0; i < count; ++i) {
+    std::vector<uint8_t> message = payload(i, length(i));
+    stream.insert(stream.end(), message.begin(), message.end());
+  }
+  // Chunks that do not line up with messages, so the buffer never empties
+  // and its start moves round the ring.
+  const size_t chunk = 1000;
+  for (size_t at = 0; at < stream.size(); at += chunk) {
+    size_t end = std::min(at + chunk, stream.size());
+    source.add(std::vector<uint8_t>(stream.begin() + at, stream.begin() + end));
+  }
+  const uint8_t *first = nullptr;
+  size_t intact = 0;
+  straddled = 0;
+  for (size_t i = 0; i < count; ++i) {
+    std::vector<uint8_t> expected = payload(i, length(i));
+    StreamView view = reader.readExact(expected.size());
+    if (first == nullptr) first = view.data;
+    if (view.size == expected.size() &&
+        std::equal(expected.begin(), expected.end(), view.data)) {
+      ++intact;
+    }
+    if (view.data + view.size > first + reader.capacity()) ++straddled;
+  }
+  return intact;
+}
+
+}  // namespace
+
+TEST(StreamReader, MessagesWrapAcrossTheMirror) {
+  spdlog::set_level(spdlog::level::off);
+  size_t straddled = 0;
+  EXPECT_EQ(readAcrossEnd(true, straddled), 50u);
+#ifdef __linux__
+  // Returned in place, running on into the second mapping.
+  EXPECT_GT(straddled, 0u);
+#endif
+}
+
+TEST(StreamReader, CompactingFallbackKeepsMessagesWhole) {
+  spdlog::set_level(spdlog::level::off);
+  size_t straddled = 0;
+  EXPECT_EQ(readAcrossEnd(false, straddled), 50u);
+  // Compaction keeps every message inside the buffer.
+  EXPECT_EQ(straddled, 0u);
+}
+
+TEST(StreamReader, ReadUntilResumesScanAcrossFills) {
+  ScriptedSocket source;
+  for (char c : std::string("one line\n")) source.add(std::string(1, c));
+  source.add("two\nthree");
+  source.add("\nfour");
+  StreamReader reader(source, 4096);
+
+  EXPECT_EQ(text(reader.readUntil('\n')), "one line\n");
+  EXPECT_EQ(source.reads, 9);
+  EXPECT_EQ(text(reader.readUntil('\n')), "two\n");
+  EXPECT_EQ(text(reader.readUntil('\n')), "three\n");
+  // No delimiter before the source runs dry; what arrived stays buffered.
+  EXPECT_TRUE(reader.readUntil('\n').empty());
+  source.add("\n");
+  EXPECT_EQ(text(reader.readUntil('\n')), "four\n");
+}
+
+TEST(StreamReader, ReadUntilStopsAtMaxLength) {
+  spdlog::set_level(spdlog::level::off);
+  ScriptedSocket source;
+  source.add("abcdef");
+  source.add("gh;");
+  StreamReader reader(source, 4096);
+  EXPECT_TRUE(reader.readUntil(';', 5).empty());
+  EXPECT_EQ(text(reader.readUntil(';')), "abcdefgh;");
+}
+
+TEST(StreamReader, PeekLeavesBytesBuffered) {
+  spdlog::set_level(spdlog::level::off);
+  ScriptedSocket source;
+  source.add("head");
+  StreamReader reader(source, 4096);
+  EXPECT_TRUE(reader.peek(reader.capacity() + 1).empty());
+  EXPECT_TRUE(reader.readExact(6).empty());
+  EXPECT_EQ(text(reader.buffered()), "head");
+  source.add("er");
+  EXPECT_EQ(text(reader.peek(6)), "header");
+  EXPECT_EQ(text(reader.readExact(6)), "header");
+  EXPECT_TRUE(reader.buffered().empty());
+}
+
+#ifndef _WIN32
+TEST(StreamReader, DescriptorSourceReportsEnd) {
+  int pipeFds[2];
+  ASSERT_EQ(pipe(pipeFds), 0);
+  const std::string data = "length:5;hello";
+  ASSERT_EQ(::write(pipeFds[1], data.data(), data.size()),
+            static_cast<ssize_t>(data.size()));
+  ::close(pipeFds[1]);
+
+  StreamReader reader(pipeFds[0], 4096);
+  EXPECT_EQ(text(reader.readUntil(';')), "length:5;");
+  EXPECT_EQ(text(reader.readExact(5)), "hello");
+  EXPECT_TRUE(reader.readExact(1).empty());
+  EXPECT_TRUE(reader.eof());
+  ::close(pipeFds[0]);
+}
+
+TEST(StreamReader, ReadsASerialPort) {
+  spdlog::set_level(spdlog::level::off);
+  // The slave end of a pseudo-terminal stands in for the port.
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  ASSERT_NE(master, -1);
+  ASSERT_EQ(grantpt(master), 0);
+  ASSERT_EQ(unlockpt(master), 0);
+  SerialSocket port(ptsname(master));
+  port.open();
+  StreamReader reader(port, 4096);
+
+  // The port is non-blocking; with nothing sent, reads time out.
+  EXPECT_TRUE(port.read().empty());
+  EXPECT_TRUE(reader.readExact(1).empty());
+
+  const std::string data = "length:5;hello";
+  ASSERT_EQ(::write(master, data.data(), 9), 9);
+  EXPECT_EQ(text(reader.readUntil(';')), "length:5;");
+  ASSERT_EQ(::write(master, data.data() + 9, 5), 5);
+  EXPECT_EQ(text(reader.readExact(5)), "hello");
+  port.close();
+  ::close(master);
+}
+#endif
@@ -0,0 +1,1297 @@
+#include <gtest/gtest.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "socket/IoUring.h"
+#include "socket/TCP/LinuxTCP/LinuxTCPSocket.h"
+#include "socket/TCP/LinuxTCP/ShardedTCPServer.h"
+#include "socket/TCP/LinuxTCP/TCPConnectionPool.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Below the ephemeral range (32768 up by default): a port there can be
+// held by a client's connection, or one in TIME_WAIT, and bind() fails.
+int getRandomPort() {
+  std::random_device rd;
+  std::mt19937 gen(rd());
+  std::uniform_int_distribution<> distrib(10000, 32000);
+  return distrib(gen);
+}
+
+Serializable message(const std::string &text) {
+  return Serializable(std::vector<uint8_t>(text.begin(), text.end()));
+}
+
+std::string text(Serializable serializable) {
+  std::vector<uint8_t> data = static_cast<std::vector<uint8_t>>(serializable);
+  return std::string(data.begin(), data.end());
+}
+
+// Byte i of a stream of patterned messages.
+uint8_t pattern(size_t i) { return static_cast<uint8_t>(i % 251); }
+
+bool waitFor(const std::function<bool()> &done,
+             std::chrono::milliseconds timeout = std::chrono::seconds(5)) {
+  auto deadline = Clock::now() + timeout;
+  while (!done()) {
+    if (Clock::now() > deadline) return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  return true;
+}
+
+// Records what a socket hands to its subscribers. While held, update()
+// blocks, and with it the socket's event loop.
+class Recorder : public Subscriber {
+ public:
+  void update(Serializable) override {}
+
+  void update(Serializable updateData, ConnectionId connection) override {
+    std::vector<uint8_t> data = static_cast<std::vector<uint8_t>>(updateData);
+    std::unique_lock<std::mutex> lock(mutex);
+    released.wait(lock, [this] { return !holding; });
+    bytes.insert(bytes.end(), data.begin(), data.end());
+    lastConnection = connection;
+  }
+
+  void onConnectionEvent(ConnectionId connection,
+                         ConnectionEvent event) override {
+    std::lock_guard<std::mutex> lock(mutex);
+    (event == ConnectionEvent::CONNECTED ? connected : disconnected)
+        .push_back(connection);
+  }
+
+  void hold() {
+    std::lock_guard<std::mutex> lock(mutex);
+    holding = true;
+  }
+
+  void release() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      holding = false;
+    }
+    released.notify_all();
+  }
+
+  size_t received() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return bytes.size();
+  }
+
+  std::mutex mutex;
+  std::condition_variable released;
+  bool holding = false;
+  std::vector<uint8_t> bytes;
+  ConnectionId lastConnection = 0;
+  std::vector<ConnectionId> connected;
+  std::vector<ConnectionId> disconnected;
+};
+
+std::unique_ptr<LinuxTCPSocket> client(int port,
+                                       IoBackend backend = IoBackend::EPOLL) {
+  std::unique_ptr<LinuxTCPSocket> socket(
+      new LinuxTCPSocket("127.0.0.1", 0, port, TCPSocket::CLIENT, 3, 1));
+  socket->setIoBackend(backend);
+  socket->open();
+  return socket;
+}
+
+// An unlinked temporary file holding size patterned bytes from first on.
+int patternFile(size_t size, size_t first = 0) {
+  const char *directory = std::getenv("TMPDIR");
+  std::string path =
+      std::string(directory != nullptr ? directory : "/tmp") +
+      "/socketlib-test-XXXXXX";
+  int fd = mkstemp(&path[0]);
+  if (fd == -1) return -1;
+  unlink(path.c_str());
+  std::vector<uint8_t> data(size);
+  for (size_t i = 0; i < size; ++i) data[i] = pattern(first + i);
+  if (::write(fd, data.data(), size) != static_cast<ssize_t>(size) ||
+      lseek(fd, 0, SEEK_SET) != 0) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+bool ioUringSupported() {
+#ifdef SOCKET_LIB_HAS_IO_URING
+  return IoUring::supported();
+#else
+  return false;
+#endif
+}
+
+// The backend a socket asked for backend ends up with.
+IoBackend resolved(IoBackend backend) {
+  if (backend == IoBackend::EPOLL || !ioUringSupported()) {
+    return IoBackend::EPOLL;
+  }
+  return IoBackend::IO_URING;
+}
+
+std::string backendName(const ::testing::TestParamInfo<IoBackend> &info) {
+  switch (info.param) {
+    case IoBackend::AUTO:
+      return "AUTO";
+    case IoBackend::IO_URING:
+      return "IO_URING";
+    default:
+      return "EPOLL";
+  }
+}
+
+}  // namespace
+
+// Loopback exchanges run over every I/O backend, server and clients alike.
+// AUTO runs everywhere, on EPOLL where io_uring is missing.
+class LinuxTCPSocketLoopback : public ::testing::TestWithParam<IoBackend> {
+ protected:
+  void SetUp() override {
+    if (GetParam() == IoBackend::IO_URING && !ioUringSupported()) {
+      GTEST_SKIP() << "io_uring is not supported by this kernel";
+    }
+  }
+};
+
+INSTANTIATE_TEST_SUITE_P(Backend, LinuxTCPSocketLoopback,
+                         ::testing::Values(IoBackend::EPOLL,
+                                           IoBackend::IO_URING,
+                                           IoBackend::AUTO),
+                         backendName);
+
+TEST_P(LinuxTCPSocketLoopback, AcceptsManyClients) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  LinuxTCPSocket server("127.0.0.1", port, 0, TCPSocket::SERVER, 3, 1);
+  server.setIoBackend(GetParam());
+  auto events = std::make_shared<Recorder>();
+  server.addSubscriber(events);
+  server.open();
+
+  std::vector<std::unique_ptr<LinuxTCPSocket>> clients;
+  for (int i = 0; i < 4; ++i) clients.push_back(client(port, GetParam()));
+  ASSERT_TRUE(waitFor([&] { return server.getConnections().size() == 4; }));
+  EXPECT_EQ(server.getIoBackend(), resolved(GetParam()));
+  EXPECT_EQ(clients[0]->getIoBackend(), resolved(GetParam()));
+
+  // Each reply goes back to the connection the request came from.
+  for (int i = 0; i < 4; ++i) {
+    clients[i]->write(message("hello " + std::to_string(i)));
+    ConnectionId from = 0;
+    std::string request = text(server.read(from));
+    ASSERT_EQ(request, "hello " + std::to_string(i));
+    EXPECT_TRUE(server.writeTo(from, message("reply " + std::to_string(i))));
+  }
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(text(clients[i]->read()), "reply " + std::to_string(i));
+  }
+
+  std::lock_guard<std::mutex> lock(events->mutex);
+  EXPECT_EQ(events->connected.size(), 4u);
+  for (size_t i = 1; i < events->connected.size(); ++i) {
+    EXPECT_NE(events->connected[i], events->connected[0]);
+  }
+}
+
+TEST_P(LinuxTCPSocketLoopback, BroadcastReachesEveryClient) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  LinuxTCPSocket server("127.0.0.1", port, 0, TCPSocket::SERVER, 3, 1);
+  server.setIoBackend(GetParam());
+  server.open();
+  std::vector<std::unique_ptr<LinuxTCPSocket>> clients;
+  for (int i = 0; i < 3; ++i) clients.push_back(client(port, GetParam()));
+  ASSERT_TRUE(waitFor([&] { return server.getConnections().size() == 3; }));
+
+  EXPECT_EQ(server.broadcast(message("all")), 3u);
+  for (auto &peer : clients) EXPECT_EQ(text(peer->read()), "all");
+  EXPECT_FALSE(server.writeTo(12345, message("nobody")));
+}
+
+TEST_P(LinuxTCPSocketLoopback, ResumesPartialWrites) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  LinuxTCPSocket server("127.0.0.1", port, 0, TCPSocket::SERVER, 3, 1);
+  server.setIoBackend(GetParam());
+  server.open();
+  auto peer = client(port, GetParam());
+  auto received = std::make_shared<Recorder>();
+  peer->setReadQueue(false);
+  peer->addSubscriber(received);
+  ASSERT_TRUE(waitFor([&] { return server.getConnections().size() == 1; }));
+
+  // Far more than the socket buffers take at once.
+  const size_t size = 16 * 1024 * 1024;
+  std::vector<uint8_t> data(size);
+  for (size_t i = 0; i < size; ++i) data[i] = pattern(i);
+  received->hold();
+  server.write(Serializable(data));
+  ASSERT_TRUE(waitFor([&] {
+    auto connections = server.getConnections();
+    return connections.size() == 1 && connections[0].queuedBytes > 0;
+  }));
+  received->release();
+
+  ASSERT_TRUE(waitFor([&] { return received->received() >= size; },
+                      std::chrono::seconds(20)));
+  EXPECT_EQ(received->bytes, data);
+  EXPECT_EQ(server.getConnections()[0].queuedBytes, 0u);
+}
+
+TEST_P(LinuxTCPSocketLoopback, BackpressureCallbacks) {
+  spdlog::set_level(spdlog::level::off);
+  std::mutex mutex;
+  std::vector<bool> signals;
+  int port = getRandomPort();
+  LinuxTCPSocket server("127.0.0.1", port, 0, TCPSocket::SERVER, 3, 1);
+  server.setIoBackend(GetParam());
+  SendQueueConfig queue;
+  queue.highWatermark = 256 * 1024;
+  queue.lowWatermark = 64 * 1024;
+  server.setSendQueue(queue);
+  server.setBackpressureCallback([&](ConnectionId, bool paused) {
+    std::lock_guard<std::mutex> lock(mutex);
+    signals.push_back(paused);
+  });
+  server.open();
+  auto peer = client(port, GetParam());
+  auto received = std::make_shared<Recorder>();
+  peer->setReadQueue(false);
+  peer->addSubscriber(received);
+  ASSERT_TRUE(waitFor([&] { return server.getConnections().size() == 1; }));
+
+  received->hold();
+  const size_t chunk = 64 * 1024;
+  size_t sent = 0;
+  for (int i = 0; i < 256; ++i) {
+    server.write(Serializable(std::vector<uint8_t>(chunk, 7)));
+    sent += chunk;
+  }
+  ASSERT_TRUE(waitFor([&] {
+    std::lock_guard<std::mutex> lock(mutex);
+    return !signals.empty();
+  }));
+  received->release();
+
+  ASSERT_TRUE(waitFor([&] { return received->received() >= sent; },
+                      std::chrono::seconds(20)));
+  ASSERT_TRUE(waitFor([&] {
+    std::lock_guard<std::mutex> lock(mutex);
+    return signals.size() >= 2;
+  }));
+  std::lock_guard<std::mutex> lock(mutex);
+  // Paused and resumed, alternately.
+  for (size_t i = 0; i < signals.size(); ++i) {
+    EXPECT_EQ(signals[i], i % 2 == 0) << "signal " << i;
+  }
+}
+
+TEST_P(LinuxTCPSocketLoopback, ReportsPeerLoss) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  LinuxTCPSocket server("127.0.0.1", port, 0, TCPSocket::SERVER, 3, 1);
+  server.setIoBackend(GetParam());
+  auto events = std::make_shared<Recorder>();
+  server.addSubscriber(events);
+  server.open();
+  auto first = client(port, GetParam());
+  auto second = client(port, GetParam());
+  ASSERT_TRUE(waitFor([&] { return server.getConnections().size() == 2; }));
+
+  first->write(message("bye"));
+  ASSERT_EQ(text(server.read()), "bye");
+  ConnectionId lost;
+  {
+    std::lock_guard<std::mutex> lock(events->mutex);
+    lost = events->lastConnection;
+  }
+  first->close();
+
+  ASSERT_TRUE(waitFor([&] {
+    std::lock_guard<std::mutex> lock(events->mutex);
+    return !events->disconnected.empty();
+  }));
+  {
+    std::lock_guard<std::mutex> lock(events->mutex);
+    ASSERT_EQ(events->disconnected.size(), 1u);
+    EXPECT_EQ(events->disconnected[0], lost);
+  }
+  auto connections = server.getConnections();
+  ASSERT_EQ(connections.size(), 1u);
+  EXPECT_NE(connections[0].id, lost);
+  EXPECT_FALSE(server.writeTo(lost, message("gone")));
+}
+
+TEST_P(LinuxTCPSocketLoopback, SlowReaderLosesNothing) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  LinuxTCPSocket server("127.0.0.1", port, 0, TCPSocket::SERVER, 3, 5);
+  server.setIoBackend(GetParam());
+  server.open();
+  auto peer = client(port, GetParam());
+  WriteModeConfig mode;
+  mode.mode = WriteMode::LOW_LATENCY;
+  peer->setWriteMode(mode);
+
+  // Small writes arrive as many chunks, more than read() queues.
+  const size_t count = 20000;
+  const size_t size = 997;
+  std::thread writer([&] {
+    for (size_t i = 0; i < count; ++i) {
+      std::vector<uint8_t> data(size);
+      for (size_t b = 0; b < size; ++b) data[b] = pattern(i * size + b);
+      peer->write(Serializable(data));
+    }
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+  size_t position = 0;
+  bool ordered = true;
+  while (position < count * size && ordered) {
+    std::vector<uint8_t> data = static_cast<std::vector<uint8_t>>(
+        server.read(Clock::now() + std::chrono::seconds(5)));
+    if (data.empty()) break;
+    for (uint8_t byte : data) ordered = ordered && byte == pattern(position++);
+  }
+  writer.join();
+  EXPECT_TRUE(ordered);
+  EXPECT_EQ(position, count * size);
+}
+
+TEST_P(LinuxTCPSocketLoopback, CloseFromSubscriber) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  LinuxTCPSocket server("127.0.0.1", port, 0, TCPSocket::SERVER, 3, 1);
+  server.setIoBackend(GetParam());
+
+  class Closer : public Subscriber {
+   public:
+    explicit Closer(LinuxTCPSocket &socket) : socket(socket) {}
+    void update(Serializable) override {
+      ++calls;
+      socket.close();
+    }
+    LinuxTCPSocket &socket;
+    std::atomic<int> calls{0};
+  };
+  auto closer = std::make_shared<Closer>(server);
+  server.addSubscriber(closer);
+  server.setReadQueue(false);
+  server.open();
+
+  auto peer = client(port, GetParam());
+  peer->write(message("close"));
+  ASSERT_TRUE(waitFor([&] { return closer->calls == 1; }));
+  EXPECT_TRUE(waitFor([&] { return server.getConnections().empty(); }));
+
+  // Reopening from this thread joins the loop that stopped itself.
+  server.open();
+  auto again = client(port, GetParam());
+  again->write(message("close"));
+  EXPECT_TRUE(waitFor([&] { return closer->calls == 2; }));
+}
+
+TEST_P(LinuxTCPSocketLoopback, CoalesceHoldsWritesUntilBatchOrDeadline) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  LinuxTCPSocket server("127.0.0.1", port, 0, TCPSocket::SERVER, 3, 1);
+  server.setIoBackend(GetParam());
+  auto received = std::make_shared<Recorder>();
+  server.setReadQueue(false);
+  server.addSubscriber(received);
+  server.open();
+  auto peer = client(port, GetParam());
+  ASSERT_TRUE(waitFor([&] { return server.getConnections().size() == 1; }));
+  WriteModeConfig mode;
+  mode.mode = WriteMode::THROUGHPUT_COALESCE;
+  mode.maxBatchBytes = 4096;
+  mode.flushDeadline = std::chrono::seconds(1);
+  peer->setWriteMode(mode);
+  auto queued = [&] { return peer->getConnections()[0].queuedBytes; };
+
+  // Below maxBatchBytes nothing is sent.
+  auto firstHeld = Clock::now();
+  for (int i = 0; i < 3; ++i) {
+    peer->write(Serializable(std::vector<uint8_t>(100, 'a')));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(received->received(), 0u);
+  EXPECT_EQ(queued(), 300u);
+
+  // Reaching it sends the batch well before the deadline.
+  auto start = Clock::now();
+  peer->write(Serializable(std::vector<uint8_t>(4000, 'b')));
+  ASSERT_TRUE(waitFor([&] { return received->received() == 4300; },
+                      std::chrono::milliseconds(500)));
+  EXPECT_LT(Clock::now() - start, mode.flushDeadline);
+  EXPECT_EQ(queued(), 0u);
+
+  // The deadline runs from the first write held since the last flush,
+  // which sending the batch was not; a lone write goes out then.
+  peer->write(Serializable(std::vector<uint8_t>(100, 'c')));
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(received->received(), 4300u);
+  ASSERT_TRUE(waitFor([&] { return received->received() == 4400; }));
+  EXPECT_GE(Clock::now() - firstHeld, std::chrono::milliseconds(990));
+  EXPECT_LT(Clock::now() - firstHeld, std::chrono::milliseconds(1500));
+
+  // flush() sends at once. Data written while a send is still under way
+  // goes out with it, so wait for that one to complete.
+  ASSERT_TRUE(waitFor([&] { return queued() == 0; }));
+  peer->write(Serializable(std::vector<uint8_t>(100, 'd')));
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(received->received(), 4400u);
+  start = Clock::now();
+  peer->flush(peer->getConnections()[0].id);
+  ASSERT_TRUE(waitFor([&] { return received->received() == 4500; }));
+  EXPECT_LT(Clock::now() - start, std::chrono::milliseconds(500));
+
+  std::lock_guard<std::mutex> lock(received->mutex);
+  std::string bytes(received->bytes.begin(), received->bytes.end());
+  EXPECT_EQ(bytes, std::string(300, 'a') + std::string(4000, 'b') +
+                       std::string(100, 'c') + std::string(100, 'd'));
+}
+
+TEST_P(LinuxTCPSocketLoopback, CoalesceFlushesOneConnection) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  LinuxTCPSocket server("127.0.0.1", port, 0, TCPSocket::SERVER, 3, 1);
+  server.setIoBackend(GetParam());
+  server.open();
+  auto first = client(port, GetParam());
+  auto second = client(port, GetParam());
+  ASSERT_TRUE(waitFor([&] { return server.getConnections().size() == 2; }));
+  auto toFirst = std::make_shared<Recorder>();
+  auto toSecond = std::make_shared<Recorder>();
+  first->setReadQueue(false);
+  first->addSubscriber(toFirst);
+  second->setReadQueue(false);
+  second->addSubscriber(toSecond);
+
+  // Learn which server connection is whose.
+  first->write(message("first"));
+  ConnectionId firstId = 0;
+  ASSERT_EQ(text(server.read(firstId)), "first");
+  ConnectionId secondId = 0;
+  for (const ConnectionInfo &info : server.getConnections()) {
+    if (info.id != firstId) secondId = info.id;
+  }
+  ASSERT_NE(secondId, 0u);
+
+  WriteModeConfig mode;
+  mode.mode = WriteMode::THROUGHPUT_COALESCE;
+  mode.flushDeadline = std::chrono::seconds(1);
+  server.setWriteMode(mode);
+  EXPECT_TRUE(server.writeTo(firstId, message("to first")));
+  EXPECT_TRUE(server.writeTo(secondId, message("to second")));
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(toFirst->received(), 0u);
+  EXPECT_EQ(toSecond->received(), 0u);
+
+  // Only the flushed connection sends; the other waits for its deadline.
+  server.flush(firstId);
+  ASSERT_TRUE(waitFor([&] { return toFirst->received() == 8; },
+                      std::chrono::milliseconds(500)));
+  EXPECT_EQ(toSecond->received(), 0u);
+  ASSERT_TRUE(waitFor([&] { return toSecond->received() == 9; }));
+  std::lock_guard<std::mutex> lock(toSecond->mutex);
+  EXPECT_EQ(std::string(toSecond->bytes.begin(), toSecond->bytes.end()),
+            "to second");
+}
+
+TEST_P(LinuxTCPSocketLoopback, HeartbeatMeasuresTheRoundTrip) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  LinuxTCPSocket server("127.0.0.1", port, 0, TCPSocket::SERVER, 3, 1);
+  server.setIoBackend(GetParam());
+  server.setReadQueue(false);
+  server.open();
+  auto peer = client(port, GetParam());
+  ASSERT_TRUE(waitFor([&] { return server.getConnections().size() == 1; }));
+  EXPECT_EQ(server.getConnections()[0].heartbeatRtt.count(), 0);
+
+  // The peer answers each heartbeat a little later.
+  const auto delay = std::chrono::milliseconds(30);
+  std::atomic<bool> answering{true};
+  std::atomic<int> answered{0};
+  std::thread answerer([&] {
+    while (answering) {
+      if (text(peer->read()).find("ping") == std::string::npos) continue;
+      std::this_thread::sleep_for(delay);
+      peer->write(message("pong"));
+      ++answered;
+    }
+  });
+  LivenessConfig liveness;
+  liveness.heartbeatInterval = std::chrono::milliseconds(100);
+  liveness.heartbeatPayload = {'p', 'i', 'n', 'g'};
+  server.setLiveness(liveness);
+
+  bool measured = waitFor([&] {
+    return answered >= 3 && server.getConnections()[0].heartbeatRtt.count() > 0;
+  });
+  std::chrono::microseconds rtt = server.getConnections()[0].heartbeatRtt;
+  answering = false;
+  answerer.join();
+  ASSERT_TRUE(measured);
+  EXPECT_GE(rtt, delay);
+  EXPECT_LT(rtt, delay + std::chrono::milliseconds(500));
+}
+
+TEST_P(LinuxTCPSocketLoopback, SilentConnectionIsClosed) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  LinuxTCPSocket server("127.0.0.1", port, 0, TCPSocket::SERVER, 3, 1);
+  server.setIoBackend(GetParam());
+  auto events = std::make_shared<Recorder>();
+  server.setReadQueue(false);
+  server.addSubscriber(events);
+  LivenessConfig liveness;
+  liveness.heartbeatTimeout = std::chrono::milliseconds(300);
+  server.setLiveness(liveness);
+  server.open();
+
+  auto start = Clock::now();
+  auto silent = client(port, GetParam());
+  ASSERT_TRUE(waitFor([&] { return server.getConnections().size() == 1; }));
+  ConnectionId silentId = server.getConnections()[0].id;
+  auto talking = client(port, GetParam());
+  ASSERT_TRUE(waitFor([&] { return server.getConnections().size() == 2; }));
+
+  // One peer writes more often than the timeout, the other never does.
+  std::atomic<bool> writing{true};
+  std::thread writer([&] {
+    while (writing) {
+      talking->write(message("still here"));
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+  });
+  bool closed = waitFor([&] {
+    std::lock_guard<std::mutex> lock(events->mutex);
+    return !events->disconnected.empty();
+  });
+  auto elapsed = Clock::now() - start;
+  // Long enough for a second timeout to have passed.
+  std::this_thread::sleep_for(std::chrono::milliseconds(600));
+  writing = false;
+  writer.join();
+
+  ASSERT_TRUE(closed);
+  EXPECT_GE(elapsed, liveness.heartbeatTimeout);
+  {
+    std::lock_guard<std::mutex> lock(events->mutex);
+    ASSERT_EQ(events->disconnected.size(), 1u);
+    EXPECT_EQ(events->disconnected[0], silentId);
+  }
+  auto connections = server.getConnections();
+  ASSERT_EQ(connections.size(), 1u);
+  EXPECT_NE(connections[0].id, silentId);
+  EXPECT_FALSE(server.writeTo(silentId, message("gone")));
+}
+
+TEST(LinuxTCPSocket, ZeroCopyCompletionsDrainOnDualStackServer) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  // Dual-stack by default: accepted connections are IPv6 sockets, which
+  // report completions as IPV6_RECVERR.
+  LinuxTCPSocket server("127.0.0.1", port, 0, TCPSocket::SERVER, 3, 1);
+  ZeroCopyConfig zeroCopy;
+  zeroCopy.enabled = true;
+  zeroCopy.threshold = 16 * 1024;
+  server.setZeroCopy(zeroCopy);
+  server.open();
+  auto peer = client(port);
+  auto received = std::make_shared<Recorder>();
+  peer->setReadQueue(false);
+  peer->addSubscriber(received);
+  ASSERT_TRUE(waitFor([&] { return server.getConnections().size() == 1; }));
+
+  const size_t size = 256 * 1024;
+  for (int i = 0; i < 16; ++i) {
+    server.write(Serializable(std::vector<uint8_t>(size, 1)));
+  }
+  ASSERT_TRUE(waitFor([&] { return received->received() >= 16 * size; },
+                      std::chrono::seconds(20)));
+  if (server.getZeroCopyStats().zeroCopySends == 0) {
+    GTEST_SKIP() << "No SO_ZEROCOPY on this kernel";
+  }
+
+  // The event loop reaps completions as they arrive on the error queue.
+  EXPECT_TRUE(waitFor(
+      [&] { return server.getZeroCopyStats().pinnedBuffers == 0; }));
+  ZeroCopyStats stats = server.getZeroCopyStats();
+  EXPECT_EQ(stats.completions, stats.zeroCopySends);
+}
+
+TEST(LinuxTCPSocket, DisconnectFromAnotherThreadWhileReceiving) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  LinuxTCPSocket server("127.0.0.1", port, 0, TCPSocket::SERVER, 3, 1);
+
+  // Bytes received per connection.
+  class Tally : public Subscriber {
+   public:
+    void update(Serializable) override {}
+    void update(Serializable data, ConnectionId connection) override {
+      std::vector<uint8_t> bytes = static_cast<std::vector<uint8_t>>(data);
+      std::lock_guard<std::mutex> lock(mutex);
+      std::string &text = received[connection];
+      text.insert(text.end(), bytes.begin(), bytes.end());
+    }
+    std::string of(ConnectionId connection) {
+      std::lock_guard<std::mutex> lock(mutex);
+      return received[connection];
+    }
+    std::mutex mutex;
+    std::map<ConnectionId, std::string> received;
+  };
+  auto tally = std::make_shared<Tally>();
+  server.addSubscriber(tally);
+  server.setReadQueue(false);
+  server.open();
+
+  for (int round = 0; round < 20; ++round) {
+    auto flooder = client(port);
+    ASSERT_TRUE(waitFor([&] { return server.getConnections().size() == 1; }));
+    ConnectionId flooded = server.getConnections()[0].id;
+    std::atomic<bool> flooding{true};
+    std::thread writer([&] {
+      while (flooding) flooder->write(Serializable(std::vector<uint8_t>(4096, 'f')));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    // The loop is reading the connection while it closes here.
+    server.disconnect(flooded);
+    flooding = false;
+    writer.join();
+    flooder->close();
+    ASSERT_TRUE(waitFor([&] { return server.getConnections().empty(); }));
+
+    // The next connection is likely to get the descriptor just closed; what
+    // it sends must never be read as the old connection's data.
+    auto next = client(port);
+    ASSERT_TRUE(waitFor([&] { return server.getConnections().size() == 1; }));
+    ConnectionId id = server.getConnections()[0].id;
+    next->write(message("next"));
+    ASSERT_TRUE(waitFor([&] { return tally->of(id) == "next"; }))
+        << "round " << round;
+    EXPECT_EQ(tally->of(flooded).find("next"), std::string::npos)
+        << "round " << round;
+    next->close();
+    ASSERT_TRUE(waitFor([&] { return server.getConnections().empty(); }));
+  }
+}
+
+TEST(LinuxTCPSocket, OpenAsyncRetriesUntilTheServerListens) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  LinuxTCPSocket peer("127.0.0.1", 0, port, TCPSocket::CLIENT, 20, 1);
+  BackoffConfig backoff;
+  backoff.initialDelay = std::chrono::milliseconds(20);
+  backoff.maxDelay = std::chrono::milliseconds(50);
+  backoff.jitter = 0;
+  peer.setBackoff(backoff);
+  std::future<bool> connected = peer.openAsync();
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  ASSERT_EQ(connected.wait_for(std::chrono::seconds(0)),
+            std::future_status::timeout);
+
+  LinuxTCPSocket server("127.0.0.1", port, 0, TCPSocket::SERVER, 3, 1);
+  ASSERT_TRUE(server.openAsync().get());
+  ASSERT_EQ(connected.wait_for(std::chrono::seconds(5)),
+            std::future_status::ready);
+  EXPECT_TRUE(connected.get());
+  peer.write(message("late"));
+  EXPECT_EQ(text(server.read()), "late");
+}
+
+TEST(LinuxTCPSocket, OpenAsyncGivesUpAfterMaxRetries) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  LinuxTCPSocket peer("127.0.0.1", 0, port, TCPSocket::CLIENT, 3, 1);
+  BackoffConfig backoff;
+  backoff.initialDelay = std::chrono::milliseconds(100);
+  backoff.multiplier = 2;
+  backoff.jitter = 0;
+  peer.setBackoff(backoff);
+  std::atomic<int> calls{0};
+  auto start = Clock::now();
+  std::future<bool> connected =
+      peer.openAsync([&](bool result) { calls += result ? 100 : 1; });
+  ASSERT_EQ(connected.wait_for(std::chrono::seconds(5)),
+            std::future_status::ready);
+  EXPECT_FALSE(connected.get());
+  EXPECT_EQ(calls, 1);
+  // Three attempts, with 100 and 200 ms between them.
+  EXPECT_GE(Clock::now() - start, std::chrono::milliseconds(300));
+}
+
+TEST(LinuxTCPSocket, ServerReportsAPortItCannotListenOn) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  LinuxTCPSocket first("127.0.0.1", port, 0, TCPSocket::SERVER, 3, 1);
+  ASSERT_TRUE(first.openAsync().get());
+
+  LinuxTCPSocket second("127.0.0.1", port, 0, TCPSocket::SERVER, 3, 1);
+  bool reported = true;
+  EXPECT_FALSE(second.openAsync([&](bool result) { reported = result; }).get());
+  EXPECT_FALSE(reported);
+  // The failed attempt keeps no descriptor; reopening after the port is
+  // free listens.
+  first.close();
+  EXPECT_TRUE(second.openAsync().get());
+  auto peer = client(port);
+  peer->write(message("second"));
+  EXPECT_EQ(text(second.read()), "second");
+}
+
+TEST(LinuxTCPSocket, ClosedConnectionKeepsZeroCopyBuffersUntilComplete) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  LinuxTCPSocket server("127.0.0.1", port, 0, TCPSocket::SERVER, 3, 1);
+  ZeroCopyConfig zeroCopy;
+  zeroCopy.enabled = true;
+  zeroCopy.threshold = 16 * 1024;
+  server.setZeroCopy(zeroCopy);
+  server.open();
+  auto peer = client(port);
+  auto received = std::make_shared<Recorder>();
+  peer->setReadQueue(false);
+  peer->addSubscriber(received);
+  ASSERT_TRUE(waitFor([&] { return server.getConnections().size() == 1; }));
+  ConnectionId id = server.getConnections()[0].id;
+
+  // More than the socket buffers take while the peer does not read.
+  const size_t size = 256 * 1024;
+  received->hold();
+  for (size_t i = 0; i < 64; ++i) {
+    std::vector<uint8_t> data(size);
+    for (size_t b = 0; b < size; ++b) data[b] = pattern(i * size + b);
+    server.write(Serializable(data));
+  }
+  if (!waitFor([&] { return server.getZeroCopyStats().pinnedBuffers > 0; })) {
+    received->release();
+    GTEST_SKIP() << "No SO_ZEROCOPY on this kernel";
+  }
+  server.disconnect(id);
+  EXPECT_TRUE(server.getConnections().empty());
+  EXPECT_GT(server.getZeroCopyStats().pinnedBuffers, 0u);
+
+  // What the kernel took still reaches the peer, unchanged, and the
+  // buffers go once it reports the sends complete.
+  received->release();
+  ASSERT_TRUE(waitFor([&] {
+    std::lock_guard<std::mutex> lock(received->mutex);
+    return !received->disconnected.empty();
+  }, std::chrono::seconds(20)));
+  EXPECT_TRUE(waitFor(
+      [&] { return server.getZeroCopyStats().pinnedBuffers == 0; }));
+  std::lock_guard<std::mutex> lock(received->mutex);
+  EXPECT_GT(received->bytes.size(), 0u);
+  bool intact = true;
+  for (size_t i = 0; i < received->bytes.size() && intact; ++i) {
+    intact = received->bytes[i] == pattern(i);
+  }
+  EXPECT_TRUE(intact);
+}
+
+TEST(LinuxTCPSocket, ZeroCopyLingerTimeoutResetsTheConnection) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  LinuxTCPSocket server("127.0.0.1", port, 0, TCPSocket::SERVER, 3, 1);
+  ZeroCopyConfig zeroCopy;
+  zeroCopy.enabled = true;
+  zeroCopy.threshold = 16 * 1024;
+  zeroCopy.lingerTimeout = std::chrono::milliseconds(200);
+  server.setZeroCopy(zeroCopy);
+  server.open();
+  auto peer = client(port);
+  auto received = std::make_shared<Recorder>();
+  peer->setReadQueue(false);
+  peer->addSubscriber(received);
+  ASSERT_TRUE(waitFor([&] { return server.getConnections().size() == 1; }));
+  ConnectionId id = server.getConnections()[0].id;
+
+  received->hold();
+  for (int i = 0; i < 64; ++i) {
+    server.write(Serializable(std::vector<uint8_t>(256 * 1024, 1)));
+  }
+  if (!waitFor([&] { return server.getZeroCopyStats().pinnedBuffers > 0; })) {
+    received->release();
+    GTEST_SKIP() << "No SO_ZEROCOPY on this kernel";
+  }
+  auto closed = Clock::now();
+  server.disconnect(id);
+  // The peer still reads nothing; the timeout gives the buffers up.
+  EXPECT_TRUE(waitFor(
+      [&] { return server.getZeroCopyStats().pinnedBuffers == 0; }));
+  EXPECT_GE(Clock::now() - closed, std::chrono::milliseconds(150));
+  received->release();
+  EXPECT_TRUE(waitFor([&] {
+    std::lock_guard<std::mutex> lock(received->mutex);
+    return !received->disconnected.empty();
+  }));
+}
+
+TEST(LinuxTCPSocket, SendFileResumesFromNextOffset) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  LinuxTCPSocket server("127.0.0.1", port, 0, TCPSocket::SERVER, 3, 1);
+  auto received = std::make_shared<Recorder>();
+  server.setReadQueue(false);
+  server.addSubscriber(received);
+  server.open();
+  auto peer = client(port);
+  ASSERT_TRUE(waitFor([&] { return server.getConnections().size() == 1; }));
+
+  const size_t size = 8 * 1024 * 1024;
+  int fd = patternFile(size);
+  ASSERT_NE(fd, -1);
+  std::vector<uint64_t> reports;
+  TransferResult first =
+      peer->sendFile(fd, 0, size, [&](uint64_t sent, uint64_t total) {
+        reports.push_back(total);
+        return sent < size / 3;
+      });
+  EXPECT_FALSE(first.complete);
+  EXPECT_EQ(first.error, 0);
+  EXPECT_GE(first.bytesSent, size / 3);
+  EXPECT_LT(first.bytesSent, size);
+  EXPECT_EQ(first.nextOffset, static_cast<off_t>(first.bytesSent));
+  ASSERT_FALSE(reports.empty());
+  EXPECT_EQ(reports[0], size);
+
+  // Resumed where it stopped; the file offset was never moved.
+  TransferResult rest = peer->sendFile(
+      fd, first.nextOffset, size - static_cast<size_t>(first.nextOffset));
+  EXPECT_TRUE(rest.complete);
+  EXPECT_EQ(rest.error, 0);
+  EXPECT_EQ(rest.bytesSent + first.bytesSent, size);
+  EXPECT_EQ(rest.nextOffset, static_cast<off_t>(size));
+  EXPECT_EQ(lseek(fd, 0, SEEK_CUR), 0);
+  ::close(fd);
+
+  ASSERT_TRUE(waitFor([&] { return received->received() >= size; },
+                      std::chrono::seconds(20)));
+  std::lock_guard<std::mutex> lock(received->mutex);
+  ASSERT_EQ(received->bytes.size(), size);
+  for (size_t i = 0; i < size; ++i) {
+    ASSERT_EQ(received->bytes[i], pattern(i)) << "byte " << i;
+  }
+}
+
+TEST(LinuxTCPSocket, SendFileKeepsItsPlaceAmongWrites) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  LinuxTCPSocket server("127.0.0.1", port, 0, TCPSocket::SERVER, 3, 1);
+  auto received = std::make_shared<Recorder>();
+  server.setReadQueue(false);
+  server.addSubscriber(received);
+  server.open();
+  auto peer = client(port);
+  ASSERT_TRUE(waitFor([&] { return server.getConnections().size() == 1; }));
+
+  // The server stops reading, so the first write, more than the socket
+  // buffers take, is still queued when the transfer starts.
+  const size_t before = 32 * 1024 * 1024;
+  const size_t size = 4 * 1024 * 1024;
+  const size_t after = 64 * 1024;
+  int fd = patternFile(size);
+  ASSERT_NE(fd, -1);
+  received->hold();
+  peer->write(Serializable(std::vector<uint8_t>(before, 'a')));
+  ASSERT_TRUE(waitFor([&] {
+    auto connections = peer->getConnections();
+    return connections.size() == 1 && connections[0].queuedBytes > 0;
+  }));
+  std::atomic<bool> progressWrote{false};
+  auto sending = std::async(std::launch::async, [&] {
+    return peer->sendFile(fd, 0, size, [&](uint64_t, uint64_t) {
+      // Written mid-transfer: queued until it ends.
+      if (!progressWrote.exchange(true)) {
+        peer->write(Serializable(std::vector<uint8_t>(after, 'c')));
+      }
+      return true;
+    });
+  });
+  // Written while the transfer waits for the queue to drain.
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(sending.wait_for(std::chrono::seconds(0)),
+            std::future_status::timeout);
+  peer->write(Serializable(std::vector<uint8_t>(after, 'b')));
+  received->release();
+
+  ASSERT_EQ(sending.wait_for(std::chrono::seconds(20)),
+            std::future_status::ready);
+  TransferResult result = sending.get();
+  EXPECT_TRUE(result.complete);
+  EXPECT_EQ(result.bytesSent, size);
+  ::close(fd);
+
+  const size_t total = before + size + 2 * after;
+  ASSERT_TRUE(waitFor([&] { return received->received() >= total; },
+                      std::chrono::seconds(20)));
+  std::lock_guard<std::mutex> lock(received->mutex);
+  const std::vector<uint8_t> &bytes = received->bytes;
+  ASSERT_EQ(bytes.size(), total);
+  for (size_t i = 0; i < before; ++i) ASSERT_EQ(bytes[i], 'a') << i;
+  for (size_t i = 0; i < size; ++i) {
+    ASSERT_EQ(bytes[before + i], pattern(i)) << "file byte " << i;
+  }
+  for (size_t i = 0; i < after; ++i) {
+    ASSERT_EQ(bytes[before + size + i], 'b') << i;
+    ASSERT_EQ(bytes[before + size + after + i], 'c') << i;
+  }
+}
+
+TEST(LinuxTCPSocket, StoppedRelayLosesNothing) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  LinuxTCPSocket server("127.0.0.1", port, 0, TCPSocket::SERVER, 3, 1);
+  auto received = std::make_shared<Recorder>();
+  server.setReadQueue(false);
+  server.addSubscriber(received);
+  server.open();
+  auto peer = client(port);
+  ASSERT_TRUE(waitFor([&] { return server.getConnections().size() == 1; }));
+
+  // A socket is no pipe, so the relay goes through one of its own.
+  int source[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, source), 0);
+  const size_t size = 6 * 1024 * 1024;
+  std::thread feeder([&] {
+    std::vector<uint8_t> data(64 * 1024);
+    for (size_t done = 0; done < size; done += data.size()) {
+      for (size_t i = 0; i < data.size(); ++i) data[i] = pattern(done + i);
+      for (size_t sent = 0; sent < data.size();) {
+        ssize_t n = ::write(source[1], data.data() + sent, data.size() - sent);
+        if (n <= 0) return;
+        sent += static_cast<size_t>(n);
+      }
+    }
+    shutdown(source[1], SHUT_WR);
+  });
+
+  TransferResult first =
+      peer->relay(source[0], SIZE_MAX, [&](uint64_t sent, uint64_t total) {
+        EXPECT_EQ(total, 0u);
+        return sent < size / 4;
+      });
+  EXPECT_FALSE(first.complete);
+  EXPECT_EQ(first.error, 0);
+  EXPECT_LT(first.bytesSent, size);
+  // Carries on from the source's position up to its end.
+  TransferResult rest = peer->relay(source[0]);
+  EXPECT_TRUE(rest.complete);
+  EXPECT_EQ(first.bytesSent + rest.bytesSent, size);
+  feeder.join();
+  ::close(source[0]);
+  ::close(source[1]);
+
+  ASSERT_TRUE(waitFor([&] { return received->received() >= size; },
+                      std::chrono::seconds(20)));
+  std::lock_guard<std::mutex> lock(received->mutex);
+  ASSERT_EQ(received->bytes.size(), size);
+  for (size_t i = 0; i < size; ++i) {
+    ASSERT_EQ(received->bytes[i], pattern(i)) << "byte " << i;
+  }
+}
+
+TEST(TCPConnectionPool, CapsEachEndpointAndTimesOut) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  LinuxTCPSocket server("127.0.0.1", port, 0, TCPSocket::SERVER, 3, 1);
+  server.open();
+  TCPPoolConfig config;
+  config.maxPerEndpoint = 2;
+  config.minIdle = 0;
+  config.acquireTimeout = std::chrono::milliseconds(200);
+  config.healthInterval = std::chrono::seconds(60);
+  TCPConnectionPool pool(config);
+
+  TCPConnectionPool::Handle first = pool.acquire("127.0.0.1", port);
+  TCPConnectionPool::Handle second = pool.acquire("127.0.0.1", port);
+  ASSERT_TRUE(first);
+  ASSERT_TRUE(second);
+  EXPECT_NE(&*first, &*second);
+
+  // At the cap, acquire() waits out acquireTimeout and opens nothing.
+  auto start = Clock::now();
+  EXPECT_FALSE(pool.acquire("127.0.0.1", port));
+  EXPECT_GE(Clock::now() - start, config.acquireTimeout);
+  TCPPoolStats stats = pool.getStats();
+  EXPECT_EQ(stats.created, 2u);
+  EXPECT_EQ(stats.timeouts, 1u);
+  EXPECT_EQ(stats.inUse, 2u);
+  ASSERT_TRUE(waitFor([&] { return server.getConnections().size() == 2; }));
+
+  // A connection released while acquire() waits goes to the waiter.
+  LinuxTCPSocket *lent = &*first;
+  auto waiting = std::async(std::launch::async,
+                            [&] { return pool.acquire("127.0.0.1", port); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  first.release();
+  EXPECT_FALSE(first);
+  TCPConnectionPool::Handle third = waiting.get();
+  ASSERT_TRUE(third);
+  EXPECT_EQ(&*third, lent);
+  stats = pool.getStats();
+  EXPECT_EQ(stats.created, 2u);
+  EXPECT_EQ(stats.reused, 1u);
+  EXPECT_EQ(stats.timeouts, 1u);
+  EXPECT_EQ(server.getConnections().size(), 2u);
+}
+
+TEST(TCPConnectionPool, ReusesReleasedConnections) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  LinuxTCPSocket server("127.0.0.1", port, 0, TCPSocket::SERVER, 3, 1);
+  server.open();
+  TCPPoolConfig config;
+  config.minIdle = 0;
+  config.healthInterval = std::chrono::seconds(60);
+  TCPConnectionPool pool(config);
+
+  ConnectionId used = 0;
+  LinuxTCPSocket *lent = nullptr;
+  {
+    TCPConnectionPool::Handle handle = pool.acquire("127.0.0.1", port);
+    ASSERT_TRUE(handle);
+    lent = &*handle;
+    handle->write(message("one"));
+    EXPECT_EQ(text(server.read(used)), "one");
+  }
+  EXPECT_EQ(pool.getStats().idle, 1u);
+
+  // The same socket and the same connection on the server.
+  TCPConnectionPool::Handle handle = pool.acquire("127.0.0.1", port);
+  ASSERT_TRUE(handle);
+  EXPECT_EQ(&*handle, lent);
+  handle->write(message("two"));
+  ConnectionId from = 0;
+  EXPECT_EQ(text(server.read(from)), "two");
+  EXPECT_EQ(from, used);
+  TCPPoolStats stats = pool.getStats();
+  EXPECT_EQ(stats.created, 1u);
+  EXPECT_EQ(stats.reused, 1u);
+  EXPECT_EQ(stats.idle, 0u);
+  EXPECT_EQ(stats.inUse, 1u);
+
+  // discard() closes it instead of returning it.
+  handle.discard();
+  EXPECT_FALSE(handle);
+  stats = pool.getStats();
+  EXPECT_EQ(stats.idle, 0u);
+  EXPECT_EQ(stats.inUse, 0u);
+  ASSERT_TRUE(waitFor([&] { return server.getConnections().empty(); }));
+  TCPConnectionPool::Handle fresh = pool.acquire("127.0.0.1", port);
+  ASSERT_TRUE(fresh);
+  EXPECT_EQ(pool.getStats().created, 2u);
+}
+
+TEST(TCPConnectionPool, DropsConnectionsThePeerClosed) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  LinuxTCPSocket server("127.0.0.1", port, 0, TCPSocket::SERVER, 3, 1);
+  server.open();
+  TCPPoolConfig config;
+  config.minIdle = 0;
+  // No maintenance pass: acquire() itself finds the dead connection.
+  config.healthInterval = std::chrono::seconds(60);
+  TCPConnectionPool pool(config);
+
+  ConnectionId dropped = 0;
+  {
+    TCPConnectionPool::Handle handle = pool.acquire("127.0.0.1", port);
+    ASSERT_TRUE(handle);
+    handle->write(message("hello"));
+    EXPECT_EQ(text(server.read(dropped)), "hello");
+  }
+  server.disconnect(dropped);
+  ASSERT_TRUE(waitFor([&] { return server.getConnections().empty(); }));
+  // Time for the pooled socket to see the connection close.
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  TCPConnectionPool::Handle handle = pool.acquire("127.0.0.1", port);
+  ASSERT_TRUE(handle);
+  handle->write(message("again"));
+  ConnectionId from = 0;
+  EXPECT_EQ(text(server.read(from)), "again");
+  EXPECT_NE(from, dropped);
+  TCPPoolStats stats = pool.getStats();
+  EXPECT_EQ(stats.unhealthy, 1u);
+  EXPECT_EQ(stats.created, 2u);
+  EXPECT_EQ(stats.reused, 0u);
+
+  // Closed while lent: not taken back.
+  server.disconnect(from);
+  ASSERT_TRUE(waitFor([&] { return server.getConnections().empty(); }));
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  handle.release();
+  stats = pool.getStats();
+  EXPECT_EQ(stats.unhealthy, 2u);
+  EXPECT_EQ(stats.idle, 0u);
+  EXPECT_EQ(stats.inUse, 0u);
+}
+
+TEST(TCPConnectionPool, ExpiresIdleConnectionsAboveMinIdle) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  LinuxTCPSocket server("127.0.0.1", port, 0, TCPSocket::SERVER, 3, 1);
+  server.open();
+  TCPPoolConfig config;
+  config.maxPerEndpoint = 4;
+  config.minIdle = 1;
+  config.idleTimeout = std::chrono::milliseconds(150);
+  config.healthInterval = std::chrono::milliseconds(50);
+  TCPConnectionPool pool(config);
+
+  EXPECT_EQ(pool.warm("127.0.0.1", port), 1u);
+  EXPECT_EQ(pool.getStats().created, 1u);
+  {
+    // The warm connection and two new ones, all idle again afterwards.
+    std::vector<TCPConnectionPool::Handle> handles;
+    for (int i = 0; i < 3; ++i) {
+      handles.push_back(pool.acquire("127.0.0.1", port));
+      ASSERT_TRUE(handles.back());
+    }
+  }
+  TCPPoolStats stats = pool.getStats();
+  EXPECT_EQ(stats.created, 3u);
+  EXPECT_EQ(stats.reused, 1u);
+  EXPECT_EQ(stats.idle, 3u);
+
+  ASSERT_TRUE(waitFor([&] {
+    TCPPoolStats now = pool.getStats();
+    return now.idle == 1 && now.expired == 2;
+  }));
+  ASSERT_TRUE(waitFor([&] { return server.getConnections().size() == 1; }));
+  // minIdle stays open past idleTimeout.
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  stats = pool.getStats();
+  EXPECT_EQ(stats.idle, 1u);
+  EXPECT_EQ(stats.expired, 2u);
+  EXPECT_EQ(stats.created, 3u);
+
+  // Found dead by the maintenance pass, which opens a replacement.
+  server.disconnect(server.getConnections()[0].id);
+  ASSERT_TRUE(waitFor([&] {
+    TCPPoolStats now = pool.getStats();
+    return now.unhealthy == 1 && now.created == 4 && now.idle == 1;
+  }));
+  ASSERT_TRUE(waitFor([&] { return server.getConnections().size() == 1; }));
+}
+
+TEST(ShardedTCPServer, GlobalIdsReachTheRightShard) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  ShardConfig config;
+  config.shards = 4;
+  // Unpinned, so the test runs on any number of CPUs.
+  config.cpus = {-1};
+  ShardedTCPServer server(port, config);
+  server.open();
+  ASSERT_EQ(server.shardCount(), 4u);
+
+  const int kClients = 16;
+  std::vector<std::unique_ptr<LinuxTCPSocket>> clients;
+  for (int i = 0; i < kClients; ++i) clients.push_back(client(port));
+  ASSERT_TRUE(waitFor([&] {
+    return server.getConnections().size() == static_cast<size_t>(kClients);
+  }));
+
+  // Learn each client's global id from what it sends.
+  std::map<ConnectionId, int> owner;
+  for (int i = 0; i < kClients; ++i) {
+    clients[i]->write(message("client " + std::to_string(i)));
+    ConnectionId from = 0;
+    std::string request = text(server.read(from));
+    ASSERT_EQ(request, "client " + std::to_string(i));
+    EXPECT_TRUE(owner.emplace(from, i).second) << "id " << from;
+  }
+  for (const ConnectionInfo &info : server.getConnections()) {
+    EXPECT_EQ(owner.count(info.id), 1u) << "id " << info.id;
+  }
+
+  // Each reply reaches the client the id belongs to, through its shard.
+  std::vector<uint64_t> bytesIn(4, 0);
+  std::vector<uint64_t> bytesOut(4, 0);
+  std::vector<uint64_t> messagesIn(4, 0);
+  for (const auto &entry : owner) {
+    std::string reply = "reply " + std::to_string(entry.second);
+    ASSERT_TRUE(server.writeTo(entry.first, message(reply)));
+    EXPECT_EQ(text(clients[entry.second]->read()), reply);
+    size_t shard = entry.first % 4;
+    bytesIn[shard] += ("client " + std::to_string(entry.second)).size();
+    bytesOut[shard] += reply.size();
+    ++messagesIn[shard];
+  }
+
+  std::vector<ShardStats> stats = server.getShardStats();
+  ASSERT_EQ(stats.size(), 4u);
+  size_t shardsUsed = 0;
+  for (size_t shard = 0; shard < 4; ++shard) {
+    EXPECT_EQ(stats[shard].cpu, -1);
+    EXPECT_EQ(stats[shard].accepted, messagesIn[shard]) << "shard " << shard;
+    EXPECT_EQ(stats[shard].active, messagesIn[shard]) << "shard " << shard;
+    EXPECT_EQ(stats[shard].messagesIn, messagesIn[shard]) << "shard " << shard;
+    EXPECT_EQ(stats[shard].bytesIn, bytesIn[shard]) << "shard " << shard;
+    EXPECT_EQ(stats[shard].bytesOut, bytesOut[shard]) << "shard " << shard;
+    if (messagesIn[shard] > 0) ++shardsUsed;
+  }
+  // The kernel spread the clients, so ids of several shards were used.
+  EXPECT_GT(shardsUsed, 1u);
+
+  // disconnect() closes that connection and no other.
+  ConnectionId gone = owner.begin()->first;
+  size_t goneShard = gone % 4;
+  server.disconnect(gone);
+  ASSERT_TRUE(waitFor([&] {
+    return server.getConnections().size() ==
+           static_cast<size_t>(kClients - 1);
+  }));
+  for (const ConnectionInfo &info : server.getConnections()) {
+    EXPECT_NE(info.id, gone);
+  }
+  EXPECT_FALSE(server.writeTo(gone, message("gone")));
+  ASSERT_TRUE(waitFor([&] {
+    return server.getShardStats()[goneShard].active ==
+           messagesIn[goneShard] - 1;
+  }));
+  EXPECT_EQ(server.getShardStats()[goneShard].accepted,
+            messagesIn[goneShard]);
+
+  // broadcast() reaches the rest, counted on each shard.
+  EXPECT_EQ(server.broadcast(message("all")),
+            static_cast<size_t>(kClients - 1));
+  for (const auto &entry : owner) {
+    if (entry.first != gone) {
+      EXPECT_EQ(text(clients[entry.second]->read()), "all");
+    }
+  }
+  stats = server.getShardStats();
+  for (size_t shard = 0; shard < 4; ++shard) {
+    size_t open = messagesIn[shard] - (shard == goneShard ? 1 : 0);
+    EXPECT_EQ(stats[shard].bytesOut, bytesOut[shard] + open * 3)
+        << "shard " << shard;
+  }
+}
@@ -0,0 +1,184 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "socket/TimerWheel.h"
+
+namespace {
+
+using Clock = TimerWheel::Clock;
+
+// A coarse tick, so the few microseconds between the wheel's origin and
+// start never move a deadline to another tick.
+const Clock::duration kTick = std::chrono::seconds(1);
+
+// Ticks where a timer first lands on each wheel, and the overflow list.
+const uint64_t kLevel1 = 1ull << 8;
+const uint64_t kLevel2 = 1ull << 14;
+const uint64_t kLevel3 = 1ull << 20;
+const uint64_t kOverflow = 1ull << 26;
+
+class Wheel {
+ public:
+  Wheel() : start(Clock::now()) {}
+
+  // A deadline inside tick k, which is when it expires.
+  Clock::time_point due(uint64_t k) const {
+    return start + kTick * static_cast<Clock::rep>(k) - kTick / 2;
+  }
+
+  // A time in tick k, once k is over.
+  Clock::time_point after(uint64_t k) const {
+    return start + kTick * static_cast<Clock::rep>(k) + kTick / 2;
+  }
+
+  std::vector<uint64_t> advanceTo(uint64_t k) {
+    std::vector<uint64_t> expired;
+    wheel.advance(after(k), expired);
+    return expired;
+  }
+
+  TimerWheel wheel{kTick};
+  Clock::time_point start;
+};
+
+// Deadlines around every level boundary and into the overflow list.
+std::vector<uint64_t> boundaries() {
+  std::vector<uint64_t> ticks;
+  for (uint64_t edge : {kLevel1, kLevel2, kLevel3, kOverflow}) {
+    for (uint64_t k : {edge - 1, edge, edge + 1, 2 * edge + 3}) {
+      ticks.push_back(k);
+    }
+  }
+  ticks.push_back(1);
+  ticks.push_back(3 * kOverflow + 7);
+  std::sort(ticks.begin(), ticks.end());
+  ticks.erase(std::unique(ticks.begin(), ticks.end()), ticks.end());
+  return ticks;
+}
+
+}  // namespace
+
+TEST(TimerWheel, NeverFiresEarly) {
+  Wheel w;
+  std::vector<uint64_t> ticks = boundaries();
+  for (uint64_t k : ticks) w.wheel.schedule(w.due(k), k);
+  for (uint64_t k : ticks) {
+    std::vector<uint64_t> early = w.advanceTo(k - 1);
+    EXPECT_TRUE(early.empty()) << "tick " << k << " fired "
+                               << (early.empty() ? 0 : early[0]);
+    EXPECT_LE(w.wheel.nextExpiry(), w.start + kTick * static_cast<Clock::rep>(k))
+        << "tick " << k;
+    EXPECT_EQ(w.advanceTo(k), std::vector<uint64_t>{k});
+  }
+  EXPECT_EQ(w.wheel.size(), 0u);
+  EXPECT_EQ(w.wheel.nextExpiry(), Clock::time_point::max());
+}
+
+TEST(TimerWheel, CascadesThroughEveryLevelInOneJump) {
+  Wheel w;
+  std::vector<uint64_t> ticks = boundaries();
+  std::vector<uint64_t> shuffled = ticks;
+  std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(7));
+  for (uint64_t k : shuffled) w.wheel.schedule(w.due(k), k);
+  EXPECT_EQ(w.wheel.size(), ticks.size());
+  // Each timer moves down the wheels as its slots come up, and all come
+  // out in deadline order.
+  EXPECT_EQ(w.advanceTo(ticks.back()), ticks);
+}
+
+TEST(TimerWheel, RandomStepsExpireEachTimerOnItsTick) {
+  Wheel w;
+  std::mt19937 random(11);
+  std::uniform_int_distribution<uint64_t> distance(1, 3 * kLevel3);
+  std::vector<uint64_t> ticks;
+  for (int i = 0; i < 2000; ++i) {
+    uint64_t k = distance(random);
+    ticks.push_back(k);
+    w.wheel.schedule(w.due(k), k);
+  }
+  std::sort(ticks.begin(), ticks.end());
+
+  std::uniform_int_distribution<uint64_t> step(1, 3 * kLevel1);
+  uint64_t now = 0;
+  size_t fired = 0;
+  while (fired < ticks.size()) {
+    now += step(random);
+    for (uint64_t k : w.advanceTo(now)) {
+      // Due by now, and not due by the previous step.
+      ASSERT_EQ(k, ticks[fired]);
+      ASSERT_LE(k, now);
+      ++fired;
+    }
+    ASSERT_TRUE(fired == ticks.size() || ticks[fired] > now);
+  }
+}
+
+TEST(TimerWheel, OverflowTimersArePlacedAgain) {
+  Wheel w;
+  // Half a wheel rotation in, a timer a rotation and a bit away sits in
+  // the overflow list until the next 2^26 boundary.
+  uint64_t now = kOverflow / 2 + 12345;
+  EXPECT_TRUE(w.advanceTo(now).empty());
+  uint64_t far = now + kOverflow + 99;
+  uint64_t farther = now + 2 * kOverflow + 5;
+  w.wheel.schedule(w.due(far), far);
+  w.wheel.schedule(w.due(farther), farther);
+  // The wheel's origin is a moment before start.
+  Clock::time_point rotation =
+      w.start + kTick * static_cast<Clock::rep>(kOverflow);
+  EXPECT_LE(w.wheel.nextExpiry(), rotation);
+  EXPECT_GT(w.wheel.nextExpiry(), rotation - kTick);
+
+  EXPECT_TRUE(w.advanceTo(kOverflow).empty());
+  EXPECT_TRUE(w.advanceTo(far - 1).empty());
+  EXPECT_EQ(w.advanceTo(far), std::vector<uint64_t>{far});
+  EXPECT_TRUE(w.advanceTo(farther - 1).empty());
+  EXPECT_EQ(w.advanceTo(farther), std::vector<uint64_t>{farther});
+}
+
+TEST(TimerWheel, CancelOnlyPendingTimers) {
+  Wheel w;
+  EXPECT_FALSE(w.wheel.cancel(0));
+  EXPECT_EQ(w.wheel.schedule(Clock::time_point::max(), 1), 0u);
+
+  TimerId expired = w.wheel.schedule(w.due(5), 5);
+  EXPECT_EQ(w.advanceTo(5), std::vector<uint64_t>{5});
+  EXPECT_FALSE(w.wheel.cancel(expired));
+
+  // Reuses the freed node under a new generation.
+  TimerId reused = w.wheel.schedule(w.due(kLevel2), 6);
+  EXPECT_NE(reused, expired);
+  EXPECT_EQ(static_cast<uint32_t>(reused), static_cast<uint32_t>(expired));
+  EXPECT_FALSE(w.wheel.cancel(expired));
+  EXPECT_EQ(w.wheel.size(), 1u);
+  EXPECT_TRUE(w.wheel.cancel(reused));
+  EXPECT_FALSE(w.wheel.cancel(reused));
+  EXPECT_EQ(w.wheel.size(), 0u);
+  EXPECT_TRUE(w.advanceTo(kLevel2 + 1).empty());
+
+  // A cancelled timer among others on the same slot.
+  TimerId a = w.wheel.schedule(w.due(kLevel2 + 10), 1);
+  TimerId b = w.wheel.schedule(w.due(kLevel2 + 10), 2);
+  TimerId c = w.wheel.schedule(w.due(kLevel2 + 10), 3);
+  EXPECT_TRUE(w.wheel.cancel(b));
+  std::vector<uint64_t> fired = w.advanceTo(kLevel2 + 10);
+  std::sort(fired.begin(), fired.end());
+  EXPECT_EQ(fired, (std::vector<uint64_t>{1, 3}));
+  EXPECT_FALSE(w.wheel.cancel(a));
+  EXPECT_FALSE(w.wheel.cancel(c));
+}
+
+TEST(TimerWheel, PastDeadlinesFireOnTheNextTick) {
+  Wheel w;
+  EXPECT_TRUE(w.advanceTo(100).empty());
+  w.wheel.schedule(w.due(50), 50);
+  w.wheel.schedule(w.start - kTick, 0);
+  std::vector<uint64_t> fired = w.advanceTo(101);
+  std::sort(fired.begin(), fired.end());
+  EXPECT_EQ(fired, (std::vector<uint64_t>{0, 50}));
+}
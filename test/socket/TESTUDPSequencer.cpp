@@ -0,0 +1,178 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "socket/UDP/UDPSequencer.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+class Receiver {
+ public:
+  explicit Receiver(const SequencerConfig &config) : sequencer(config) {}
+
+  void receive(const std::string &peer, const std::vector<uint8_t> &datagram,
+               Clock::time_point now) {
+    sequencer.receive(peer, peer, datagram, now, output, gaps);
+  }
+
+  // Payloads delivered so far, as their first byte.
+  std::vector<int> delivered() {
+    std::vector<int> result;
+    for (auto &payload : output) result.push_back(payload[0]);
+    return result;
+  }
+
+  UDPSequencer sequencer;
+  std::deque<std::vector<uint8_t>> output;
+  std::vector<SequenceGap> gaps;
+};
+
+// The stamped datagrams of payloads 0 .. count - 1.
+std::vector<std::vector<uint8_t>> send(UDPSequencer &sender, int count) {
+  std::vector<std::vector<uint8_t>> result;
+  for (int i = 0; i < count; ++i) {
+    result.push_back(sender.stamp({static_cast<uint8_t>(i)}));
+  }
+  return result;
+}
+
+SequencerConfig enabled() {
+  SequencerConfig config;
+  config.enabled = true;
+  config.reorderWindow = 8;
+  return config;
+}
+
+}  // namespace
+
+TEST(UDPSequencer, RestoresOrderAndDropsDuplicates) {
+  UDPSequencer sender(enabled());
+  auto datagrams = send(sender, 4);
+  Receiver receiver(enabled());
+  Clock::time_point now = Clock::now();
+  for (int i : {0, 2, 1, 1, 3}) receiver.receive("a", datagrams[i], now);
+  EXPECT_EQ(receiver.delivered(), (std::vector<int>{0, 1, 2, 3}));
+  EXPECT_EQ(receiver.sequencer.stats().duplicates, 1u);
+  EXPECT_EQ(receiver.sequencer.stats().reordered, 1u);
+}
+
+TEST(UDPSequencer, SenderRestartStartsNewSequence) {
+  UDPSequencer before(enabled());
+  auto old = send(before, 100);
+  Receiver receiver(enabled());
+  Clock::time_point now = Clock::now();
+  for (auto &datagram : old) receiver.receive("a", datagram, now);
+
+  // Same address, back to sequence 0, well behind the reorder window.
+  UDPSequencer after(enabled());
+  for (auto &datagram : send(after, 3)) receiver.receive("a", datagram, now);
+  EXPECT_EQ(receiver.output.size(), 103u);
+  EXPECT_EQ(receiver.sequencer.stats().restarts, 1u);
+  EXPECT_EQ(receiver.sequencer.stats().duplicates, 0u);
+}
+
+TEST(UDPSequencer, RestartAfterSilenceWithinWindow) {
+  SequencerConfig config = enabled();
+  config.peerIdleTimeout = std::chrono::milliseconds(100);
+  UDPSequencer before(config);
+  Receiver receiver(config);
+  Clock::time_point now = Clock::now();
+  for (auto &datagram : send(before, 4)) receiver.receive("a", datagram, now);
+
+  // Only four behind, which would pass for duplicates without the silence.
+  UDPSequencer after(config);
+  auto fresh = send(after, 2);
+  receiver.receive("a", fresh[0], now + std::chrono::milliseconds(10));
+  EXPECT_EQ(receiver.output.size(), 4u);
+  receiver.receive("a", fresh[0], now + std::chrono::milliseconds(200));
+  receiver.receive("a", fresh[1], now + std::chrono::milliseconds(200));
+  EXPECT_EQ(receiver.delivered(), (std::vector<int>{0, 1, 2, 3, 0, 1}));
+}
+
+TEST(UDPSequencer, ForgetsLeastRecentPeer) {
+  SequencerConfig config = enabled();
+  config.maxPeers = 2;
+  UDPSequencer sender(config);
+  auto datagrams = send(sender, 4);
+  Receiver receiver(config);
+  Clock::time_point now = Clock::now();
+
+  // Peer a holds 2 back behind the hole at 1.
+  receiver.receive("a", datagrams[0], now);
+  receiver.receive("a", datagrams[2], now);
+  receiver.receive("b", datagrams[0], now + std::chrono::milliseconds(1));
+  EXPECT_EQ(receiver.output.size(), 2u);
+
+  // A third peer pushes a out; what it held is released with its gap.
+  receiver.receive("c", datagrams[0], now + std::chrono::milliseconds(2));
+  EXPECT_EQ(receiver.delivered(), (std::vector<int>{0, 0, 2, 0}));
+  ASSERT_EQ(receiver.gaps.size(), 2u);
+  EXPECT_EQ(receiver.gaps[1].peer, "a");
+  EXPECT_EQ(receiver.gaps[1].firstMissing, 1u);
+  EXPECT_EQ(receiver.gaps[1].event, GapEvent::LOST);
+
+  // a comes back as a new sender.
+  receiver.receive("a", datagrams[1], now + std::chrono::milliseconds(3));
+  EXPECT_EQ(receiver.output.size(), 5u);
+  EXPECT_EQ(receiver.sequencer.stats().duplicates, 0u);
+}
+
+TEST(UDPSequencer, ExpireForgetsIdlePeers) {
+  SequencerConfig config = enabled();
+  config.peerIdleTimeout = std::chrono::milliseconds(100);
+  UDPSequencer sender(config);
+  auto datagrams = send(sender, 2);
+  Receiver receiver(config);
+  Clock::time_point now = Clock::now();
+  receiver.receive("a", datagrams[1], now);
+  receiver.sequencer.expire(now + std::chrono::milliseconds(200),
+                            receiver.output, receiver.gaps);
+  // Forgotten, so the older datagram is a fresh start, not a duplicate.
+  receiver.receive("a", datagrams[0], now + std::chrono::milliseconds(201));
+  EXPECT_EQ(receiver.delivered(), (std::vector<int>{1, 0}));
+  EXPECT_EQ(receiver.sequencer.stats().duplicates, 0u);
+}
+
+TEST(UDPSequencer, ReportsGapsWhenDetectedAndWhenLost) {
+  UDPSequencer sender(enabled());
+  auto datagrams = send(sender, 6);
+  Receiver receiver(enabled());
+  Clock::time_point now = Clock::now();
+  receiver.receive("a", datagrams[0], now);
+  EXPECT_TRUE(receiver.gaps.empty());
+
+  // 1 and 2 are missing as soon as 3 arrives; 2 filling in uncovers
+  // nothing new, 5 uncovers 4.
+  receiver.receive("a", datagrams[3], now);
+  ASSERT_EQ(receiver.gaps.size(), 1u);
+  EXPECT_EQ(receiver.gaps[0].event, GapEvent::DETECTED);
+  EXPECT_EQ(receiver.gaps[0].firstMissing, 1u);
+  EXPECT_EQ(receiver.gaps[0].count, 2u);
+  receiver.receive("a", datagrams[2], now);
+  EXPECT_EQ(receiver.gaps.size(), 1u);
+  receiver.receive("a", datagrams[5], now);
+  ASSERT_EQ(receiver.gaps.size(), 2u);
+  EXPECT_EQ(receiver.gaps[1].event, GapEvent::DETECTED);
+  EXPECT_EQ(receiver.gaps[1].firstMissing, 4u);
+  EXPECT_EQ(receiver.gaps[1].count, 1u);
+  EXPECT_EQ(receiver.delivered(), std::vector<int>{0});
+  EXPECT_EQ(receiver.sequencer.stats().gaps, 0u);
+
+  // Given up on after the reorder timeout, one LOST per hole.
+  receiver.sequencer.expire(now + std::chrono::milliseconds(50),
+                            receiver.output, receiver.gaps);
+  EXPECT_EQ(receiver.delivered(), (std::vector<int>{0, 2, 3, 5}));
+  ASSERT_EQ(receiver.gaps.size(), 4u);
+  EXPECT_EQ(receiver.gaps[2].event, GapEvent::LOST);
+  EXPECT_EQ(receiver.gaps[2].firstMissing, 1u);
+  EXPECT_EQ(receiver.gaps[2].count, 1u);
+  EXPECT_EQ(receiver.gaps[3].event, GapEvent::LOST);
+  EXPECT_EQ(receiver.gaps[3].firstMissing, 4u);
+  EXPECT_EQ(receiver.sequencer.stats().lost, 2u);
+}
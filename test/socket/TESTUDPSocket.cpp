@@ -0,0 +1,648 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "socket/IoUring.h"
+#include "socket/UDP/UDPSocket.h"
+
+namespace {
+
+// Below the ephemeral range (32768 up by default): a port there can be
+// held by a client's connection, or one in TIME_WAIT, and bind() fails.
+int getRandomPort() {
+  std::random_device rd;
+  std::mt19937 gen(rd());
+  std::uniform_int_distribution<> distrib(10000, 32000);
+  return distrib(gen);
+}
+
+Serializable message(const std::string &text) {
+  return Serializable(std::vector<uint8_t>(text.begin(), text.end()));
+}
+
+std::string text(Serializable serializable) {
+  std::vector<uint8_t> data = static_cast<std::vector<uint8_t>>(serializable);
+  return std::string(data.begin(), data.end());
+}
+
+// An AsyncWriter sink that holds the writer thread until released.
+class GatedSink {
+ public:
+  AsyncWriter::Sink sink() {
+    return [this](std::vector<std::vector<uint8_t>> &batch) {
+      std::unique_lock<std::mutex> lock(mutex);
+      for (auto &message : batch) sent.push_back(message[0]);
+      ++batches;
+      cv.notify_all();
+      cv.wait(lock, [this] { return released; });
+      return true;
+    };
+  }
+
+  // Waits until the writer is inside the sink with its first batch.
+  void waitForWriter() {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [this] { return batches > 0; });
+  }
+
+  void release() {
+    std::lock_guard<std::mutex> lock(mutex);
+    released = true;
+    cv.notify_all();
+  }
+
+  std::vector<int> received() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return sent;
+  }
+
+ private:
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool released = false;
+  int batches = 0;
+  std::vector<int> sent;
+};
+
+// One message sent, two queued behind it: a queue of two is full.
+AsyncWriteConfig tinyQueue(QueueFullPolicy whenFull) {
+  AsyncWriteConfig config;
+  config.enabled = true;
+  config.queueCapacity = 2;
+  config.maxBatch = 1;
+  config.whenFull = whenFull;
+  return config;
+}
+
+void fill(AsyncWriter &writer, GatedSink &gate) {
+  ASSERT_TRUE(writer.enqueue({0}));
+  gate.waitForWriter();
+  ASSERT_TRUE(writer.enqueue({1}));
+  ASSERT_TRUE(writer.enqueue({2}));
+}
+
+bool ioUringSupported() {
+#ifdef SOCKET_LIB_HAS_IO_URING
+  return IoUring::supported();
+#else
+  return false;
+#endif
+}
+
+std::string backendName(const ::testing::TestParamInfo<IoBackend> &info) {
+  switch (info.param) {
+    case IoBackend::AUTO:
+      return "AUTO";
+    case IoBackend::IO_URING:
+      return "IO_URING";
+    default:
+      return "EPOLL";
+  }
+}
+
+// Loopback tests run over every I/O backend; every socket a test opens
+// with open() uses the backend under test. AUTO runs everywhere, on EPOLL
+// where io_uring is missing.
+class UDPSocketLoopback : public ::testing::TestWithParam<IoBackend> {
+ protected:
+  void SetUp() override {
+    if (GetParam() == IoBackend::IO_URING && !ioUringSupported()) {
+      GTEST_SKIP() << "io_uring is not supported by this kernel";
+    }
+  }
+
+  void open(UDPSocket &socket) {
+    socket.setIoBackend(GetParam());
+    socket.open();
+  }
+};
+
+const auto kBackends = ::testing::Values(IoBackend::EPOLL, IoBackend::IO_URING,
+                                         IoBackend::AUTO);
+
+}  // namespace
+
+using UDPSocketRead = UDPSocketLoopback;
+using UDPSocketFec = UDPSocketLoopback;
+using UDPSocketAsyncWrite = UDPSocketLoopback;
+using UDPSocketSequencing = UDPSocketLoopback;
+using UDPSocketCoalescing = UDPSocketLoopback;
+using UDPSocketPacing = UDPSocketLoopback;
+INSTANTIATE_TEST_SUITE_P(Backend, UDPSocketRead, kBackends, backendName);
+INSTANTIATE_TEST_SUITE_P(Backend, UDPSocketFec, kBackends, backendName);
+INSTANTIATE_TEST_SUITE_P(Backend, UDPSocketAsyncWrite, kBackends, backendName);
+INSTANTIATE_TEST_SUITE_P(Backend, UDPSocketSequencing, kBackends, backendName);
+INSTANTIATE_TEST_SUITE_P(Backend, UDPSocketCoalescing, kBackends, backendName);
+INSTANTIATE_TEST_SUITE_P(Backend, UDPSocketPacing, kBackends, backendName);
+
+TEST(UDPSocketMulticast, LoopbackGroupDelivery) {
+  spdlog::set_level(spdlog::level::off);
+  const std::string group = "239.255.10.1";
+  int groupPort = getRandomPort();
+
+  UDPSocket sender(group, groupPort + 1, groupPort);
+  UDPSocket receiverA("127.0.0.1", groupPort, 0);
+  UDPSocket receiverB("127.0.0.1", groupPort, 0);
+  receiverA.setReuseAddress(true);
+  receiverB.setReuseAddress(true);
+  sender.open();
+  receiverA.open();
+  receiverB.open();
+
+  receiverA.joinGroup(group, "127.0.0.1");
+  receiverB.joinSourceGroup(group, "127.0.0.1", "127.0.0.1");
+  sender.setMulticastInterface("127.0.0.1");
+  sender.setMulticastLoop(true);
+  sender.setMulticastTTL(1);
+
+  sender.write(message("feed"));
+  EXPECT_EQ(text(receiverA.read()), "feed");
+  EXPECT_EQ(text(receiverB.read()), "feed");
+
+  receiverA.leaveGroup(group, "127.0.0.1");
+  sender.write(message("again"));
+  EXPECT_TRUE(receiverA.read().empty());
+  EXPECT_EQ(text(receiverB.read()), "again");
+}
+
+TEST(UDPSocketMulticast, JoinRequiresOpenSocket) {
+  UDPSocket socket("239.255.10.2", getRandomPort(), getRandomPort());
+  EXPECT_THROW(socket.joinGroup("239.255.10.2"), std::runtime_error);
+}
+
+TEST_P(UDPSocketRead, DeadlineAndTryRead) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  UDPSocket receiver("127.0.0.1", port, 0);
+  UDPSocket sender("127.0.0.1", port + 1, port);
+  open(receiver);
+  open(sender);
+
+  EXPECT_TRUE(receiver.tryRead().empty());
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_TRUE(receiver.read(start + std::chrono::milliseconds(50)).empty());
+  auto waited = std::chrono::steady_clock::now() - start;
+  EXPECT_GE(waited, std::chrono::milliseconds(50));
+  EXPECT_LT(waited, std::chrono::milliseconds(500));
+
+  sender.write(message("ready"));
+  EXPECT_EQ(text(receiver.read(std::chrono::steady_clock::now() +
+                               std::chrono::seconds(1))),
+            "ready");
+  IoBackend expected = GetParam() == IoBackend::EPOLL || !ioUringSupported()
+                           ? IoBackend::EPOLL
+                           : IoBackend::IO_URING;
+  EXPECT_EQ(receiver.getIoBackend(), expected);
+  EXPECT_EQ(sender.getIoBackend(), expected);
+}
+
+TEST_P(UDPSocketRead, CancelWakesBlockedRead) {
+  spdlog::set_level(spdlog::level::off);
+  UDPSocket receiver("127.0.0.1", getRandomPort(), 0);
+  open(receiver);
+  receiver.setReadTimeout(std::chrono::steady_clock::duration::max());
+
+  std::thread reader([&]() { EXPECT_TRUE(receiver.read().empty()); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  auto start = std::chrono::steady_clock::now();
+  receiver.close();
+  reader.join();
+  EXPECT_LT(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds(200));
+}
+
+TEST_P(UDPSocketFec, PartialBlockGetsParity) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  UDPSocket receiver("127.0.0.1", port, 0);
+  UDPSocket sender("127.0.0.1", port + 1, port);
+  FecConfig config;
+  config.scheme = FecScheme::REED_SOLOMON;
+  config.dataShards = 8;
+  config.parityShards = 2;
+  receiver.setFec(config);
+  config.parityDeadline = std::chrono::milliseconds(20);
+  sender.setFec(config);
+  open(receiver);
+  open(sender);
+
+  // flush() closes the block early.
+  sender.write(message("a"));
+  sender.write(message("b"));
+  sender.write(message("c"));
+  sender.flush();
+  EXPECT_EQ(sender.getFecStats().paritySent, 2u);
+  EXPECT_EQ(text(receiver.read()), "a");
+  EXPECT_EQ(text(receiver.read()), "b");
+  EXPECT_EQ(text(receiver.read()), "c");
+
+  // So does the deadline, without another write.
+  sender.write(message("d"));
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  EXPECT_EQ(sender.getFecStats().paritySent, 4u);
+  EXPECT_EQ(text(receiver.read()), "d");
+  EXPECT_TRUE(receiver.read(std::chrono::steady_clock::now() +
+                           std::chrono::milliseconds(50)).empty());
+  // The first parity of each short block completes it; the second finds it
+  // complete.
+  EXPECT_EQ(receiver.getFecStats().parityReceived, 2u);
+  EXPECT_EQ(receiver.getFecStats().unrecoverable, 0u);
+}
+
+TEST(AsyncWriter, BlockWaitsForRoom) {
+  GatedSink gate;
+  AsyncWriter writer(tinyQueue(QueueFullPolicy::BLOCK), gate.sink());
+  fill(writer, gate);
+
+  std::atomic<bool> returned{false};
+  std::thread producer([&] {
+    EXPECT_TRUE(writer.enqueue({3}));
+    returned = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(returned);
+  gate.release();
+  producer.join();
+  EXPECT_TRUE(writer.drain(std::chrono::seconds(5)));
+  EXPECT_EQ(gate.received(), (std::vector<int>{0, 1, 2, 3}));
+  EXPECT_EQ(writer.stats().sent, 4u);
+  EXPECT_EQ(writer.stats().dropped, 0u);
+}
+
+TEST(AsyncWriter, DropNewestRefusesAndCounts) {
+  GatedSink gate;
+  AsyncWriter writer(tinyQueue(QueueFullPolicy::DROP_NEWEST), gate.sink());
+  fill(writer, gate);
+  EXPECT_FALSE(writer.enqueue({3}));
+  EXPECT_EQ(writer.stats().dropped, 1u);
+  gate.release();
+  EXPECT_TRUE(writer.drain(std::chrono::seconds(5)));
+  EXPECT_EQ(gate.received(), (std::vector<int>{0, 1, 2}));
+  EXPECT_EQ(writer.stats().enqueued, 3u);
+}
+
+TEST(AsyncWriter, ThrowWhenFull) {
+  GatedSink gate;
+  AsyncWriter writer(tinyQueue(QueueFullPolicy::THROW), gate.sink());
+  fill(writer, gate);
+  EXPECT_THROW(writer.enqueue({3}), std::runtime_error);
+  gate.release();
+  EXPECT_TRUE(writer.drain(std::chrono::seconds(5)));
+  EXPECT_EQ(gate.received(), (std::vector<int>{0, 1, 2}));
+}
+
+TEST(AsyncWriter, DrainWaitsForTheSink) {
+  GatedSink gate;
+  AsyncWriter writer(tinyQueue(QueueFullPolicy::BLOCK), gate.sink());
+  fill(writer, gate);
+  EXPECT_FALSE(writer.drain(std::chrono::milliseconds(20)));
+  gate.release();
+  EXPECT_TRUE(writer.drain(std::chrono::steady_clock::duration::max()));
+  EXPECT_EQ(writer.stats().sent, 3u);
+}
+
+TEST(AsyncWriter, StopWithoutDrainDropsTheQueue) {
+  GatedSink gate;
+  AsyncWriter writer(tinyQueue(QueueFullPolicy::BLOCK), gate.sink());
+  fill(writer, gate);
+  // Blocked on the full queue until the stop turns it away.
+  std::thread producer([&] { EXPECT_FALSE(writer.enqueue({3})); });
+  std::thread stopper([&] { writer.stop(false); });
+  producer.join();
+  gate.release();
+  stopper.join();
+
+  EXPECT_EQ(gate.received(), (std::vector<int>{0}));
+  EXPECT_EQ(writer.stats().sent, 1u);
+  EXPECT_EQ(writer.stats().dropped, 3u);
+  EXPECT_FALSE(writer.enqueue({4}));
+  EXPECT_TRUE(writer.drain(std::chrono::seconds(1)));
+}
+
+TEST_P(UDPSocketAsyncWrite, BatchesArriveInOrder) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  UDPSocket receiver("127.0.0.1", port, 0);
+  UDPSocket sender("127.0.0.1", port + 1, port);
+  AsyncWriteConfig config;
+  config.enabled = true;
+  config.maxBatch = 32;
+  // Long enough for every write below to join a batch.
+  config.linger = std::chrono::milliseconds(200);
+  sender.setAsyncWrite(config);
+  open(receiver);
+  open(sender);
+
+  const int count = 96;
+  for (int i = 0; i < count; ++i) sender.write(message(std::to_string(i)));
+  EXPECT_TRUE(sender.drainWrites(std::chrono::seconds(5)));
+  AsyncWriteStats stats = sender.getAsyncWriteStats();
+  EXPECT_EQ(stats.enqueued, static_cast<uint64_t>(count));
+  EXPECT_EQ(stats.sent, static_cast<uint64_t>(count));
+  EXPECT_EQ(stats.failed, 0u);
+  // Full batches, each one sendmmsg() on Linux.
+  EXPECT_EQ(stats.batches, 3u);
+  for (int i = 0; i < count; ++i) {
+    ASSERT_EQ(text(receiver.read()), std::to_string(i));
+  }
+}
+
+TEST_P(UDPSocketAsyncWrite, CloseSendsTheQueue) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  UDPSocket receiver("127.0.0.1", port, 0);
+  UDPSocket sender("127.0.0.1", port + 1, port);
+  AsyncWriteConfig config;
+  config.enabled = true;
+  config.linger = std::chrono::seconds(1);
+  sender.setAsyncWrite(config);
+  open(receiver);
+  open(sender);
+
+  for (int i = 0; i < 10; ++i) sender.write(message(std::to_string(i)));
+  // Does not wait out the linger.
+  auto start = std::chrono::steady_clock::now();
+  sender.close();
+  EXPECT_LT(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds(500));
+  EXPECT_EQ(sender.getAsyncWriteStats().sent, 10u);
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_EQ(text(receiver.read()), std::to_string(i));
+  }
+}
+
+TEST_P(UDPSocketAsyncWrite, CloseWithoutDrainDropsTheQueue) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  UDPSocket receiver("127.0.0.1", port, 0);
+  UDPSocket sender("127.0.0.1", port + 1, port);
+  AsyncWriteConfig config;
+  config.enabled = true;
+  config.linger = std::chrono::seconds(1);
+  config.drainOnClose = false;
+  sender.setAsyncWrite(config);
+  open(receiver);
+  open(sender);
+
+  // Still lingering for a fuller batch when the socket closes.
+  for (int i = 0; i < 10; ++i) sender.write(message(std::to_string(i)));
+  sender.close();
+  AsyncWriteStats stats = sender.getAsyncWriteStats();
+  EXPECT_EQ(stats.sent, 0u);
+  EXPECT_EQ(stats.dropped, 10u);
+  EXPECT_TRUE(receiver.read(std::chrono::steady_clock::now() +
+                            std::chrono::milliseconds(50)).empty());
+}
+
+TEST_P(UDPSocketAsyncWrite, DropNewestAccountsForEveryWrite) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  UDPSocket receiver("127.0.0.1", port, 0);
+  UDPSocket sender("127.0.0.1", port + 1, port);
+  AsyncWriteConfig config = tinyQueue(QueueFullPolicy::DROP_NEWEST);
+  sender.setAsyncWrite(config);
+  open(receiver);
+  open(sender);
+
+  // Faster than one datagram per batch can go; whatever is refused is
+  // counted and never arrives.
+  const int count = 200;
+  for (int i = 0; i < count; ++i) sender.write(message(std::to_string(i)));
+  EXPECT_TRUE(sender.drainWrites(std::chrono::seconds(5)));
+  AsyncWriteStats stats = sender.getAsyncWriteStats();
+  EXPECT_EQ(stats.enqueued + stats.dropped, static_cast<uint64_t>(count));
+  EXPECT_EQ(stats.sent, stats.enqueued);
+
+  int last = -1;
+  uint64_t arrived = 0;
+  for (Serializable received = receiver.read(std::chrono::steady_clock::now() +
+                                             std::chrono::milliseconds(200));
+       !received.empty();
+       received = receiver.read(std::chrono::steady_clock::now() +
+                                std::chrono::milliseconds(50))) {
+    int value = std::stoi(text(received));
+    EXPECT_GT(value, last);
+    last = value;
+    ++arrived;
+  }
+  EXPECT_EQ(arrived, stats.sent);
+}
+
+TEST_P(UDPSocketSequencing, GapCallbackRunsWhileTheHoleCanFill) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  UDPSocket receiver("127.0.0.1", port, 0);
+  // Sends pre-stamped datagrams, so one can be held back.
+  UDPSocket sender("127.0.0.1", port + 1, port);
+  SequencerConfig config;
+  config.enabled = true;
+  config.reorderTimeout = std::chrono::seconds(2);
+  receiver.setSequencing(config);
+  std::mutex mutex;
+  std::vector<SequenceGap> gaps;
+  receiver.setGapCallback([&](const SequenceGap &gap) {
+    std::lock_guard<std::mutex> lock(mutex);
+    gaps.push_back(gap);
+  });
+  open(receiver);
+  open(sender);
+
+  UDPSequencer stamps(config);
+  std::vector<std::vector<uint8_t>> datagrams;
+  for (const char *payload : {"zero", "one", "two"}) {
+    datagrams.push_back(stamps.stamp(static_cast<std::vector<uint8_t>>(
+        message(payload))));
+  }
+  sender.write(Serializable(datagrams[0]));
+  EXPECT_EQ(text(receiver.read()), "zero");
+
+  sender.write(Serializable(datagrams[2]));
+  // Reported while the read still waits for the hole to fill.
+  EXPECT_TRUE(receiver.read(std::chrono::steady_clock::now() +
+                            std::chrono::milliseconds(100)).empty());
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    ASSERT_EQ(gaps.size(), 1u);
+    EXPECT_EQ(gaps[0].event, GapEvent::DETECTED);
+    EXPECT_EQ(gaps[0].firstMissing, 1u);
+    EXPECT_EQ(gaps[0].count, 1u);
+  }
+
+  // The retransmission arrives in time; nothing is lost.
+  sender.write(Serializable(datagrams[1]));
+  EXPECT_EQ(text(receiver.read()), "one");
+  EXPECT_EQ(text(receiver.read()), "two");
+  EXPECT_EQ(receiver.getSequenceStats().lost, 0u);
+  std::lock_guard<std::mutex> lock(mutex);
+  EXPECT_EQ(gaps.size(), 1u);
+}
+
+TEST_P(UDPSocketCoalescing, MessagesShareADatagram) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  UDPSocket receiver("127.0.0.1", port, 0);
+  // Sees the datagrams as they are on the wire.
+  UDPSocket raw("127.0.0.1", port + 2, 0);
+  UDPSocket sender("127.0.0.1", port + 1, port);
+  CoalescingConfig config;
+  config.enabled = true;
+  config.flushDeadline = std::chrono::seconds(10);
+  receiver.setCoalescing(config);
+  sender.setCoalescing(config);
+  open(receiver);
+  open(raw);
+  open(sender);
+
+  // The large one does not fit and closes the datagram before it; it
+  // travels alone.
+  std::string large(2000, 'x');
+  for (const std::string &text : {std::string("a"), std::string("bb"), large,
+                                   std::string("c")}) {
+    sender.write(message(text));
+  }
+  sender.flush();
+  EXPECT_EQ(text(receiver.read()), "a");
+  EXPECT_EQ(text(receiver.read()), "bb");
+  EXPECT_EQ(text(receiver.read()), large);
+  EXPECT_EQ(text(receiver.read()), "c");
+  EXPECT_TRUE(receiver.read(std::chrono::steady_clock::now() +
+                            std::chrono::milliseconds(50)).empty());
+
+  UDPSocket toRaw("127.0.0.1", port + 3, port + 2);
+  toRaw.setCoalescing(config);
+  open(toRaw);
+  for (int i = 0; i < 5; ++i) toRaw.write(message(std::to_string(i)));
+  toRaw.flush();
+  std::string datagram = text(raw.read());
+  // Marker, then five one-byte messages with their lengths.
+  EXPECT_EQ(datagram.size(), 11u);
+  EXPECT_TRUE(raw.read(std::chrono::steady_clock::now() +
+                       std::chrono::milliseconds(50)).empty());
+}
+
+TEST_P(UDPSocketCoalescing, DeadlineSendsWithoutFlush) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  UDPSocket receiver("127.0.0.1", port, 0);
+  UDPSocket sender("127.0.0.1", port + 1, port);
+  CoalescingConfig config;
+  config.enabled = true;
+  config.flushDeadline = std::chrono::milliseconds(30);
+  receiver.setCoalescing(config);
+  sender.setCoalescing(config);
+  open(receiver);
+  open(sender);
+
+  auto start = std::chrono::steady_clock::now();
+  sender.write(message("one"));
+  sender.write(message("two"));
+  EXPECT_EQ(text(receiver.read(start + std::chrono::seconds(2))), "one");
+  EXPECT_GE(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds(25));
+  EXPECT_EQ(text(receiver.read(start + std::chrono::seconds(2))), "two");
+}
+
+TEST_P(UDPSocketCoalescing, HeadersFitTheDatagramSize) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  UDPSocket raw("127.0.0.1", port, 0);
+  UDPSocket sender("127.0.0.1", port + 1, port);
+  CoalescingConfig coalescing;
+  coalescing.enabled = true;
+  coalescing.maxDatagramSize = 200;
+  coalescing.flushDeadline = std::chrono::seconds(10);
+  sender.setCoalescing(coalescing);
+  // Enabled after coalescing, so the size is fitted again.
+  SequencerConfig sequencing;
+  sequencing.enabled = true;
+  sender.setSequencing(sequencing);
+  FecConfig fec;
+  fec.scheme = FecScheme::REED_SOLOMON;
+  fec.dataShards = 4;
+  fec.parityShards = 2;
+  sender.setFec(fec);
+  open(raw);
+  open(sender);
+
+  for (int i = 0; i < 200; ++i) sender.write(message(std::string(10, 'm')));
+  sender.flush();
+  size_t largest = 0;
+  size_t datagrams = 0;
+  for (Serializable datagram = raw.read(); !datagram.empty();
+       datagram = raw.read(std::chrono::steady_clock::now() +
+                           std::chrono::milliseconds(50))) {
+    largest = std::max(largest, text(datagram).size());
+    ++datagrams;
+  }
+  EXPECT_GT(datagrams, 10u);
+  EXPECT_LE(largest, 200u);
+  // Not far below it either.
+  EXPECT_GE(largest, 190u);
+}
+
+TEST_P(UDPSocketCoalescing, IPv6PeerLeavesRoomForItsHeader) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  UDPSocket raw("::1", port, 0);
+  UDPSocket sender("::1", port + 1, port);
+  CoalescingConfig coalescing;
+  coalescing.enabled = true;
+  coalescing.maxDatagramSize = 200;
+  coalescing.flushDeadline = std::chrono::seconds(10);
+  sender.setCoalescing(coalescing);
+  try {
+    open(raw);
+    open(sender);
+  } catch (const std::runtime_error &) {
+    GTEST_SKIP() << "no IPv6 loopback";
+  }
+
+  for (int i = 0; i < 40; ++i) sender.write(message(std::string(10, 'm')));
+  sender.flush();
+  size_t largest = 0;
+  for (Serializable datagram = raw.read(); !datagram.empty();
+       datagram = raw.read(std::chrono::steady_clock::now() +
+                           std::chrono::milliseconds(50))) {
+    largest = std::max(largest, text(datagram).size());
+  }
+  EXPECT_LE(largest, 180u);
+  EXPECT_GE(largest, 170u);
+}
+
+TEST_P(UDPSocketPacing, UserPacingSpacesDatagrams) {
+  spdlog::set_level(spdlog::level::off);
+  int port = getRandomPort();
+  UDPSocket receiver("127.0.0.1", port, 0);
+  UDPSocket sender("127.0.0.1", port + 1, port);
+  PacingConfig config;
+  config.enabled = true;
+  config.rateBytesPerSecond = 100000;
+  config.burstBytes = 1000;
+  config.mode = PacingMode::USER;
+  // Applied when the socket opens.
+  sender.setPacing(config);
+  open(receiver);
+  open(sender);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < 11; ++i) sender.write(message(std::string(1000, 'p')));
+  // The first fits the burst; the other ten take 10 ms each.
+  EXPECT_GE(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds(95));
+  PacingStats stats = sender.getPacingStats();
+  EXPECT_FALSE(stats.kernelPacing);
+  EXPECT_EQ(stats.pacedWrites, 11u);
+  EXPECT_EQ(stats.delayedWrites, 10u);
+  EXPECT_LE(stats.maxDelay, std::chrono::milliseconds(10));
+  for (int i = 0; i < 11; ++i) EXPECT_EQ(text(receiver.read()).size(), 1000u);
+}
@@ -0,0 +1,306 @@
+#include <gtest/gtest.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "socket/Unix/UnixSocket.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// An abstract address no other test run uses.
+std::string abstractPath() {
+  std::random_device rd;
+  return "@socketlib-test-" + std::to_string(getpid()) + "-" +
+         std::to_string(rd());
+}
+
+Serializable message(const std::string &text) {
+  return Serializable(std::vector<uint8_t>(text.begin(), text.end()));
+}
+
+std::string text(Serializable serializable) {
+  std::vector<uint8_t> data = static_cast<std::vector<uint8_t>>(serializable);
+  return std::string(data.begin(), data.end());
+}
+
+// A file system address in the temporary directory.
+std::string filePath() {
+  const char *directory = std::getenv("TMPDIR");
+  std::random_device rd;
+  return std::string(directory != nullptr ? directory : "/tmp") +
+         "/socketlib-test-" + std::to_string(getpid()) + "-" +
+         std::to_string(rd()) + ".sock";
+}
+
+bool exists(const std::string &path) {
+  struct stat status;
+  return stat(path.c_str(), &status) == 0;
+}
+
+std::string name(UnixSocketType type) {
+  switch (type) {
+    case UnixSocketType::SEQPACKET:
+      return "SEQPACKET";
+    case UnixSocketType::DATAGRAM:
+      return "DATAGRAM";
+    default:
+      return "STREAM";
+  }
+}
+
+// Records connection events.
+class Events : public Subscriber {
+ public:
+  void update(Serializable) override {}
+
+  void onConnectionEvent(ConnectionId connection,
+                         ConnectionEvent event) override {
+    std::lock_guard<std::mutex> lock(mutex);
+    (event == ConnectionEvent::CONNECTED ? connected : disconnected)
+        .push_back(connection);
+  }
+
+  std::vector<ConnectionId> disconnectedIds() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return disconnected;
+  }
+
+  std::mutex mutex;
+  std::vector<ConnectionId> connected;
+  std::vector<ConnectionId> disconnected;
+};
+
+const UnixSocketType kTypes[] = {UnixSocketType::STREAM,
+                                 UnixSocketType::SEQPACKET,
+                                 UnixSocketType::DATAGRAM};
+
+}  // namespace
+
+TEST(UnixSocket, RequestAndReplyOverEveryType) {
+  spdlog::set_level(spdlog::level::off);
+  for (UnixSocketType type : kTypes) {
+    for (bool abstract : {true, false}) {
+      SCOPED_TRACE(name(type) + (abstract ? " abstract" : " file"));
+      std::string path = abstract ? abstractPath() : filePath();
+      UnixSocket server(path, UnixSocket::SERVER, type);
+      server.open();
+      // An abstract address leaves nothing in the file system.
+      EXPECT_EQ(exists(path), !abstract);
+      UnixSocket client(path, UnixSocket::CLIENT, type);
+      client.open();
+
+      client.write(message("request"));
+      ConnectionId from = 0;
+      EXPECT_EQ(text(server.read(from)), "request");
+      EXPECT_NE(from, 0u);
+      EXPECT_TRUE(server.writeTo(from, message("reply")));
+      EXPECT_EQ(text(client.read()), "reply");
+
+      client.close();
+      server.close();
+      EXPECT_FALSE(exists(path));
+    }
+  }
+}
+
+TEST(UnixSocket, MessageTypesKeepBoundaries) {
+  spdlog::set_level(spdlog::level::off);
+  for (UnixSocketType type :
+       {UnixSocketType::SEQPACKET, UnixSocketType::DATAGRAM}) {
+    SCOPED_TRACE(name(type));
+    std::string path = abstractPath();
+    UnixSocket server(path, UnixSocket::SERVER, type);
+    server.open();
+    UnixSocket client(path, UnixSocket::CLIENT, type);
+    client.open();
+
+    // All three are queued before the first read.
+    client.write(message("a"));
+    client.write(message("bb"));
+    client.write(message("ccc"));
+    EXPECT_EQ(text(server.read()), "a");
+    EXPECT_EQ(text(server.read()), "bb");
+    EXPECT_EQ(text(server.read()), "ccc");
+  }
+}
+
+TEST(UnixSocket, EachPeerHasItsOwnConnection) {
+  spdlog::set_level(spdlog::level::off);
+  for (UnixSocketType type : kTypes) {
+    SCOPED_TRACE(name(type));
+    std::string path = abstractPath();
+    UnixSocket server(path, UnixSocket::SERVER, type);
+    auto events = std::make_shared<Events>();
+    server.addSubscriber(events);
+    server.open();
+    UnixSocket first(path, UnixSocket::CLIENT, type);
+    UnixSocket second(path, UnixSocket::CLIENT, type);
+    first.open();
+    second.open();
+
+    first.write(message("first"));
+    ConnectionId firstId = 0;
+    ASSERT_EQ(text(server.read(firstId)), "first");
+    second.write(message("second"));
+    ConnectionId secondId = 0;
+    ASSERT_EQ(text(server.read(secondId)), "second");
+    EXPECT_NE(firstId, secondId);
+    EXPECT_EQ(server.getConnections(),
+              (std::vector<ConnectionId>{firstId, secondId}));
+
+    // Replies go to the peer they are for; broadcast reaches both.
+    EXPECT_TRUE(server.writeTo(secondId, message("to second")));
+    EXPECT_TRUE(server.writeTo(firstId, message("to first")));
+    EXPECT_EQ(text(first.read()), "to first");
+    EXPECT_EQ(text(second.read()), "to second");
+    EXPECT_EQ(server.broadcast(message("all")), 2u);
+    EXPECT_EQ(text(first.read()), "all");
+    EXPECT_EQ(text(second.read()), "all");
+
+    server.disconnect(firstId);
+    if (type != UnixSocketType::DATAGRAM) {
+      // The peer sees the end of the stream, and the server's next read
+      // drops the connection.
+      EXPECT_TRUE(first.read().empty());
+      EXPECT_TRUE(first.getConnections().empty());
+      server.read(Clock::now() + std::chrono::milliseconds(100));
+    }
+    EXPECT_EQ(events->disconnectedIds(), std::vector<ConnectionId>{firstId});
+    EXPECT_EQ(server.getConnections(), std::vector<ConnectionId>{secondId});
+    EXPECT_FALSE(server.writeTo(firstId, message("gone")));
+  }
+}
+
+TEST(UnixSocket, CloseWakesAWaitingRead) {
+  spdlog::set_level(spdlog::level::off);
+  for (UnixSocketType type : kTypes) {
+    SCOPED_TRACE(name(type));
+    std::string path = abstractPath();
+    UnixSocket server(path, UnixSocket::SERVER, type);
+    server.open();
+    UnixSocket client(path, UnixSocket::CLIENT, type);
+    client.open();
+
+    auto serverRead = std::async(std::launch::async, [&] {
+      return server.read(Clock::time_point::max());
+    });
+    auto clientRead = std::async(std::launch::async, [&] {
+      return client.read(Clock::time_point::max());
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    auto closing = Clock::now();
+    server.close();
+    client.close();
+    ASSERT_EQ(serverRead.wait_for(std::chrono::seconds(1)),
+              std::future_status::ready);
+    ASSERT_EQ(clientRead.wait_for(std::chrono::seconds(1)),
+              std::future_status::ready);
+    EXPECT_TRUE(serverRead.get().empty());
+    EXPECT_TRUE(clientRead.get().empty());
+    EXPECT_LT(Clock::now() - closing, std::chrono::milliseconds(200));
+    EXPECT_TRUE(server.tryRead().empty());
+  }
+}
+
+TEST(UnixSocket, PassesDescriptors) {
+  spdlog::set_level(spdlog::level::off);
+  for (UnixSocketType type : kTypes) {
+    SCOPED_TRACE(name(type));
+    std::string path = abstractPath();
+    UnixSocket server(path, UnixSocket::SERVER, type);
+    server.open();
+    UnixSocket client(path, UnixSocket::CLIENT, type);
+    client.open();
+
+    int pipeFds[2];
+    ASSERT_EQ(pipe(pipeFds), 0);
+    // Client to server, with data, then back with the filler byte only.
+    ASSERT_TRUE(client.sendFds({pipeFds[0]}, message("pipe")));
+    ConnectionId from = 0;
+    EXPECT_EQ(text(server.read(from)), "pipe");
+    std::vector<int> received = server.takeReceivedFds();
+    ASSERT_EQ(received.size(), 1u);
+    EXPECT_NE(received[0], pipeFds[0]);
+    EXPECT_TRUE(server.takeReceivedFds().empty());
+
+    ASSERT_TRUE(server.sendFdsTo(from, {pipeFds[1], received[0]}));
+    EXPECT_EQ(client.read().size(), 1u);
+    std::vector<int> returned = client.takeReceivedFds();
+    ASSERT_EQ(returned.size(), 2u);
+
+    // Each received descriptor is the same pipe.
+    ASSERT_EQ(::write(returned[0], "x", 1), 1);
+    char byte = 0;
+    ASSERT_EQ(::read(received[0], &byte, 1), 1);
+    EXPECT_EQ(byte, 'x');
+    ASSERT_EQ(::write(pipeFds[1], "y", 1), 1);
+    ASSERT_EQ(::read(returned[1], &byte, 1), 1);
+    EXPECT_EQ(byte, 'y');
+
+    for (int fd : {pipeFds[0], pipeFds[1], received[0], returned[0],
+                   returned[1]}) {
+      ::close(fd);
+    }
+  }
+}
+
+TEST(UnixSocket, ReadsWaitNoLongerThanTheirDeadline) {
+  spdlog::set_level(spdlog::level::off);
+  std::string path = abstractPath();
+  UnixSocket server(path, UnixSocket::SERVER, UnixSocketType::DATAGRAM);
+  server.open();
+  UnixSocket client(path, UnixSocket::CLIENT, UnixSocketType::DATAGRAM);
+  client.open();
+
+  auto start = Clock::now();
+  EXPECT_TRUE(server.tryRead().empty());
+  EXPECT_LT(Clock::now() - start, std::chrono::milliseconds(50));
+  start = Clock::now();
+  EXPECT_TRUE(server.read(start + std::chrono::milliseconds(100)).empty());
+  EXPECT_GE(Clock::now() - start, std::chrono::milliseconds(100));
+  EXPECT_LT(Clock::now() - start, std::chrono::seconds(1));
+
+  client.write(message("ping"));
+  EXPECT_EQ(text(server.tryRead()), "ping");
+  client.write(message("pong"));
+  ConnectionId from = 0;
+  EXPECT_EQ(text(server.read(from, Clock::now() + std::chrono::seconds(5))),
+            "pong");
+  EXPECT_NE(from, 0u);
+}
+
+TEST(UnixSocket, CancelWakesAWaitingRead) {
+  spdlog::set_level(spdlog::level::off);
+  std::string path = abstractPath();
+  UnixSocket server(path, UnixSocket::SERVER, UnixSocketType::DATAGRAM);
+  server.open();
+
+  // A cancel() nobody waits for does not end later reads.
+  server.cancel();
+  auto start = Clock::now();
+  EXPECT_TRUE(server.read(start + std::chrono::milliseconds(50)).empty());
+  EXPECT_GE(Clock::now() - start, std::chrono::milliseconds(50));
+
+  auto reader = std::async(std::launch::async, [&] {
+    return server.read(Clock::time_point::max());
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  auto cancelled = Clock::now();
+  server.cancel();
+  ASSERT_EQ(reader.wait_for(std::chrono::seconds(1)),
+            std::future_status::ready);
+  EXPECT_TRUE(reader.get().empty());
+  EXPECT_LT(Clock::now() - cancelled, std::chrono::milliseconds(100));
+}